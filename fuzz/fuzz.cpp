@@ -512,12 +512,12 @@ void testTransportWideFeedbackMessage()
 			//For each lost
 			for (DWORD i = lastFeedbackPacketExtSeqNum+1; i<transportExtSeqNum; ++i)
 				//Add it
-				field->packets.insert(std::make_pair(i,0));
+				field->packets.emplace_back(i,0);
 		//Store last
 		lastFeedbackPacketExtSeqNum = transportExtSeqNum;
 
 		//Add this one
-		field->packets.insert(std::make_pair(transportSeqNum,time));
+		field->packets.emplace_back(transportSeqNum,time);
 
 	}
 
@@ -582,6 +582,72 @@ void testTransportWideFeedbackMessageParser()
 	}
 }
 
+void testTransportWideFeedbackMessageRoundTrip()
+{
+	BYTE data[65536];
+	
+	//Use fixed seed so failures can be reproduced
+	srand(27);
+	
+	//Random feedbacks
+	for (DWORD n=0;n<1000;++n)
+	{
+		RTCPRTPFeedback::TransportWideFeedbackMessageField field(n);
+		
+		//Random start, count and loss/jitter pattern
+		DWORD base = rand() & 0xFFFF;
+		DWORD count = 1 + rand()%600;
+		DWORD loss = rand()%100;
+		DWORD jitter = 1 + rand()%50000;
+		QWORD time = 1000000 + rand()%100000000;
+		
+		//Fill packets
+		for (DWORD i=0;i<count;++i)
+		{
+			//Lost?
+			if ((DWORD)rand()%100<loss)
+				field.packets.emplace_back(base+i,0);
+			else
+				//Arrival with random jitter, may be negative
+				field.packets.emplace_back(base+i,time = time + (int)(rand()%jitter) - (int)(jitter/4));
+		}
+		
+		//Serialize
+		DWORD len = field.Serialize(data,sizeof(data));
+		assert(len);
+		assert(len==field.GetSize());
+		
+		//Parse it
+		RTCPRTPFeedback::TransportWideFeedbackMessageField parsed;
+		assert(parsed.Parse(data,len)==len);
+		assert(parsed.packets.size()==field.packets.size());
+		
+		//Compare
+		for (DWORD i=0;i<count;++i)
+		{
+			assert(parsed.packets[i].first==(field.packets[i].first & 0xFFFF));
+			assert(!parsed.packets[i].second==!field.packets[i].second);
+			if (field.packets[i].second)
+				assert(std::abs((long long)parsed.packets[i].second-(long long)field.packets[i].second)<250);
+		}
+		
+		//Truncated or corrupted input must not crash
+		parsed.Parse(data,rand()%len);
+		data[8+rand()%(len-8)] ^= 1<<(rand()%8);
+		parsed.Parse(data,len);
+	}
+	
+	//Random garbage must not crash
+	for (DWORD n=0;n<10000;++n)
+	{
+		DWORD len = rand()%64;
+		for (DWORD i=0;i<len;++i)
+			data[i] = rand();
+		RTCPRTPFeedback::TransportWideFeedbackMessageField parsed;
+		parsed.Parse(data,len);
+	}
+}
+
 void testRTPPacket()
 {
 
@@ -784,6 +850,7 @@ int main()
 	testTransportField();
 	testTransportWideFeedbackMessage();
 	testTransportWideFeedbackMessageParser();
+	testTransportWideFeedbackMessageRoundTrip();
 	testBye();
 	
 	return 0;
@@ -2,6 +2,9 @@
 #define ACTIVESPEAKERDETECTOR_H
 #include "config.h"
 
+#include <map>
+#include <vector>
+
 class ActiveSpeakerDetector
 {
 public:
@@ -9,6 +12,7 @@ public:
 	{
 	public:
 		virtual void onActiveSpeakerChanded(uint32_t id) = 0;
+		virtual void onActiveSpeakersChanged(const std::vector<uint32_t>& speakers) {}
 	};
 public:
 	ActiveSpeakerDetector(Listener *listener) : listener(listener) {}
@@ -19,14 +23,20 @@ public:
 	void SetMaxAccumulatedScore(uint64_t maxAcummulatedScore)	{ this->maxAcummulatedScore = maxAcummulatedScore;	}	
 	void SetNoiseGatingThreshold(uint8_t noiseGatingThreshold)	{ this->noiseGatingThreshold = noiseGatingThreshold;	}	
 	void SetMinActivationScore(uint32_t minActivationScore)		{ this->minActivationScore = minActivationScore;	}	
+	void SetLastN(uint32_t lastN);
+	void SetLastNHysteresis(uint64_t lastNHysteresis)		{ this->lastNHysteresis = lastNHysteresis;		}
+	const std::vector<uint32_t>& GetActiveSpeakers() const		{ return activeSpeakers;				}
 protected:
 	void Process(uint64_t now);
+	void UpdateLastN(uint64_t now, bool changed);
 	
 private:
 	struct SpeakerInfo
 	{
 		uint64_t score;
 		uint64_t ts;
+		bool active		= false;	//On the last N set
+		uint64_t activeSince	= 0;
 	};
 private:
 	uint64_t last			= 0;
@@ -36,6 +46,9 @@ private:
 	uint64_t maxAcummulatedScore	= 2500;
 	uint8_t noiseGatingThreshold	= 127;
 	uint64_t minActivationScore	= 0;
+	uint32_t lastN			= 0;
+	uint64_t lastNHysteresis	= 250;
+	std::vector<uint32_t> activeSpeakers;	//Last N set, ranked by score
 	
 	Listener* listener;
 	std::map<uint32_t,SpeakerInfo> speakers;
@@ -0,0 +1,88 @@
+#ifndef AUDIOCONFERENCEENGINE_H
+#define AUDIOCONFERENCEENGINE_H
+
+#include <vector>
+#include <set>
+#include <atomic>
+#include <pthread.h>
+
+#include "config.h"
+#include "use.h"
+#include "audiomixer.h"
+#include "audiodecoder.h"
+
+/*
+ * Runs decode, mix and encode of all the participants of many audio
+ * conferences on a small pool of worker threads, instead of one decoding
+ * thread, one encoding thread and one pipe per participant plus a mixing
+ * thread per conference.
+ *  - Each worker wakes up on absolute 10ms deadlines (clock_nanosleep with
+ *    TIMER_ABSTIME), so scheduling jitter does not accumulate as drift.
+ *  - Conferences are assigned to the least loaded worker when added.
+ *  - On each tick, queued packets of every decoder are decoded into the
+ *    mixer, which then mixes and encodes its outputs.
+ *  - If a worker wakes up late it processes the missed ticks at once, and
+ *    resyncs the clock after kMaxCatchUp ticks.
+ * Mixers must be initialized offline ("online" property set to false) and
+ * participant outputs encoded by the mixer (AudioMixer::SetEncodedOutput).
+ * Decoders must not be started.
+ */
+class AudioConferenceEngine
+{
+public:
+	static constexpr DWORD kTickPeriod	= 10;	// ms
+	static constexpr DWORD kMaxCatchUp	= 5;	// ticks
+	static constexpr DWORD kReportInterval	= 1000;	// ticks
+public:
+	AudioConferenceEngine(DWORD numWorkers = 2);
+	~AudioConferenceEngine();
+
+	bool Start();
+	bool Stop();
+
+	bool AddConference(AudioMixer* mixer);
+	bool RemoveConference(AudioMixer* mixer);
+	bool AddDecoder(AudioMixer* mixer, AudioDecoderWorker* decoder);
+	bool RemoveDecoder(AudioMixer* mixer, AudioDecoderWorker* decoder);
+
+	DWORD GetNumWorkers() const	{ return workers.size();	}
+	DWORD GetConferenceCount();
+	//Tick stats of all workers, times in us
+	QWORD GetTicks();
+	QWORD GetMissedTicks();
+	QWORD GetLastTickTime();
+	QWORD GetMaxTickTime();
+	QWORD GetAvgTickTime();
+private:
+	struct Conference
+	{
+		AudioMixer* mixer;
+		std::set<AudioDecoderWorker*> decoders;
+	};
+
+	struct Worker
+	{
+		AudioConferenceEngine* engine = nullptr;
+		pthread_t thread;
+		Mutex mutex;
+		std::vector<Conference> conferences;
+		//Stats, only written by the worker thread
+		std::atomic<QWORD> ticks		{0};
+		std::atomic<QWORD> missed		{0};
+		std::atomic<QWORD> lastTickTime	{0};
+		std::atomic<QWORD> maxTickTime	{0};
+		std::atomic<QWORD> totalTickTime	{0};
+	};
+
+	static void* run(void* par);
+	void Run(Worker* worker);
+	void Tick(Worker* worker, DWORD ms);
+	static Conference* GetConference(Worker* worker, AudioMixer* mixer);
+private:
+	//Serializes changes on conferences
+	Mutex mutex;
+	std::vector<Worker*> workers;
+	volatile bool running = false;
+};
+
+#endif /* AUDIOCONFERENCEENGINE_H */
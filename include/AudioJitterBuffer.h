@@ -0,0 +1,66 @@
+#ifndef AUDIOJITTERBUFFER_H
+#define AUDIOJITTERBUFFER_H
+
+#include <map>
+#include <deque>
+#include <vector>
+
+#include "config.h"
+#include "use.h"
+#include "rtp/RTPPacket.h"
+
+/*
+ * Audio playout buffer ordering packets by RTP timestamp, and estimating
+ * the playout delay needed to absorb the network jitter.
+ *  - Target delay is the 95th percentile of the packet transit time over
+ *    the last packets, relative to the fastest one, plus one packet.
+ *  - It grows immediately on jitter spikes and shrinks slowly afterwards.
+ *  - Packets arriving after their playout time are dropped.
+ * Decoding and playout timing is driven by the caller (AudioDecoderWorker),
+ * which also uses the time-stretching helpers to track the target delay.
+ */
+class AudioJitterBuffer
+{
+public:
+	static constexpr DWORD kMinDelay	= 20;	// ms
+	static constexpr DWORD kMaxDelay	= 500;	// ms
+	static constexpr DWORD kMaxPackets	= 250;
+	static constexpr DWORD kWindowSize	= 100;	// packets
+	static constexpr DWORD kMinPitch	= 25;	// 0.1 ms
+	static constexpr DWORD kMaxPitch	= 125;	// 0.1 ms
+public:
+	bool Add(const RTPPacket::shared& packet, QWORD now);
+	//Remove packets older than from, and get first one before to if any
+	RTPPacket::shared Pop(QWORD from, QWORD to, QWORD* timestamp);
+	void Reset();
+
+	bool  IsEmpty();
+	QWORD GetFirstTimestamp();
+	DWORD GetClockRate() const	{ return clockRate;	}
+	//Duration of the media buffered after the playout timestamp, in ms
+	DWORD GetBufferedDuration(QWORD playout);
+	DWORD GetTargetDelay() const	{ return targetDelay;	}
+	QWORD GetLatePackets() const	{ return late;		}
+	QWORD GetDroppedPackets() const	{ return dropped;	}
+
+	//Time-stretching by one pitch period, return number of samples removed or added
+	static DWORD Accelerate(std::vector<SWORD>& samples, DWORD rate);
+	static DWORD Expand(std::vector<SWORD>& samples, DWORD rate);
+	static DWORD GetPitchPeriod(const SWORD* samples, DWORD len, DWORD rate);
+private:
+	Mutex mutex;
+	std::map<QWORD,RTPPacket::shared> packets;
+	std::deque<int64_t> transits;
+	DWORD clockRate		= 0;
+	DWORD frameDuration	= 0;
+	DWORD targetDelay	= kMinDelay;
+	QWORD playout		= 0;
+	QWORD late		= 0;
+	QWORD dropped		= 0;
+	//Newest packet
+	QWORD last		= 0;
+	WORD  lastSeqNum	= 0;
+	bool  first		= true;
+};
+
+#endif /* AUDIOJITTERBUFFER_H */
@@ -0,0 +1,48 @@
+#ifndef AUDIOMIXKERNEL_H
+#define AUDIOMIXKERNEL_H
+
+#include "config.h"
+
+/*
+ * Mixing primitives on 32 bit accumulators, so the sum of any number of
+ * participants never wraps. AVX2 when available, SSE2 otherwise, with a
+ * scalar tail so any length is accepted.
+ */
+class AudioMixKernel
+{
+public:
+	static void Clear(int32_t* acc, DWORD len);
+	static void Accumulate(int32_t* acc, const SWORD* samples, DWORD len);
+	//dst = acc - samples, used to remove own voice from the mix
+	static void Subtract(int32_t* dst, const int32_t* acc, const SWORD* samples, DWORD len);
+	static int32_t GetPeak(const int32_t* acc, DWORD len);
+	//Apply a linear gain ramp from start to end and saturate to 16 bits
+	static void Scale(SWORD* dst, const int32_t* acc, DWORD len, float start, float end);
+	static void Saturate(SWORD* dst, const int32_t* acc, DWORD len);
+};
+
+/*
+ * Peak limiter bringing a 32 bit mix back to 16 bits without wrapping.
+ *  - Gain is reduced within the same block when the peak goes above the
+ *    threshold, ramping from previous gain to avoid discontinuities.
+ *  - Gain recovers slowly towards unity once the mix gets quieter.
+ *  - Anything still above full scale is saturated.
+ * One instance per output signal, as it keeps the gain between blocks.
+ */
+class AudioLimiter
+{
+public:
+	static constexpr int32_t kThreshold	= 29204;	// -1dBFS
+	static constexpr float   kRelease	= 0.05f;	// gain recovered per block
+public:
+	void Process(SWORD* dst, const int32_t* acc, DWORD len);
+	void Reset()			{ gain = 1.0f;		}
+
+	float GetGain() const		{ return gain;		}
+	QWORD GetLimitedBlocks() const	{ return limited;	}
+private:
+	float gain	= 1.0f;
+	QWORD limited	= 0;
+};
+
+#endif /* AUDIOMIXKERNEL_H */
@@ -31,6 +31,12 @@
 #include "Endpoint.h"
 #include "SRTPSession.h"
 #include "SendSideBandwidthEstimation.h"
+#include "ProbeController.h"
+#include "LayerAllocator.h"
+#include "rtp/RTCPScheduler.h"
+#include "rtp/TransportWideReceivedPackets.h"
+#include "rtp/RTPPacer.h"
+#include "rtp/RTPPaddingTemplate.h"
 
 class DTLSICETransport : 
 	public RTPSender,
@@ -74,6 +80,7 @@ public:
 	virtual int SendPLI(DWORD ssrc) override;
 	virtual int Enqueue(const RTPPacket::shared& packet) override;
 	virtual int Enqueue(const RTPPacket::shared& packet,std::function<RTPPacket::shared(const RTPPacket::shared&)> modifier) override;
+	virtual int Send(RTPPacket::shared&& packet) override;
 	int Dump(const char* filename, bool inbound = true, bool outbound = true, bool rtcp = true, bool rtpHeadersOnly = false);
 	int Dump(UDPDumper* dumper, bool inbound = true, bool outbound = true, bool rtcp = true, bool rtpHeadersOnly = false);
         int DumpBWEStats(const char* filename);
@@ -92,7 +99,9 @@ public:
 	void SetBandwidthProbing(bool probe);
 	void SetMaxProbingBitrate(DWORD bitrate)	{ this->maxProbingBitrate = bitrate;	}
 	void SetProbingBitrateLimit(DWORD bitrate)	{ this->probingBitrateLimit = bitrate;	}
+	void SetStartBitrate(DWORD bitrate)		{ this->startBitrate = bitrate;		}
 	void SetSenderSideEstimatorListener(RemoteRateEstimator::Listener* listener) { senderSideBandwidthEstimator.SetListener(listener); }
+	void SetSenderSideEstimatorMode(SendSideBandwidthEstimation::Mode mode) { senderSideBandwidthEstimator.SetMode(mode); }
 	
 	const char* GetRemoteUsername() const { return iceRemoteUsername;	};
 	const char* GetRemotePwd()	const { return iceRemotePwd;		};
@@ -106,21 +115,29 @@ public:
 	virtual int onData(const ICERemoteCandidate* candidate,const BYTE* data,DWORD size)  override;
 	
 	DWORD GetRTT() const { return rtt; }
+	DWORD GetRTXBitrate() const { return rtxBitrate.GetInstantAvg()*8; }
+	virtual LayerAllocator* GetLayerAllocator() override { return &layerAllocator; }
 	
-	TimeService& GetTimeService() { return timeService; }
+	virtual TimeService& GetTimeService() override { return timeService; }
 	
 	void SetListener(Listener* listener);
 
 private:
 	void SetState(DTLSState state);
-	void Probe();
-	int Send(RTPPacket::shared&& packet);
+	void Probe(DWORD budget);
+	DWORD SendPacket(RTPPacket::shared&& packet);
 	int Send(const RTCPCompoundPacket::shared& rtcp);
 	void SetRTT(DWORD rtt);
 	void onRTCP(const RTCPCompoundPacket::shared &rtcp);
 	void ReSendPacket(RTPOutgoingSourceGroup *group,WORD seq);
+	void DeliverRecoveredPackets(RTPIncomingSourceGroup* group);
 	DWORD SendProbe(const RTPPacket::shared& packet);
 	DWORD SendProbe(RTPOutgoingSourceGroup *group,BYTE padding);
+	DWORD SendFEC(RTPOutgoingSourceGroup *group,DWORD repairSize);
+	int   SerializeHeader(RTPHeader& header,RTPHeaderExtension& extension,bool transportWideCC,QWORD now,BYTE* data,DWORD size);
+	DWORD SendRTP(RTPOutgoingSource& source,Packet&& buffer,DWORD len,DWORD truncate,DWORD seqNum,DWORD timestamp,BYTE payloadType,QWORD& now);
+	DWORD SendProbeClusterPacket(RTPOutgoingSourceGroup *group,DWORD cluster);
+	bool  SendProbeCluster(QWORD now);
 	void SendTransportWideFeedbackMessage(DWORD ssrc);
 	
 	int SetLocalCryptoSDES(const char* suite, const BYTE* key, const DWORD len);
@@ -151,6 +168,8 @@ private:
 	datachannels::Endpoint::Options dcOptions;
 	Listener*	listener = nullptr;
 	DTLSConnection	dtls;
+	RTCPScheduler	rtcpScheduler;
+	RTPPacer	pacer;
 	DTLSState	state = DTLSState::New;
 	Maps		sendMaps;
 	Maps		recvMaps;
@@ -159,7 +178,6 @@ private:
 	SRTPSession	recv;
 	WORD		transportSeqNum			= 0;
 	WORD		feedbackPacketCount		= 0;
-	DWORD		lastFeedbackPacketExtSeqNum	= 0;
 	WORD		feedbackCycles			= 0;
 	OutgoingStreams outgoing;
 	IncomingStreams incoming;
@@ -179,7 +197,7 @@ private:
 	Acumulator rtxBitrate;
 	Acumulator probingBitrate;
 	
-	std::map<DWORD,PacketStats::shared> transportWideReceivedPacketsStats;
+	TransportWideReceivedPackets transportWideReceivedPackets;
 	
 	UDPDumper* dumper		= nullptr;
 	bool dumpInRTP			= false;
@@ -189,12 +207,15 @@ private:
 	volatile bool probe		= false;
 	DWORD maxProbingBitrate		= 1024*1000;
 	DWORD probingBitrateLimit	= maxProbingBitrate *4;
+	DWORD startBitrate		= ProbeController::kStartBitrate;
 	
-	Timer::shared probingTimer;
 	QWORD   lastProbe = 0;
 	QWORD 	initTime = 0;
 	
 	SendSideBandwidthEstimation senderSideBandwidthEstimator;
+	ProbeController probeController;
+	RTPPaddingTemplate probeTemplate;
+	LayerAllocator layerAllocator;
 };
 
 
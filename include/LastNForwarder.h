@@ -0,0 +1,63 @@
+#ifndef LASTNFORWARDER_H
+#define LASTNFORWARDER_H
+
+#include <vector>
+#include <set>
+
+#include "config.h"
+#include "use.h"
+#include "ActiveSpeakerDetector.h"
+#include "rtp/RTPStreamTransponder.h"
+
+/*
+ * SFU last N mode: each subscriber only receives the video of the N most
+ * active speakers other than itself, ranked by the active speaker detector.
+ *  - Transponders of publishers outside the set are muted, so no bandwidth
+ *    is spent on them.
+ *  - When a publisher enters the set its transponder is unmuted, which
+ *    requests a key frame and waits for it before forwarding.
+ *  - Publishers not known yet by the detector fill any free slot, so all
+ *    videos are forwarded in rooms with less than N other participants.
+ * Dominant speaker changes are forwarded to the listener, if any.
+ * Transponders must be removed before they are deleted.
+ */
+class LastNForwarder :
+	public ActiveSpeakerDetector::Listener
+{
+public:
+	LastNForwarder(uint32_t lastN, ActiveSpeakerDetector::Listener* listener = nullptr);
+	
+	void AddTransponder(uint32_t subscriberId, uint32_t publisherId, RTPStreamTransponder* transponder);
+	void RemoveTransponder(RTPStreamTransponder* transponder);
+	void SetLastN(uint32_t lastN);
+	
+	void Accumulate(uint32_t id, bool vad, uint8_t db, uint64_t now);
+	void Release(uint32_t id);
+	
+	ActiveSpeakerDetector& GetActiveSpeakerDetector()	{ return detector;		}
+	uint32_t GetLastN() const				{ return lastN;			}
+	uint32_t GetTransponderCount() const			{ return subscriptions.size();	}
+	uint32_t GetForwardedCount() const;
+	
+	virtual void onActiveSpeakerChanded(uint32_t id) override;
+	virtual void onActiveSpeakersChanged(const std::vector<uint32_t>& speakers) override;
+private:
+	struct Subscription
+	{
+		uint32_t subscriberId	= 0;
+		uint32_t publisherId	= 0;
+		RTPStreamTransponder* transponder = nullptr;
+	};
+	bool IsForwarded(uint32_t subscriberId, uint32_t publisherId, const std::set<uint32_t>& unranked) const;
+	void Apply();
+private:
+	mutable Mutex mutex;
+	ActiveSpeakerDetector detector;
+	ActiveSpeakerDetector::Listener* listener;
+	uint32_t lastN;
+	std::vector<Subscription> subscriptions;
+	std::vector<uint32_t> speakers;		//Ranked by the detector
+	bool changed = false;
+};
+
+#endif /* LASTNFORWARDER_H */
@@ -0,0 +1,68 @@
+#ifndef LAYERALLOCATOR_H
+#define LAYERALLOCATOR_H
+
+#include <vector>
+
+#include "config.h"
+#include "rtp/LayerInfo.h"
+#include "rtp/RTPStreamTransponder.h"
+
+/*
+ * Distributes the bandwidth available on a transport across the video
+ * transponders sending on it, choosing the spatial/temporal layer to forward
+ * on each one based on the incoming bitrate measured for each layer.
+ *  - All streams get their base layer first, then the remaining budget is
+ *    used to upgrade them in priority order, round robin within a priority.
+ *  - Viewport hints cap the maximum spatial and temporal layers of a stream.
+ *  - Upgrades need headroom above the layer cost and are delayed after a
+ *    downgrade, so layers do not flap when the estimation oscillates.
+ * Video transponders are added to the allocator of their sender when created
+ * and removed when closed.
+ */
+class LayerAllocator
+{
+public:
+	struct Layer : public LayerInfo
+	{
+		DWORD bitrate	= 0;	//Cumulative bitrate including the layers it depends on
+	};
+
+	static constexpr QWORD  kAllocationInterval	= 500;	// ms
+	static constexpr QWORD  kUpgradeDelay		= 2000;	// ms after a downgrade
+	static constexpr double kUpgradeHeadroom	= 1.15;
+public:
+	void AddTransponder(RTPStreamTransponder* transponder, int priority = 0);
+	void RemoveTransponder(RTPStreamTransponder* transponder);
+	void SetPriority(RTPStreamTransponder* transponder, int priority);
+	void SetMaxLayers(RTPStreamTransponder* transponder, BYTE maxSpatialLayerId, BYTE maxTemporalLayerId);
+
+	DWORD Update(DWORD bitrate, QWORD now);
+	DWORD Allocate(DWORD bitrate, QWORD now);
+
+	DWORD GetAllocatedBitrate() const	{ return allocated;		}
+	DWORD GetTransponderCount() const	{ return subscribers.size();	}
+
+	static std::vector<Layer> GetCandidates(const std::vector<LayerSource>& layers, BYTE maxSpatialLayerId, BYTE maxTemporalLayerId);
+private:
+	struct Subscriber
+	{
+		RTPStreamTransponder* transponder = nullptr;
+		int   priority			= 0;
+		BYTE  maxSpatialLayerId		= LayerInfo::MaxLayerId;
+		BYTE  maxTemporalLayerId	= LayerInfo::MaxLayerId;
+		QWORD lastDowngrade		= 0;
+
+		//Allocation state
+		std::vector<Layer> candidates;
+		int current			= -1;
+		int selected			= -1;
+	};
+	Subscriber* GetSubscriber(RTPStreamTransponder* transponder);
+private:
+	Mutex mutex{true};
+	std::vector<Subscriber> subscribers;
+	QWORD lastAllocation	= 0;
+	DWORD allocated		= 0;
+};
+
+#endif /* LAYERALLOCATOR_H */
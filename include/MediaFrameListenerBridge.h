@@ -39,6 +39,7 @@ public:
 	QWORD baseTimestamp	= 0;
 	QWORD lastTimestamp	= 0;
 	QWORD lastTime		= 0;
+	QWORD lastFrameEnd	= 0;
 	DWORD numFrames		= 0;
 	DWORD numPackets	= 0;
 	DWORD totalBytes	= 0;
@@ -0,0 +1,70 @@
+#ifndef MIXERAUDIOENCODER_H
+#define MIXERAUDIOENCODER_H
+
+#include <set>
+#include <string>
+#include <algorithm>
+
+#include "config.h"
+#include "audio.h"
+#include "fifo.h"
+#include "audiotransrater.h"
+
+/*
+ * Encoder run synchronously from the audio mixer loop, delivering encoded
+ * frames to any number of listeners. Used to encode once the mix shared by
+ * all participants that are not an input of it, and for the minus one mix
+ * of the ones that are, so no encoding thread is needed per participant.
+ * Frame timestamps are taken from the mixer clock, so listeners can be moved
+ * between encoders of the same mixer without timestamp jumps.
+ * Frames suppressed by the codec (Opus DTX) are not sent, leaving a gap on
+ * the timestamps. IsSuppressing() tells if the last frame was suppressed, so
+ * frames buffered after the encoder are sent without waiting for the talk to
+ * resume. Opus in-band FEC is adapted to the worst loss reported by
+ * the listeners since previous call to Encode.
+ */
+class MixerAudioEncoder
+{
+public:
+	MixerAudioEncoder(AudioCodec::Type codec, const Properties& properties);
+	~MixerAudioEncoder();
+
+	//Start encoding samples at mixer rate, first one at given mixer time in ms
+	bool Init(DWORD rate, QWORD time);
+	//Feed samples at mixer rate, encoding as many frames as available
+	int  Encode(SWORD* samples, DWORD len);
+
+	void AddListener(MediaFrame::Listener* listener)	{ listeners.insert(listener);	}
+	void RemoveListener(MediaFrame::Listener* listener)	{ listeners.erase(listener);	}
+
+	//Loss reported by a listener, in 1/256 units as in RTCP reports
+	void ReportPacketLoss(BYTE fractionLost)	{ reportedLoss = std::max(reportedLoss,fractionLost);	}
+
+	DWORD GetListenerCount() const	{ return listeners.size();	}
+	QWORD GetEncodedFrames() const	{ return frames;		}
+	QWORD GetSuppressedFrames() const	{ return suppressed;	}
+	QWORD GetEncodedBytes() const	{ return bytes;			}
+	BYTE  GetPacketLoss() const	{ return packetLoss;		}
+	//Last encoded frame was suppressed by the codec
+	bool  IsSuppressing() const	{ return suppressing;		}
+
+	//Key to identify encoders producing the same output for a given codec configuration
+	static std::string GetKey(AudioCodec::Type codec, const Properties& properties);
+private:
+	AudioCodec::Type	type;
+	Properties		properties;
+	AudioEncoder*		codec	= nullptr;
+	AudioTransrater		transrater;
+	fifo<SWORD,8192>	pending;
+	std::set<MediaFrame::Listener*> listeners;
+	QWORD			time	= 0;
+	QWORD			encoded	= 0;
+	QWORD			frames	= 0;
+	QWORD			suppressed	= 0;
+	bool			suppressing	= false;
+	QWORD			bytes	= 0;
+	BYTE			reportedLoss	= 0;
+	BYTE			packetLoss	= 0;
+};
+
+#endif /* MIXERAUDIOENCODER_H */
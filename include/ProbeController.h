@@ -0,0 +1,63 @@
+#ifndef PROBE_CONTROLLER_H_
+#define PROBE_CONTROLLER_H_
+
+#include <deque>
+#include <stdint.h>
+
+/*
+ * Schedules probe clusters, short bursts of padding sent at a defined target
+ * rate whose received rate is reported back by the send side estimator.
+ *  - On start, or on the first estimation if not started before, an exponential
+ *    ramp-up is started at 3x and 6x, continuing at 2x while the results keep
+ *    confirming the probed rate.
+ *  - After a large drop, the previous estimation is probed periodically so it
+ *    can be recovered at once when the network allows it again.
+ */
+class ProbeController
+{
+public:
+	struct Cluster
+	{
+		uint32_t id		= 0;
+		uint32_t bitrate	= 0;
+		uint64_t duration	= 0;
+		uint32_t minPackets	= 0;
+		uint64_t start		= 0;
+		uint32_t sentBytes	= 0;
+		uint32_t sentPackets	= 0;
+	};
+	
+	static constexpr uint64_t kClusterDuration	= 15E3;		// 15ms
+	static constexpr uint32_t kClusterMinPackets	= 5;
+	static constexpr uint32_t kStartBitrate		= 300E3;	// 300kbps
+public:
+	//Start ramp-up before having any estimation
+	void Start(uint32_t bitrate, uint64_t now);
+	void SetEstimate(uint32_t bitrate, uint64_t now);
+	void SetMaxBitrate(uint32_t bitrate)	{ maxBitrate = bitrate;		}
+	uint32_t CreateCluster(uint32_t bitrate, uint64_t duration = kClusterDuration, uint32_t minPackets = kClusterMinPackets);
+	
+	uint32_t GetProbeSize(uint64_t now);
+	uint32_t GetActiveClusterId() const	{ return !clusters.empty() ? clusters.front().id : 0;	}
+	void ProbeSent(uint32_t size);
+	
+	uint32_t GetPendingClusters() const	{ return clusters.size();	}
+	bool IsStarted() const			{ return started;		}
+private:
+	std::deque<Cluster> clusters;
+	uint32_t nextId			= 1;
+	uint32_t maxBitrate		= 0;
+	uint32_t estimate		= 0;
+	bool	 started		= false;
+	
+	//Exponential ramp-up
+	uint32_t exponentialBitrate	= 0;
+	uint64_t exponentialTime	= 0;
+	
+	//Recovery after a large drop
+	uint32_t dropBitrate		= 0;
+	uint64_t dropTime		= 0;
+	uint32_t recoveryProbes		= 0;
+};
+
+#endif  // PROBE_CONTROLLER_H_
@@ -0,0 +1,141 @@
+#ifndef SPSCRING_H
+#define SPSCRING_H
+
+#include <atomic>
+#include <algorithm>
+#include <string.h>
+
+#include "config.h"
+
+/*
+ * Wait-free ring buffer between a single producer and a single consumer
+ * thread, so neither side ever blocks the other.
+ *  - Read and write positions are monotonic counters, each one only written
+ *    by its own side.
+ *  - Samples that do not fit on push are dropped and accounted as overrun,
+ *    as the producer can not discard the queued ones.
+ *  - Pops with less samples queued than requested are accounted as underrun.
+ *  - It can be cleared from any side, queued samples are discarded by the
+ *    consumer on its next access.
+ */
+template<typename T,DWORD S>
+class SPSCRing
+{
+public:
+	//Producer side
+	DWORD push(const T* in,DWORD l)
+	{
+		//Get positions
+		QWORD tail = this->tail.load(std::memory_order_relaxed);
+		QWORD head = this->head.load(std::memory_order_acquire);
+
+		//Get free space
+		DWORD free = S-(DWORD)(tail-head);
+
+		//If it does not fit
+		if (l>free)
+		{
+			//Account
+			overruns.store(overruns.load(std::memory_order_relaxed)+1,std::memory_order_relaxed);
+			dropped.store(dropped.load(std::memory_order_relaxed)+l-free,std::memory_order_relaxed);
+			//Only push what fits
+			l = free;
+		}
+
+		//Copy until the end of the buffer and the rest from the begining
+		DWORD pos = tail%S;
+		DWORD first = std::min(l,S-pos);
+		memcpy(data+pos,in,first*sizeof(T));
+		memcpy(data,in+first,(l-first)*sizeof(T));
+
+		//Publish them
+		this->tail.store(tail+l,std::memory_order_release);
+
+		return l;
+	}
+
+	//Consumer side
+	DWORD pop(T* out,DWORD l)
+	{
+		//Get positions
+		QWORD head = Discard();
+		QWORD tail = this->tail.load(std::memory_order_acquire);
+
+		//Get queued samples
+		DWORD len = tail-head;
+
+		//If there are not enough
+		if (l>len)
+		{
+			//Account
+			underruns.store(underruns.load(std::memory_order_relaxed)+1,std::memory_order_relaxed);
+			//Get what we have
+			l = len;
+		}
+
+		//Copy until the end of the buffer and the rest from the begining
+		DWORD pos = head%S;
+		DWORD first = std::min(l,S-pos);
+		memcpy(out,data+pos,first*sizeof(T));
+		memcpy(out+first,data,(l-first)*sizeof(T));
+
+		//Release space
+		this->head.store(head+l,std::memory_order_release);
+
+		return l;
+	}
+
+	//Consumer side
+	DWORD length()
+	{
+		//Get positions
+		QWORD head = Discard();
+		QWORD tail = this->tail.load(std::memory_order_acquire);
+		return tail-head;
+	}
+
+	//Any side
+	void clear()
+	{
+		//Everything pushed until now
+		QWORD pos = tail.load(std::memory_order_acquire);
+		QWORD prev = cleared.load(std::memory_order_relaxed);
+		//Only move it forward
+		while (prev<pos && !cleared.compare_exchange_weak(prev,pos,std::memory_order_release,std::memory_order_relaxed));
+	}
+
+	DWORD size() const		{ return S;						}
+	QWORD GetUnderruns() const	{ return underruns.load(std::memory_order_relaxed);	}
+	QWORD GetOverruns() const	{ return overruns.load(std::memory_order_relaxed);	}
+	QWORD GetDropped() const	{ return dropped.load(std::memory_order_relaxed);	}
+private:
+	QWORD Discard()
+	{
+		//Get read position
+		QWORD head = this->head.load(std::memory_order_relaxed);
+		QWORD cleared = this->cleared.load(std::memory_order_acquire);
+
+		//If it has been cleared after it
+		if (cleared>head)
+		{
+			//Skip them
+			head = cleared;
+			//Release space
+			this->head.store(head,std::memory_order_release);
+		}
+
+		return head;
+	}
+private:
+	T data[S];
+	//Each position on its own cache line
+	alignas(64) std::atomic<QWORD> head{0};
+	alignas(64) std::atomic<QWORD> tail{0};
+	alignas(64) std::atomic<QWORD> cleared{0};
+	//Stats
+	std::atomic<QWORD> underruns{0};
+	std::atomic<QWORD> overruns{0};
+	std::atomic<QWORD> dropped{0};
+};
+
+#endif /* SPSCRING_H */
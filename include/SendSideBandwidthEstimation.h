@@ -1,13 +1,14 @@
 #ifndef SEND_SIDE_BANDWIDTH_ESTIMATION_H_
 #define SEND_SIDE_BANDWIDTH_ESTIMATION_H_
 
-#include <deque>
+#include <array>
 #include <utility>
 #include <vector>
 
 #include "acumulator.h"
 #include "rtp/PacketStats.h"
 #include "remoterateestimator.h"
+#include "TrendlineEstimator.h"
 
 class SendSideBandwidthEstimation
 {
@@ -21,24 +22,67 @@ public:
 		Congestion
 	}
 ;
+	enum Mode {
+		AccumulatedDelay,
+		DelayGradient
+	};
 public:
 	SendSideBandwidthEstimation();
         ~SendSideBandwidthEstimation();
-	void SentPacket(const PacketStats::shared& packet);
-	void ReceivedFeedback(uint8_t feedbackNum, const std::map<uint32_t,uint64_t>& packets, uint64_t when = 0);
+	void SentPacket(const PacketStats& packet);
+	void SentPacket(const PacketStats::shared& packet) { SentPacket(*packet); }
+	void ReceivedFeedback(uint8_t feedbackNum, const std::vector<std::pair<uint32_t,uint64_t>>& packets, uint64_t when = 0);
 	void UpdateRTT(uint64_t when, uint32_t rtt);
 	uint32_t GetEstimatedBitrate() const;
 	uint32_t GetTargetBitrate() const;
 	uint32_t GetAvailableBitrate() const;
 	uint32_t GetMinRTT() const;
+	uint32_t GetLastProbeResult() const { return lastProbeResult; }
 	void SetListener(RemoteRateEstimator::Listener* listener) { this->listener = listener; }
+	void SetMode(Mode mode) { this->mode = mode; }
+	Mode GetMode() const { return mode; }
 
         
         int Dump(const char* filename);
+private:
+	struct SentPacketInfo
+	{
+		uint64_t time			= 0;
+		uint32_t size			= 0;
+		uint16_t transportWideSeqNum	= 0;
+		bool	 used			= false;
+		bool	 mark			= false;
+		bool	 rtx			= false;
+		bool	 probing		= false;
+		uint32_t probeCluster		= 0;
+	};
+	struct ProbeClusterInfo
+	{
+		uint32_t id			= 0;
+		uint64_t firstSent		= 0;
+		uint64_t lastSent		= 0;
+		uint32_t sentBytes		= 0;
+		uint32_t sentPackets		= 0;
+		uint32_t firstSize		= 0;
+		uint64_t firstRecv		= 0;
+		uint64_t lastRecv		= 0;
+		uint32_t recvBytes		= 0;
+		uint32_t recvPackets		= 0;
+		bool	 done			= false;
+	};
+	//Must be power of 2
+	static constexpr uint32_t kHistorySize = 4096;
+	static constexpr uint32_t kProbeClusters = 8;
 private:
 	void EstimateBandwidthRate(uint64_t when);
+	void EstimateProbeClusters();
+	SentPacketInfo* GetSentPacket(uint32_t transportWideSeqNum);
 private:
-	std::map<DWORD,PacketStats::shared> transportWideSentPacketsStats;
+	std::array<SentPacketInfo,kHistorySize> transportWideSentPacketsStats;
+	std::array<ProbeClusterInfo,kProbeClusters> probeClusters;
+	uint32_t lastProbeResult = 0;
+	Mode mode = Mode::AccumulatedDelay;
+	TrendlineEstimator trendline;
 	uint64_t bandwidthEstimation = 0;
 	uint64_t targetBitrate = 0;
 	uint64_t availableRate = 0;
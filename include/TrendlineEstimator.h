@@ -0,0 +1,64 @@
+#ifndef TRENDLINE_ESTIMATOR_H_
+#define TRENDLINE_ESTIMATOR_H_
+
+#include <array>
+#include <utility>
+#include <stdint.h>
+
+/*
+ * Delay gradient estimator, packets are grouped in bursts and the trend of the
+ * accumulated one way delay variation between groups is compared against an
+ * adaptive threshold to detect queues building up before losses or rtt increase.
+ */
+class TrendlineEstimator
+{
+public:
+	enum BandwidthUsage {
+		Normal,
+		Underusing,
+		Overusing
+	};
+	
+	static constexpr uint32_t kWindowSize = 20;
+public:
+	void Reset();
+	void Update(uint64_t sent, uint64_t recv);
+	
+	BandwidthUsage GetUsage() const	{ return usage;		}
+	double GetTrend() const		{ return trend;		}
+	double GetThreshold() const	{ return threshold;	}
+private:
+	void UpdateTrendline(double delayDelta, double arrival);
+	void Detect(double timeDelta, double arrival);
+	void UpdateThreshold(double modifiedTrend, double arrival);
+private:
+	struct PacketGroup
+	{
+		uint64_t firstSent	= 0;
+		uint64_t lastSent	= 0;
+		uint64_t lastRecv	= 0;
+		bool     valid		= false;
+	};
+	
+	PacketGroup current;
+	PacketGroup prev;
+	uint64_t firstRecv		= 0;
+	
+	//Linear regression window as ring
+	std::array<std::pair<double,double>,kWindowSize> samples;
+	uint32_t numSamples		= 0;
+	uint32_t numDeltas		= 0;
+	double accumulatedDelay		= 0;
+	double smoothedDelay		= 0;
+	double trend			= 0;
+	double prevTrend		= 0;
+	
+	//Overuse detector
+	double threshold		= 12.5;
+	double lastThresholdUpdate	= -1;
+	double timeOverUsing		= -1;
+	uint32_t overuseCounter		= 0;
+	BandwidthUsage usage		= Normal;
+};
+
+#endif  // TRENDLINE_ESTIMATOR_H_
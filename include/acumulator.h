@@ -9,7 +9,7 @@
 #define	ACUMULATOR_H
 
 #include "config.h"
-#include <list>
+#include <deque>
 
 class Acumulator
 {
@@ -120,7 +120,7 @@ public:
 	}
 	
 private:
-	std::list<std::pair<QWORD,DWORD>> values;
+	std::deque<std::pair<QWORD,DWORD>> values;
 	DWORD window;
 	DWORD base;
 	bool  inWindow;
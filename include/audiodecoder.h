@@ -11,10 +11,18 @@
 #include "audio.h"
 #include "waitqueue.h"
 #include "rtp.h"
+#include "AudioJitterBuffer.h"
 
 class AudioDecoderWorker 
 	: public RTPIncomingMediaStream::Listener
 {
+public:
+	//Silent packets still decoded before skipping, so the signal fades out
+	static constexpr DWORD kSilenceHangover = 5;
+	//Adaptive playout
+	static constexpr DWORD kPlayoutPeriod	= 10;	// ms
+	static constexpr DWORD kStretchMargin	= 10;	// ms
+	static constexpr DWORD kMaxConcealment	= 100;	// ms
 public:
 	AudioDecoderWorker() = default;
 	virtual ~AudioDecoderWorker();
@@ -24,6 +32,23 @@ public:
 	virtual void onEnded(RTPIncomingMediaStream* stream);
 	virtual void onBye(RTPIncomingMediaStream* stream);
 	int Stop();
+	//Decode queued packets from an external loop instead of the decoding thread
+	DWORD Process(DWORD ms = kPlayoutPeriod);
+	
+	//Do not decode packets signaled as silence by the RFC 6464 audio level
+	void SetSkipSilence(bool enabled, BYTE silenceLevel = 127);
+	QWORD GetSkippedPackets() const	{ return skipped;	}
+
+	//Reorder packets by timestamp and adapt playout delay to network jitter, must be set before starting
+	void SetAdaptivePlayout(bool enabled);
+	DWORD Playout(DWORD ms);
+	DWORD GetTargetDelay() const		{ return jitterBuffer.GetTargetDelay();	}
+	DWORD GetPlayoutDelay() const		{ return delay;		}
+	QWORD GetLatePackets() const		{ return jitterBuffer.GetLatePackets();	}
+	QWORD GetConcealedFrames() const	{ return concealed;	}
+	QWORD GetUnderruns() const		{ return underruns;	}
+	QWORD GetAcceleratedSamples() const	{ return accelerated;	}
+	QWORD GetExpandedSamples() const	{ return expanded;	}
 	
 	void SetAACConfig(const uint8_t* data,const size_t size);
 	void AddAudioOuput(AudioOutput* ouput);
@@ -31,6 +56,10 @@ public:
 
 protected:
 	int Decode();
+	int DecodePacket(const RTPPacket::shared& packet);
+	int DecodeFrame(const RTPPacket::shared& packet,SWORD* raw,DWORD rawSize,BYTE* vadLevel);
+	DWORD Fill(DWORD need);
+	void Conceal(DWORD samples);
 
 private:
 	static void *startDecoding(void *par);
@@ -42,7 +71,26 @@ private:
 	Mutex mutex;
 	bool		decoding	= false;
 	DWORD		rate		= 0;
+	DWORD		lastTime	= 0;
+	bool		skipSilence	= false;
+	BYTE		silenceLevel	= 127;
+	DWORD		silent		= 0;
+	QWORD		skipped		= 0;
 	std::unique_ptr<AudioDecoder>	codec;
+	//Adaptive playout
+	bool		adaptive	= false;
+	AudioJitterBuffer	jitterBuffer;
+	std::vector<SWORD>	pcm;
+	QWORD		playout		= 0;
+	bool		buffering	= true;
+	DWORD		frameSamples	= 0;
+	DWORD		concealing	= 0;
+	BYTE		vadLevel	= -1;
+	DWORD		delay		= 0;
+	QWORD		concealed	= 0;
+	QWORD		underruns	= 0;
+	QWORD		accelerated	= 0;
+	QWORD		expanded	= 0;
 };
 
 #endif	/* AUDIODECODER_H */
@@ -6,7 +6,13 @@
 #include "pipeaudioinput.h"
 #include "pipeaudiooutput.h"
 #include "sidebar.h"
+#include "MixerAudioEncoder.h"
+#include "opus/opusrepacketizer.h"
+#include "rtp/RTPOutgoingSourceGroup.h"
 #include <map>
+#include <vector>
+#include <memory>
+#include <atomic>
 
 class AudioMixer : public VADProxy
 {
@@ -24,6 +30,7 @@ public:
 	AudioInput*  GetInput(int id);
 	AudioOutput* GetOutput(int id);
 	void Process(DWORD numSamples);
+	DWORD GetRate() const	{ return rate;	}
 
 	int CreateSidebar();
 	int AddSidebarParticipant(int SidebarId,int partId);
@@ -35,10 +42,31 @@ public:
 	virtual DWORD GetVAD(int id);
 	
 	int SetCalculateVAD(bool vad);
+	//Only mix the loudest active participants, 0 mixes everybody
+	int SetMaxSpeakers(DWORD maxSpeakers);
+	//Mix at the most common participant rate, so they do not need resampling
+	int SetNativeRate(bool nativeRate);
+	DWORD GetDominantRate();
+
+	//Encode participant output on the mixer, sharing the encoder with anyone getting the same mix
+	//If the outgoing group is set, loss reported by the participant on it is used for the encoding
+	int SetEncodedOutput(int id,AudioCodec::Type codec,const Properties& properties,MediaFrame::Listener* listener,RTPOutgoingSourceGroup* group = nullptr);
+	int RemoveEncodedOutput(int id);
+	//Loss reported by the participant receiver, in 1/256 units as in RTCP reports
+	int SetPacketLoss(int id,BYTE fractionLost);
+	//Max Opus frames per packet accepted by the participant while only listening, 1 disables it
+	int SetRepacketization(int id,DWORD maxFrames);
+	DWORD GetEncoderCount();
 
 public:
 	static int SidebarDefault;
 	static int NoSidebar;
+	//Time to keep own encoder after not being mixed anymore, in ms
+	static constexpr QWORD kEncoderHangover = 2000;
+	//Time between checks of the dominant participant rate, in ms
+	static constexpr QWORD kRateCheckInterval = 1000;
+	//Loss over which frames are not combined anymore, in 1/256 units as in RTCP reports
+	static constexpr BYTE kMaxRepacketizationLoss = 13;
 	
 protected:
 	//Mix thread
@@ -51,7 +79,41 @@ private:
 private:
 
 	//Tipos
-	class AudioSource
+	//Delivers the encoded frames of a participant, so its listener can be changed while the mixer is encoding
+	class Dispatcher : public MediaFrame::Listener
+	{
+	public:
+		Dispatcher() : mutex(true) {}
+
+		void SetListener(MediaFrame::Listener* listener,AudioCodec::Type codec)
+		{
+			//Wait for any frame being delivered
+			ScopedLock scope(mutex);
+			//Store them
+			this->listener = listener;
+			this->codec = codec;
+		}
+
+		//MediaFrame::Listener interface
+		virtual void onMediaFrame(const MediaFrame &frame) override
+		{
+			//Listener may call back the mixer from here
+			ScopedLock scope(mutex);
+			//Drop frames encoded for a previous listener
+			if (listener && ((const AudioFrame&)frame).GetCodec()==codec)
+				listener->onMediaFrame(frame);
+		}
+		virtual void onMediaFrame(DWORD ssrc, const MediaFrame &frame) override
+		{
+			onMediaFrame(frame);
+		}
+	private:
+		Mutex			mutex;
+		MediaFrame::Listener*	listener = nullptr;
+		AudioCodec::Type	codec = AudioCodec::UNKNOWN;
+	};
+
+	class AudioSource : public RTPOutgoingSourceGroup::Listener
 	{
 	public:
 		AudioSource()
@@ -60,9 +122,28 @@ private:
 			buffer = (SWORD*)malloc32(Sidebar::MIXER_BUFFER_SIZE*sizeof(SWORD));
 			//No len
 			len = 0;
+			vad = 0;
+			//No pipes yet
+			input = NULL;
+			output = NULL;
+			sidebar = NULL;
+			//Not encoded by mixer
+			listener = NULL;
+			reset = false;
+			lastMixed = 0;
+			fractionLost = 0;
+			maxFrames = 1;
+			combine = 1;
+			//Not getting reports
+			group = NULL;
+			//Shared mix is sent through the repacketizer
+			repacketizer.SetListener(&dispatcher);
 		}
 		~AudioSource()
 		{
+			//Delete pipes
+			delete input;
+			delete output;
 			//Free buffer
 			free(buffer);
 		}
@@ -71,23 +152,92 @@ private:
 		PipeAudioInput  *input;
 		PipeAudioOutput *output;
 		Sidebar*	sidebar;
-		DWORD		vad;
+		std::atomic<DWORD>	vad;
+		//Limiter for the mix without own audio
+		AudioLimiter	limiter;
+		//Encoded output
+		MediaFrame::Listener*	listener;
+		AudioCodec::Type	codec;
+		Properties		properties;
+		std::string		key;
+		//Encoders must be released by the mixer
+		bool			reset;
+		//Own encoder while being an input of the mix
+		std::shared_ptr<MixerAudioEncoder>	encoder;
+		//Shared encoder of the mix otherwise
+		std::shared_ptr<MixerAudioEncoder>	shared;
+		QWORD			lastMixed;
+		std::atomic<BYTE>	fractionLost;
+		//Combines frames of the shared mix
+		OpusRepacketizer	repacketizer;
+		std::atomic<DWORD>	maxFrames;
+		//Frames to combine on current mix
+		DWORD			combine;
+		//Sends the encoded frames to the listener
+		Dispatcher		dispatcher;
+		//Outgoing stream of the participant, reporting the loss
+		RTPOutgoingSourceGroup*	group;
+
+		//RTPOutgoingSourceGroup::Listener interface
+		virtual void onPLIRequest(RTPOutgoingSourceGroup* group,DWORD ssrc) override {}
+		virtual void onREMB(RTPOutgoingSourceGroup* group,DWORD ssrc,DWORD bitrate) override {}
+		virtual void onPacketLoss(RTPOutgoingSourceGroup* group,DWORD ssrc,BYTE fractionLost) override
+		{
+			//Only on the encoded stream, it will be used on next encoding
+			if (ssrc==group->media.ssrc)
+				this->fractionLost = fractionLost;
+		}
 	};
 
-	typedef std::map<int,AudioSource *>	Audios;
+	typedef std::map<int,std::shared_ptr<AudioSource>> Audios;
 	typedef std::map<int,Sidebar *>		Sidebars;
+	typedef std::map<std::pair<Sidebar*,std::string>,std::shared_ptr<MixerAudioEncoder>> SharedEncoders;
+
+	//Encoding of current mix, run without blocking the control operations
+	struct Encoding
+	{
+		std::shared_ptr<MixerAudioEncoder> encoder;
+		std::vector<SWORD> samples;
+		//Participant switching from the shared mix, its pending frames are sent first
+		AudioSource* flush = nullptr;
+		//Participants getting the shared mix
+		std::vector<AudioSource*> listeners;
+	};
+
+private:
+	void EncodeOutput(AudioSource* audio,bool isMixed,SWORD* samples,DWORD numSamples,QWORD now);
+	Encoding& AddEncoding(const std::shared_ptr<MixerAudioEncoder>& encoder,const SWORD* samples,DWORD numSamples);
+	void ReleaseEncoders(AudioSource* audio);
+	void SetLossReports(AudioSource* audio,RTPOutgoingSourceGroup* group);
+	DWORD CalculateDominantRate();
+	void UpdateRate(DWORD rate);
 
 private:
 	pthread_t 	mixAudioThread;
 	int		mixingAudio;
-	Use		lstAudiosUse;
+	//Serializes the mix with changes on participants and sidebars, encoders are run without it
+	Mutex		mutex;
 	
-	Audios		audios;
+	//Copy on write list, so it can be read without blocking the mixer
+	std::shared_ptr<const Audios> participants;
 	Sidebars	sidebars;
 	Sidebar*	defaultSidebar;
 	int		numSidebars;
 	bool		vad;
 	DWORD		rate;
+	DWORD		maxSpeakers;
+	//32 bits buffer for the mix without own audio
+	int32_t*	minus;
+	SharedEncoders	sharedEncoders;
+	//Encodings of current mix, reused between mixes
+	std::vector<Encoding> encodings;
+	DWORD		numEncodings;
+	//Deleted participants with encoders not released yet
+	std::vector<std::shared_ptr<AudioSource>> deleted;
+	//Mixed samples
+	QWORD		time;
+	bool		nativeRate;
+	QWORD		rateChecked;
 
 };
 
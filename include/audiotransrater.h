@@ -13,6 +13,9 @@ public:
 	void Close();
 
 	bool IsOpen()	{ return resampler!=NULL; }
+
+	//Filter banks shared by all transraters with same rates
+	static void GetSharedFilters(DWORD* num, DWORD* bytes, DWORD* users);
 	
 private:
 	SpeexResamplerState *resampler;
@@ -1,8 +1,9 @@
 #ifndef _PIPEAUDIOINPUT_H_
 #define _PIPEAUDIOINPUT_H_
 #include <pthread.h>
+#include <atomic>
 #include <audio.h>
-#include <fifo.h>
+#include "SPSCRing.h"
 #include "audiotransrater.h"
 
 
@@ -22,24 +23,33 @@ public:
 	virtual DWORD GetRecordingRate()	{ return recordRate;	}
 	
 	int Init(DWORD rate);
+	int SetNativeRate(DWORD rate);
+	//Called from the mixer, only locks if the recorder is waiting for samples
 	int PutSamples(SWORD *buffer,DWORD size);
 	int End();
 
+	QWORD GetOverruns() const	{ return fifoBuffer.GetOverruns();	}
+	QWORD GetDroppedSamples() const	{ return fifoBuffer.GetDropped();	}
+
 private:
-	//Los mutex y condiciones
+	//Los mutex y condiciones, only used to wait for samples
 	pthread_mutex_t mutex;
 	pthread_cond_t  cond; 
 
 	//Members
-	fifo<SWORD,4096>	fifoBuffer;
-	int		recording;
-	int 		inited;
-	int		canceled;
-	
+	SPSCRing<SWORD,4096>	fifoBuffer;
+	std::atomic<bool>	recording;
+	int 			inited;
+	std::atomic<bool>	canceled;
+	std::atomic<bool>	waiting;
 	
+	//Only used from the mixer
 	AudioTransrater		transrater;
-	DWORD			recordRate;
-	DWORD			nativeRate;
+	//Reset when recording stops, so it is opened again
+	std::atomic<DWORD>	transraterRate;
+	std::atomic<DWORD>	recordRate;
+	//Read by the encoder
+	std::atomic<DWORD>	nativeRate;
 };
 
 #endif
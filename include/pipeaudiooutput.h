@@ -1,8 +1,9 @@
 #ifndef _AUDIOOUTPUT_H_
 #define _AUDIOOUTPUT_H_
 #include <pthread.h>
-#include <fifo.h>
+#include <atomic>
 #include <audio.h>
+#include "SPSCRing.h"
 #include "vad.h"
 #include "audiotransrater.h"
 
@@ -20,24 +21,32 @@ public:
 	virtual DWORD GetNativeRate()		{ return nativeRate;	}
 	virtual DWORD GetPlayingRate()		{ return playRate;	}
 
+	//Called from the mixer, never blocks on the player
 	int GetSamples(SWORD *buffer,DWORD size);
 	DWORD GetVAD(DWORD numSamples);
+	QWORD GetUnderruns() const	{ return fifoBuffer.GetUnderruns();	}
+	QWORD GetOverruns() const	{ return fifoBuffer.GetOverruns();	}
+	QWORD GetDroppedSamples() const	{ return fifoBuffer.GetDropped();	}
 	int Init(DWORD samplerate);
+	int SetNativeRate(DWORD samplerate);
 	int End();
 private:
-	//Mutex
+	//Mutex for configuration changes and transrater use
 	pthread_mutex_t mutex;
 
 	//Members
-	fifo<SWORD,8192>	fifoBuffer;
+	SPSCRing<SWORD,8192>	fifoBuffer;
 	int			inited;
 	VAD			vad;
-	DWORD			acu;
+	std::atomic<DWORD>	acu;
 	bool			calcVAD;
 	AudioTransrater 	transrater;
+	//Native rate the transrater was opened for, it is reopened by the player when it changes
+	DWORD			transraterRate;
 
-	DWORD	playRate;
-	DWORD	nativeRate;
+	DWORD			playRate;
+	//Set by the mixer
+	std::atomic<DWORD>	nativeRate;
 };
 
 #endif
@@ -4,6 +4,7 @@
 #include "config.h"
 #include "log.h"
 #include "media.h"
+#include "TimeService.h"
 #include <vector>
 #include <list>
 #include <utility>
@@ -41,11 +42,18 @@
 #include "rtp/RTPOutgoingSource.h"
 #include "rtp/RTPOutgoingSourceGroup.h"
 
+class LayerAllocator;
+
 class RTPSender
 {
 public:
 	virtual int Enqueue(const RTPPacket::shared& packet) = 0;
 	virtual int Enqueue(const RTPPacket::shared& packet,std::function<RTPPacket::shared(const RTPPacket::shared&)> modifier) = 0;
+	//Must be called from the sender time service thread
+	virtual int Send(RTPPacket::shared&& packet) = 0;
+	virtual TimeService& GetTimeService() = 0;
+	//Allocates the layers of the video transponders sending through it, if any
+	virtual LayerAllocator* GetLayerAllocator() { return nullptr; }
 };
 
 class RTPReceiver
@@ -0,0 +1,48 @@
+#ifndef FLEXFEC_H
+#define FLEXFEC_H
+
+#include "config.h"
+
+/*
+ * FlexFEC (draft-ietf-payload-flexible-fec-scheme-03) repair payload helpers.
+ *
+ *    0                   1                   2                   3
+ *    0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1
+ *   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+ *   |R|F|P|X|  CC   |M| PT recovery |        length recovery        |
+ *   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+ *   |                          TS recovery                          |
+ *   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+ *   |   SSRCCount   |                    reserved                   |
+ *   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+ *   |                             SSRC_i                            |
+ *   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+ *   |           SN base_i           |k|          Mask [0-14]        |
+ *   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+ *   |k|                   Mask [15-45] (optional)                   |
+ *   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+ *   |                     Mask [46-108] (optional)                  |
+ *   +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+ *
+ * Only single stream, flexible mask (F=0) packets are supported. The repair
+ * data after the header is the XOR of the protected RTP packets after their
+ * fixed 12 byte header, which is recovered from the header fields above.
+ */
+struct FlexFEC
+{
+	static constexpr DWORD RTPHeaderSize	= 12;
+	static constexpr DWORD MinHeaderSize	= 20;
+	static constexpr DWORD MaxMaskBits	= 109;
+	
+	//Header size for a mask able to hold the given number of packets
+	static DWORD GetHeaderSize(DWORD maskBits);
+	//Serialize the header, mask is indexed by offset to the sequence base
+	static DWORD WriteHeader(BYTE* data, DWORD size, BYTE recoveryFlags, BYTE recoveryPT, WORD recoveryLength, DWORD recoveryTimestamp, DWORD ssrc, WORD seqNumBase, const bool* mask, DWORD maskBits);
+	//Parse the header, returns header length or 0 on error
+	static DWORD ReadHeader(const BYTE* data, DWORD size, DWORD* ssrc, WORD* seqNumBase, bool* mask, DWORD* maskBits);
+	
+	//dst ^= src
+	static void Xor(BYTE* dst, const BYTE* src, DWORD size);
+};
+
+#endif /* FLEXFEC_H */
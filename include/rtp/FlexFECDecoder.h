@@ -0,0 +1,74 @@
+#ifndef FLEXFECDECODER_H
+#define FLEXFECDECODER_H
+
+#include <array>
+#include <deque>
+#include <vector>
+
+#include "config.h"
+#include "rtp/FlexFEC.h"
+
+/*
+ * Recovers lost media packets from FlexFEC repair packets.
+ *  - Media and repair packets are stored on preallocated rings indexed by
+ *    sequence number, so there are no allocations nor lookups on ordered maps.
+ *  - Each repair packet keeps the count of protected packets still missing,
+ *    which is updated as media arrives. Recovery is only attempted when that
+ *    count reaches one, and recovered packets may in turn complete others.
+ *  - Buffers are only allocated and media stored once the first repair
+ *    packet is received.
+ */
+class FlexFECDecoder
+{
+public:
+	static constexpr DWORD kMediaRingSize	= 256;
+	static constexpr DWORD kMaxRepairs	= 64;
+	static constexpr DWORD kMaxAge		= kMediaRingSize/2;
+public:
+	void AddMedia(const BYTE* data, DWORD size);
+	void AddFEC(const BYTE* data, DWORD size);
+	//Pops next recovered packet, returns its size or 0 if there are none
+	DWORD GetRecovered(BYTE* data, DWORD size);
+	void Reset();
+	
+	bool IsEnabled()		const { return !medias.empty();		}
+	QWORD GetRecoveredPackets()	const { return recoveredPackets;	}
+	QWORD GetRepairPackets()	const { return repairPackets;		}
+	QWORD GetUselessRepairs()	const { return uselessRepairs;		}
+private:
+	struct Media
+	{
+		bool  used	= false;
+		WORD  seqNum	= 0;
+		DWORD size	= 0;
+		std::array<BYTE,MTU> data;
+	};
+	struct Repair
+	{
+		bool  used	= false;
+		DWORD ssrc	= 0;
+		WORD  seqNumBase= 0;
+		DWORD maskBits	= 0;
+		DWORD missing	= 0;
+		DWORD header	= 0;
+		DWORD size	= 0;
+		std::array<bool,FlexFEC::MaxMaskBits> mask;
+		std::array<BYTE,MTU> data;
+	};
+	void Enable();
+	Media* GetMedia(WORD seqNum);
+	void Store(const BYTE* data, DWORD size);
+	bool Recover(Repair& repair);
+private:
+	std::vector<Media> medias;
+	std::vector<Repair> repairs;
+	std::deque<WORD> recovered;
+	DWORD nextRepair	= 0;
+	WORD  lastSeqNum	= 0;
+	
+	QWORD recoveredPackets	= 0;
+	QWORD repairPackets	= 0;
+	QWORD uselessRepairs	= 0;
+};
+
+#endif /* FLEXFECDECODER_H */
@@ -0,0 +1,68 @@
+#ifndef FLEXFECENCODER_H
+#define FLEXFECENCODER_H
+
+#include <array>
+
+#include "config.h"
+#include "rtp/FlexFEC.h"
+
+/*
+ * Generates FlexFEC repair payloads for a media stream.
+ *  - Serialized media packets are XORed on arrival into a single repair
+ *    packet per group, so nothing is buffered apart from the repair itself.
+ *  - The group size is adapted to the reported loss rate so on average a
+ *    group has at most one loss, which is what a single XOR can recover.
+ *  - Groups are closed at the end of a frame once they are half full, so
+ *    repair is not delayed waiting for next frame. A packet that does not
+ *    fit on the current group closes it too.
+ *  - Protection is only enabled when the RTT is too high for NACKs to arrive
+ *    in time and there is some loss.
+ */
+class FlexFECEncoder
+{
+public:
+	static constexpr DWORD kMinGroupSize	= 4;
+	static constexpr DWORD kMaxGroupSize	= 24;
+	static constexpr DWORD kMinRTT		= 200;	// ms
+	static constexpr DWORD kMaxRepairSize	= MTU;
+public:
+	void Update(BYTE fractionLost, DWORD rtt);
+	void SetGroupSize(DWORD groupSize);
+	//Returns the size of the repair payload if a group has been completed
+	DWORD AddPacket(const BYTE* data, DWORD size, bool mark);
+	void Reset();
+	
+	bool IsEnabled()		const { return groupSize;		}
+	DWORD GetGroupSize()		const { return groupSize;		}
+	const BYTE* GetRepair()		const { return repair.data();		}
+	DWORD GetRepairTimestamp()	const { return repairTimestamp;		}
+	QWORD GetProtectedPackets()	const { return protectedPackets;	}
+	QWORD GetRepairPackets()	const { return repairPackets;		}
+	QWORD GetRepairBytes()		const { return repairBytes;		}
+private:
+	DWORD Flush();
+private:
+	DWORD groupSize		= 0;
+	
+	//Current group
+	DWORD ssrc		= 0;
+	WORD  seqNumBase	= 0;
+	DWORD timestamp		= 0;
+	DWORD count		= 0;
+	DWORD last		= 0;
+	BYTE  flags		= 0;
+	BYTE  pt		= 0;
+	WORD  length		= 0;
+	DWORD ts		= 0;
+	DWORD payloadSize	= 0;
+	std::array<bool,FlexFEC::MaxMaskBits> mask = {};
+	std::array<BYTE,kMaxRepairSize> payload = {};
+	std::array<BYTE,kMaxRepairSize> repair = {};
+	DWORD repairTimestamp	= 0;
+	
+	QWORD protectedPackets	= 0;
+	QWORD repairPackets	= 0;
+	QWORD repairBytes	= 0;
+};
+
+#endif /* FLEXFECENCODER_H */
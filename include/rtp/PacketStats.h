@@ -7,51 +7,54 @@ struct PacketStats
 {
 	using shared = std::shared_ptr<PacketStats>;
 
+	PacketStats() = default;
+	
+	PacketStats(const RTPPacket::shared& packet, uint32_t size, uint64_t now) :
+		transportWideSeqNum(packet->GetTransportSeqNum()),
+		ssrc(packet->GetSSRC()),
+		extSeqNum(packet->GetExtSeqNum()),
+		size(size),
+		payload(packet->GetMediaLength()),
+		timestamp(packet->GetTimestamp()),
+		time(now),
+		mark(packet->GetMark())
+	{
+	}
+	
+	PacketStats(uint32_t transportWideSeqNum, uint32_t ssrc,uint32_t extSeqNum, uint32_t size, uint32_t payload, uint32_t timestamp, uint64_t now, bool mark) :
+		transportWideSeqNum(transportWideSeqNum),
+		ssrc(ssrc),
+		extSeqNum(extSeqNum),
+		size(size),
+		payload(payload),
+		timestamp(timestamp),
+		time(now),
+		mark(mark)
+	{
+	}
+	
 	static PacketStats::shared Create(const RTPPacket::shared& packet, uint32_t size, uint64_t now)
 	{
-		auto stats = std::make_shared<PacketStats>();
-
-		stats->transportWideSeqNum	= packet->GetTransportSeqNum();
-		stats->ssrc			= packet->GetSSRC();
-		stats->extSeqNum		= packet->GetExtSeqNum();
-		stats->size			= size;
-		stats->payload			= packet->GetMediaLength();
-		stats->timestamp		= packet->GetTimestamp();
-		stats->time			= now;
-		stats->mark			= packet->GetMark();
-
-		return stats;
+		return std::make_shared<PacketStats>(packet,size,now);
 	}
 	
 	static PacketStats::shared Create(uint32_t transportWideSeqNum, uint32_t ssrc,uint32_t extSeqNum, uint32_t size, uint32_t payload, uint32_t timestamp, uint64_t now, bool mark)
 	{
-		//Create stat
-		auto stats = std::make_shared<PacketStats>();
-		//Fill
-		stats->transportWideSeqNum	= transportWideSeqNum;
-		stats->ssrc			= ssrc;
-		stats->extSeqNum		= extSeqNum;
-		stats->size			= size;
-		stats->payload			= payload;
-		stats->timestamp		= timestamp;
-		stats->time			= now;
-		stats->mark			= mark;
-
-		return stats;
+		return std::make_shared<PacketStats>(transportWideSeqNum,ssrc,extSeqNum,size,payload,timestamp,now,mark);
 	}
 
-	uint32_t transportWideSeqNum;
-	uint32_t ssrc;
-	uint32_t extSeqNum;
-	uint32_t size;
-	uint32_t payload;
-	uint32_t timestamp;
-	uint64_t time;
+	uint32_t transportWideSeqNum	= 0;
+	uint32_t ssrc			= 0;
+	uint32_t extSeqNum		= 0;
+	uint32_t size			= 0;
+	uint32_t payload		= 0;
+	uint32_t timestamp		= 0;
+	uint64_t time			= 0;
 	bool  mark = false;
 	bool  rtx = false;
 	bool  probing = false;
+	uint32_t probeCluster = 0;
 	uint32_t bwe = 0;
 };
 
 #endif /* PACKETSTATS_H */
-
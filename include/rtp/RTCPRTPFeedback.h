@@ -268,8 +268,11 @@ public:
 		virtual DWORD Serialize(BYTE* data,DWORD size) const;
 		virtual void Dump() const;
 		
-		//Pair<seqnum,us> -> us = 0, not received
-		typedef std::map<DWORD,QWORD> Packets;
+		//Encode to buffer, or only calculate size if no buffer is provided
+		DWORD Encode(BYTE* data,DWORD size) const;
+		
+		//Pair<seqnum,us> -> us = 0, not received, in transport sequence order
+		typedef std::vector<std::pair<DWORD,QWORD>> Packets;
 		
 		BYTE feedbackPacketCount;
 		QWORD referenceTime = 0;
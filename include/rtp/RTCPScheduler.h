@@ -0,0 +1,71 @@
+#ifndef RTCPSCHEDULER_H
+#define RTCPSCHEDULER_H
+
+#include <vector>
+#include <functional>
+#include <chrono>
+
+#include "config.h"
+#include "rtp/RTCPPacket.h"
+#include "rtp/RTCPCompoundPacket.h"
+#include "TimeService.h"
+
+/*
+ * Collects all the RTCP blocks generated on a transport and sends them
+ * aggregated on as few compound packets as possible.
+ *  - Regular blocks (SR/RR/REMB) are delayed up to the RFC 3550 interval,
+ *    calculated as 5% of the session bandwidth.
+ *  - Urgent blocks (NACK/PLI/FIR/transport-wide feedback) are sent as RFC 4585
+ *    early feedback on next loop iteration, piggybacking any regular pending one.
+ *  - The time a report block has been queued is added to its DLSR when sent,
+ *    so it does not increase the rtt calculated by the remote peer.
+ *  - Every compound starts with a report, an empty RR from the configured
+ *    ssrc is added when feedback is splitted over several compounds.
+ */
+class RTCPScheduler
+{
+public:
+	using Sender = std::function<int(const RTCPCompoundPacket::shared&)>;
+
+	static constexpr DWORD MaxCompoundSize = 1200;
+	static constexpr std::chrono::milliseconds MinInterval = std::chrono::milliseconds(50);
+	static constexpr std::chrono::milliseconds MaxInterval = std::chrono::milliseconds(1000);
+public:
+	RTCPScheduler(TimeService& timeService, Sender sender);
+	~RTCPScheduler();
+
+	void Enqueue(const RTCPPacket::shared& packet, bool urgent = false);
+	void Enqueue(const RTCPCompoundPacket::shared& rtcp, bool urgent = false);
+	void SetSessionBandwidth(DWORD bitrate)	{ this->bandwidth = bitrate;	}
+	void SetSSRC(DWORD ssrc)		{ this->ssrc = ssrc;		}
+	void Flush();
+	void Stop();
+
+	std::chrono::milliseconds GetInterval() const;
+	DWORD GetPendingCount()		const { return pending.size();		}
+	QWORD GetTotalBlocks()		const { return totalBlocks;		}
+	QWORD GetTotalCompounds()	const { return totalCompounds;		}
+private:
+	void Schedule(const std::chrono::milliseconds& ms);
+	static void AddDelay(const RTCPPacket::shared& packet, QWORD ms);
+private:
+	struct Pending
+	{
+		RTCPPacket::shared packet;
+		QWORD enqueued;
+	};
+
+	TimeService&	timeService;
+	Sender		sender;
+	Timer::shared	timer;
+	std::vector<Pending> pending;
+	QWORD		scheduled	= 0;
+	DWORD		bandwidth	= 0;
+	DWORD		ssrc		= 1;
+	DWORD		avgSize		= 0;
+	QWORD		totalBlocks	= 0;
+	QWORD		totalCompounds	= 0;
+};
+
+#endif /* RTCPSCHEDULER_H */
+
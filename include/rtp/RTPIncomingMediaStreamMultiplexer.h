@@ -1,24 +1,18 @@
 #ifndef RTPINCOMINGMEDIASTREAMMULTIPLEXER_H
 #define RTPINCOMINGMEDIASTREAMMULTIPLEXER_H
 
-#include <set>
-
 #include "config.h"
 #include "use.h"
-#include "rtp/RTPIncomingMediaStream.h"
+#include "rtp/RTPStreamFanOut.h"
 #include "TimeService.h"
 
 
 class RTPIncomingMediaStreamMultiplexer : 
-	public RTPIncomingMediaStream,
-	public RTPIncomingMediaStream::Listener
+	public RTPStreamFanOut
 {
 public:
 	RTPIncomingMediaStreamMultiplexer(DWORD ssrc, TimeService& timeService);
 	virtual ~RTPIncomingMediaStreamMultiplexer() = default;
-	virtual void AddListener(RTPIncomingMediaStream::Listener* listener) override;
-	virtual void RemoveListener(RTPIncomingMediaStream::Listener* listener) override;
-	virtual DWORD GetMediaSSRC() override { return ssrc; }
 	
 	virtual void onRTP(RTPIncomingMediaStream* stream,const RTPPacket::shared& packet) override;
 	virtual void onRTP(RTPIncomingMediaStream* stream,const std::vector<RTPPacket::shared>& packets) override;
@@ -27,10 +21,7 @@ public:
 	
 	void Stop();
 private:
-	DWORD		ssrc = 0;
 	TimeService&	timeService;
-	Mutex		listenerMutex;
-	std::set<RTPIncomingMediaStream::Listener*>  listeners;	
 };
 
 #endif /* RTPINCOMINGMEDIASTREAMMULTIPLEXER_H */
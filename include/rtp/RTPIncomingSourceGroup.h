@@ -4,6 +4,8 @@
 #include <set>
 #include <string>
 #include <list>
+#include <map>
+#include <functional>
 
 #include "config.h"
 #include "use.h"
@@ -12,6 +14,7 @@
 #include "rtp/RTPIncomingSource.h"
 #include "rtp/RTPLostPackets.h"
 #include "rtp/RTPBuffer.h"
+#include "rtp/FlexFECDecoder.h"
 #include "remoterateestimator.h"
 #include "TimeService.h"
 
@@ -19,6 +22,11 @@ class RTPIncomingSourceGroup :
 	public RTPIncomingMediaStream,
 	public RemoteRateEstimator::Listener
 {
+public:
+	using KeyFrameRequester = std::function<void(DWORD ssrc)>;
+	
+	static constexpr QWORD kMinKeyFrameInterval = 500; // ms
+	static constexpr DWORD kMaxGOPCacheSize = 2*1024*1024; // bytes
 public:	
 	RTPIncomingSourceGroup(MediaFrame::Type type,TimeService& timeService);
 	virtual ~RTPIncomingSourceGroup() = default;
@@ -42,6 +50,16 @@ public:
 	
 	WORD SetRTTRTX(uint64_t time);
 	
+	void SetKeyFrameRequester(KeyFrameRequester requester) { this->keyFrameRequester = requester; }
+	bool RequestKeyFrame(QWORD now);
+	void onKeyFrame(QWORD now);
+	QWORD GetKeyFrameInterval() const;
+	bool IsWaitingForKeyFrame() const	{ return waitingForKeyFrame;	}
+	
+	void SetGOPCache(bool enabled, DWORD maxSize = kMaxGOPCacheSize);
+	std::vector<RTPPacket::shared> GetGOPCache(BYTE maxSpatialLayerId = LayerInfo::MaxLayerId);
+	DWORD GetGOPCacheSize() const		{ return gopSize;		}
+	
 	DWORD GetCurrentLost()			const { return losts.GetTotal();}
 	DWORD GetMinWaitedTime()		const { return minWaitedTime;	}
 	DWORD GetMaxWaitedTime()		const { return maxWaitedTime;	}
@@ -50,6 +68,10 @@ public:
 	virtual void onTargetBitrateRequested(DWORD bitrate) override;
 private:
 	void DispatchPackets(QWORD time);
+	void ForwardKeyFrameRequest(QWORD now);
+	void UpdateGOPCache(const std::vector<RTPPacket::shared>& ordered);
+	void ClearGOPCache();
+	std::vector<RTPPacket::shared> GetCachedPackets(BYTE maxSpatialLayerId) const;
 public:	
 	std::string rid;
 	std::string mid;
@@ -58,6 +80,7 @@ public:
 	RTPIncomingSource media;
 	RTPIncomingSource fec;
 	RTPIncomingSource rtx;
+	FlexFECDecoder fecDecoder;
         DWORD remoteBitrateEstimation = 0;
 	
 	//Stats
@@ -65,12 +88,16 @@ public:
 	DWORD minWaitedTime = 0;
 	DWORD maxWaitedTime = 0;
 	long double avgWaitedTime = 0;
+	DWORD requestedPLIs = 0;	//Key frame requests from all listeners
+	DWORD forwardedPLIs = 0;	//Key frame requests actually sent to the publisher
 	
 	//TODO: FIx
 	RemoteRateEstimator remoteRateEstimator;
 private:
 	TimeService&	timeService;
 	Timer::shared	dispatchTimer;
+	Timer::shared	keyFrameTimer;
+	KeyFrameRequester keyFrameRequester;
 	RTPLostPackets	losts;
 	RTPBuffer	packets;
 	Mutex		listenerMutex;
@@ -79,6 +106,24 @@ private:
 	WORD  rttrtxSeq	 = 0 ;
 	QWORD rttrtxTime = 0;
 	bool remb	 = false;
+	
+	QWORD lastKeyFrame	  = 0;
+	QWORD lastForwardedPLI	  = 0;
+	bool waitingForKeyFrame	  = false;
+	bool pendingKeyFrameRequest = false;
+	
+	//Packets since last key frame per spatial layer, protected by the listener mutex
+	struct GOPLayer
+	{
+		std::vector<RTPPacket::shared> packets;
+		bool dropped = false;
+	};
+	bool  gopCache		= false;
+	bool  gopStarted	= false;
+	DWORD gopMaxSize	= kMaxGOPCacheSize;
+	DWORD gopSize		= 0;
+	DWORD gopTimestamp	= 0;
+	std::map<BYTE,GOPLayer> gop;
 };
 
 #endif /* RTPINCOMINGSOURCEGROUP_H */
@@ -16,6 +16,7 @@ struct RTPOutgoingSource :
 	QWORD	lastSenderReport;
 	QWORD	lastSenderReportNTP;
 	DWORD	remb;
+	BYTE	fractionLost;
 	
 	RTPOutgoingSource() : RTPSource()
 	{
@@ -29,6 +30,7 @@ struct RTPOutgoingSource :
 		seqGaps			= 0;
 		generatedSeqNum		= false;
 		remb			= 0;
+		fractionLost		= 0;
 	}
 	
 	DWORD CorrectExtSeqNum(DWORD extSeqNum) 
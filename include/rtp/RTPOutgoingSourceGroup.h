@@ -9,6 +9,8 @@
 #include "use.h"
 #include "rtp/RTPPacket.h"
 #include "rtp/RTPOutgoingSource.h"
+#include "rtp/RTXController.h"
+#include "rtp/FlexFECEncoder.h"
 
 
 struct RTPOutgoingSourceGroup
@@ -19,6 +21,8 @@ public:
 		public:
 			virtual void onPLIRequest(RTPOutgoingSourceGroup* group,DWORD ssrc) = 0;
 			virtual void onREMB(RTPOutgoingSourceGroup* group,DWORD ssrc,DWORD bitrate) = 0;
+			//Loss reported on RTCP receiver reports, in 1/256 units
+			virtual void onPacketLoss(RTPOutgoingSourceGroup* group,DWORD ssrc,BYTE fractionLost) {}
 		
 	};
 public:
@@ -29,6 +33,7 @@ public:
 	void RemoveListener(Listener* listener);
 	void onPLIRequest(DWORD ssrc);
 	void onREMB(DWORD ssrc,DWORD bitrate);
+	void onPacketLoss(DWORD ssrc,BYTE fractionLost);
 	
 	RTPOutgoingSource* GetSource(DWORD ssrc);
 	
@@ -49,6 +54,8 @@ public:
 	RTPOutgoingSource media;
 	RTPOutgoingSource fec;
 	RTPOutgoingSource rtx;
+	RTXController rtxController;
+	FlexFECEncoder fecEncoder;
 private:	
 	mutable Mutex listenersMutex;
 	std::map<DWORD,RTPPacket::shared> packets;
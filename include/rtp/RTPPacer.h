@@ -0,0 +1,67 @@
+#ifndef RTPPACER_H
+#define RTPPACER_H
+
+#include <array>
+#include <deque>
+#include <functional>
+#include <chrono>
+
+#include "config.h"
+#include "media.h"
+#include "rtp/RTPPacket.h"
+#include "TimeService.h"
+
+/*
+ * Leaky bucket pacer for outgoing rtp packets.
+ *  - Packets are metered at a multiple of the target bitrate, so frame bursts
+ *    don't leave the transport at line rate.
+ *  - There is a queue per media type, lower types are served first. Audio
+ *    bypasses the queues but is taken into account on the budget.
+ *  - Up to a burst of budget is sent right away when idle.
+ *  - When there is nothing queued the remaining budget is offered for padding.
+ *  - If no target bitrate is set, packets are sent right away.
+ */
+class RTPPacer
+{
+public:
+	using Sender = std::function<DWORD(RTPPacket::shared&& packet)>;
+	using Padder = std::function<void(DWORD budget)>;
+	
+	static constexpr double PacingFactor = 2.5;
+	static constexpr std::chrono::milliseconds Interval = std::chrono::milliseconds(5);
+	static constexpr std::chrono::milliseconds MaxBurst = std::chrono::milliseconds(20);
+	static constexpr std::chrono::milliseconds MaxQueueTime = std::chrono::milliseconds(500);
+public:
+	RTPPacer(TimeService& timeService, Sender sender, Padder padder);
+	~RTPPacer();
+	
+	void Start();
+	void Stop();
+	void Enqueue(MediaFrame::Type type, RTPPacket::shared&& packet);
+	void SetTargetBitrate(DWORD bitrate)	{ this->bitrate = bitrate;	}
+	
+	DWORD GetTargetBitrate() const		{ return bitrate;		}
+	DWORD GetQueuedPackets() const;
+	std::chrono::milliseconds GetQueueTime() const;
+private:
+	void Process(std::chrono::milliseconds now);
+	void Refill(std::chrono::milliseconds now);
+	DWORD SendPacket(RTPPacket::shared&& packet);
+private:
+	struct Queued
+	{
+		RTPPacket::shared packet;
+		std::chrono::milliseconds time;
+	};
+	TimeService&	timeService;
+	Sender		sender;
+	Padder		padder;
+	Timer::shared	timer;
+	std::array<std::deque<Queued>,3> queues;
+	DWORD		bitrate	= 0;
+	int64_t		budget	= 0;
+	std::chrono::milliseconds last;
+};
+
+#endif /* RTPPACER_H */
+
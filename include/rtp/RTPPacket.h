@@ -43,6 +43,7 @@ public:
 	RTPPacket::shared Clone() const;
 	
 	DWORD Serialize(BYTE* data,DWORD size,const RTPMap& extMap) const;
+	DWORD SerializeHeaders(BYTE* data,DWORD size,const RTPMap& extMap,const BYTE* &payload,DWORD &payloadLen) const;
 	
 	bool SetPayload(const BYTE *data,DWORD size)	{ return payload->SetPayload(data,size);	}
 	bool SkipPayload(DWORD skip)			{ return payload->SkipPayload(skip);		}
@@ -94,6 +95,7 @@ public:
 	//Extensions
 	void  SetAbsSentTime(QWORD absSentTime)						{ header.extension = extension.hasAbsSentTime     = true; extension.absSentTime = absSentTime;	}
 	void  SetTimeOffset(int timeOffset)						{ header.extension = extension.hasTimeOffset      = true; extension.timeOffset = timeOffset;	}
+	void  SetAudioLevel(bool vad, BYTE level)					{ header.extension = extension.hasAudioLevel      = true; extension.vad = vad; extension.level = level;	}
 	void  SetTransportSeqNum(DWORD seq)						{ header.extension = extension.hasTransportWideCC = true; extension.transportSeqNum = seq;	}
 	void  SetFrameMarkings(const RTPHeaderExtension::FrameMarks& frameMarks )	{ header.extension = extension.hasFrameMarking    = true; extension.frameMarks = frameMarks;	}
 	void  SetRId(const std::string &rid)						{ header.extension = extension.hasRId		  = true; extension.rid = rid;			}
@@ -0,0 +1,44 @@
+#ifndef RTPPADDINGTEMPLATE_H
+#define RTPPADDINGTEMPLATE_H
+
+#include <array>
+
+#include "config.h"
+#include "rtp/RTPMap.h"
+
+/*
+ * Prebuilt padding-only rtp packet used for bandwidth probing.
+ *  - Header, one-byte header extensions and zeroed padding are serialized once.
+ *  - Filling a packet is a single copy plus patching seq num, timestamp,
+ *    transport wide seq num and abs send time at known offsets.
+ */
+class RTPPaddingTemplate
+{
+public:
+	static constexpr BYTE MaxPadding = 255;
+public:
+	bool Build(DWORD ssrc, BYTE payloadType, BYTE transportWideCCId, BYTE absSendTimeId);
+	DWORD Fill(BYTE* data, DWORD size, WORD seqNum, DWORD timestamp, WORD transportSeqNum, QWORD absSendTime, BYTE padding) const;
+	
+	bool Matches(DWORD ssrc, BYTE payloadType, BYTE transportWideCCId, BYTE absSendTimeId) const
+	{
+		return headerLen && this->ssrc==ssrc && this->payloadType==payloadType && this->transportWideCCId==transportWideCCId && this->absSendTimeId==absSendTimeId;
+	}
+	bool  IsValid() const			{ return headerLen;		}
+	DWORD GetSSRC() const			{ return ssrc;			}
+	DWORD GetHeaderLength() const		{ return headerLen;		}
+	bool  HasTransportWideCC() const	{ return transportWideCCOffset;	}
+private:
+	//RTP header + extension header + tranport wide + abs send time
+	std::array<BYTE,12+4+3+4+MaxPadding> buffer = {};
+	DWORD headerLen			= 0;
+	DWORD transportWideCCOffset	= 0;
+	DWORD absSendTimeOffset		= 0;
+	DWORD ssrc			= 0;
+	BYTE  payloadType		= 0;
+	BYTE  transportWideCCId		= RTPMap::NotFound;
+	BYTE  absSendTimeId		= RTPMap::NotFound;
+};
+
+#endif /* RTPPADDINGTEMPLATE_H */
+
@@ -0,0 +1,55 @@
+#ifndef RTPSTREAMFANOUT_H
+#define RTPSTREAMFANOUT_H
+
+#include <set>
+#include <vector>
+
+#include "config.h"
+#include "use.h"
+#include "rtp/RTPIncomingMediaStream.h"
+#include "TimeService.h"
+
+class RTPStreamTransponder;
+
+/*
+ * One to many forwarding stage between an incoming stream and its transponders.
+ *  - Transponders are kept in contiguous arrays grouped by the time service of
+ *    their sender, so each packet is posted once per loop instead of once per
+ *    subscriber.
+ *  - Header rewrites are calculated on the incoming thread and applied on the
+ *    sender loop over a clone sharing the payload of the original packet.
+ *  - The sender is taken from the transponder on each packet, transponders
+ *    are removed when closed as they stop listening the incoming stream.
+ *  - Any other listener receives the packets as usual.
+ */
+class RTPStreamFanOut :
+	public RTPIncomingMediaStream,
+	public RTPIncomingMediaStream::Listener
+{
+public:
+	RTPStreamFanOut(DWORD ssrc);
+	virtual ~RTPStreamFanOut() = default;
+	virtual void AddListener(RTPIncomingMediaStream::Listener* listener) override;
+	virtual void RemoveListener(RTPIncomingMediaStream::Listener* listener) override;
+	virtual DWORD GetMediaSSRC() override { return ssrc; }
+	
+	virtual void onRTP(RTPIncomingMediaStream* stream,const RTPPacket::shared& packet) override;
+	virtual void onBye(RTPIncomingMediaStream* stream) override;
+	virtual void onEnded(RTPIncomingMediaStream* stream) override;
+	
+	DWORD GetLoopCount() const	{ return loops.size();	}
+	DWORD GetTransponderCount() const;
+private:
+	struct Loop
+	{
+		TimeService*				timeService;
+		std::vector<RTPStreamTransponder*>	transponders;
+	};
+private:
+	DWORD		ssrc = 0;
+	Mutex		listenerMutex;
+	std::vector<Loop> loops;
+	std::set<RTPIncomingMediaStream::Listener*> listeners;
+};
+
+#endif /* RTPSTREAMFANOUT_H */
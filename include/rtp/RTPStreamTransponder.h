@@ -14,6 +14,7 @@
 #ifndef RTPSTREAMTRANSPONDER_H
 #define RTPSTREAMTRANSPONDER_H
 
+#include <atomic>
 #include "rtp.h"
 #include "VideoLayerSelector.h"
 
@@ -21,6 +22,22 @@ class RTPStreamTransponder :
 	public RTPIncomingMediaStream::Listener,
 	public RTPOutgoingSourceGroup::Listener
 {
+public:
+	static constexpr DWORD kSilenceHangover		= 5;	// packets forwarded after speech ends
+	static constexpr DWORD kSilenceKeepAlive	= 50;	// forward one of each while silent
+public:
+	struct Rewrite
+	{
+		DWORD ssrc			= 0;
+		DWORD extSeqNum			= 0;
+		DWORD timestamp			= 0;
+		bool  mark			= false;
+		bool  rewitePictureIds		= false;
+		DWORD pictureId			= 0;
+		DWORD temporalLevelZeroIndex	= 0;
+		
+		RTPPacket::shared Apply(const RTPPacket::shared& packet) const;
+	};
 public:
 	RTPStreamTransponder(RTPOutgoingSourceGroup* outgoing,RTPSender* sender);
 	virtual ~RTPStreamTransponder();
@@ -37,6 +54,16 @@ public:
 	
 	void SelectLayer(int spatialLayerId,int temporalLayerId);
 	void Mute(bool muting);
+	bool IsMuted() const { return muted; }
+	void SetSilenceSuppression(bool enabled, BYTE silenceLevel = 127);
+	DWORD GetSuppressedPackets() const { return suppressed; }
+	bool Process(const RTPPacket::shared& packet,Rewrite& rewrite);
+	RTPSender* GetSender() const { return sender; }
+	
+	std::vector<LayerSource> GetLayers(QWORD now);
+	DWORD GetLayerBitrate(BYTE spatialLayerId,BYTE temporalLayerId,QWORD now);
+	BYTE GetSelectedSpatialLayerId() const	{ return spatialLayerId;	}
+	BYTE GetSelectedTemporalLayerId() const	{ return temporalLayerId;	}
 protected:
 	void RequestPLI();
 
@@ -46,12 +73,16 @@ private:
 	RTPIncomingMediaStream *incoming	= NULL;
 	RTPReceiver* receiver			= NULL;
 	RTPSender* sender			= NULL;
+	LayerAllocator* allocator		= NULL;
 	std::unique_ptr<VideoLayerSelector> selector;
 	Mutex mutex;
+	Mutex layersMutex;
+	std::map<WORD,LayerSource> layers;	//Incoming bitrate per layer, before selection
 	
 	
-	volatile bool reset	= false;
+	std::atomic<bool> reset	= {false}; //Set by any thread, handled on next packet
 	volatile bool muted	= false;
+	bool primed		= false; //Got an intra since incoming was set, protected by mutex
 	DWORD firstExtSeqNum	= 0;  //First seq num of incoming stream
 	DWORD baseExtSeqNum	= 0;  //Base seq num of outgoing stream
 	DWORD lastExtSeqNum	= 0;  //Last seq num of sent packet
@@ -76,6 +107,10 @@ private:
 	WORD tl0Idx		= 0;
 	bool rewritePicId	= true;
 	QWORD lastSentPLI	= 0;
+	bool  silenceSuppression= false;
+	BYTE  silenceLevel	= 127;	//-dBov, RFC 6464
+	DWORD silentPackets	= 0;  //Consecutive silent packets
+	DWORD suppressed	= 0;  //Silent packets not forwarded
 	
 	RTPPacket::shared	h264Parameters;
 };
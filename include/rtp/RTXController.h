@@ -0,0 +1,47 @@
+#ifndef RTXCONTROLLER_H
+#define RTXCONTROLLER_H
+
+#include <array>
+
+#include "config.h"
+
+/*
+ * Decides which NACKed packets of an outgoing group are worth retransmitting.
+ *  - Re-sends of the same sequence number within one RTT are suppressed, as
+ *    the previous retransmission may still be in flight.
+ *  - RTX bitrate is capped to a fraction of the available bandwidth. Above
+ *    half of the cap, only packets young enough to still be waited for by
+ *    the receiver jitter buffer are retransmitted.
+ */
+class RTXController
+{
+public:
+	static constexpr float kMaxRTXRatio		= 0.30f;
+	static constexpr float kPreferredRTXRatio	= 0.15f;
+	static constexpr QWORD kMinResendInterval	= 20;	// ms
+	static constexpr QWORD kJitterBufferDelay	= 150;	// ms
+	static constexpr DWORD kHistorySize		= 1024;
+public:
+	bool Accept(WORD seq, QWORD age, DWORD rtt, DWORD rtxBitrate, DWORD availableBitrate, QWORD now);
+	void Reset();
+	
+	DWORD GetSent()			const { return sent;			}
+	DWORD GetSuppressedDuplicates()	const { return suppressedDuplicates;	}
+	DWORD GetSuppressedBudget()	const { return suppressedBudget;	}
+	DWORD GetSuppressedLate()	const { return suppressedLate;		}
+	DWORD GetSuppressed()		const { return suppressedDuplicates + suppressedBudget + suppressedLate; }
+private:
+	struct Resent
+	{
+		WORD  seq	= 0;
+		QWORD time	= 0;
+	};
+	std::array<Resent,kHistorySize> history;
+	
+	DWORD sent			= 0;
+	DWORD suppressedDuplicates	= 0;
+	DWORD suppressedBudget		= 0;
+	DWORD suppressedLate		= 0;
+};
+
+#endif /* RTXCONTROLLER_H */
@@ -0,0 +1,48 @@
+#ifndef TRANSPORTWIDERECEIVEDPACKETS_H
+#define TRANSPORTWIDERECEIVEDPACKETS_H
+
+#include <array>
+
+#include "config.h"
+#include "rtp/RTCPRTPFeedback.h"
+
+/*
+ * Receive history for transport wide congestion control, indexed by the
+ * extended transport sequence number on a fixed ring so no allocation is
+ * done per received packet. The last reported ones are kept so packets
+ * arriving after being reported as lost are sent again on next feedback.
+ */
+class TransportWideReceivedPackets
+{
+public:
+	//Must be power of 2
+	static constexpr DWORD Size = 1024;
+	//Already reported packets kept to detect late arrivals
+	static constexpr DWORD LateWindow = 64;
+public:
+	void Reset();
+	bool Add(DWORD extSeqNum, QWORD time);
+	bool Fits(DWORD extSeqNum) const;
+	void Flush(RTCPRTPFeedback::TransportWideFeedbackMessageField::Packets& packets, QWORD initTime);
+	
+	bool  IsEmpty()			const { return !count;		}
+	DWORD GetCount()		const { return count;		}
+	DWORD GetLastExtSeqNum()	const { return last;		}
+	QWORD GetFirstTime()		const { return firstTime;	}
+private:
+	std::array<QWORD,Size> times = {};
+	//First sequence number not reported yet
+	DWORD base	= 0;
+	//First sequence number to report on next feedback, lower than base if a late one arrived
+	DWORD first	= 0;
+	//Number of reported sequence numbers before base still on the ring
+	DWORD reported	= 0;
+	//Max sequence number received or reported
+	DWORD last	= 0;
+	DWORD count	= 0;
+	QWORD firstTime	= 0;
+	bool  started	= false;
+};
+
+#endif /* TRANSPORTWIDERECEIVEDPACKETS_H */
+
@@ -9,30 +9,59 @@
 #define	SIDEBAR_H
 #include "config.h"
 #include "tools.h"
+#include "AudioMixKernel.h"
 #include <set>
+#include <map>
+#include <vector>
 
 class Sidebar
 {
+public:
+	typedef std::set<int> Participants;
 public:
 	Sidebar();
 	~Sidebar();
 
-	int  Update(int index,SWORD *samples,DWORD len);
+	int  Update(int index,SWORD *samples,DWORD len,DWORD vad = 0);
+	void Mix(DWORD len,DWORD maxSpeakers = 0);
 	void Reset();
 
 	void AddParticipant(int id);
 	bool HasParticipant(int id);
 	void RemoveParticipant(int id);
+	bool IsMixed(int id) const	{ return mixed.find(id)!=mixed.end();	}
 
-	SWORD* GetBuffer()	{ return mixer_buffer; }
+	const Participants& GetParticipants() const	{ return participants;		}
+	const Participants& GetMixed() const		{ return mixed;			}
+	const int32_t* GetAccumulator() const		{ return accumulator;		}
+	SWORD* GetBuffer()				{ return mixer_buffer;		}
 public:
 	static const DWORD MIXER_BUFFER_SIZE = 4096;
+	//Mixes a speaker is kept after being selected as one of the loudest, 500ms on the 10ms mixer loop
+	static const DWORD MIN_SELECTED_MIXES = 50;
+	//Percent a speaker has to be louder than a selected one to replace it
+	static const DWORD SELECTED_MARGIN = 25;
 private:
-	typedef std::set<int> Participants;
-private:
-	//Audio mixing buffer
+	//32 bits mixing buffer
+	int32_t* accumulator;
+	//Limited output of the mix
 	SWORD* mixer_buffer;
+	AudioLimiter limiter;
 	Participants participants;
+	//Participants summed on current mix
+	Participants mixed;
+	//Loudest participants selected and the mix when they were
+	std::map<int,QWORD> selected;
+	QWORD mixes = 0;
+	//Inputs pending to be mixed
+	struct Input
+	{
+		int	id;
+		SWORD*	samples;
+		DWORD	len;
+		DWORD	vad;
+	};
+	std::vector<Input> inputs;
 };
 
 #endif	/* SIDEBAR_H */
@@ -52,6 +52,18 @@ void ActiveSpeakerDetector::Release(uint32_t id)
 		
 	//Remove speaker
 	speakers.erase(id);
+	
+	//Remove it from the last N set
+	auto active = std::find(activeSpeakers.begin(),activeSpeakers.end(),id);
+	//If it was there
+	if (active!=activeSpeakers.end())
+	{
+		//Remove it
+		activeSpeakers.erase(active);
+		//Fill the empty slot now
+		UpdateLastN(last,true);
+	}
+	
 	//If it was last active
 	if (lastActive==id)
 	{
@@ -114,4 +126,113 @@ void ActiveSpeakerDetector::Process(uint64_t now)
 		
 		//UltraDebug("-ActiveSpeakerDetector::onActiveSpeakerChanded() [active:%u,blockedUntil:%ull]\n",active,blockedUntil);
 	}
+	
+	//Update last N set with new scores
+	UpdateLastN(now,false);
+}
+
+void ActiveSpeakerDetector::SetLastN(uint32_t lastN)
+{
+	Debug("-ActiveSpeakerDetector::SetLastN() [lastN:%u]\n",lastN);
+	
+	//Store it
+	this->lastN = lastN;
+	
+	bool changed = false;
+	
+	//Remove lowest ranked ones if it has been reduced
+	while (activeSpeakers.size()>lastN)
+	{
+		//Not active anymore
+		speakers[activeSpeakers.back()].active = false;
+		//Remove it
+		activeSpeakers.pop_back();
+		//Changed
+		changed = true;
+	}
+	
+	//Fill any new slot
+	UpdateLastN(last,changed);
+}
+
+void ActiveSpeakerDetector::UpdateLastN(uint64_t now, bool changed)
+{
+	//Check if enabled
+	if (!lastN)
+		return;
+	
+	//Get speakers outside the last N set
+	std::vector<std::pair<uint64_t,uint32_t>> candidates;
+	for (const auto& entry : speakers)
+		if (!entry.second.active)
+			candidates.emplace_back(entry.second.score,entry.first);
+	
+	//Highest scores first
+	std::sort(candidates.begin(),candidates.end(),[](const auto& a, const auto& b){
+		return a.first!=b.first ? a.first>b.first : a.second<b.second;
+	});
+	
+	auto candidate = candidates.begin();
+	
+	//Fill empty slots, even with silent speakers
+	for (;candidate!=candidates.end() && activeSpeakers.size()<lastN;++candidate)
+	{
+		//Add it
+		activeSpeakers.push_back(candidate->second);
+		//Now it is active
+		speakers[candidate->second].active = true;
+		speakers[candidate->second].activeSince = now;
+		//Changed
+		changed = true;
+	}
+	
+	//Replace the weakest speakers by louder candidates
+	for (;candidate!=candidates.end();++candidate)
+	{
+		//Candidate must be speaking
+		if (candidate->first<=minActivationScore)
+			break;
+		
+		//Find weakest speaker which has been on the set long enough
+		auto weakest = activeSpeakers.end();
+		for (auto it=activeSpeakers.begin();it!=activeSpeakers.end();++it)
+		{
+			const auto& info = speakers[*it];
+			//Do not replace speakers just added
+			if (now<info.activeSince+minChangePeriod)
+				continue;
+			//If it is weaker
+			if (weakest==activeSpeakers.end() || info.score<speakers[*weakest].score)
+				weakest = it;
+		}
+		
+		//If none can be replaced or candidate is not loud enough to do it
+		if (weakest==activeSpeakers.end() || candidate->first<speakers[*weakest].score+lastNHysteresis)
+			break;
+		
+		UltraDebug("-ActiveSpeakerDetector::UpdateLastN() | replacing speaker [out:%u,in:%u,score:%llu]\n",*weakest,candidate->second,candidate->first);
+		
+		//Replace it
+		speakers[*weakest].active = false;
+		*weakest = candidate->second;
+		speakers[candidate->second].active = true;
+		speakers[candidate->second].activeSince = now;
+		//Changed
+		changed = true;
+	}
+	
+	//Rank by score
+	auto byScore = [&](uint32_t a, uint32_t b){
+		return speakers[a].score>speakers[b].score;
+	};
+	
+	//Nothing more to do if the set and the ranking are the same
+	if (!changed && std::is_sorted(activeSpeakers.begin(),activeSpeakers.end(),byScore))
+		return;
+	
+	//Re-rank, keeping order of speakers with same score
+	std::stable_sort(activeSpeakers.begin(),activeSpeakers.end(),byScore);
+	
+	//Event
+	listener->onActiveSpeakersChanged(activeSpeakers);
 }
@@ -0,0 +1,368 @@
+#include "AudioConferenceEngine.h"
+#include "log.h"
+
+#include <time.h>
+#include <errno.h>
+#include <algorithm>
+
+static inline QWORD GetMonotonicTime()
+{
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC,&ts);
+	return (QWORD)ts.tv_sec*1000000 + ts.tv_nsec/1000;
+}
+
+AudioConferenceEngine::AudioConferenceEngine(DWORD numWorkers)
+{
+	//At least one
+	numWorkers = std::max(numWorkers,1u);
+
+	//Create workers
+	for (DWORD i=0;i<numWorkers;++i)
+	{
+		Worker* worker = new Worker();
+		worker->engine = this;
+		workers.push_back(worker);
+	}
+}
+
+AudioConferenceEngine::~AudioConferenceEngine()
+{
+	//Stop threads
+	Stop();
+
+	//Delete workers
+	for (auto worker : workers)
+		delete(worker);
+}
+
+bool AudioConferenceEngine::Start()
+{
+	Log("-AudioConferenceEngine::Start() [workers:%u]\n",workers.size());
+
+	//Check if already running
+	if (running)
+		//Done
+		return true;
+
+	//Running
+	running = true;
+
+	//Launch workers
+	for (auto worker : workers)
+		createPriorityThread(&worker->thread,run,worker,0);
+
+	return true;
+}
+
+bool AudioConferenceEngine::Stop()
+{
+	//Check if running
+	if (!running)
+		//Done
+		return true;
+
+	Log(">AudioConferenceEngine::Stop()\n");
+
+	//Stop them
+	running = false;
+
+	//Wait them, they will exit on next tick
+	for (auto worker : workers)
+		pthread_join(worker->thread,NULL);
+
+	Log("<AudioConferenceEngine::Stop()\n");
+
+	return true;
+}
+
+AudioConferenceEngine::Conference* AudioConferenceEngine::GetConference(Worker* worker, AudioMixer* mixer)
+{
+	//Find it
+	for (auto& conference : worker->conferences)
+		if (conference.mixer==mixer)
+			return &conference;
+	//Not found
+	return nullptr;
+}
+
+bool AudioConferenceEngine::AddConference(AudioMixer* mixer)
+{
+	//Lock
+	ScopedLock scoped(mutex);
+
+	Worker* selected = nullptr;
+
+	//Get least loaded worker
+	for (auto worker : workers)
+	{
+		//Lock worker
+		ScopedLock lock(worker->mutex);
+		//Check if already added
+		if (GetConference(worker,mixer))
+			//Error
+			return Error("-AudioConferenceEngine::AddConference() already added [mixer:%p]\n",mixer);
+		//If it has less conferences
+		if (!selected || worker->conferences.size()<selected->conferences.size())
+			//Select it
+			selected = worker;
+	}
+
+	//Lock worker
+	ScopedLock lock(selected->mutex);
+
+	Conference conference;
+	conference.mixer = mixer;
+
+	//Add it, it will be processed on next tick
+	selected->conferences.push_back(std::move(conference));
+
+	Debug("-AudioConferenceEngine::AddConference() [mixer:%p,worker:%p,conferences:%u]\n",mixer,selected,selected->conferences.size());
+
+	return true;
+}
+
+bool AudioConferenceEngine::RemoveConference(AudioMixer* mixer)
+{
+	//Lock
+	ScopedLock scoped(mutex);
+
+	//For each worker
+	for (auto worker : workers)
+	{
+		//Lock worker, so it is not being processed after we return
+		ScopedLock lock(worker->mutex);
+		//Remove it
+		auto it = std::remove_if(worker->conferences.begin(),worker->conferences.end(),[=](const Conference& conference){
+			return conference.mixer==mixer;
+		});
+		//If found
+		if (it!=worker->conferences.end())
+		{
+			//Erase
+			worker->conferences.erase(it,worker->conferences.end());
+			//Done
+			return true;
+		}
+	}
+
+	//Not found
+	return false;
+}
+
+bool AudioConferenceEngine::AddDecoder(AudioMixer* mixer, AudioDecoderWorker* decoder)
+{
+	//Lock
+	ScopedLock scoped(mutex);
+
+	//For each worker
+	for (auto worker : workers)
+	{
+		//Lock worker
+		ScopedLock lock(worker->mutex);
+		//Find conference
+		if (Conference* conference = GetConference(worker,mixer))
+		{
+			//Add decoder
+			conference->decoders.insert(decoder);
+			//Done
+			return true;
+		}
+	}
+
+	//Not found
+	return Error("-AudioConferenceEngine::AddDecoder() conference not found [mixer:%p]\n",mixer);
+}
+
+bool AudioConferenceEngine::RemoveDecoder(AudioMixer* mixer, AudioDecoderWorker* decoder)
+{
+	//Lock
+	ScopedLock scoped(mutex);
+
+	//For each worker
+	for (auto worker : workers)
+	{
+		//Lock worker
+		ScopedLock lock(worker->mutex);
+		//Find conference
+		if (Conference* conference = GetConference(worker,mixer))
+			//Remove decoder
+			return conference->decoders.erase(decoder);
+	}
+
+	//Not found
+	return false;
+}
+
+void* AudioConferenceEngine::run(void* par)
+{
+	Log("AudioConferenceEngineThread [%p]\n",pthread_self());
+	//Get worker
+	Worker* worker = (Worker*)par;
+	//Block all signals
+	blocksignals();
+	//Run
+	worker->engine->Run(worker);
+	//Exit
+	return NULL;
+}
+
+void AudioConferenceEngine::Run(Worker* worker)
+{
+	Log(">AudioConferenceEngine::Run() [worker:%p]\n",worker);
+
+	timespec deadline;
+
+	//Start now
+	clock_gettime(CLOCK_MONOTONIC,&deadline);
+
+	//While running
+	while (running)
+	{
+		//Next deadline
+		deadline.tv_nsec += kTickPeriod*1000000;
+		//Normalize
+		if (deadline.tv_nsec>=1000000000)
+		{
+			deadline.tv_sec++;
+			deadline.tv_nsec -= 1000000000;
+		}
+
+		//Wait until it, absolute so there is no drift
+		while (clock_nanosleep(CLOCK_MONOTONIC,TIMER_ABSTIME,&deadline,NULL)==EINTR);
+
+		//Get how late we are
+		QWORD now = GetMonotonicTime();
+		QWORD expected = (QWORD)deadline.tv_sec*1000000 + deadline.tv_nsec/1000;
+		DWORD late = now>expected ? (now-expected)/(kTickPeriod*1000) : 0;
+
+		//If we have missed too many ticks
+		if (late>=kMaxCatchUp)
+		{
+			//Log
+			Warning("-AudioConferenceEngine::Run() stalled, resyncing [worker:%p,missed:%u]\n",worker,late);
+			//Drop them
+			worker->missed.fetch_add(late,std::memory_order_relaxed);
+			//Restart clock from now
+			clock_gettime(CLOCK_MONOTONIC,&deadline);
+			//Process just this tick
+			late = 0;
+		} else if (late) {
+			//Catch up
+			worker->missed.fetch_add(late,std::memory_order_relaxed);
+			//Move deadline
+			deadline.tv_nsec += late*kTickPeriod*1000000;
+			//Normalize
+			deadline.tv_sec += deadline.tv_nsec/1000000000;
+			deadline.tv_nsec %= 1000000000;
+		}
+
+		//Process all pending time at once
+		Tick(worker,(late+1)*kTickPeriod);
+	}
+
+	Log("<AudioConferenceEngine::Run() [worker:%p]\n",worker);
+}
+
+void AudioConferenceEngine::Tick(Worker* worker, DWORD ms)
+{
+	//Get start time
+	QWORD start = GetMonotonicTime();
+
+	//SYNC
+	{
+		//Lock worker
+		ScopedLock lock(worker->mutex);
+
+		//For each conference
+		for (auto& conference : worker->conferences)
+		{
+			//Decode all pending packets into the mixer
+			for (auto decoder : conference.decoders)
+				decoder->Process(ms);
+			//Mix and encode
+			conference.mixer->Process(conference.mixer->GetRate()*ms/1000);
+		}
+	}
+
+	//Get processing time
+	QWORD elapsed = GetMonotonicTime()-start;
+
+	//Update stats, only this thread writes them so no need for read-modify-write
+	QWORD ticks = worker->ticks.load(std::memory_order_relaxed)+1;
+	QWORD total = worker->totalTickTime.load(std::memory_order_relaxed)+elapsed;
+	QWORD max   = std::max(worker->maxTickTime.load(std::memory_order_relaxed),elapsed);
+	worker->ticks.store(ticks,std::memory_order_relaxed);
+	worker->lastTickTime.store(elapsed,std::memory_order_relaxed);
+	worker->totalTickTime.store(total,std::memory_order_relaxed);
+	worker->maxTickTime.store(max,std::memory_order_relaxed);
+
+	//Report it from time to time
+	if (ticks % kReportInterval == 0)
+		Debug("-AudioConferenceEngine::Tick() [worker:%p,conferences:%u,ticks:%llu,missed:%llu,avg:%lluus,max:%lluus]\n",worker,worker->conferences.size(),ticks,worker->missed.load(std::memory_order_relaxed),total/ticks,max);
+}
+
+DWORD AudioConferenceEngine::GetConferenceCount()
+{
+	DWORD num = 0;
+	//For each worker
+	for (auto worker : workers)
+	{
+		//Lock worker
+		ScopedLock lock(worker->mutex);
+		//Add conferences
+		num += worker->conferences.size();
+	}
+	return num;
+}
+
+QWORD AudioConferenceEngine::GetTicks()
+{
+	QWORD ticks = 0;
+	//Get max, all of them tick at the same pace
+	for (auto worker : workers)
+		ticks = std::max(ticks,worker->ticks.load(std::memory_order_relaxed));
+	return ticks;
+}
+
+QWORD AudioConferenceEngine::GetMissedTicks()
+{
+	QWORD missed = 0;
+	//Sum them
+	for (auto worker : workers)
+		missed += worker->missed.load(std::memory_order_relaxed);
+	return missed;
+}
+
+QWORD AudioConferenceEngine::GetLastTickTime()
+{
+	QWORD time = 0;
+	//Slowest worker
+	for (auto worker : workers)
+		time = std::max(time,worker->lastTickTime.load(std::memory_order_relaxed));
+	return time;
+}
+
+QWORD AudioConferenceEngine::GetMaxTickTime()
+{
+	QWORD time = 0;
+	//Slowest worker
+	for (auto worker : workers)
+		time = std::max(time,worker->maxTickTime.load(std::memory_order_relaxed));
+	return time;
+}
+
+QWORD AudioConferenceEngine::GetAvgTickTime()
+{
+	QWORD time = 0;
+	//Slowest worker
+	for (auto worker : workers)
+	{
+		//Relaxed reads, may be off by one tick
+		QWORD total = worker->totalTickTime.load(std::memory_order_relaxed);
+		QWORD ticks = worker->ticks.load(std::memory_order_relaxed);
+		if (ticks)
+			time = std::max(time,total/ticks);
+	}
+	return time;
+}
@@ -0,0 +1,260 @@
+#include "AudioJitterBuffer.h"
+#include "log.h"
+
+#include <cmath>
+#include <algorithm>
+
+bool AudioJitterBuffer::Add(const RTPPacket::shared& packet, QWORD now)
+{
+	//Lock
+	ScopedLock scope(mutex);
+
+	//Get timestamp
+	DWORD ts = packet->GetTimestamp();
+
+	//Unwrap it from the newest one, start on second cycle so older packets do not underflow
+	QWORD ext = !first ? last + (int32_t)(ts - (DWORD)last) : (1ull<<32 | ts);
+
+	//Get clock rate
+	DWORD clock = packet->GetClockRate() ? packet->GetClockRate() : 8000;
+
+	//If it is newer
+	if (first || ext>=last)
+	{
+		//If it is the next one, we can know the packet duration
+		if (!first && clock==clockRate && (WORD)(packet->GetSeqNum()-lastSeqNum)==1)
+			//Store it
+			frameDuration = std::min<QWORD>((ext-last)*1000/clock,kMaxDelay);
+		//Store last
+		last = ext;
+		lastSeqNum = packet->GetSeqNum();
+		first = false;
+	}
+
+	//Store clock rate
+	clockRate = clock;
+
+	//Check if its playout time has already passed
+	if (playout && ext<playout)
+	{
+		//Update stats
+		late++;
+		//Drop it
+		return false;
+	}
+
+	//Transit time in ms, relative to an unknown offset
+	int64_t transit = (int64_t)now - (int64_t)(ext*1000/clockRate);
+
+	//Add it to the window
+	transits.push_back(transit);
+	//Keep window size
+	if (transits.size()>kWindowSize)
+		transits.pop_front();
+
+	//Get 95th percentile of transit times
+	std::vector<int64_t> sorted(transits.begin(),transits.end());
+	auto percentile = sorted.begin() + (sorted.size()-1)*95/100;
+	std::nth_element(sorted.begin(),percentile,sorted.end());
+	int64_t high = *percentile;
+	int64_t low  = *std::min_element(sorted.begin(),percentile+1);
+
+	//Delay needed so 95% of the packets arrive on time, plus the packet itself
+	DWORD target = std::min<int64_t>(high - low + std::max(frameDuration,kMinDelay),kMaxDelay);
+
+	//Grow fast, shrink slowly
+	if (target>targetDelay)
+		targetDelay = target;
+	else
+		targetDelay = (targetDelay*63 + target)/64;
+
+	//Insert ordered by timestamp
+	if (!packets.emplace(ext,packet).second)
+		//Duplicated
+		return false;
+
+	//Check size
+	if (packets.size()>kMaxPackets)
+	{
+		//Drop oldest one
+		packets.erase(packets.begin());
+		//Update stats
+		dropped++;
+	}
+
+	//Done
+	return true;
+}
+
+RTPPacket::shared AudioJitterBuffer::Pop(QWORD from, QWORD to, QWORD* timestamp)
+{
+	//Lock
+	ScopedLock scope(mutex);
+
+	//Store playout point
+	playout = from;
+
+	//Remove packets that arrived after their playout time
+	while (!packets.empty() && packets.begin()->first<from)
+	{
+		//Drop it
+		packets.erase(packets.begin());
+		//Update stats
+		late++;
+	}
+
+	//Check if first one is in range
+	if (packets.empty() || packets.begin()->first>=to)
+		//Nothing to play
+		return nullptr;
+
+	//Get first
+	auto it = packets.begin();
+	//Return timestamp
+	*timestamp = it->first;
+	//Get packet
+	auto packet = it->second;
+	//Remove it
+	packets.erase(it);
+
+	return packet;
+}
+
+void AudioJitterBuffer::Reset()
+{
+	//Lock
+	ScopedLock scope(mutex);
+
+	//Clean everything
+	packets.clear();
+	transits.clear();
+	clockRate	= 0;
+	frameDuration	= 0;
+	targetDelay	= kMinDelay;
+	playout		= 0;
+	last		= 0;
+	lastSeqNum	= 0;
+	first		= true;
+}
+
+bool AudioJitterBuffer::IsEmpty()
+{
+	//Lock
+	ScopedLock scope(mutex);
+	return packets.empty();
+}
+
+QWORD AudioJitterBuffer::GetFirstTimestamp()
+{
+	//Lock
+	ScopedLock scope(mutex);
+	return !packets.empty() ? packets.begin()->first : 0;
+}
+
+DWORD AudioJitterBuffer::GetBufferedDuration(QWORD playout)
+{
+	//Lock
+	ScopedLock scope(mutex);
+
+	//Check we have packets
+	if (packets.empty() || !clockRate)
+		return 0;
+
+	//Get last one
+	QWORD last = packets.rbegin()->first;
+
+	//Check it is not in the past
+	if (last<playout)
+		return 0;
+
+	//Up to the end of the last packet
+	return (last-playout)*1000/clockRate + std::max(frameDuration,kMinDelay);
+}
+
+DWORD AudioJitterBuffer::GetPitchPeriod(const SWORD* samples, DWORD len, DWORD rate)
+{
+	//Search range
+	DWORD min = rate*kMinPitch/10000;
+	DWORD max = std::min(rate*kMaxPitch/10000,len/2);
+
+	//Check we have enough samples for a period
+	if (!min || max<min)
+		return 0;
+
+	//Search on 8khz equivalent signal, precision is not needed for cross fading
+	DWORD step = std::max(rate/8000,1u);
+
+	DWORD best = max;
+	double bestCorrelation = -1;
+
+	//For each candidate period
+	for (DWORD period=min;period<=max;period+=step)
+	{
+		double corr = 0;
+		double e1 = 0;
+		double e2 = 0;
+		//Compare with the next period
+		for (DWORD i=0;i<period;i+=step)
+		{
+			corr += (double)samples[i]*samples[i+period];
+			e1   += (double)samples[i]*samples[i];
+			e2   += (double)samples[i+period]*samples[i+period];
+		}
+		//Silence can be cut anywhere, prefer longest one
+		if (!e1 || !e2)
+			continue;
+		//Normalize
+		double normalized = corr/std::sqrt(e1*e2);
+		//If it is more similar
+		if (normalized>bestCorrelation)
+		{
+			//Store it
+			best = period;
+			bestCorrelation = normalized;
+		}
+	}
+
+	return best;
+}
+
+DWORD AudioJitterBuffer::Accelerate(std::vector<SWORD>& samples, DWORD rate)
+{
+	//Get period
+	DWORD period = GetPitchPeriod(samples.data(),samples.size(),rate);
+
+	//Check
+	if (!period)
+		return 0;
+
+	//Cross fade first period into second one
+	for (DWORD i=0;i<period;++i)
+		samples[i] = ((int)samples[i]*(int)(period-i) + (int)samples[i+period]*(int)i)/(int)period;
+
+	//Remove second period
+	samples.erase(samples.begin()+period,samples.begin()+2*period);
+
+	//Removed samples
+	return period;
+}
+
+DWORD AudioJitterBuffer::Expand(std::vector<SWORD>& samples, DWORD rate)
+{
+	//Get period
+	DWORD period = GetPitchPeriod(samples.data(),samples.size(),rate);
+
+	//Check
+	if (!period)
+		return 0;
+
+	std::vector<SWORD> inserted(period);
+
+	//Cross fade second period into the first one, so it joins both sides smoothly
+	for (DWORD i=0;i<period;++i)
+		inserted[i] = ((int)samples[i+period]*(int)(period-i) + (int)samples[i]*(int)i)/(int)period;
+
+	//Insert it after first period
+	samples.insert(samples.begin()+period,inserted.begin(),inserted.end());
+
+	//Added samples
+	return period;
+}
@@ -0,0 +1,212 @@
+#include "AudioMixKernel.h"
+
+#include <cstring>
+#include <cstdlib>
+#include <cmath>
+#include <algorithm>
+#include <emmintrin.h>
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+static inline int32_t Saturate16(int32_t val)
+{
+	return val>32767 ? 32767 : (val<-32768 ? -32768 : val);
+}
+
+void AudioMixKernel::Clear(int32_t* acc, DWORD len)
+{
+	memset(acc,0,len*sizeof(int32_t));
+}
+
+void AudioMixKernel::Accumulate(int32_t* acc, const SWORD* samples, DWORD len)
+{
+	DWORD i = 0;
+#ifdef __AVX2__
+	//16 samples at a time
+	for (;i+16<=len;i+=16)
+	{
+		__m256i s = _mm256_loadu_si256((const __m256i*)(samples+i));
+		__m256i lo = _mm256_cvtepi16_epi32(_mm256_castsi256_si128(s));
+		__m256i hi = _mm256_cvtepi16_epi32(_mm256_extracti128_si256(s,1));
+		_mm256_storeu_si256((__m256i*)(acc+i),  _mm256_add_epi32(_mm256_loadu_si256((const __m256i*)(acc+i)),lo));
+		_mm256_storeu_si256((__m256i*)(acc+i+8),_mm256_add_epi32(_mm256_loadu_si256((const __m256i*)(acc+i+8)),hi));
+	}
+#endif
+	//8 samples at a time
+	for (;i+8<=len;i+=8)
+	{
+		__m128i s = _mm_loadu_si128((const __m128i*)(samples+i));
+		//Sign extend to 32 bits
+		__m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(s,s),16);
+		__m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(s,s),16);
+		_mm_storeu_si128((__m128i*)(acc+i),  _mm_add_epi32(_mm_loadu_si128((const __m128i*)(acc+i)),lo));
+		_mm_storeu_si128((__m128i*)(acc+i+4),_mm_add_epi32(_mm_loadu_si128((const __m128i*)(acc+i+4)),hi));
+	}
+	//Remaining
+	for (;i<len;++i)
+		acc[i] += samples[i];
+}
+
+void AudioMixKernel::Subtract(int32_t* dst, const int32_t* acc, const SWORD* samples, DWORD len)
+{
+	DWORD i = 0;
+#ifdef __AVX2__
+	//16 samples at a time
+	for (;i+16<=len;i+=16)
+	{
+		__m256i s = _mm256_loadu_si256((const __m256i*)(samples+i));
+		__m256i lo = _mm256_cvtepi16_epi32(_mm256_castsi256_si128(s));
+		__m256i hi = _mm256_cvtepi16_epi32(_mm256_extracti128_si256(s,1));
+		_mm256_storeu_si256((__m256i*)(dst+i),  _mm256_sub_epi32(_mm256_loadu_si256((const __m256i*)(acc+i)),lo));
+		_mm256_storeu_si256((__m256i*)(dst+i+8),_mm256_sub_epi32(_mm256_loadu_si256((const __m256i*)(acc+i+8)),hi));
+	}
+#endif
+	//8 samples at a time
+	for (;i+8<=len;i+=8)
+	{
+		__m128i s = _mm_loadu_si128((const __m128i*)(samples+i));
+		//Sign extend to 32 bits
+		__m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(s,s),16);
+		__m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(s,s),16);
+		_mm_storeu_si128((__m128i*)(dst+i),  _mm_sub_epi32(_mm_loadu_si128((const __m128i*)(acc+i)),lo));
+		_mm_storeu_si128((__m128i*)(dst+i+4),_mm_sub_epi32(_mm_loadu_si128((const __m128i*)(acc+i+4)),hi));
+	}
+	//Remaining
+	for (;i<len;++i)
+		dst[i] = acc[i] - samples[i];
+}
+
+int32_t AudioMixKernel::GetPeak(const int32_t* acc, DWORD len)
+{
+	DWORD i = 0;
+	int32_t peak = 0;
+#ifdef __AVX2__
+	__m256i max8 = _mm256_setzero_si256();
+	//8 samples at a time
+	for (;i+8<=len;i+=8)
+		max8 = _mm256_max_epi32(max8,_mm256_abs_epi32(_mm256_loadu_si256((const __m256i*)(acc+i))));
+	//Reduce
+	__m128i max4 = _mm_max_epi32(_mm256_castsi256_si128(max8),_mm256_extracti128_si256(max8,1));
+#else
+	__m128i max4 = _mm_setzero_si128();
+#endif
+	//4 samples at a time
+	for (;i+4<=len;i+=4)
+	{
+		__m128i v = _mm_loadu_si128((const __m128i*)(acc+i));
+		//SSE2 has no abs nor max for 32 bits
+		__m128i sign = _mm_srai_epi32(v,31);
+		__m128i abs = _mm_sub_epi32(_mm_xor_si128(v,sign),sign);
+		__m128i gt = _mm_cmpgt_epi32(abs,max4);
+		max4 = _mm_or_si128(_mm_and_si128(gt,abs),_mm_andnot_si128(gt,max4));
+	}
+	//Reduce
+	int32_t lanes[4];
+	_mm_storeu_si128((__m128i*)lanes,max4);
+	for (DWORD j=0;j<4;++j)
+		peak = std::max(peak,lanes[j]);
+	//Remaining
+	for (;i<len;++i)
+		peak = std::max(peak,std::abs(acc[i]));
+	return peak;
+}
+
+void AudioMixKernel::Scale(SWORD* dst, const int32_t* acc, DWORD len, float start, float end)
+{
+	if (!len)
+		return;
+
+	DWORD i = 0;
+	//Gain increment per sample, so last one gets the end gain
+	float step = (end-start)/len;
+#ifdef __AVX2__
+	__m256 gain8 = _mm256_add_ps(_mm256_set1_ps(start),_mm256_mul_ps(_mm256_set1_ps(step),_mm256_setr_ps(1,2,3,4,5,6,7,8)));
+	__m256 step8 = _mm256_set1_ps(step*8);
+	//16 samples at a time
+	for (;i+16<=len;i+=16)
+	{
+		__m256i lo = _mm256_cvtps_epi32(_mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_loadu_si256((const __m256i*)(acc+i))),gain8));
+		gain8 = _mm256_add_ps(gain8,step8);
+		__m256i hi = _mm256_cvtps_epi32(_mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_loadu_si256((const __m256i*)(acc+i+8))),gain8));
+		gain8 = _mm256_add_ps(gain8,step8);
+		//Pack works per 128 bit lane, so reorder 64 bit blocks afterwards
+		_mm256_storeu_si256((__m256i*)(dst+i),_mm256_permute4x64_epi64(_mm256_packs_epi32(lo,hi),0xD8));
+	}
+#endif
+	__m128 gain4 = _mm_add_ps(_mm_set1_ps(start+step*i),_mm_mul_ps(_mm_set1_ps(step),_mm_setr_ps(1,2,3,4)));
+	__m128 step4 = _mm_set1_ps(step*4);
+	//8 samples at a time
+	for (;i+8<=len;i+=8)
+	{
+		__m128i lo = _mm_cvtps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(_mm_loadu_si128((const __m128i*)(acc+i))),gain4));
+		gain4 = _mm_add_ps(gain4,step4);
+		__m128i hi = _mm_cvtps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(_mm_loadu_si128((const __m128i*)(acc+i+4))),gain4));
+		gain4 = _mm_add_ps(gain4,step4);
+		//Saturating pack
+		_mm_storeu_si128((__m128i*)(dst+i),_mm_packs_epi32(lo,hi));
+	}
+	//Remaining
+	for (;i<len;++i)
+		dst[i] = Saturate16(lrintf(acc[i]*(start+step*(i+1))));
+}
+
+void AudioMixKernel::Saturate(SWORD* dst, const int32_t* acc, DWORD len)
+{
+	DWORD i = 0;
+#ifdef __AVX2__
+	//16 samples at a time
+	for (;i+16<=len;i+=16)
+	{
+		__m256i lo = _mm256_loadu_si256((const __m256i*)(acc+i));
+		__m256i hi = _mm256_loadu_si256((const __m256i*)(acc+i+8));
+		//Pack works per 128 bit lane, so reorder 64 bit blocks afterwards
+		_mm256_storeu_si256((__m256i*)(dst+i),_mm256_permute4x64_epi64(_mm256_packs_epi32(lo,hi),0xD8));
+	}
+#endif
+	//8 samples at a time
+	for (;i+8<=len;i+=8)
+	{
+		__m128i lo = _mm_loadu_si128((const __m128i*)(acc+i));
+		__m128i hi = _mm_loadu_si128((const __m128i*)(acc+i+4));
+		//Saturating pack
+		_mm_storeu_si128((__m128i*)(dst+i),_mm_packs_epi32(lo,hi));
+	}
+	//Remaining
+	for (;i<len;++i)
+		dst[i] = Saturate16(acc[i]);
+}
+
+void AudioLimiter::Process(SWORD* dst, const int32_t* acc, DWORD len)
+{
+	//Get block peak
+	int32_t peak = AudioMixKernel::GetPeak(acc,len);
+
+	//Gain needed to keep the peak under threshold
+	float target = peak>kThreshold ? (float)kThreshold/peak : 1.0f;
+	//Gain at the end of this block
+	float next = gain;
+
+	//If we need to reduce it
+	if (target<gain)
+	{
+		//Attack now
+		next = target;
+		//Inc stats
+		limited++;
+	} else if (gain<1.0f) {
+		//Release slowly
+		next = std::min(target,gain+kRelease);
+	}
+
+	//If no gain is applied
+	if (gain==1.0f && next==1.0f)
+		//Just pack
+		AudioMixKernel::Saturate(dst,acc,len);
+	else
+		//Ramp gain across the block, saturating whatever is left above full scale
+		AudioMixKernel::Scale(dst,acc,len,gain,next);
+
+	//Store for next block
+	gain = next;
+}
@@ -45,6 +45,8 @@ DTLSICETransport::DTLSICETransport(Sender *sender,TimeService& timeService) :
 	timeService(timeService),
 	endpoint(timeService),
 	dtls(*this,timeService,endpoint.GetTransport()),
+	rtcpScheduler(timeService,[this](const RTCPCompoundPacket::shared& rtcp){ return Send(rtcp); }),
+	pacer(timeService,[this](RTPPacket::shared&& packet){ return SendPacket(std::move(packet)); },[this](DWORD budget){ Probe(budget); }),
 	incomingBitrate(250),
 	outgoingBitrate(250),
 	rtxBitrate(250),
@@ -238,6 +240,8 @@ int DTLSICETransport::onData(const ICERemoteCandidate* candidate,const BYTE* dat
 					incoming.erase(group->media.ssrc);
 					//Also from srtp session
 					recv.RemoveStream(group->media.ssrc);
+					//Repairs of the previous stream can't be applied to the new one
+					group->fecDecoder.Reset();
 				}
 
 				//Set ssrc for next ones
@@ -294,6 +298,8 @@ int DTLSICETransport::onData(const ICERemoteCandidate* candidate,const BYTE* dat
 					incoming.erase(group->media.ssrc);
 					//Also from srtp session
 					recv.RemoveStream(group->media.ssrc);
+					//Repairs of the previous stream can't be applied to the new one
+					group->fecDecoder.Reset();
 				}
 
 				//Set ssrc for next ones
@@ -348,8 +354,8 @@ int DTLSICETransport::onData(const ICERemoteCandidate* candidate,const BYTE* dat
 		// Get current seq mum
 		WORD transportSeqNum = packet->GetTransportSeqNum();
 		
-		//Get max seq num so far, it is either last one if queue is empy or last one of the queue
-		DWORD maxFeedbackPacketExtSeqNum = transportWideReceivedPacketsStats.size() ? transportWideReceivedPacketsStats.rbegin()->first : lastFeedbackPacketExtSeqNum;
+		//Get max seq num so far, it is either last one received or last one reported
+		DWORD maxFeedbackPacketExtSeqNum = transportWideReceivedPackets.GetLastExtSeqNum();
 		
 		//Check if we have a sequence wrap
 		if (transportSeqNum<0x00FF && (maxFeedbackPacketExtSeqNum & 0xFFFF)>0xFF00)
@@ -368,11 +374,16 @@ int DTLSICETransport::onData(const ICERemoteCandidate* candidate,const BYTE* dat
 		//Get current time
 		auto now = getTime();
 		
-		//Add packets to the transport wide stats
-		transportWideReceivedPacketsStats[transportExtSeqNum] = PacketStats::Create(packet,size,now);
+		//If it doesn't fit in the history window
+		if (!transportWideReceivedPackets.Fits(transportExtSeqNum))
+			//Send feedback now to make room
+			SendTransportWideFeedbackMessage(ssrc);
+		
+		//Add packets to the transport wide history
+		transportWideReceivedPackets.Add(transportExtSeqNum,now);
 		
 		//If we have enought or timeout (500ms)
-		if (packet->GetMark()  || transportWideReceivedPacketsStats.size()>100 || (now-transportWideReceivedPacketsStats.begin()->second->time)>5E5)
+		if (packet->GetMark()  || transportWideReceivedPackets.GetCount()>100 || (now-transportWideReceivedPackets.GetFirstTime())>5E5)
 			//Send feedback message
 			SendTransportWideFeedbackMessage(ssrc);
 	}
@@ -413,12 +424,24 @@ int DTLSICETransport::onData(const ICERemoteCandidate* candidate,const BYTE* dat
 		if (codec!=VideoCodec::FLEXFEC)
 			//error
 			return  Warning("-DTLSICETransport::onData() | No FLEXFEC codec on fec sssrc:%u type:%d codec:%d\n",MediaFrame::TypeToString(packet->GetMedia()),packet->GetPayloadType(),packet->GetSSRC());
-		//DO NOTHING with it yet
+		//Try to recover lost media packets with it
+		group->fecDecoder.AddFEC(packet->GetMediaData(),packet->GetMediaLength());
+		//Deliver any recovered one
+		DeliverRecoveredPackets(group);
+		//Done
 		return 1;
-	}	
+	} else if (ssrc==group->media.ssrc && group->fecDecoder.IsEnabled()) {
+		//Keep plain media packet for fec recovery
+		group->fecDecoder.AddMedia(data,len);
+	}
 
 	//Add packet and see if we have lost any in between
 	int lost = group->AddPacket(packet,size);
+	
+	//If media completed any fec group
+	if (group->fecDecoder.IsEnabled())
+		//Deliver recovered packets before checking for losses
+		DeliverRecoveredPackets(group);
 
 	//Check if it was rejected
 	if (lost<0)
@@ -444,8 +467,8 @@ int DTLSICETransport::onData(const ICERemoteCandidate* candidate,const BYTE* dat
 		for (auto field : group->GetNacks())
 			//Add it
 			nack->AddField(field);
-		//Send packet
-		Send(rtcp);
+		//Send packet as early feedback
+		rtcpScheduler.Enqueue(rtcp,true);
 
 		//Update last time nacked
 		source->lastNACKed = now;
@@ -503,19 +526,25 @@ int DTLSICETransport::onData(const ICERemoteCandidate* candidate,const BYTE* dat
 			remb->AddField(RTCPPayloadFeedback::ApplicationLayerFeeedbackField::CreateReceiverEstimatedMaxBitrate(ssrcs,bitrate));
 		}
 		
-		//If there is no outgoing stream
-		if (outgoing.empty() && group->rtx.ssrc)
+		//If there is no outgoing stream we try to calculate rtt based on rtx
+		bool rttrtx = outgoing.empty() && group->rtx.ssrc;
+		
+		//If calculating rtt
+		if (rttrtx)
 		{
-			//We try to calculate rtt based on rtx
+			//Create nack for it
 			auto nack = rtcp->CreatePacket<RTCPRTPFeedback>(RTCPRTPFeedback::NACK,mainSSRC,group->media.ssrc);
 			//Get last seq num for calculating rtt based on rtx
 			WORD last = group->SetRTTRTX(now);
 			//Request it
 			nack->AddField(std::make_shared<RTCPRTPFeedback::NACKField>(last,0));
 		}
+		
+		//Update session bandwidth for the rtcp interval
+		rtcpScheduler.SetSessionBandwidth(static_cast<DWORD>((incomingBitrate.GetInstantAvg()+outgoingBitrate.GetInstantAvg())*8));
 	
-		//Send it
-		Send(rtcp);
+		//Send it, the rtt nack must not be delayed
+		rtcpScheduler.Enqueue(rtcp,rttrtx);
 	}
 	
 	//Done
@@ -615,61 +644,25 @@ DWORD DTLSICETransport::SendProbe(const RTPPacket::shared& original)
 	//IF failed
 	if (!len)
 		return Warning("-DTLSICETransport::SendProbe() | Could not serialize packet\n");
-
-	//If we don't have an active candidate yet
-	if (!active)
-		//Error
-		return Warning("-DTLSICETransport::SendProbe() | We don't have an active candidate yet\n");
-
-	//If dumping
-	if (dumper && dumpOutRTP)
-	{
-		//Get truncate size
-		DWORD truncate = dumpRTPHeadersOnly ? len - packet->GetMediaLength() + 16 : 0;
-		//Write udp packet
-		dumper->WriteUDP(now/1000,0x7F000001,5004,active->GetIPAddress(),active->GetPort(),data,len,truncate);
-	}
-
-	//Encript
-	len = send.ProtectRTP(data,len);
-		
-	//Check size
-	if (!len)
-		//Error
-		return Error("-DTLSICETransport::SendProbe() | Error protecting RTP packet [ssrc:%u,%s]\n",source.ssrc,send.GetLastError());
 	
-	//Store candidate before unlocking
-	ICERemoteCandidate* candidate = active;
-
-	//Set buffer size
-	buffer.SetSize(len);
-	//No error yet, send packet
-	sender->Send(candidate,std::move(buffer));
+	//Get truncate size for dumping
+	DWORD truncate = dumpRTPHeadersOnly ? len - packet->GetMediaLength() + 16 : 0;
 	
-	//Update current time after sending
-	now = getTime();
-	//Update bitrate
-	outgoingBitrate.Update(now/1000,len);
-		
-        //Synchronized
-	{
-		//Block scope
-		ScopedLock scope(source);
-                //Update last send time
-                source.lastTime		= packet->GetTimestamp();
-                source.lastPayloadType  = packet->GetPayloadType();
+	//Send it
+	len = SendRTP(source,std::move(buffer),len,truncate,packet->GetSeqNum(),packet->GetTimestamp(),packet->GetPayloadType(),now);
 	
-                //Update stats
-                source.Update(now/1000,packet->GetSeqNum(),len);
-        }
+	//Check
+	if (!len)
+		//Error already logged
+		return 0;
 	
 	//Add to transport wide stats
 	if (packet->HasTransportWideCC())
 	{
 		//Create stats
-		auto stats = PacketStats::Create(packet,len,now);
+		PacketStats stats(packet,len,now);
 		//It is probe
-		stats->probing = true;
+		stats.probing = true;
 		//Add new stat
 		senderSideBandwidthEstimator.SentPacket(stats);
 	}
@@ -723,9 +716,155 @@ DWORD DTLSICETransport::SendProbe(RTPOutgoingSourceGroup *group,BYTE padding)
 	
 	//Get current time
 	auto now = getTime();
+	
+	//Send buffer
+	Packet buffer;
+	BYTE* 	data = buffer.GetData();
+	DWORD	size = buffer.GetCapacity();
+	
+	//Serialize headers, transport wide cc only on video
+	DWORD len = SerializeHeader(header,extension,group->type == MediaFrame::Video,now,data,size);
+	
+	//Check
+	if (!len)
+		//Error
+		return Error("-DTLSICETransport::SendProbe() | Error serializing rtp headers\n");
+	
+	//Check padding fits
+	if (len+padding>size)
+		//Error
+		return Error("-DTLSICETransport::SendProbe() | Padding too big [padding:%u]\n",padding);
 
-	//Add transport wide cc on video
-	if (group->type == MediaFrame::Video && sendMaps.ext.GetTypeForCodec(RTPHeaderExtension::TransportWideCC)!=RTPMap::NotFound)
+	//Set 0 padding
+	memset(data+len,0,padding);
+	
+	//Set pateckt length
+	len += padding;
+	
+	//Set padding size in last byte of the padding
+	data[len-1] = padding;
+	
+	//Send it
+	len = SendRTP(source,std::move(buffer),len,dumpRTPHeadersOnly ? len - padding : 0,header.sequenceNumber,header.timestamp,header.payloadType,now);
+	
+	//Check
+	if (!len)
+		//Error already logged
+		return 0;
+	
+	//Add to transport wide stats
+	if (extension.hasTransportWideCC)
+	{
+		//Create stat
+		PacketStats stats(
+			extension.transportSeqNum,
+			header.ssrc,
+			extSeqNum,
+			len,
+			0,
+			header.timestamp,
+			now,
+			false
+		);
+		//It is probe
+		stats.probing = true;
+		//Add new stat
+		senderSideBandwidthEstimator.SentPacket(stats);
+	}
+	
+	return len;
+}
+
+DWORD DTLSICETransport::SendFEC(RTPOutgoingSourceGroup *group,DWORD repairSize)
+{
+	//Get fec payload type
+	BYTE type = sendMaps.rtp.GetTypeForCodec(VideoCodec::FLEXFEC);
+	
+	//Check it is negotiated
+	if (type==RTPMap::NotFound)
+		//Error
+		return Warning("-DTLSICETransport::SendFEC() | FLEXFEC not negotiated\n");
+	
+	//Overrride headers
+	RTPHeader		header;
+	RTPHeaderExtension	extension;
+	
+	//Get fec source
+	RTPOutgoingSource& source = group->fec;
+	
+	//Get extended sequence number
+	DWORD extSeqNum;
+	
+	//SYNC
+	{
+		//Lock in scope
+		ScopedLock scope(source);
+		//Update headers
+		header.ssrc		= source.ssrc;
+		header.payloadType	= type;
+		header.sequenceNumber	= extSeqNum = source.NextSeqNum();
+		//Same timestamp than last protected packet
+		header.timestamp	= group->fecEncoder.GetRepairTimestamp();
+	}
+	
+	//Get current time
+	auto now = getTime();
+	
+	//Send buffer
+	Packet buffer;
+	BYTE* 	data = buffer.GetData();
+	DWORD	size = buffer.GetCapacity();
+	
+	//Serialize headers
+	int len = SerializeHeader(header,extension,true,now,data,size);
+	
+	//Check
+	if (!len)
+		//Error
+		return Error("-DTLSICETransport::SendFEC() | Error serializing rtp headers\n");
+	
+	//Check repair fits
+	if (len+repairSize>MTU)
+		//Error
+		return Warning("-DTLSICETransport::SendFEC() | Repair packet too big [size:%u]\n",repairSize);
+	
+	//Copy repair payload
+	memcpy(data+len,group->fecEncoder.GetRepair(),repairSize);
+	len += repairSize;
+	
+	//Send it
+	len = SendRTP(source,std::move(buffer),len,dumpRTPHeadersOnly ? len - repairSize : 0,header.sequenceNumber,header.timestamp,header.payloadType,now);
+	
+	//Check
+	if (!len)
+		//Error
+		return Warning("-DTLSICETransport::SendFEC() | Repair packet not sent [ssrc:%u]\n",source.ssrc);
+	
+	//Add to transport wide stats
+	if (extension.hasTransportWideCC)
+	{
+		//Create stat
+		PacketStats stats(
+			extension.transportSeqNum,
+			header.ssrc,
+			extSeqNum,
+			len,
+			0,
+			header.timestamp,
+			now,
+			false
+		);
+		//Add new stat
+		senderSideBandwidthEstimator.SentPacket(stats);
+	}
+	
+	return len;
+}
+
+int DTLSICETransport::SerializeHeader(RTPHeader& header,RTPHeaderExtension& extension,bool transportWideCC,QWORD now,BYTE* data,DWORD size)
+{
+	//Add transport wide cc if requested and negotiated
+	if (transportWideCC && sendMaps.ext.GetTypeForCodec(RTPHeaderExtension::TransportWideCC)!=RTPMap::NotFound)
 	{
 		//Add extension
 		header.extension = true;
@@ -744,68 +883,146 @@ DWORD DTLSICETransport::SendProbe(RTPOutgoingSourceGroup *group,BYTE padding)
 		extension.absSentTime = now/1000;
 	}
 	
-	//Send buffer
-	Packet buffer;
-	BYTE* 	data = buffer.GetData();
-	DWORD	size = buffer.GetCapacity();
-	int	len  = 0;
-
 	//Serialize header
-	int n = header.Serialize(data,size);
-
+	int len = header.Serialize(data,size);
+	
 	//Comprobamos que quepan
-	if (!n)
+	if (!len)
 		//Error
-		return Error("-DTLSICETransport::SendProbe() | Error serializing rtp headers\n");
-
-	//Inc len
-	len += n;
-
+		return 0;
+	
 	//If we have extension
 	if (header.extension)
 	{
 		//Serialize
-		n = extension.Serialize(sendMaps.ext,data+len,size-len);
+		int n = extension.Serialize(sendMaps.ext,data+len,size-len);
 		//Comprobamos que quepan
 		if (!n)
 			//Error
-			return Error("-DTLSICETransport::SendProbe() | Error serializing rtp extension headers\n");
+			return 0;
 		//Inc len
 		len += n;
 	}
+	
+	return len;
+}
 
-	//Set 0 padding
-	memset(data+len,0,padding);
+DWORD DTLSICETransport::SendRTP(RTPOutgoingSource& source,Packet&& buffer,DWORD len,DWORD truncate,DWORD seqNum,DWORD timestamp,BYTE payloadType,QWORD& now)
+{
+	//If we don't have an active candidate yet
+	if (!active)
+		//Error
+		return Debug("-DTLSICETransport::SendRTP() | We don't have an active candidate yet\n");
 	
-	//Set pateckt length
-	len += padding;
+	//If dumping
+	if (dumper && dumpOutRTP)
+		//Write udp packet
+		dumper->WriteUDP(now/1000,0x7F000001,5004,active->GetIPAddress(),active->GetPort(),buffer.GetData(),len,truncate);
 	
-	//Set padding size in last byte of the padding
-	data[len-1] = padding;
+	//Encript
+	len = send.ProtectRTP(buffer.GetData(),len);
+	
+	//Check size
+	if (!len)
+		//Error
+		return Error("-DTLSICETransport::SendRTP() | Error protecting RTP packet [ssrc:%u,%s]\n",source.ssrc,send.GetLastError());
+	
+	//Store candidate
+	ICERemoteCandidate* candidate = active;
+	//Set buffer size
+	buffer.SetSize(len);
+	//No error yet, send packet
+	sender->Send(candidate,std::move(buffer));
+	
+	//Update now
+	now = getTime();
+	//Update bitrate
+	outgoingBitrate.Update(now/1000,len);
+	
+	//SYNC
+	{
+		//Lock in scope
+		ScopedLock scope(source);
+		//Update last send time
+		source.lastTime		= timestamp;
+		source.lastPayloadType  = payloadType;
+		//Update stats
+		source.Update(now/1000,seqNum,len);
+	}
+	
+	return len;
+}
 
+DWORD DTLSICETransport::SendProbeClusterPacket(RTPOutgoingSourceGroup *group,DWORD cluster)
+{
+	//Check if we have an active DTLS connection yet
+	if (!send.IsSetup())
+		//Error
+		return Warning("-DTLSICETransport::SendProbeClusterPacket() | Send SRTPSession is not setup\n");
+	
 	//If we don't have an active candidate yet
 	if (!active)
 		//Error
-		return Debug("-DTLSICETransport::SendProbe() | We don't have an active candidate yet\n");
-
+		return Debug("-DTLSICETransport::SendProbeClusterPacket() | We don't have an active candidate yet\n");
+	
+	//Probes are sent on rtx
+	RTPOutgoingSource& source = group->rtx;
+	
+	//Get rtx payload and extensions
+	BYTE apt		= sendMaps.apt.begin()->first;
+	BYTE transportWideCCId	= sendMaps.ext.GetTypeForCodec(RTPHeaderExtension::TransportWideCC);
+	BYTE absSendTimeId	= sendMaps.ext.GetTypeForCodec(RTPHeaderExtension::AbsoluteSendTime);
+	
+	//Rebuild template if anything has changed
+	if (!probeTemplate.Matches(source.ssrc,apt,transportWideCCId,absSendTimeId) && !probeTemplate.Build(source.ssrc,apt,transportWideCCId,absSendTimeId))
+		//Error
+		return Warning("-DTLSICETransport::SendProbeClusterPacket() | Could not build padding template [ssrc:%u]\n",source.ssrc);
+	
+	WORD  seqNum;
+	DWORD extSeqNum;
+	DWORD timestamp;
+	
+	//SYNC
+	{
+		//Lock in scope
+		ScopedLock scope(source);
+		//Get next rtx seq num
+		seqNum = extSeqNum = source.NextSeqNum();
+		//Get timestamp
+		timestamp = source.lastTime++;
+	}
+	
+	//Get transport wide seq num
+	WORD transportWideSeqNum = probeTemplate.HasTransportWideCC() ? ++transportSeqNum : 0;
+	
+	//Get current time
+	auto now = getTime();
+	
+	//Send buffer
+	Packet buffer;
+	BYTE* 	data = buffer.GetData();
+	
+	//Fill it from template
+	int len = probeTemplate.Fill(data,buffer.GetCapacity(),seqNum,timestamp,transportWideSeqNum,now/1000,RTPPaddingTemplate::MaxPadding);
+	
 	//If dumping
 	if (dumper && dumpOutRTP)
 	{
 		//Get truncate size
-		DWORD truncate = dumpRTPHeadersOnly ? len - padding : 0;
+		DWORD truncate = dumpRTPHeadersOnly ? probeTemplate.GetHeaderLength() : 0;
 		//Write udp packet
 		dumper->WriteUDP(now/1000,0x7F000001,5004,active->GetIPAddress(),active->GetPort(),data,len,truncate);
 	}
-
+	
 	//Encript
 	len = send.ProtectRTP(data,len);
 		
 	//Check size
 	if (!len)
 		//Error
-		return Error("-RTPTransport::SendProbe() | Error protecting RTP packet [ssrc:%u,%s]\n",source.ssrc,send.GetLastError());
-
-	//Store candidate before unlocking
+		return Error("-DTLSICETransport::SendProbeClusterPacket() | Error protecting RTP packet [ssrc:%u,%s]\n",source.ssrc,send.GetLastError());
+	
+	//Store candidate
 	ICERemoteCandidate* candidate = active;
 	//Set buffer size
 	buffer.SetSize(len);
@@ -814,37 +1031,27 @@ DWORD DTLSICETransport::SendProbe(RTPOutgoingSourceGroup *group,BYTE padding)
 	
 	//Update now
 	now = getTime();
-	//Update bitrate
+	//Update bitrates
 	outgoingBitrate.Update(now/1000,len);
+	probingBitrate.Update(now/1000,len);
 	
-        //SYNC
-        {
-                //Lock in scope
-                ScopedLock scope(source);
-                //Update last send time
-                source.lastTime		= header.timestamp;
-                source.lastPayloadType  = header.payloadType;
-                //Update stats
-                source.Update(now/1000,header.sequenceNumber,len);
-        }
-	
+	//SYNC
+	{
+		//Lock in scope
+		ScopedLock scope(source);
+		//Update stats
+		source.Update(now/1000,seqNum,len);
+	}
 	
 	//Add to transport wide stats
-	if (extension.hasTransportWideCC)
+	if (probeTemplate.HasTransportWideCC())
 	{
 		//Create stat
-		auto stats = PacketStats::Create(
-			extension.transportSeqNum,
-			header.ssrc,
-			extSeqNum,
-			len,
-			0,
-			header.timestamp,
-			now,
-			false
-		);
+		PacketStats stats(transportWideSeqNum,source.ssrc,extSeqNum,len,0,timestamp,now,false);
 		//It is probe
-		stats->probing = true;
+		stats.probing = true;
+		//Of this cluster
+		stats.probeCluster = cluster;
 		//Add new stat
 		senderSideBandwidthEstimator.SentPacket(stats);
 	}
@@ -852,6 +1059,77 @@ DWORD DTLSICETransport::SendProbe(RTPOutgoingSourceGroup *group,BYTE padding)
 	return len;
 }
 
+bool DTLSICETransport::SendProbeCluster(QWORD now)
+{
+	//Get how much we have to send for current cluster
+	DWORD probingSize = probeController.GetProbeSize(now);
+	
+	//If there is no active cluster
+	if (!probingSize)
+		//Not probing
+		return false;
+	
+	//Find a video group with rtx to probe on
+	RTPOutgoingSourceGroup* group = nullptr;
+	for (auto& outgoing : this->outgoing)
+		if (outgoing.second->type==MediaFrame::Video && outgoing.second->rtx.ssrc && !sendMaps.apt.empty())
+			group = outgoing.second;
+	
+	//If not found, cluster will time out
+	if (!group)
+		//Not probing
+		return false;
+	
+	//Get cluster
+	DWORD cluster = probeController.GetActiveClusterId();
+	
+	//Send until the cluster rate is reached
+	while (probingSize)
+	{
+		//Send padding
+		DWORD len = SendProbeClusterPacket(group,cluster);
+		//Check len
+		if (!len)
+			//Done
+			break;
+		//Update cluster
+		probeController.ProbeSent(len);
+		//Reduce probe
+		probingSize -= std::min(len,probingSize);
+	}
+	
+	//Probing
+	return true;
+}
+
+void DTLSICETransport::DeliverRecoveredPackets(RTPIncomingSourceGroup* group)
+{
+	Packet buffer;
+	DWORD len;
+	
+	//Get all packets recovered by fec
+	while ((len = group->fecDecoder.GetRecovered(buffer.GetData(),buffer.GetCapacity())))
+	{
+		//Parse it
+		RTPPacket::shared packet = RTPPacket::Parse(buffer.GetData(),len,recvMaps.rtp,recvMaps.ext);
+		
+		//Check
+		if (!packet || packet->GetSSRC()!=group->media.ssrc)
+		{
+			Debug("-DTLSICETransport::DeliverRecoveredPackets() | Could not parse recovered packet\n");
+			continue;
+		}
+		
+		//Set corrected seq num cycles
+		packet->SetSeqCycles(group->media.RecoverSeqNum(packet->GetSeqNum()));
+		//Fill the vp8/vp9 descriptors
+		VideoLayerSelector::GetLayerIds(packet);
+		
+		//Add it as if it was received
+		group->AddPacket(packet,len);
+	}
+}
+
 void DTLSICETransport::ReSendPacket(RTPOutgoingSourceGroup *group,WORD seq)
 {
 	//Check if we have an active DTLS connection yet
@@ -871,14 +1149,6 @@ void DTLSICETransport::ReSendPacket(RTPOutgoingSourceGroup *group,WORD seq)
 	//Update rtx bitrate
 	rtxBitrate.Update(now/1000);
 	
-	//Get available bitrate
-	DWORD availableBitrate = senderSideBandwidthEstimator.GetAvailableBitrate();
-	
-	//Check if we are sending way to much bitrate
-	if (availableBitrate && rtxBitrate.GetInstantAvg()*8 > availableBitrate * 0.30f)
-		//Error
-		return (void)Warning("-DTLSICETransport::ReSendPacket() | Too much bitrate on rtx, skiping rtx:%lld estimated:%u available:%d\n",(uint64_t)(rtxBitrate.GetInstantAvg()*8), senderSideBandwidthEstimator.GetEstimatedBitrate(),availableBitrate);
-	
 	//Find packet to retransmit
 	auto original = group->GetPacket(seq);
 
@@ -887,6 +1157,14 @@ void DTLSICETransport::ReSendPacket(RTPOutgoingSourceGroup *group,WORD seq)
 		//Debug
 		return (void)Warning("-DTLSICETransport::ReSendPacket() | packet not found[seq:%d,ssrc:&%u,rtx:%u]\n",seq,group->media.ssrc,group->rtx.ssrc);
 	
+	//Get packet age
+	QWORD age = now/1000>original->GetTime() ? now/1000-original->GetTime() : 0;
+	
+	//Check if it is worth retransmitting it
+	if (!group->rtxController.Accept(seq,age,rtt,rtxBitrate.GetInstantAvg()*8,senderSideBandwidthEstimator.GetAvailableBitrate(),now/1000))
+		//Skip
+		return (void)UltraDebug("-DTLSICETransport::ReSendPacket() | rtx suppressed [seq:%d,ssrc:%u,sent:%u,suppressed:%u]\n",seq,group->media.ssrc,group->rtxController.GetSent(),group->rtxController.GetSuppressed());
+	
 	//Create resend packet
 	auto packet = original->Clone();
 	
@@ -1013,9 +1291,9 @@ void DTLSICETransport::ReSendPacket(RTPOutgoingSourceGroup *group,WORD seq)
 	if (packet->HasTransportWideCC())
 	{
 		//Create stats
-		auto stats = PacketStats::Create(packet,len,now);
+		PacketStats stats(packet,len,now);
 		//It is rtx
-		stats->rtx = true;
+		stats.rtx = true;
 		//Add new stat
 		senderSideBandwidthEstimator.SentPacket(stats);
 	}
@@ -1490,11 +1768,21 @@ void DTLSICETransport::onDTLSSetup(DTLSConnection::Suite suite,BYTE* localMaster
 	//Done
 	SetState(DTLSState::Connected);
 	
-	//Create new probe timer
-	probingTimer = timeService.CreateTimer(0ms,5ms,[this](...){
-		//Do probe
-		Probe();
-	});
+	//Until we get the first estimation, pace from the start bitrate
+	if (!pacer.GetTargetBitrate())
+		pacer.SetTargetBitrate(startBitrate);
+	
+	//If probing is enabled
+	if (probe)
+	{
+		//Do not probe above the max bitrate we want to reach
+		probeController.SetMaxBitrate(probingBitrateLimit);
+		//Ramp-up without waiting for the first feedback
+		probeController.Start(startBitrate,getTime());
+	}
+	
+	//Start pacing, it will also trigger probing
+	pacer.Start();
 }
 
 void DTLSICETransport::onDTLSSetupError()
@@ -1563,13 +1851,15 @@ bool DTLSICETransport::AddOutgoingSourceGroup(RTPOutgoingSourceGroup *group)
 
 		//If we don't have a mainSSRC
 		if (mainSSRC==1 && media)
+		{
 			//Set it
 			mainSSRC = media;
+			//Use it on the reports added by the scheduler
+			rtcpScheduler.SetSSRC(mainSSRC);
+		}
 
-		//Create rtcp sender retpor
-		auto rtcp = RTCPCompoundPacket::Create(group->media.CreateSenderReport(getTime()));
-		//Send packet
-		Send(rtcp);	
+		//Send sender report right away so it is not skewing the rtt calculation
+		rtcpScheduler.Enqueue(group->media.CreateSenderReport(getTime()),true);
 	});
 	
 	//Done
@@ -1623,11 +1913,15 @@ bool DTLSICETransport::RemoveOutgoingSourceGroup(RTPOutgoingSourceGroup *group)
 		
 		//If it was our main ssrc
 		if (mainSSRC==group->media.ssrc)
+		{
 			//Set first
 			mainSSRC = outgoing.begin()!=outgoing.end() ? outgoing.begin()->second->media.ssrc : 1;
+			//Use it on the reports added by the scheduler
+			rtcpScheduler.SetSSRC(mainSSRC);
+		}
 		
 		//Send BYE
-		Send(RTCPCompoundPacket::Create(RTCPBye::Create(ssrcs,"terminated")));
+		rtcpScheduler.Enqueue(RTCPBye::Create(ssrcs,"terminated"),true);
 	});
 	
 	//Done
@@ -1707,6 +2001,18 @@ bool DTLSICETransport::AddIncomingSourceGroup(RTPIncomingSourceGroup *group)
 			incoming[rtx] = group;
 			recv.AddStream(rtx);
 		}
+		
+		//Send the key frame requests arbitrated by the group
+		group->SetKeyFrameRequester([this](DWORD ssrc){
+			//Create rtcp sender retpor
+			auto rtcp = RTCPCompoundPacket::Create();
+
+			//Add to rtcp
+			rtcp->CreatePacket<RTCPPayloadFeedback>(RTCPPayloadFeedback::PictureLossIndication,mainSSRC,ssrc);
+
+			//Send packet as early feedback
+			rtcpScheduler.Enqueue(rtcp,true);
+		});
 	});
 	
 	//Check result
@@ -1732,6 +2038,10 @@ bool DTLSICETransport::RemoveIncomingSourceGroup(RTPIncomingSourceGroup *group)
 	
 	//Dispatch to the event loop thread
 	timeService.Sync([&](...){
+		//Do not send more key frame requests
+		group->SetKeyFrameRequester(nullptr);
+		//Free recovery buffers
+		group->fecDecoder.Reset();
 		//Remove rid if any
 		if (!group->rid.empty())
 			rids.erase(group->mid + "@" + group->rid);
@@ -1863,26 +2173,8 @@ int DTLSICETransport::SendPLI(DWORD ssrc)
 		if (!group)
 			return (void)Debug("-DTLSICETransport::SendPLI() | no incoming source found for [ssrc:%u]\n",ssrc);
 		
-		//Get current time
-		auto now = getTime();
-
-		//Check if we have sent a PLI recently (less than half a second ago)
-		if ((now-group->media.lastPLI)<1E6/2)
-			//We refuse to end more
-			return (void)UltraDebug("-DTLSICETransport::SendPLI() | ignored, we send a PLI recently\n");
-		//Update last PLI requested time
-		group->media.lastPLI = now;
-		//And number of requested plis
-		group->media.totalPLIs++;
-
-		//Create rtcp sender retpor
-		auto rtcp = RTCPCompoundPacket::Create();
-
-		//Add to rtcp
-		rtcp->CreatePacket<RTCPPayloadFeedback>(RTCPPayloadFeedback::PictureLossIndication,mainSSRC,ssrc);
-
-		//Send packet
-		Send(rtcp);
+		//Let the group merge it with the requests from other listeners
+		group->RequestKeyFrame(getTimeMS());
 	});
 	
 	return 1;
@@ -1900,16 +2192,38 @@ int DTLSICETransport::Send(RTPPacket::shared&& packet)
 		//Error
 		return Debug("-DTLSICETransport::Send() | We don't have an DTLS setup yet\n");
 	
+	//Get outgoing group
+	RTPOutgoingSourceGroup* group = GetOutgoingSourceGroup(packet->GetSSRC());
+	
+	//If not found
+	if (!group)
+		//Error
+		return Warning("-DTLSICETransport::Send() | Outgoind source not registered for ssrc:%u\n",packet->GetSSRC());
+	
+	//Pace it, it will be sent now or when there is budget for it
+	pacer.Enqueue(group->type,std::move(packet));
+	
+	//Enqueued
+	return 1;
+}
+
+DWORD DTLSICETransport::SendPacket(RTPPacket::shared&& packet)
+{
+	//Check if we have an active DTLS connection yet
+	if (!send.IsSetup())
+		//Error
+		return Debug("-DTLSICETransport::SendPacket() | We don't have an DTLS setup yet\n");
+	
 	//Get ssrc
 	DWORD ssrc = packet->GetSSRC();
 	
-	//Get outgoing group
+	//Get outgoing group, it could have been removed while queued
 	RTPOutgoingSourceGroup* group = GetOutgoingSourceGroup(ssrc);
 	
 	//If not found
 	if (!group)
 		//Error
-		return Warning("-DTLSICETransport::Send() | Outgoind source not registered for ssrc:%u\n",packet->GetSSRC());
+		return Warning("-DTLSICETransport::SendPacket() | Outgoind source not registered for ssrc:%u\n",packet->GetSSRC());
 	
 	//Get outgoing source
 	RTPOutgoingSource& source = group->media;
@@ -1973,44 +2287,35 @@ int DTLSICETransport::Send(RTPPacket::shared&& packet)
 	
 	//IF failed
 	if (!len)
-		return Warning("-DTLSICETransport::Send() | Could not serialize packet\n");
+		return Warning("-DTLSICETransport::SendPacket() | Could not serialize packet\n");
 
 	//Add packet for RTX
 	group->AddPacket(packet);
 	
 	//If we don't have an active candidate yet
 	if (!active)
-		//Error
-		return Debug("-DTLSICETransport::Send() | We don't have an active candidate yet\n");
-
-	//If dumping
-	if (dumper && dumpOutRTP)
-	{
-		//Get truncate size
-		DWORD truncate = dumpRTPHeadersOnly ? len - packet->GetMediaLength() + 16 : 0;
-		//Write udp packet
-		dumper->WriteUDP(now/1000,0x7F000001,5004,active->GetIPAddress(),active->GetPort(),data,len,truncate);
-	}
-
-	//Encript
-	len = send.ProtectRTP(data,len);
+		//Error, do not protect it either as it is not sent
+		return Debug("-DTLSICETransport::SendPacket() | We don't have an active candidate yet\n");
 	
-	//Check error
+	//Feed the fec encoder with the plain packet if negotiated, it returns the repair size when a group is completed
+	DWORD repairSize = group->type==MediaFrame::Video && group->fec.ssrc && sendMaps.rtp.GetTypeForCodec(VideoCodec::FLEXFEC)!=RTPMap::NotFound ? group->fecEncoder.AddPacket(data,len,packet->GetMark()) : 0;
+	
+	//Get truncate size for dumping
+	DWORD truncate = dumpRTPHeadersOnly ? len - packet->GetMediaLength() + 16 : 0;
+	
+	//Send it
+	len = SendRTP(source,std::move(buffer),len,truncate,packet->GetSeqNum(),packet->GetTimestamp(),packet->GetPayloadType(),now);
+	
+	//Send the repair even if the packet failed, it protects the ones already sent
 	if (!len)
-		//Error
-		return Error("-RTPTransport::SendPacket() | Error protecting RTP packet [ssrc:%u,%s]\n",ssrc,send.GetLastError());
-
-	//Store candidate
-	ICERemoteCandidate* candidate = active;
-
-	//Set buffer size
-	buffer.SetSize(len);
-	//No error yet, send packet
-	sender->Send(candidate,std::move(buffer));
-	//Get time
-	now = getTime();
-	//Update bitrate
-	outgoingBitrate.Update(now/1000,len);
+	{
+		//If a fec group has been completed
+		if (repairSize)
+			//Send repair packet
+			SendFEC(group,repairSize);
+		//Error already logged
+		return 0;
+	}
 	
 	DWORD bitrate   = 0;
 	DWORD estimated = 0;
@@ -2020,14 +2325,7 @@ int DTLSICETransport::Send(RTPPacket::shared&& packet)
 	{
 		//Block scope
 		ScopedLock scope(source);
-		//Update last items
-		source.lastTime		= packet->GetTimestamp();
-		source.lastPayloadType  = packet->GetPayloadType();
-
-		//Update source
-		source.Update(now/1000,packet->GetSeqNum(),len);
-		
-		 //Get bitrates
+		//Get bitrates
 		bitrate   = static_cast<DWORD>(source.acumulator.GetInstantAvg()*8);
 		estimated = source.remb;
 		probing	  = static_cast<DWORD>(probingBitrate.GetInstantAvg()*8);
@@ -2037,11 +2335,16 @@ int DTLSICETransport::Send(RTPPacket::shared&& packet)
 	if (packet->HasTransportWideCC())
 	{
 		//Create stats
-		auto stats = PacketStats::Create(packet,len,now);
+		PacketStats stats(packet,len,now);
 		//Add new stat
 		senderSideBandwidthEstimator.SentPacket(stats);
 	}
 
+	//If a fec group has been completed
+	if (repairSize)
+		//Send repair packet
+		SendFEC(group,repairSize);
+
 	//Get time for packets to discard, always have at least 200ms, max 500ms
 	QWORD until = now/1000 - (200+fmin(rtt*2,300));
 	
@@ -2055,8 +2358,8 @@ int DTLSICETransport::Send(RTPPacket::shared&& packet)
 	
 	//Check if we need to send SR (1 per second)
 	if (now-source.lastSenderReport>1E6)
-		//Create and send rtcp sender retpor
-		Send(RTCPCompoundPacket::Create(group->media.CreateSenderReport(now)));
+		//Create and send rtcp sender report right away, any pending report will be aggregated with it
+		rtcpScheduler.Enqueue(group->media.CreateSenderReport(now),true);
 	
 	//Check if this packets support rtx
 	bool rtx = group->rtx.ssrc && !sendMaps.apt.empty();
@@ -2090,8 +2393,8 @@ int DTLSICETransport::Send(RTPPacket::shared&& packet)
 			history.pop_front();
 	}
 	
-	//Did we send successfully?
-	return (len>=0);
+	//Return sent bytes so the pacer can consume its budget
+	return len;
 }
 
 void DTLSICETransport::onRTCP(const RTCPCompoundPacket::shared& rtcp)
@@ -2153,6 +2456,14 @@ void DTLSICETransport::onRTCP(const RTCPCompoundPacket::shared& rtcp)
 								//Update packet jitter buffer
 								SetRTT(rtt);
 							}
+							//If it is for the media
+							if (source==&group->media)
+							{
+								//Adapt fec protection to the loss reported
+								group->fecEncoder.Update(report->GetFactionLost(),this->rtt);
+								//Report it to the media producers
+								group->onPacketLoss(ssrc,report->GetFactionLost());
+							}
 						}
 					}
 				}
@@ -2190,6 +2501,14 @@ void DTLSICETransport::onRTCP(const RTCPCompoundPacket::shared& rtcp)
 								SetRTT(rtt);
 								
 							}
+							//If it is for the media
+							if (source==&group->media)
+							{
+								//Adapt fec protection to the loss reported
+								group->fecEncoder.Update(report->GetFactionLost(),this->rtt);
+								//Report it to the media producers
+								group->onPacketLoss(ssrc,report->GetFactionLost());
+							}
 						}
 					}
 				}
@@ -2239,21 +2558,28 @@ void DTLSICETransport::onRTCP(const RTCPCompoundPacket::shared& rtcp)
 				switch(fb->GetFeedbackType())
 				{
 					case RTCPRTPFeedback::NACK:
+					{
+						//Requested packets
+						std::vector<WORD> seqs;
 						for (BYTE i=0;i<fb->GetFieldCount();i++)
 						{
 							//Get field
 							auto field = fb->GetField<RTCPRTPFeedback::NACKField>(i);
 							
-							//Resent it
-							ReSendPacket(group,field->pid);
+							//Add it
+							seqs.push_back(field->pid);
 							//Check each bit of the mask
 							for (BYTE i=0;i<16;i++)
 								//Check it bit is present to rtx the packets
 								if ((field->blp >> i) & 1)
-									//Resent it
-									ReSendPacket(group,field->pid+i+1);
+									//Add it
+									seqs.push_back(field->pid+i+1);
 						}
+						//Newest first, so they get the rtx budget while they are still useful for the receiver
+						for (auto it=seqs.rbegin();it!=seqs.rend();++it)
+							ReSendPacket(group,*it);
 						break;
+					}
 					case RTCPRTPFeedback::TempMaxMediaStreamBitrateRequest:
 						UltraDebug("-DTLSICETransport::onRTCP() | TempMaxMediaStreamBitrateRequest\n");
 						break;
@@ -2269,6 +2595,18 @@ void DTLSICETransport::onRTCP(const RTCPCompoundPacket::shared& rtcp)
 							//Pass it to the estimator
 							senderSideBandwidthEstimator.ReceivedFeedback(field->feedbackPacketCount,field->packets,getTime());
 						}
+						//Pace media at the new estimation
+						pacer.SetTargetBitrate(senderSideBandwidthEstimator.GetTargetBitrate());
+						//Distribute the estimation across the forwarded video layers
+						layerAllocator.Update(senderSideBandwidthEstimator.GetAvailableBitrate(),getTimeMS());
+						//If probing is enabled
+						if (probe)
+						{
+							//Do not probe above the max bitrate we want to reach
+							probeController.SetMaxBitrate(probingBitrateLimit);
+							//Schedule probe clusters for the new estimation
+							probeController.SetEstimate(senderSideBandwidthEstimator.GetEstimatedBitrate(),getTime());
+						}
 						break;
 				}
 				break;
@@ -2358,6 +2696,10 @@ void DTLSICETransport::onRTCP(const RTCPCompoundPacket::shared& rtcp)
 										//Call listener
 										group->onREMB(target,bitrate);
 								}
+								//If there is no transport wide feedback, allocate layers based on the remote estimation
+								if (!senderSideBandwidthEstimator.GetEstimatedBitrate())
+									//Distribute it
+									layerAllocator.Update(bitrate,getTimeMS());
 							}
 						}
 						break;
@@ -2452,6 +2794,11 @@ void DTLSICETransport::SetRTT(DWORD rtt)
 
 void DTLSICETransport::SendTransportWideFeedbackMessage(DWORD ssrc)
 {
+	//If there is nothing to report
+	if (transportWideReceivedPackets.IsEmpty())
+		//Done
+		return;
+	
 	//RTCP packet
 	auto rtcp = RTCPCompoundPacket::Create();
 
@@ -2461,34 +2808,11 @@ void DTLSICETransport::SendTransportWideFeedbackMessage(DWORD ssrc)
 	//Create trnasport field
 	auto field = feedback->CreateField<RTCPRTPFeedback::TransportWideFeedbackMessageField>(++feedbackPacketCount);
 
-	//Proccess and delete all elements
-	for (auto it =transportWideReceivedPacketsStats.cbegin();
-		  it!=transportWideReceivedPacketsStats.cend();
-		  it = transportWideReceivedPacketsStats.erase(it))
-	{
-		//Get stat
-		auto stats = it->second;
-		//Get transport seq
-		DWORD transportExtSeqNum = it->first;
-		//Get relative time
-		QWORD time = stats->time - initTime;
-
-		//if not first and not out of order
-		if (lastFeedbackPacketExtSeqNum && transportExtSeqNum>lastFeedbackPacketExtSeqNum)
-			//For each lost
-			for (DWORD i = lastFeedbackPacketExtSeqNum+1; i<transportExtSeqNum; ++i)
-				//Add it
-				field->packets.insert(std::make_pair(i,0));
-
-		//Store last
-		lastFeedbackPacketExtSeqNum = transportExtSeqNum;
-
-		//Add this one
-		field->packets.insert(std::make_pair(transportExtSeqNum,time));
-	}
+	//Add all received packets and the lost ones in between, and clear history
+	transportWideReceivedPackets.Flush(field->packets,initTime);
 
-	//Send packet
-	Send(rtcp);
+	//Send packet as early feedback
+	rtcpScheduler.Enqueue(rtcp,true);
 }
 
 void DTLSICETransport::Start()
@@ -2507,10 +2831,11 @@ void DTLSICETransport::Stop()
 {
 	Debug(">DTLSICETransport::Stop()\n");
 	
-	//Check probing timer
-	if (probingTimer)
-		//Stop probing
-		probingTimer->Cancel();
+	//Stop pacing and probing
+	pacer.Stop();
+	
+	//Stop sending rtcp
+	rtcpScheduler.Stop();
 	
 	//Stop
 	endpoint.Close();
@@ -2537,7 +2862,7 @@ int DTLSICETransport::Enqueue(const RTPPacket::shared& packet,std::function<RTPP
 	
 	return 1;
 }
-void DTLSICETransport::Probe()
+void DTLSICETransport::Probe(DWORD budget)
 {
 	//Endure that transport wide cc is enabled
 	if (probe && sendMaps.ext.GetTypeForCodec(RTPHeaderExtension::TransportWideCC)!=RTPMap::NotFound)
@@ -2549,9 +2874,15 @@ void DTLSICETransport::Probe()
 		outgoingBitrate.Update(now/1000);
 		probingBitrate.Update(now/1000);
 		//Calculate sleep time
-		uint64_t sleep = lastProbe ? (now - lastProbe)/1000 : probingTimer->GetRepeat().count();
+		uint64_t sleep = lastProbe ? (now - lastProbe)/1000 : RTPPacer::Interval.count();
 		//Update last probe time
 		lastProbe = now;
+		
+		//If there is a probe cluster running, it replaces regular probing
+		if (SendProbeCluster(now))
+			//Done
+			return;
+		
 		//Get bitrates
 		DWORD bitrate		= static_cast<DWORD>(outgoingBitrate.GetInstantAvg()*8);
 		DWORD probing		= static_cast<DWORD>(probingBitrate.GetInstantAvg()*8);
@@ -2565,8 +2896,8 @@ void DTLSICETransport::Probe()
 			//Increase probing bitrate
 			probing = std::min(maxProbingBitrate, target - bitrate);
 
-			//Get size of probes
-			DWORD probingSize = (probing*sleep)/8000;
+			//Get size of probes, never above the budget left unused by media on the pacer
+			DWORD probingSize = std::min<DWORD>((probing*sleep)/8000,budget);
 			
 			//Log("-DTLSICETransport::Probe() | Sending probing packets [target:%u,bitrate:%u,probing:%u,max:%u,probingSize:%d,sleep:%d]\n", target, bitrate,probing,maxProbingBitrate, probingSize, sleep);
 
@@ -0,0 +1,174 @@
+#include "LastNForwarder.h"
+#include "log.h"
+
+#include <algorithm>
+#include <map>
+
+LastNForwarder::LastNForwarder(uint32_t lastN, ActiveSpeakerDetector::Listener* listener) :
+	detector(this),
+	listener(listener),
+	lastN(lastN)
+{
+	//Rank one more, as subscribers do not get their own video
+	detector.SetLastN(lastN ? lastN+1 : 0);
+}
+
+void LastNForwarder::SetLastN(uint32_t lastN)
+{
+	//Lock
+	ScopedLock scoped(mutex);
+	
+	Debug("-LastNForwarder::SetLastN() [lastN:%u]\n",lastN);
+	
+	//Store it
+	this->lastN = lastN;
+	//Update detector
+	detector.SetLastN(lastN ? lastN+1 : 0);
+	//Apply new set
+	Apply();
+}
+
+void LastNForwarder::AddTransponder(uint32_t subscriberId, uint32_t publisherId, RTPStreamTransponder* transponder)
+{
+	//Lock
+	ScopedLock scoped(mutex);
+	
+	Subscription subscription;
+	subscription.subscriberId	= subscriberId;
+	subscription.publisherId	= publisherId;
+	subscription.transponder	= transponder;
+	
+	//Add it
+	subscriptions.push_back(subscription);
+	
+	//Mute or unmute all, it may have taken a free slot
+	Apply();
+}
+
+void LastNForwarder::RemoveTransponder(RTPStreamTransponder* transponder)
+{
+	//Lock
+	ScopedLock scoped(mutex);
+	
+	//Remove it
+	subscriptions.erase(std::remove_if(subscriptions.begin(),subscriptions.end(),[=](const Subscription& subscription){
+		return subscription.transponder==transponder;
+	}),subscriptions.end());
+	
+	//Its slot may be free now
+	Apply();
+}
+
+void LastNForwarder::Accumulate(uint32_t id, bool vad, uint8_t db, uint64_t now)
+{
+	//Lock
+	ScopedLock scoped(mutex);
+	
+	//Update detector
+	detector.Accumulate(id,vad,db,now);
+	
+	//If last N set has changed
+	if (changed)
+		//Apply it
+		Apply();
+}
+
+void LastNForwarder::Release(uint32_t id)
+{
+	//Lock
+	ScopedLock scoped(mutex);
+	
+	//Remove from detector
+	detector.Release(id);
+	
+	//If last N set has changed
+	if (changed)
+		//Apply it
+		Apply();
+}
+
+void LastNForwarder::onActiveSpeakerChanded(uint32_t id)
+{
+	//Forward event
+	if (listener)
+		listener->onActiveSpeakerChanded(id);
+}
+
+void LastNForwarder::onActiveSpeakersChanged(const std::vector<uint32_t>& speakers)
+{
+	//Called from the detector with the lock held, store it and apply it later
+	this->speakers = speakers;
+	changed = true;
+	
+	//Forward event
+	if (listener)
+		listener->onActiveSpeakersChanged(speakers);
+}
+
+bool LastNForwarder::IsForwarded(uint32_t subscriberId, uint32_t publisherId, const std::set<uint32_t>& unranked) const
+{
+	//Disabled
+	if (!lastN)
+		return true;
+	
+	uint32_t slots = lastN;
+	
+	//Ranked speakers first
+	for (auto id : speakers)
+	{
+		//Skip itself
+		if (id==subscriberId)
+			continue;
+		//Found
+		if (id==publisherId)
+			return true;
+		//No more slots
+		if (!--slots)
+			return false;
+	}
+	
+	//All known speakers are ranked while there are free slots, so fill them with publishers not known yet, in order
+	for (auto id : unranked)
+	{
+		//Found
+		if (id==publisherId)
+			return true;
+		//No more slots
+		if (!--slots)
+			return false;
+	}
+	
+	return false;
+}
+
+void LastNForwarder::Apply()
+{
+	//Applied
+	changed = false;
+	
+	//Publishers not ranked by the detector for each subscriber
+	std::map<uint32_t,std::set<uint32_t>> unranked;
+	for (const auto& subscription : subscriptions)
+		if (std::find(speakers.begin(),speakers.end(),subscription.publisherId)==speakers.end())
+			unranked[subscription.subscriberId].insert(subscription.publisherId);
+	
+	//For each subscription
+	for (const auto& subscription : subscriptions)
+		//Mute the ones out of the set, unmuting will request a key frame
+		subscription.transponder->Mute(!IsForwarded(subscription.subscriberId,subscription.publisherId,unranked[subscription.subscriberId]));
+}
+
+uint32_t LastNForwarder::GetForwardedCount() const
+{
+	//Lock
+	ScopedLock scoped(mutex);
+	
+	uint32_t forwarded = 0;
+	
+	//Count not muted
+	for (const auto& subscription : subscriptions)
+		if (!subscription.transponder->IsMuted())
+			forwarded++;
+	
+	return forwarded;
+}
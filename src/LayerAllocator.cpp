@@ -0,0 +1,242 @@
+#include "LayerAllocator.h"
+
+#include <algorithm>
+#include <set>
+
+void LayerAllocator::AddTransponder(RTPStreamTransponder* transponder, int priority)
+{
+	//Lock
+	ScopedLock scoped(mutex);
+
+	//Check if already added
+	if (Subscriber* subscriber = GetSubscriber(transponder))
+	{
+		//Just update priority
+		subscriber->priority = priority;
+		return;
+	}
+
+	Subscriber subscriber;
+	subscriber.transponder	= transponder;
+	subscriber.priority	= priority;
+
+	//Add it
+	subscribers.push_back(std::move(subscriber));
+}
+
+void LayerAllocator::RemoveTransponder(RTPStreamTransponder* transponder)
+{
+	//Lock
+	ScopedLock scoped(mutex);
+
+	//Remove it
+	subscribers.erase(std::remove_if(subscribers.begin(),subscribers.end(),[=](const Subscriber& subscriber){
+		return subscriber.transponder==transponder;
+	}),subscribers.end());
+}
+
+void LayerAllocator::SetPriority(RTPStreamTransponder* transponder, int priority)
+{
+	//Lock
+	ScopedLock scoped(mutex);
+
+	//Find it
+	if (Subscriber* subscriber = GetSubscriber(transponder))
+		//Update
+		subscriber->priority = priority;
+}
+
+void LayerAllocator::SetMaxLayers(RTPStreamTransponder* transponder, BYTE maxSpatialLayerId, BYTE maxTemporalLayerId)
+{
+	//Lock
+	ScopedLock scoped(mutex);
+
+	//Find it
+	if (Subscriber* subscriber = GetSubscriber(transponder))
+	{
+		//Update viewport hints
+		subscriber->maxSpatialLayerId	= maxSpatialLayerId;
+		subscriber->maxTemporalLayerId	= maxTemporalLayerId;
+	}
+}
+
+LayerAllocator::Subscriber* LayerAllocator::GetSubscriber(RTPStreamTransponder* transponder)
+{
+	//Find it
+	for (auto& subscriber : subscribers)
+		if (subscriber.transponder==transponder)
+			return &subscriber;
+	//Not found
+	return nullptr;
+}
+
+std::vector<LayerAllocator::Layer> LayerAllocator::GetCandidates(const std::vector<LayerSource>& layers, BYTE maxSpatialLayerId, BYTE maxTemporalLayerId)
+{
+	std::vector<Layer> candidates;
+
+	//For each layer with media
+	for (const auto& layer : layers)
+	{
+		//Skip layers not being received
+		if (!layer.bitrate)
+			continue;
+		//Skip layers above the hints, unless the stream does not signal that dimension
+		if (layer.spatialLayerId!=LayerInfo::MaxLayerId && layer.spatialLayerId>maxSpatialLayerId)
+			continue;
+		if (layer.temporalLayerId!=LayerInfo::MaxLayerId && layer.temporalLayerId>maxTemporalLayerId)
+			continue;
+
+		Layer candidate;
+		candidate.spatialLayerId	= layer.spatialLayerId;
+		candidate.temporalLayerId	= layer.temporalLayerId;
+
+		//Forwarding a layer requires forwarding all the ones it depends on
+		for (const auto& other : layers)
+			if (other.spatialLayerId<=layer.spatialLayerId && other.temporalLayerId<=layer.temporalLayerId)
+				candidate.bitrate += other.bitrate;
+
+		//Add it
+		candidates.push_back(candidate);
+	}
+
+	//Sort by cost
+	std::sort(candidates.begin(),candidates.end(),[](const Layer& a, const Layer& b){
+		return a.bitrate!=b.bitrate ? a.bitrate<b.bitrate : a.GetId()<b.GetId();
+	});
+
+	return candidates;
+}
+
+DWORD LayerAllocator::Update(DWORD bitrate, QWORD now)
+{
+	//Lock
+	ScopedLock scoped(mutex);
+
+	//Do not reallocate too often
+	if (lastAllocation && now<lastAllocation+kAllocationInterval)
+		//Keep last one
+		return allocated;
+	//Allocate
+	return Allocate(bitrate,now);
+}
+
+DWORD LayerAllocator::Allocate(DWORD bitrate, QWORD now)
+{
+	//Lock
+	ScopedLock scoped(mutex);
+
+	//Store time
+	lastAllocation = now;
+
+	//Remaining budget
+	int64_t budget = bitrate;
+	//Priority levels, highest first
+	std::set<int,std::greater<int>> priorities;
+
+	//Get candidates and base layers
+	for (auto& subscriber : subscribers)
+	{
+		//Get candidate layers from the measured incoming bitrate
+		subscriber.candidates = GetCandidates(subscriber.transponder->GetLayers(now),subscriber.maxSpatialLayerId,subscriber.maxTemporalLayerId);
+		subscriber.current  = -1;
+		subscriber.selected = -1;
+
+		//If it is not layered or no media is being received
+		if (subscriber.candidates.empty())
+			//Leave it as it is
+			continue;
+
+		//Get currently selected layers
+		BYTE spatialLayerId  = subscriber.transponder->GetSelectedSpatialLayerId();
+		BYTE temporalLayerId = subscriber.transponder->GetSelectedTemporalLayerId();
+
+		//Find the highest candidate being currently forwarded
+		for (int i=0;i<(int)subscriber.candidates.size();++i)
+			if (subscriber.candidates[i].spatialLayerId<=spatialLayerId && subscriber.candidates[i].temporalLayerId<=temporalLayerId)
+				subscriber.current = i;
+
+		//Everybody gets the base layer
+		subscriber.selected = 0;
+		budget -= subscriber.candidates[0].bitrate;
+
+		//Add priority level
+		priorities.insert(subscriber.priority);
+	}
+
+	//Upgrade higher priorities first
+	for (int priority : priorities)
+	{
+		bool upgraded = true;
+		//Round robin while there is budget for anyone
+		while (upgraded)
+		{
+			upgraded = false;
+			for (auto& subscriber : subscribers)
+			{
+				//Only the ones on this level
+				if (subscriber.priority!=priority || subscriber.candidates.empty())
+					continue;
+				//Next layer
+				int next = subscriber.selected+1;
+				//If already at top
+				if (next>=(int)subscriber.candidates.size())
+					continue;
+				//Get extra cost
+				int64_t cost = subscriber.candidates[next].bitrate - subscriber.candidates[subscriber.selected].bitrate;
+				//If it is above current one
+				if (next>subscriber.current)
+				{
+					//Do not upgrade just after a downgrade
+					if (subscriber.lastDowngrade && now<subscriber.lastDowngrade+kUpgradeDelay)
+						continue;
+					//Require some headroom before switching up
+					cost += subscriber.candidates[next].bitrate*(kUpgradeHeadroom-1);
+				}
+				//If we can't afford it
+				if (cost>budget)
+					continue;
+				//Upgrade
+				subscriber.selected = next;
+				budget -= subscriber.candidates[next].bitrate - subscriber.candidates[next-1].bitrate;
+				upgraded = true;
+			}
+		}
+	}
+
+	//Total allocated
+	allocated = 0;
+
+	//Apply
+	for (auto& subscriber : subscribers)
+	{
+		//Skip not allocated
+		if (subscriber.selected<0)
+			continue;
+
+		const Layer& layer = subscriber.candidates[subscriber.selected];
+
+		//Add to the allocated bitrate
+		allocated += layer.bitrate;
+
+		//If it is the same as before
+		if (subscriber.selected==subscriber.current
+			&& layer.spatialLayerId==subscriber.transponder->GetSelectedSpatialLayerId()
+			&& layer.temporalLayerId==subscriber.transponder->GetSelectedTemporalLayerId())
+			//Nothing to do
+			continue;
+
+		//If going down
+		if (subscriber.selected<subscriber.current)
+			//Hold upgrades for a while
+			subscriber.lastDowngrade = now;
+
+		Debug("-LayerAllocator::Allocate() | selecting layer [transponder:%p,priority:%d,sid:%u,tid:%u,bitrate:%u]\n",subscriber.transponder,subscriber.priority,layer.spatialLayerId,layer.temporalLayerId,layer.bitrate);
+
+		//Select new layer
+		subscriber.transponder->SelectLayer(layer.spatialLayerId,layer.temporalLayerId);
+	}
+
+	UltraDebug("-LayerAllocator::Allocate() [bitrate:%u,allocated:%u,transponders:%u]\n",bitrate,allocated,subscribers.size());
+
+	return allocated;
+}
@@ -122,6 +122,13 @@ void MediaFrameListenerBridge::onMediaFrame(const MediaFrame& frame)
 		firstTimestamp = frame.GetTimeStamp();
 	}
 
+	//Only opus has dtx and integral ms durations, so gaps can be detected without rounding errors
+	bool dtx = frame.GetType()==MediaFrame::Audio && codec==AudioCodec::OPUS;
+	//Opus is only marked on the first packet of a talkspurt, after start or a silence gap
+	bool talkspurt = !frame.GetDuration() || numFrames==1 || frame.GetTimeStamp()>lastFrameEnd;
+	//Store where next frame should start
+	lastFrameEnd = frame.GetTimeStamp() + frame.GetDuration();
+
 	DWORD frameLength = 0;
 	//Calculate total length
 	for (size_t i=0;i<info.size();i++)
@@ -155,7 +162,10 @@ void MediaFrameListenerBridge::onMediaFrame(const MediaFrame& frame)
 		//Set other values
 		packet->SetTimestamp(lastTimestamp*rate);
 		//Check
-		if (i+1==info.size())
+		if (dtx)
+			//Start of talkspurt
+			packet->SetMark(talkspurt && !i);
+		else if (i+1==info.size())
 			//last
 			packet->SetMark(true);
 		else
@@ -0,0 +1,167 @@
+#include "MixerAudioEncoder.h"
+#include "AudioCodecFactory.h"
+#include "opus/opusencoder.h"
+#include "log.h"
+
+MixerAudioEncoder::MixerAudioEncoder(AudioCodec::Type codec, const Properties& properties) :
+	type(codec),
+	properties(properties)
+{
+}
+
+MixerAudioEncoder::~MixerAudioEncoder()
+{
+	//Delete codec
+	delete codec;
+}
+
+std::string MixerAudioEncoder::GetKey(AudioCodec::Type codec, const Properties& properties)
+{
+	//Codec name
+	std::string key = AudioCodec::GetNameFor(codec);
+	//Properties are sorted, so same configuration gets same key
+	for (const auto& property : properties)
+		key += ";" + property.first + "=" + property.second;
+	return key;
+}
+
+bool MixerAudioEncoder::Init(DWORD rate, QWORD time)
+{
+	//Create codec
+	if (!(codec = AudioCodecFactory::CreateEncoder(type,properties)))
+		//Error
+		return Error("-MixerAudioEncoder::Init() could not create encoder [codec:%s]\n",AudioCodec::GetNameFor(type));
+
+	//Try to encode at mixer rate
+	DWORD codecRate = codec->TrySetRate(rate);
+
+	//Check frame size
+	if (codec->numFrameSamples>2048)
+	{
+		//Log
+		Error("-MixerAudioEncoder::Init() frame size too big [samples:%d]\n",codec->numFrameSamples);
+		//Delete codec
+		delete codec;
+		codec = nullptr;
+		//Error
+		return false;
+	}
+
+	//If we need to transrate
+	if (codecRate!=rate)
+		//Open transrater
+		transrater.Open(rate,codecRate);
+
+	//Store start time
+	this->time = time;
+
+	Debug("-MixerAudioEncoder::Init() [codec:%s,rate:%u,codecRate:%u]\n",AudioCodec::GetNameFor(type),rate,codecRate);
+
+	//Done
+	return true;
+}
+
+int MixerAudioEncoder::Encode(SWORD* samples, DWORD len)
+{
+	SWORD resampled[4096];
+	DWORD resampledSize = 4096;
+	SWORD buffer[2048];
+	int num = 0;
+
+	//Check codec
+	if (!codec)
+		return 0;
+
+	//If loss has changed
+	if (reportedLoss!=packetLoss && codec->type==AudioCodec::OPUS)
+		//Adapt FEC to it
+		static_cast<OpusEncoder*>(codec)->SetPacketLoss(reportedLoss);
+	//Store it
+	packetLoss = reportedLoss;
+	//Wait for new reports
+	reportedLoss = 0;
+
+	//If we need to transrate
+	if (transrater.IsOpen())
+	{
+		//Transrate
+		if (!transrater.ProcessBuffer(samples,len,resampled,&resampledSize))
+			//Error
+			return Error("-MixerAudioEncoder::Encode() could not transrate\n");
+		//Swith input parameters to resample ones
+		samples = resampled;
+		len = resampledSize;
+	}
+
+	//If it does not fit
+	if (pending.length()+len>(DWORD)pending.size())
+		//Drop it
+		return Error("-MixerAudioEncoder::Encode() buffer overflow [pending:%d,len:%u]\n",pending.length(),len);
+
+	//Enqueue
+	pending.push(samples,len);
+
+	//Create audio frame
+	AudioFrame frame(type);
+	//Set rate
+	frame.SetClockRate(codec->GetClockRate());
+
+	//While we have full frames
+	while (pending.length()>=codec->numFrameSamples)
+	{
+		//Get them
+		pending.pop(buffer,codec->numFrameSamples);
+
+		//Encode it
+		int size = codec->Encode(buffer,codec->numFrameSamples,frame.GetData(),frame.GetMaxMediaLength());
+
+		//Frame time in ms, samples are at codec rate which may not be the rtp clock rate
+		QWORD ts = time + encoded*1000/codec->GetRate();
+
+		//Increase encoded samples
+		encoded += codec->numFrameSamples;
+
+		//Check result
+		if (size<0)
+			continue;
+
+		//If codec decided not to send it
+		if (!size)
+		{
+			//Silence, timestamps will have a gap
+			suppressed++;
+			suppressing = true;
+			continue;
+		}
+
+		//Sending again
+		suppressing = false;
+
+		//Set frame length
+		frame.SetLength(size);
+
+		//Set frame time
+		frame.SetTimestamp(ts);
+		frame.SetTime(ts);
+		//Set frame duration
+		frame.SetDuration(codec->numFrameSamples*1000/codec->GetRate());
+
+		//Clear rtp
+		frame.ClearRTPPacketizationInfo();
+
+		//Add rtp packet
+		frame.AddRtpPacket(0,size,NULL,0);
+
+		//Send it to all listeners
+		for (auto listener : listeners)
+			listener->onMediaFrame(frame);
+
+		//One more
+		frames++;
+		num++;
+		bytes += size;
+	}
+
+	//Number of frames sent
+	return num;
+}
@@ -0,0 +1,183 @@
+#include <algorithm>
+#include "ProbeController.h"
+
+constexpr uint32_t kMinProbeBitrate		= 128E3;	// 128kbps
+constexpr uint64_t kProbeInterval		= 5E3;		// 5ms
+constexpr uint64_t kClusterTimeout		= 100E3;	// 100ms
+constexpr uint64_t kExponentialTimeout		= 1E6;		// 1s
+constexpr double   kExponentialThreshold	= 0.7f;
+constexpr double   kLargeDropThreshold		= 0.66f;
+constexpr double   kRecoveryFactor		= 0.85f;
+constexpr uint64_t kRecoveryInterval		= 3E6;		// 3s
+constexpr uint32_t kMaxRecoveryProbes		= 5;
+
+constexpr uint64_t ProbeController::kClusterDuration;
+constexpr uint32_t ProbeController::kClusterMinPackets;
+constexpr uint32_t ProbeController::kStartBitrate;
+
+uint32_t ProbeController::CreateCluster(uint32_t bitrate, uint64_t duration, uint32_t minPackets)
+{
+	//Limit probing rate
+	if (maxBitrate)
+		bitrate = std::min(bitrate,maxBitrate);
+	
+	//Skip too low probes
+	if (bitrate<kMinProbeBitrate)
+		return 0;
+	
+	Cluster cluster;
+	//Ids start at 1, 0 is used for non probe packets
+	cluster.id		= nextId++;
+	cluster.bitrate		= bitrate;
+	cluster.duration	= duration;
+	cluster.minPackets	= minPackets;
+	
+	//Enqueue it, it will be started when the current one finishes
+	clusters.push_back(cluster);
+	
+	//Return id
+	return cluster.id;
+}
+
+void ProbeController::Start(uint32_t bitrate, uint64_t now)
+{
+	//If already started
+	if (started)
+		//Done
+		return;
+	//Started
+	started = true;
+	//Probe at 3x and 6x
+	CreateCluster(bitrate*3);
+	//Wait for the result of the higher one
+	if (CreateCluster(bitrate*6))
+	{
+		exponentialBitrate = bitrate*6;
+		exponentialTime = now;
+	}
+}
+
+void ProbeController::SetEstimate(uint32_t bitrate, uint64_t now)
+{
+	//If this is the first estimation
+	if (!started)
+	{
+		//Start exponential ramp-up from the estimation or default start bitrate
+		Start(std::max(bitrate,kStartBitrate),now);
+	//If we are waiting for exponential probe results
+	} else if (exponentialBitrate) {
+		//If the estimation reached the probed rate
+		if (bitrate>=exponentialBitrate*kExponentialThreshold && (!maxBitrate || exponentialBitrate<maxBitrate))
+		{
+			//Keep probing at twice the new estimation
+			exponentialBitrate = CreateCluster(bitrate*2) ? bitrate*2 : 0;
+			exponentialTime = now;
+		} else if (now>exponentialTime+kExponentialTimeout) {
+			//Stop ramp-up
+			exponentialBitrate = 0;
+		}
+	}
+	
+	//Check if there has been a large drop in the estimation
+	if (estimate && bitrate<estimate*kLargeDropThreshold)
+	{
+		//Store previous estimation if it was higher than the one we already were trying to recover
+		if (estimate>dropBitrate)
+			dropBitrate = estimate;
+		//Start recovering
+		dropTime = now;
+		recoveryProbes = 0;
+		//Stop any exponential ramp-up
+		exponentialBitrate = 0;
+	}
+	
+	//If we are recovering from a drop
+	if (dropBitrate)
+	{
+		//If recovered or gave up
+		if (bitrate>=dropBitrate*kRecoveryFactor || recoveryProbes>=kMaxRecoveryProbes)
+		{
+			//Done
+			dropBitrate = 0;
+			recoveryProbes = 0;
+		//If it is time to probe again and there is nothing else probing
+		} else if (now>dropTime+kRecoveryInterval && clusters.empty()) {
+			//Probe just below the previous estimation
+			CreateCluster(dropBitrate*kRecoveryFactor);
+			//Next one
+			dropTime = now;
+			recoveryProbes++;
+		}
+	}
+	
+	//Store estimation
+	estimate = bitrate;
+}
+
+uint32_t ProbeController::GetProbeSize(uint64_t now)
+{
+	//Remove finished clusters
+	while (!clusters.empty())
+	{
+		//Get active one
+		auto& cluster = clusters.front();
+		
+		//If not started yet
+		if (!cluster.start)
+		{
+			//Start it now
+			cluster.start = now;
+			//Go on
+			break;
+		}
+		
+		//Get elapsed time
+		uint64_t elapsed = now - cluster.start;
+		
+		//Check if it is still running
+		if (elapsed<cluster.duration || (cluster.sentPackets<cluster.minPackets && elapsed<kClusterTimeout))
+			//Go on
+			break;
+		
+		//Done
+		clusters.pop_front();
+	}
+	
+	//If nothing to probe
+	if (clusters.empty())
+		//Nothing
+		return 0;
+	
+	//Get active one
+	auto& cluster = clusters.front();
+	
+	//Get how much we should have sent by next interval
+	uint64_t elapsed = std::min(now - cluster.start + kProbeInterval,cluster.duration);
+	uint64_t target = (cluster.bitrate*elapsed)/8E6;
+	
+	//Get pending size
+	uint32_t size = target>cluster.sentBytes ? target-cluster.sentBytes : 0;
+	
+	//Ensure we send the minimum number of packets after duration
+	if (!size && elapsed>=cluster.duration && cluster.sentPackets<cluster.minPackets)
+		//At least one more
+		size = 1;
+	
+	//Done
+	return size;
+}
+
+void ProbeController::ProbeSent(uint32_t size)
+{
+	//If nothing to probe
+	if (clusters.empty())
+		//Nothing
+		return;
+	
+	//Get active one
+	auto& cluster = clusters.front();
+	
+	//Update sent
+	cluster.sentBytes += size;
+	cluster.sentPackets++;
+}
@@ -1,6 +1,7 @@
 #include <sys/stat.h> 
 #include <fcntl.h>
 #include <cmath>
+#include <algorithm>
 #include "SendSideBandwidthEstimation.h"
 
 constexpr uint64_t kStartupDuration		= 1E6;		// 1s
@@ -12,6 +13,15 @@ constexpr uint64_t kMinRate			= 128E3;	// 128kbps
 constexpr uint64_t kMaxRate			= 100E6;	// 100mbps
 constexpr uint64_t kMinRateChangeBps		= 16000;
 constexpr double   kSamplingStep		= 0.0005f;
+constexpr double   kDelayGradientBackoff	= 0.85f;
+constexpr uint32_t kMinProbePackets		= 5;
+constexpr double   kMinProbeReceivedRatio	= 0.8f;
+constexpr uint64_t kMinProbeInterval		= 1E3;		// 1ms
+constexpr double   kProbeSaturationRatio	= 0.9f;
+constexpr double   kProbeSaturationBackoff	= 0.95f;
+
+constexpr uint32_t SendSideBandwidthEstimation::kHistorySize;
+constexpr uint32_t SendSideBandwidthEstimation::kProbeClusters;
 
 
 SendSideBandwidthEstimation::SendSideBandwidthEstimation() : 
@@ -37,48 +47,91 @@ SendSideBandwidthEstimation::~SendSideBandwidthEstimation()
 		close(fd);
 }
 	
-void SendSideBandwidthEstimation::SentPacket(const PacketStats::shared& stat)
+void SendSideBandwidthEstimation::SentPacket(const PacketStats& stat)
 {
 	//Check first packet sent time
 	if (!firstSent)
 		//Set first time
-		firstSent = stat->time;
+		firstSent = stat.time;
+	
+	//Store last sent time
+	lastSent = stat.time;
 	
 	//Add sent total
-	totalSentAcumulator.Update(stat->time,stat->size);
+	totalSentAcumulator.Update(stat.time,stat.size);
 
 	//Check type
-	if (stat->probing)
+	if (stat.probing)
 	{
 		//Update accumulators
-		probingSentAcumulator.Update(stat->time,stat->size);
-		rtxSentAcumulator.Update(stat->time);
-		mediaSentAcumulator.Update(stat->time);
-	} else if (stat->rtx) {
+		probingSentAcumulator.Update(stat.time,stat.size);
+		rtxSentAcumulator.Update(stat.time);
+		mediaSentAcumulator.Update(stat.time);
+	} else if (stat.rtx) {
 		//Update accumulators
-		probingSentAcumulator.Update(stat->time);
-		rtxSentAcumulator.Update(stat->time,stat->size);
-		mediaSentAcumulator.Update(stat->time);
+		probingSentAcumulator.Update(stat.time);
+		rtxSentAcumulator.Update(stat.time,stat.size);
+		mediaSentAcumulator.Update(stat.time);
 	} else {
 		//Update accumulators
-		probingSentAcumulator.Update(stat->time);
-		rtxSentAcumulator.Update(stat->time);
-		mediaSentAcumulator.Update(stat->time,stat->size);
+		probingSentAcumulator.Update(stat.time);
+		rtxSentAcumulator.Update(stat.time);
+		mediaSentAcumulator.Update(stat.time,stat.size);
 	}
 	
-	//Add to history map
-	transportWideSentPacketsStats[stat->transportWideSeqNum] = stat;
+	//Add to history ring, overwritting the oldest one
+	auto& info = transportWideSentPacketsStats[stat.transportWideSeqNum & (kHistorySize-1)];
+	//Fill it
+	info.time			= stat.time;
+	info.size			= stat.size;
+	info.transportWideSeqNum	= stat.transportWideSeqNum;
+	info.used			= true;
+	info.mark			= stat.mark;
+	info.rtx			= stat.rtx;
+	info.probing			= stat.probing;
+	info.probeCluster		= stat.probeCluster;
 	
-	//Protect against missfing feedbacks, remove too old lost packets
-	auto it = transportWideSentPacketsStats.begin();
-	//If there are no intervals for them
-	while(it!=transportWideSentPacketsStats.end() && it->second->time+rtt+kMonitorTimeout<stat->time)
-		//Erase it and move iterator
-		it = transportWideSentPacketsStats.erase(it);
+	//If it belongs to a probe cluster
+	if (stat.probeCluster)
+	{
+		//Get cluster info
+		auto& cluster = probeClusters[stat.probeCluster & (kProbeClusters-1)];
+		//If it is a new one
+		if (cluster.id!=stat.probeCluster)
+		{
+			//Reset
+			cluster = {};
+			cluster.id		= stat.probeCluster;
+			cluster.firstSent	= stat.time;
+			cluster.firstSize	= stat.size;
+		}
+		//Update sent stats
+		cluster.lastSent = stat.time;
+		cluster.sentBytes += stat.size;
+		cluster.sentPackets++;
+	}
+}
 
+SendSideBandwidthEstimation::SentPacketInfo* SendSideBandwidthEstimation::GetSentPacket(uint32_t transportWideSeqNum)
+{
+	//Get position on ring
+	auto& info = transportWideSentPacketsStats[transportWideSeqNum & (kHistorySize-1)];
+	
+	//Check it is the same packet and not an already acknowledged one
+	if (!info.used || info.transportWideSeqNum!=(uint16_t)transportWideSeqNum)
+		//Not found
+		return nullptr;
+	
+	//Protect against missing feedbacks, ignore too old lost packets
+	if (info.time+rtt+kMonitorTimeout<lastSent)
+		//Not found
+		return nullptr;
+	
+	//Found
+	return &info;
 }
 
-void SendSideBandwidthEstimation::ReceivedFeedback(uint8_t feedbackNum, const std::map<uint32_t,uint64_t>& packets, uint64_t when)
+void SendSideBandwidthEstimation::ReceivedFeedback(uint8_t feedbackNum, const std::vector<std::pair<uint32_t,uint64_t>>& packets, uint64_t when)
 {
 
 	//Check we have packets
@@ -89,14 +142,12 @@ void SendSideBandwidthEstimation::ReceivedFeedback(uint8_t feedbackNum, const st
 	//TODO: How to handle lost feedback packets?
 	
 	//Get last packets stats
-	auto last = transportWideSentPacketsStats.find(packets.rbegin()->first);
+	auto last = GetSentPacket(packets.rbegin()->first);
 	//We can use the difference between the last send packet time and the reception of the fb packet as proxy of the rtt min 
-	if (last!=transportWideSentPacketsStats.end())
+	if (last)
 	{
-		//Get stats
-		const auto& stat = last->second;
 		//Get sent time
-		const auto sentTime = stat->time;
+		const auto sentTime = last->time;
 
 		//Double check
 		if (when>sentTime)
@@ -116,12 +167,10 @@ void SendSideBandwidthEstimation::ReceivedFeedback(uint8_t feedbackNum, const st
 		auto receivedTime	= feedback.second; 
 		
 		//Get packets stats
-		auto it = transportWideSentPacketsStats.find(transportSeqNum);
+		auto stat = GetSentPacket(transportSeqNum);
 		//If found
-		if (it!=transportWideSentPacketsStats.end())
+		if (stat)
 		{
-			//Get stats
-			const auto& stat = it->second;
 			//Get sent time
 			const auto sentTime = stat->time;
 			
@@ -149,7 +198,7 @@ void SendSideBandwidthEstimation::ReceivedFeedback(uint8_t feedbackNum, const st
 			//Log("recv #%u sent:%.8lu (+%.6lu) recv:%.8lu (+%.6lu) delta:%.6ld fb:%u, size:%u, bwe:%lu accumulateDelta:%lld\n",transportSeqNum,sent,deltaSent,recv,deltaRecv,delta,feedbackNum, stat->size, bandwidthEstimation, accumulatedDelta);
 			
 			//If dumping to file
-			if (fd)
+			if (fd!=FD_INVALID)
 			{
 				char msg[1024];
 				//Create log
@@ -161,6 +210,10 @@ void SendSideBandwidthEstimation::ReceivedFeedback(uint8_t feedbackNum, const st
 			//Check if it was not lost
 			if (receivedTime)
 			{
+				//Update delay gradient
+				if (mode==Mode::DelayGradient)
+					trendline.Update(sentTime,receivedTime);
+				
 				//Add receive total
 				totalRecvAcumulator.Update(receivedTime,stat->size);
 
@@ -180,6 +233,23 @@ void SendSideBandwidthEstimation::ReceivedFeedback(uint8_t feedbackNum, const st
 					mediaRecvAcumulator.Update(receivedTime,stat->size);
 				}
 			
+				//If it belongs to a probe cluster
+				if (stat->probeCluster)
+				{
+					//Get cluster info
+					auto& cluster = probeClusters[stat->probeCluster & (kProbeClusters-1)];
+					//If it is still the same one
+					if (cluster.id==stat->probeCluster)
+					{
+						//Update received stats
+						if (!cluster.firstRecv || receivedTime<cluster.firstRecv)
+							cluster.firstRecv = receivedTime;
+						cluster.lastRecv = std::max(cluster.lastRecv,receivedTime);
+						cluster.recvBytes += stat->size;
+						cluster.recvPackets++;
+					}
+				}
+				
 				//Update last received time
 				lastRecv = receivedTime;
 				//And previous
@@ -187,17 +257,66 @@ void SendSideBandwidthEstimation::ReceivedFeedback(uint8_t feedbackNum, const st
 				prevRecv = recv;
 			}	
 
-			//Erase it
-			transportWideSentPacketsStats.erase(it);
+			//Acknowledged
+			stat->used = false;
 		} else {
 			Error("-packet not found\n");
 		}
 	}
 	
+	//Get probe cluster results
+	EstimateProbeClusters();
+	
 	//Calculate new estimation
 	EstimateBandwidthRate(when);
 }
 
+void SendSideBandwidthEstimation::EstimateProbeClusters()
+{
+	//For each cluster
+	for (auto& cluster : probeClusters)
+	{
+		//Check if we have enough feedback
+		if (!cluster.id || cluster.done || cluster.recvPackets<kMinProbePackets || cluster.recvPackets<cluster.sentPackets*kMinProbeReceivedRatio)
+			//Skip
+			continue;
+		
+		//Get send and receive intervals
+		uint64_t sendInterval = cluster.lastSent - cluster.firstSent;
+		uint64_t recvInterval = cluster.lastRecv - cluster.firstRecv;
+		
+		//Done with it
+		cluster.done = true;
+		
+		//Too short to be meaningful
+		if (sendInterval<kMinProbeInterval || recvInterval<kMinProbeInterval)
+			//Skip
+			continue;
+		
+		//Calculate rates, first packet size is not part of the intervals
+		uint64_t sendRate = (cluster.sentBytes - cluster.firstSize) * 8E6 / sendInterval;
+		uint64_t recvRate = (cluster.recvBytes - std::min(cluster.firstSize,cluster.recvBytes)) * 8E6 / recvInterval;
+		
+		//Probe result is the minimum of both
+		uint64_t result = std::min(sendRate,recvRate);
+		
+		//If it was received slower than sent, we have saturated the link
+		if (recvRate<sendRate*kProbeSaturationRatio)
+			//Go below the received rate
+			result = recvRate * kProbeSaturationBackoff;
+		
+		//Log("-SendSideBandwidthEstimation::EstimateProbeClusters() [cluster:%u,sent:%llubps,recv:%llubps,result:%llubps]\n",cluster.id,sendRate,recvRate,result);
+		
+		//Store it
+		lastProbeResult = result;
+		
+		//If we are not congested and the probe shows we can go higher, jump to it at once
+		if (state!=ChangeState::Congestion && trendline.GetUsage()!=TrendlineEstimator::Overusing && result>bandwidthEstimation)
+			//Set new estimation
+			bandwidthEstimation = result;
+	}
+}
+
 void SendSideBandwidthEstimation::UpdateRTT(uint64_t when, uint32_t rtt)
 {
 	//Store rtt
@@ -248,9 +367,18 @@ void SendSideBandwidthEstimation::EstimateBandwidthRate(uint64_t when)
 	uint64_t totalSentBitrate	= totalSentAcumulator.GetInstantAvg() * 8;
 	uint64_t rtxSentBitrate		= rtxSentAcumulator.GetInstantAvg() * 8;
 	
-	//Check none of then is 0 or if delay has increased too much
-	if (rttMin && rttEstimated>(50+rttMin*1.5))
+	//Check if delay gradient shows queues building up
+	if (mode==Mode::DelayGradient && trendline.GetUsage()==TrendlineEstimator::Overusing)
 	{
+		//We are in congestion
+		state = ChangeState::Congestion;
+		//Back off below received rate so queues can drain
+		bandwidthEstimation = totalRecvBitrate * kDelayGradientBackoff;
+	} else if (mode==Mode::DelayGradient && trendline.GetUsage()==TrendlineEstimator::Underusing) {
+		//Queues are draining, hold current estimation
+		state = ChangeState::Decrease;
+	//Check none of then is 0 or if delay has increased too much
+	} else if (mode==Mode::AccumulatedDelay && rttMin && rttEstimated>(50+rttMin*1.5)) {
 		//We are in congestion
 		state = ChangeState::Congestion;
 		//Set bwe as received rate
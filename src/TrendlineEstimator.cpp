@@ -0,0 +1,194 @@
+#include <cmath>
+#include <algorithm>
+#include "TrendlineEstimator.h"
+
+constexpr uint64_t kBurstDuration		= 5E3;		// 5ms
+constexpr double   kSmoothingCoef		= 0.9f;
+constexpr double   kThresholdGain		= 4.0f;
+constexpr uint32_t kMaxDeltas			= 60;
+constexpr double   kOverUsingTimeThreshold	= 10.0f;	// 10ms
+constexpr double   kUp				= 0.0087f;
+constexpr double   kDown			= 0.039f;
+constexpr double   kMaxAdaptOffset		= 15.0f;	// 15ms
+constexpr double   kMaxTimeDelta		= 100.0f;	// 100ms
+constexpr double   kMinThreshold		= 6.0f;		// 6ms
+constexpr double   kMaxThreshold		= 600.0f;	// 600ms
+
+constexpr uint32_t TrendlineEstimator::kWindowSize;
+
+void TrendlineEstimator::Reset()
+{
+	current = {};
+	prev = {};
+	firstRecv = 0;
+	numSamples = 0;
+	numDeltas = 0;
+	accumulatedDelay = 0;
+	smoothedDelay = 0;
+	trend = 0;
+	prevTrend = 0;
+	threshold = 12.5;
+	lastThresholdUpdate = -1;
+	timeOverUsing = -1;
+	overuseCounter = 0;
+	usage = Normal;
+}
+
+void TrendlineEstimator::Update(uint64_t sent, uint64_t recv)
+{
+	//Store first arrival to have relative times
+	if (!firstRecv)
+		firstRecv = recv;
+	
+	//If it belongs to current burst, or it is reordered
+	if (current.valid && (sent<current.firstSent+kBurstDuration || sent<current.lastSent))
+	{
+		//Update group
+		current.lastSent = std::max(current.lastSent,sent);
+		current.lastRecv = std::max(current.lastRecv,recv);
+		//Done
+		return;
+	}
+	
+	//If we have a completed group to compare with
+	if (current.valid && prev.valid)
+	{
+		//Get deltas between groups in ms
+		double sendDelta = (static_cast<int64_t>(current.lastSent) - static_cast<int64_t>(prev.lastSent))/1000.0f;
+		double recvDelta = (static_cast<int64_t>(current.lastRecv) - static_cast<int64_t>(prev.lastRecv))/1000.0f;
+		//Update trend with the delay variation
+		UpdateTrendline(recvDelta - sendDelta, (current.lastRecv - firstRecv)/1000.0f);
+		//Run detector
+		Detect(sendDelta, (current.lastRecv - firstRecv)/1000.0f);
+	}
+	
+	//Current group is completed
+	if (current.valid)
+		prev = current;
+	
+	//Start new group
+	current.firstSent = sent;
+	current.lastSent  = sent;
+	current.lastRecv  = recv;
+	current.valid     = true;
+}
+
+void TrendlineEstimator::UpdateTrendline(double delayDelta, double arrival)
+{
+	//One more
+	numDeltas = std::min(numDeltas+1,kMaxDeltas);
+	
+	//Accumulate and smooth delay
+	accumulatedDelay += delayDelta;
+	smoothedDelay = kSmoothingCoef * smoothedDelay + (1 - kSmoothingCoef) * accumulatedDelay;
+	
+	//Store sample on the ring
+	samples[numSamples % kWindowSize] = std::make_pair(arrival,smoothedDelay);
+	numSamples++;
+	
+	//Wait until window is full
+	if (numSamples<kWindowSize)
+		return;
+	
+	//Calculate means
+	double avgX = 0;
+	double avgY = 0;
+	for (const auto& sample : samples)
+	{
+		avgX += sample.first;
+		avgY += sample.second;
+	}
+	avgX /= kWindowSize;
+	avgY /= kWindowSize;
+	
+	//Least squares slope
+	double num = 0;
+	double den = 0;
+	for (const auto& sample : samples)
+	{
+		num += (sample.first - avgX) * (sample.second - avgY);
+		den += (sample.first - avgX) * (sample.first - avgX);
+	}
+	
+	//Store slope, keep previous one if not enough spread
+	if (den!=0)
+		trend = num / den;
+}
+
+void TrendlineEstimator::Detect(double timeDelta, double arrival)
+{
+	//Wait until we have enough samples
+	if (numDeltas<2)
+		return;
+	
+	//Amplify trend with number of deltas
+	double modifiedTrend = std::min(numDeltas,kMaxDeltas) * trend * kThresholdGain;
+	
+	//Check if over threshold
+	if (modifiedTrend>threshold)
+	{
+		//Accumulate time over using
+		if (timeOverUsing<0)
+			//Assume we have been half the time
+			timeOverUsing = timeDelta / 2;
+		else
+			//Increase
+			timeOverUsing += timeDelta;
+		//One more
+		overuseCounter++;
+		//If it has been enough time and delay is still increasing
+		if (timeOverUsing>kOverUsingTimeThreshold && overuseCounter>1 && trend>=prevTrend)
+		{
+			//Reset
+			timeOverUsing = 0;
+			overuseCounter = 0;
+			//We are overusing
+			usage = Overusing;
+		}
+	} else if (modifiedTrend<-threshold) {
+		//Reset
+		timeOverUsing = -1;
+		overuseCounter = 0;
+		//Queues are draining
+		usage = Underusing;
+	} else {
+		//Reset
+		timeOverUsing = -1;
+		overuseCounter = 0;
+		//Normal
+		usage = Normal;
+	}
+	
+	//Store trend
+	prevTrend = trend;
+	
+	//Adapt threshold
+	UpdateThreshold(modifiedTrend,arrival);
+}
+
+void TrendlineEstimator::UpdateThreshold(double modifiedTrend, double arrival)
+{
+	//Init
+	if (lastThresholdUpdate<0)
+		lastThresholdUpdate = arrival;
+	
+	//Don't adapt to big spikes, i.e. sudden capacity changes
+	if (std::fabs(modifiedTrend)>threshold+kMaxAdaptOffset)
+	{
+		lastThresholdUpdate = arrival;
+		return;
+	}
+	
+	//Increase slowly and decrease fast
+	double k = std::fabs(modifiedTrend)<threshold ? kDown : kUp;
+	//Limit time since last update
+	double timeDelta = std::min(arrival-lastThresholdUpdate,kMaxTimeDelta);
+	
+	//Adapt threshold
+	threshold += k * (std::fabs(modifiedTrend) - threshold) * timeDelta;
+	//Set min/max limits
+	threshold = std::min(std::max(threshold,kMinThreshold),kMaxThreshold);
+	
+	//Store update time
+	lastThresholdUpdate = arrival;
+}
@@ -0,0 +1,128 @@
+#include <time.h>
+#include <stdlib.h>
+#include <cmath>
+#include <vector>
+
+#include "config.h"
+#include "log.h"
+#include "AudioCodecFactory.h"
+
+//Only the cpu time of the calling thread, so results are per core
+static QWORD GetThreadTime()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID,&ts);
+	return ((QWORD)ts.tv_sec)*1000000+ts.tv_nsec/1000;
+}
+
+static void Benchmark(AudioCodec::Type codec, QWORD duration)
+{
+	BYTE packet[4096];
+	SWORD decoded[4096];
+
+	//Create codecs
+	AudioEncoder* encoder = AudioCodecFactory::CreateEncoder(codec);
+	AudioDecoder* decoder = AudioCodecFactory::CreateDecoder(codec);
+
+	//Check
+	if (!encoder)
+	{
+		Error("-%s: no encoder\n",AudioCodec::GetNameFor(codec));
+		delete(decoder);
+		return;
+	}
+
+	DWORD rate = encoder->GetRate();
+	DWORD frameSamples = encoder->numFrameSamples;
+
+	//One second of speech like signal, with some noise
+	std::vector<SWORD> samples(rate/frameSamples*frameSamples);
+	for (DWORD i=0;i<samples.size();++i)
+		samples[i] = 8000*sin(2*M_PI*220*i/rate)*(0.6+0.4*sin(2*M_PI*3*i/rate)) + 3000*sin(2*M_PI*1250*i/rate) + rand()%512 - 256;
+
+	//Encoded frames, to be decoded later
+	std::vector<std::vector<BYTE>> packets;
+
+	QWORD encoded = 0;
+	QWORD ini = GetThreadTime();
+	QWORD elapsed = 0;
+	//Encode the signal until duration is reached
+	while (elapsed<duration)
+	{
+		for (DWORD i=0;i+frameSamples<=samples.size();i+=frameSamples)
+		{
+			int len = encoder->Encode(samples.data()+i,frameSamples,packet,sizeof(packet));
+			//Keep first pass
+			if (len>0 && !encoded)
+				packets.emplace_back(packet,packet+len);
+		}
+		encoded += samples.size();
+		elapsed = GetThreadTime()-ini;
+	}
+
+	double encodeRate = encoded*1E6/elapsed;
+	double decodeRate = 0;
+
+	//If there is a decoder and we have something to decode
+	if (decoder && !packets.empty())
+	{
+		QWORD num = 0;
+		ini = GetThreadTime();
+		elapsed = 0;
+		//Decode them until duration is reached
+		while (elapsed<duration)
+		{
+			for (const auto& data : packets)
+			{
+				int len = decoder->Decode(data.data(),data.size(),decoded,sizeof(decoded)/sizeof(SWORD));
+				if (len>0)
+					num += len;
+			}
+			elapsed = GetThreadTime()-ini;
+			//Avoid looping forever if it does not output anything
+			if (!num)
+				break;
+		}
+		decodeRate = num*1E6/elapsed;
+	}
+
+	//Report samples per second per core, and how many realtime channels that is
+	Log("%-8s rate:%5u frame:%4u encode:%8.2f Msamples/s (%6.0f ch) decode:%8.2f Msamples/s (%6.0f ch)\n",
+		AudioCodec::GetNameFor(codec),
+		rate,
+		frameSamples,
+		encodeRate/1E6,
+		encodeRate/rate,
+		decodeRate/1E6,
+		decodeRate/(decoder ? decoder->GetRate() : rate)
+	);
+
+	delete(encoder);
+	delete(decoder);
+}
+
+int main(int argc, char** argv)
+{
+	//Time per codec and direction in ms
+	QWORD duration = argc>1 ? atoi(argv[1]) : 1000;
+
+	//All codecs in the factory
+	const AudioCodec::Type codecs[] = {
+		AudioCodec::PCMA,
+		AudioCodec::PCMU,
+		AudioCodec::G722,
+		AudioCodec::GSM,
+		AudioCodec::SPEEX16,
+		AudioCodec::NELLY8,
+		AudioCodec::NELLY11,
+		AudioCodec::OPUS,
+		AudioCodec::AAC
+	};
+
+	Log("-Audio codec benchmark [duration:%llums]\n",duration);
+
+	for (auto codec : codecs)
+		Benchmark(codec,duration*1000);
+
+	return 0;
+}
@@ -3,6 +3,9 @@
 #include "aac/aacdecoder.h"
 #include "AudioCodecFactory.h"
 
+#include <time.h>
+#include <errno.h>
+
 AudioDecoderWorker::~AudioDecoderWorker()
 {
 	Stop();
@@ -84,6 +87,18 @@ void AudioDecoderWorker::RemoveAudioOutput(AudioOutput* output)
 		output->StopPlaying();
 }
 
+void AudioDecoderWorker::SetSkipSilence(bool enabled, BYTE silenceLevel)
+{
+	Debug("-AudioDecoderWorker::SetSkipSilence() [enabled:%d,silenceLevel:%d]\n",enabled,silenceLevel);
+
+	ScopedLock scope(mutex);
+	//Store values
+	this->skipSilence  = enabled;
+	this->silenceLevel = silenceLevel;
+	//Start again
+	this->silent = 0;
+}
+
 void AudioDecoderWorker::SetAACConfig(const uint8_t* data,const size_t size)
 {
 	ScopedLock scope(mutex);
@@ -122,15 +137,34 @@ void AudioDecoderWorker::SetAACConfig(const uint8_t* data,const size_t size)
 
 int AudioDecoderWorker::Decode()
 {
-	SWORD		raw[2048];
-	DWORD		rawSize=2048;
-	DWORD		frameTime=0;
-	DWORD		lastTime=0;
-
 	Log(">AudioDecoderWorker::Decode()\n");
 
+	timespec deadline;
+
+	//Start now
+	clock_gettime(CLOCK_MONOTONIC,&deadline);
+
+	//If playing out from the jitter buffer
+	while(decoding && adaptive)
+	{
+		//Next deadline
+		deadline.tv_nsec += kPlayoutPeriod*1000000;
+		//Normalize
+		if (deadline.tv_nsec>=1000000000)
+		{
+			deadline.tv_sec++;
+			deadline.tv_nsec -= 1000000000;
+		}
+
+		//Wait until it, absolute so there is no drift
+		while (clock_nanosleep(CLOCK_MONOTONIC,TIMER_ABSTIME,&deadline,NULL)==EINTR);
+
+		//Play next period
+		Playout(kPlayoutPeriod);
+	}
+
 	//Mientras tengamos que capturar
-	while(decoding)
+	while(decoding && !adaptive)
 	{
 		//Obtenemos el paquete
 		if (!packets.Wait(0))
@@ -145,52 +179,8 @@ int AudioDecoderWorker::Decode()
 			//Check condition again
 			continue;
 		
-		//SYNC
-		{
-			//Lock
-			ScopedLock scope(mutex);
-
-			//If we don't have codec
-			if (!codec || (packet->GetCodec()!=codec->type))
-			{
-				//If got a previous codec
-				if (codec)
-					//For each output
-					for (auto output : outputs)
-						//Stop it
-						output->StopPlaying();
-
-				//Create new codec from pacekt
-				codec.reset(AudioCodecFactory::CreateDecoder((AudioCodec::Type)packet->GetCodec()));
-
-				//Check we found one
-				if (!codec)
-					//Skip
-					continue;
-
-				//Update rate
-				rate = codec->GetRate();
-
-				//For each output
-				for (auto output : outputs)
-					//Start playing again
-					output->StartPlaying(rate);	
-			}
-
-			//Lo decodificamos
-			int len = codec->Decode(packet->GetMediaData(),packet->GetMediaLength(),raw,rawSize);
-
-			//Obtenemos el tiempo del frame
-			frameTime = packet->GetTimestamp() - lastTime;
-
-			//Actualizamos el ultimo envio
-			lastTime = packet->GetTimestamp();
-		
-			//For each output
-			for (auto output : outputs)
-				//Send buffer
-				output->PlayBuffer(raw,len,frameTime);
-		}
+		//Decode it
+		DecodePacket(packet);
 	}
 
 	//SYNC
@@ -212,10 +202,341 @@ int AudioDecoderWorker::Decode()
 	return 0;
 }
 
+DWORD AudioDecoderWorker::Process(DWORD ms)
+{
+	DWORD num = 0;
+
+	//If playing out from the jitter buffer
+	if (adaptive)
+		//Play requested time
+		return Playout(ms);
+
+	//Get all packets in queue without waiting
+	while (auto packet = packets.Pop())
+		//Decode it
+		if (DecodePacket(packet))
+			//One more
+			num++;
+
+	//Number of decoded packets
+	return num;
+}
+
+int AudioDecoderWorker::DecodePacket(const RTPPacket::shared& packet)
+{
+	SWORD		raw[2048];
+	DWORD		rawSize=2048;
+	DWORD		frameTime=0;
+	BYTE		vadLevel=-1;
+
+	//Lock
+	ScopedLock scope(mutex);
+
+	//Decode it
+	int len = DecodeFrame(packet,raw,rawSize,&vadLevel);
+
+	//Check we have codec
+	if (len<0)
+		//Skip
+		return 0;
+
+	//Obtenemos el tiempo del frame
+	frameTime = packet->GetTimestamp() - lastTime;
+
+	//Actualizamos el ultimo envio
+	lastTime = packet->GetTimestamp();
+
+	//If it was not decoded
+	if (!len)
+		//Done
+		return 0;
+
+	//For each output
+	for (auto output : outputs)
+		//Send buffer
+		output->PlayBuffer(raw,len,frameTime,vadLevel);
+
+	//Done
+	return 1;
+}
+
+int AudioDecoderWorker::DecodeFrame(const RTPPacket::shared& packet,SWORD* raw,DWORD rawSize,BYTE* vadLevel)
+{
+	//If we don't have codec
+	if (!codec || (packet->GetCodec()!=codec->type))
+	{
+		//If got a previous codec
+		if (codec)
+			//For each output
+			for (auto output : outputs)
+				//Stop it
+				output->StopPlaying();
+
+		//Create new codec from pacekt
+		codec.reset(AudioCodecFactory::CreateDecoder((AudioCodec::Type)packet->GetCodec()));
+
+		//Check we found one
+		if (!codec)
+			//Skip
+			return -1;
+
+		//Update rate
+		rate = codec->GetRate();
+
+		//For each output
+		for (auto output : outputs)
+			//Start playing again
+			output->StartPlaying(rate);	
+	}
+
+	//Check if packet is signaled as silence
+	bool silence = skipSilence && packet->HasAudioLevel() && (!packet->GetVAD() || packet->GetLevel()>=silenceLevel);
+	
+	//If so
+	if (silence)
+	{
+		//One more silent packet
+		silent++;
+		//If we are past the hangover
+		if (silent>kSilenceHangover)
+		{
+			//Update stats
+			skipped++;
+			//Do not decode it
+			return 0;
+		}
+	} else if (silent) {
+		//If we have skipped any packet and the codec is not configured out of band
+		if (silent>kSilenceHangover && codec->type!=AudioCodec::AAC)
+		{
+			UltraDebug("-AudioDecoderWorker::DecodePacket() resuming after silence, reseting codec [skipped:%u]\n",silent-kSilenceHangover);
+			//Start from a clean state instead of continuing from the end of last talkspurt
+			codec.reset(AudioCodecFactory::CreateDecoder(codec->type));
+			//Check
+			if (!codec)
+				//Skip
+				return -1;
+		}
+		//Talking again
+		silent = 0;
+	}
+
+	//Use audio level in -dBov if available, with silent ones as digital silence so vad is not calculated on the hangover
+	*vadLevel = skipSilence && packet->HasAudioLevel() ? (silence ? 127 : packet->GetLevel()) : -1;
+
+	//Lo decodificamos
+	return codec->Decode(packet->GetMediaData(),packet->GetMediaLength(),raw,rawSize);
+}
+
+void AudioDecoderWorker::SetAdaptivePlayout(bool enabled)
+{
+	Debug("-AudioDecoderWorker::SetAdaptivePlayout() [enabled:%d]\n",enabled);
+
+	ScopedLock scope(mutex);
+	//Store it
+	adaptive = enabled;
+	//Start from scratch
+	jitterBuffer.Reset();
+	pcm.clear();
+	buffering = true;
+}
+
+DWORD AudioDecoderWorker::Playout(DWORD ms)
+{
+	//Lock
+	ScopedLock scope(mutex);
+
+	//If we are (re)buffering
+	if (buffering)
+	{
+		//Wait until we have enough packets to absorb the jitter
+		if (jitterBuffer.IsEmpty() || jitterBuffer.GetBufferedDuration(jitterBuffer.GetFirstTimestamp())<jitterBuffer.GetTargetDelay())
+		{
+			//Keep the signal fading out for a while after an underrun
+			if (rate && concealing<kMaxConcealment && pcm.size()<rate*ms/1000)
+			{
+				//Extrapolate
+				Conceal(rate*ms/1000-pcm.size());
+				//Increase concealed time
+				concealing += ms;
+			}
+		} else {
+			//Start playing from first packet
+			playout = jitterBuffer.GetFirstTimestamp();
+			//Not buffering anymore
+			buffering = false;
+		}
+	//If the stream has jumped far ahead
+	} else if (!jitterBuffer.IsEmpty() && jitterBuffer.GetFirstTimestamp()>playout+(QWORD)jitterBuffer.GetClockRate()*AudioJitterBuffer::kMaxDelay/1000) {
+		UltraDebug("-AudioDecoderWorker::Playout() timestamp jump, resyncing\n");
+		//Continue from there
+		playout = jitterBuffer.GetFirstTimestamp();
+	}
+
+	//Decode enough samples
+	DWORD num = !buffering ? Fill(rate*ms/1000) : 0;
+
+	//Check we know codec rate
+	if (!rate)
+		//Nothing to play yet
+		return num;
+
+	//Samples to play
+	DWORD need = rate*ms/1000;
+
+	//If we are playing
+	if (!buffering)
+	{
+		//Get current delay, both packets waiting and decoded samples
+		delay = jitterBuffer.GetBufferedDuration(playout) + pcm.size()*1000/rate;
+		//Get target and allowed deviation
+		DWORD target = jitterBuffer.GetTargetDelay();
+		DWORD margin = std::max(kStretchMargin,target/4);
+
+		//If we are too far behind
+		if (delay>target+margin)
+		{
+			//Remove one period
+			accelerated += AudioJitterBuffer::Accelerate(pcm,rate);
+			//We may need more samples now
+			num += Fill(need);
+		//If we are too close to an underrun
+		} else if (delay+margin<target) {
+			//Repeat one period
+			expanded += AudioJitterBuffer::Expand(pcm,rate);
+		}
+	}
+
+	//Get what we can play
+	DWORD len = std::min<DWORD>(need,pcm.size());
+
+	//If any
+	if (len)
+	{
+		//For each output
+		for (auto output : outputs)
+			//Send buffer
+			output->PlayBuffer(pcm.data(),len,len,vadLevel);
+		//Remove them
+		pcm.erase(pcm.begin(),pcm.begin()+len);
+	}
+
+	//Number of decoded packets
+	return num;
+}
+
+DWORD AudioDecoderWorker::Fill(DWORD need)
+{
+	SWORD raw[2048];
+	DWORD num = 0;
+
+	//Until we have enough samples, rate is unknown until first packet is decoded
+	while (!rate || pcm.size()<need)
+	{
+		//Get clock
+		DWORD clock = jitterBuffer.GetClockRate();
+		//Get frame duration in timestamp units
+		QWORD step = rate && frameSamples ? (QWORD)frameSamples*clock/rate : clock*AudioJitterBuffer::kMinDelay/1000;
+
+		QWORD ts = 0;
+		//Get packet for current playout time
+		auto packet = jitterBuffer.Pop(playout,playout+step/2+1,&ts);
+
+		//If we have it
+		if (packet)
+		{
+			//Decode it
+			int len = DecodeFrame(packet,raw,2048,&vadLevel);
+			//If no codec
+			if (len<0)
+			{
+				//Skip it
+				playout = ts + step;
+				continue;
+			}
+			//If silence was skipped or failed
+			if (!len)
+			{
+				//Play silence instead
+				len = frameSamples ? frameSamples : rate*AudioJitterBuffer::kMinDelay/1000;
+				//Append it
+				pcm.insert(pcm.end(),len,0);
+			} else {
+				//Append samples
+				pcm.insert(pcm.end(),raw,raw+len);
+				//Store frame size
+				frameSamples = len;
+			}
+			//Next one
+			playout = ts + (QWORD)len*clock/rate;
+			//Playing from packets again
+			concealing = 0;
+			//One more
+			num++;
+		//If we have later ones, it has been lost
+		} else if (!jitterBuffer.IsEmpty() && rate) {
+			//Conceal a full frame
+			Conceal(frameSamples ? frameSamples : rate*AudioJitterBuffer::kMinDelay/1000);
+			//Skip it
+			playout += step;
+			//Update stats
+			concealed++;
+		} else {
+			//Conceal what is missing
+			if (rate && pcm.size()<need)
+				Conceal(need-pcm.size());
+			//Update stats
+			underruns++;
+			//Wait for the buffer to fill again
+			buffering = true;
+			//Done
+			break;
+		}
+	}
+
+	return num;
+}
+
+void AudioDecoderWorker::Conceal(DWORD samples)
+{
+	SWORD raw[2048];
+	int len = 0;
+
+	//Check codec
+	if (!codec || !rate)
+		return;
+
+	//Opus can extrapolate the signal, but only on 2.5ms multiples
+	if (codec->type==AudioCodec::OPUS)
+	{
+		//Get size
+		DWORD step = rate/400;
+		DWORD size = std::min((samples+step-1)/step,2048/step)*step;
+		//Decode without data for packet loss concealment
+		len = codec->Decode(NULL,0,raw,size);
+	}
+
+	//If not concealed
+	if (len<=0)
+	{
+		//Play silence instead
+		len = std::min<DWORD>(samples,2048);
+		memset(raw,0,len*sizeof(SWORD));
+	}
+
+	//Append it
+	pcm.insert(pcm.end(),raw,raw+len);
+}
+
 void AudioDecoderWorker::onRTP(RTPIncomingMediaStream* stream,const RTPPacket::shared& packet)
 {
-	//Put it on the queue
-	packets.Add(packet->Clone());
+	//If playing out from the jitter buffer
+	if (adaptive)
+		//Order it by timestamp
+		jitterBuffer.Add(packet->Clone(),getTimeMS());
+	else
+		//Put it on the queue
+		packets.Add(packet->Clone());
 }
 
 void AudioDecoderWorker::onEnded(RTPIncomingMediaStream* stream)
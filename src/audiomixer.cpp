@@ -1,7 +1,6 @@
 #include <signal.h>
 #include <sys/time.h>
 #include <stdio.h>
-#include <emmintrin.h>
 #include "log.h"
 #include "tools.h"
 #include "audiomixer.h"
@@ -24,6 +23,19 @@ AudioMixer::AudioMixer()
 	numSidebars = SidebarDefault;
 	//NO vad by default
 	vad = false;
+	//Mix everybody
+	maxSpeakers = 0;
+	//No samples mixed
+	time = 0;
+	//Fixed rate
+	nativeRate = false;
+	rateChecked = 0;
+	//Nothing to encode
+	numEncodings = 0;
+	//No participants
+	participants = std::make_shared<const Audios>();
+	//Alloc alligned buffer
+	minus = (int32_t*)malloc32(Sidebar::MIXER_BUFFER_SIZE*sizeof(int32_t));
 }
 
 /***********************
@@ -32,6 +44,8 @@ AudioMixer::AudioMixer()
 ************************/
 AudioMixer::~AudioMixer()
 {
+	//Free buffer
+	free(minus);
 }
 
 /***********************************
@@ -104,7 +118,10 @@ int AudioMixer::MixAudio()
 void AudioMixer::Process(DWORD numSamples) 
 {
 	//Block list
-	lstAudiosUse.WaitUnusedAndLock();
+	mutex.Lock();
+
+	//Get participants
+	std::shared_ptr<const Audios> audios = std::atomic_load(&participants);
 
 	//At most the maximum
 	if (numSamples>Sidebar::MIXER_BUFFER_SIZE)
@@ -120,81 +137,522 @@ void AudioMixer::Process(DWORD numSamples)
 		//Reset
 		sit->second->Reset();
 
-	//First pass: Iterate through the audio inputs and calculate the sum of all streams
-	for(Audios::iterator it = audios.begin(); it != audios.end(); ++it)
+	//First pass: Iterate through the audio inputs and get the samples of all streams
+	for(Audios::const_iterator it = audios->begin(); it != audios->end(); ++it)
 	{
 		//Get the source
-		AudioSource *audio = it->second;
-		//Get id
-		DWORD id = it->first;
+		AudioSource *audio = it->second.get();
 		//Get the samples from the fifo
 		audio->len = audio->output->GetSamples(audio->buffer,numSamples);
 		//Clean rest
 		memset(audio->buffer+audio->len,0,(Sidebar::MIXER_BUFFER_SIZE-audio->len)*sizeof(SWORD));
 		//Get VAD value
 		audio->vad = audio->output->GetVAD(numSamples);
-		//For each sidebar
-		for (Sidebars::iterator sit = sidebars.begin(); sit!=sidebars.end(); ++sit)
+	}
+
+	//Release encoders of deleted participants
+	for (const auto& audio : deleted)
+		ReleaseEncoders(audio.get());
+	//Clear them
+	deleted.clear();
+
+	//Calculate the sum of the streams on each sidebar
+	for (Sidebars::iterator sit = sidebars.begin(); sit!=sidebars.end(); ++sit)
+	{
+		//Get sidebar
+		Sidebar * sidebar = sit->second;
+		//For each participant in the sidebar
+		for (int id : sidebar->GetParticipants())
 		{
-			//Get sidebar
-			Sidebar * sidebar = sit->second;
-			//Check if participant is in the sidebar
-			if (sidebar->HasParticipant(id))
-				//Mix it
-				sidebar->Update(id,audio->buffer,audio->len);
+			//Find source
+			Audios::const_iterator it = audios->find(id);
+			//If found
+			if (it!=audios->end())
+				//Add it to the mix
+				sidebar->Update(id,it->second->buffer,it->second->len,it->second->vad);
 		}
+		//Mix them, selecting the loudest ones only if we have vad values
+		sidebar->Mix(numSamples,vad ? maxSpeakers : 0);
 	}
 
+	//Get mixer time in ms
+	QWORD now = rate ? time*1000/rate : 0;
+
 	// Second pass: Calculate this stream's output
-	for(Audios::iterator it = audios.begin(); it != audios.end(); it++)
+	for(Audios::const_iterator it = audios->begin(); it != audios->end(); it++)
 	{
 		//Get the source
-		AudioSource *audio = it->second;
+		AudioSource *audio = it->second.get();
 		//Get id
 		DWORD id = it->first;
 		//Check audio
 		if (!audio)
 			//Next
 			continue;
+		//If encoding has changed
+		if (audio->reset)
+		{
+			//Create them again
+			ReleaseEncoders(audio);
+			//Done
+			audio->reset = false;
+		}
 		//Check sidebar
 		if (!audio->sidebar)
+		{
+			//Stop encoding
+			ReleaseEncoders(audio);
 			//Next
 			continue;
+		}
 		//Get mixed buffer
 		SWORD *mixed = audio->sidebar->GetBuffer();
 		//And the audio buffer for participant
 		SWORD *buffer = audio->buffer;
 
-		//Check if we are also an input to the sidebar to remove ound sound
-		if (audio->sidebar->HasParticipant(id))
+		//Check if we are also an input to the mix to remove ound sound
+		bool isMixed = audio->sidebar->IsMixed(id);
+
+		//If so
+		if (isMixed)
 		{
-			//Get pointers to buffer
-			__m128i* b = (__m128i*) buffer;
-			__m128i* m = (__m128i*) mixed;
-
-			//Sum 8 each time
-			for(DWORD n = (audio->len + 7) >> 3; n != 0; --n,++b,++m)
-			{
-				//Load data in SSE registers
-				__m128i xmm1 = _mm_load_si128(m);
-				__m128i xmm2 = _mm_load_si128(b);
-				//SSE2 sum
-				_mm_store_si128(b,  _mm_sub_epi16(xmm1,xmm2));
-			}
-			//Check length
-			if (audio->len<numSamples)
-				//Copy the rest
-				memcpy(buffer+audio->len,mixed+audio->len,(numSamples-audio->len)*sizeof(SWORD));
+			//Remove own samples, buffer is zeroed after len
+			AudioMixKernel::Subtract(minus,audio->sidebar->GetAccumulator(),buffer,numSamples);
+			//Limit back to 16 bits
+			audio->limiter.Process(buffer,minus,numSamples);
+		}
+
+		//Get output
+		SWORD* output = isMixed ? buffer : mixed;
+
+		//If it is encoded by the mixer
+		if (audio->listener)
+			//Encode it
+			EncodeOutput(audio,isMixed,output,numSamples,now);
+		else
 			//Put the output
-			audio->input->PutSamples(buffer,numSamples);
-		} else {
-			//Copy everything as it is
-			audio->input->PutSamples((SWORD*)mixed,numSamples);
+			audio->input->PutSamples(output,numSamples);
+	}
+
+	//Shared mixes are encoded after own ones
+	DWORD first = numEncodings;
+
+	//Encode each shared mix only once
+	for (SharedEncoders::iterator it = sharedEncoders.begin(); it!=sharedEncoders.end();)
+	{
+		//If nobody is listening anymore
+		if (!it->second->GetListenerCount())
+		{
+			//Remove it, it will be deleted when not used
+			it = sharedEncoders.erase(it);
+			//Next
+			continue;
 		}
+		//Encode the whole mix of the sidebar
+		AddEncoding(it->second,it->first.first->GetBuffer(),numSamples);
+		//Next
+		++it;
 	}
 
-	//Unblock list
-	lstAudiosUse.Unlock();
+	//For each participant getting a shared mix
+	for(Audios::const_iterator it = audios->begin(); it != audios->end(); it++)
+		if (it->second->shared)
+			//Find its encoding
+			for (DWORD i=first;i<numEncodings;++i)
+				if (encodings[i].encoder==it->second->shared)
+					encodings[i].listeners.push_back(it->second.get());
+
+	//Increase mixer clock
+	time += numSamples;
+
+	//If mixing at participants rate, check it from time to time
+	if (nativeRate && (time-rateChecked)*1000>=rate*kRateCheckInterval)
+	{
+		//Get most common one
+		DWORD dominant = CalculateDominantRate();
+		//If it has changed
+		if (dominant && dominant!=rate)
+			//Switch to it
+			UpdateRate(dominant);
+		//Check again later
+		rateChecked = time;
+	}
+
+	//Unblock list, listeners may call back the mixer
+	mutex.Unlock();
+
+	//For each encoding of the mix
+	for (DWORD i=0;i<numEncodings;++i)
+	{
+		//Get it
+		Encoding& encoding = encodings[i];
+		//Send pending frames of the shared mix before own ones
+		if (encoding.flush)
+			encoding.flush->repacketizer.Flush();
+		//Combine frames if accepted by the participant
+		for (AudioSource* audio : encoding.listeners)
+			audio->repacketizer.SetMaxFrames(audio->combine);
+		//Encode it
+		encoding.encoder->Encode(encoding.samples.data(),numSamples);
+		//If frames are being suppressed
+		if (encoding.encoder->IsSuppressing())
+			//Do not keep the last frames before the silence waiting for more
+			for (AudioSource* audio : encoding.listeners)
+				audio->repacketizer.Flush();
+		//Not needed anymore
+		encoding.encoder.reset();
+	}
+
+	//Done
+	numEncodings = 0;
+}
+
+AudioMixer::Encoding& AudioMixer::AddEncoding(const std::shared_ptr<MixerAudioEncoder>& encoder,const SWORD* samples,DWORD numSamples)
+{
+	//Reuse previous ones
+	if (numEncodings==encodings.size())
+		encodings.emplace_back();
+
+	//Get next one
+	Encoding& encoding = encodings[numEncodings++];
+
+	//Copy samples, as the sidebar may be deleted before encoding
+	encoding.samples.assign(samples,samples+numSamples);
+	//Set encoder
+	encoding.encoder = encoder;
+	//Clean
+	encoding.flush = NULL;
+	encoding.listeners.clear();
+
+	return encoding;
+}
+
+int AudioMixer::SetMaxSpeakers(DWORD maxSpeakers)
+{
+	Log("-SetMaxSpeakers [maxSpeakers:%d]\n",maxSpeakers);
+	//Store
+	this->maxSpeakers = maxSpeakers;
+
+	//OK
+	return 1;
+}
+
+int AudioMixer::SetNativeRate(bool nativeRate)
+{
+	Log("-SetNativeRate [nativeRate:%d]\n",nativeRate);
+	//Store
+	this->nativeRate = nativeRate;
+
+	//OK
+	return 1;
+}
+
+DWORD AudioMixer::GetDominantRate()
+{
+	//Calculate it, without blocking the mixer
+	return CalculateDominantRate();
+}
+
+DWORD AudioMixer::CalculateDominantRate()
+{
+	std::map<DWORD,DWORD> rates;
+	DWORD dominant = 0;
+
+	//Get participants
+	std::shared_ptr<const Audios> audios = std::atomic_load(&participants);
+
+	//Count participants by decoded rate
+	for (Audios::const_iterator it = audios->begin(); it!=audios->end(); ++it)
+		//If playing
+		if (DWORD playRate = it->second->output->GetPlayingRate())
+			rates[playRate]++;
+
+	//Get most common one, highest on ties
+	for (auto it = rates.begin(); it!=rates.end(); ++it)
+		if (!dominant || it->second>=rates[dominant])
+			dominant = it->first;
+
+	return dominant;
+}
+
+void AudioMixer::UpdateRate(DWORD rate)
+{
+	Log("-AudioMixer::UpdateRate() [from:%d,to:%d]\n",this->rate,rate);
+
+	//Keep mixer clock time
+	time = time*rate/this->rate;
+
+	//Store new rate
+	this->rate = rate;
+
+	//Get participants
+	std::shared_ptr<const Audios> audios = std::atomic_load(&participants);
+
+	//For each participant
+	for (Audios::const_iterator it = audios->begin(); it!=audios->end(); ++it)
+	{
+		//Get the source
+		AudioSource *audio = it->second.get();
+		//Mix at new rate
+		audio->input->SetNativeRate(rate);
+		audio->output->SetNativeRate(rate);
+		//Encoders will be created again at new rate
+		ReleaseEncoders(audio);
+	}
+
+	//Clear list, encoders are deleted when not used
+	sharedEncoders.clear();
+}
+
+void AudioMixer::EncodeOutput(AudioSource* audio,bool isMixed,SWORD* samples,DWORD numSamples,QWORD now)
+{
+	//If it is an input of the mix
+	if (isMixed)
+		//Update last time
+		audio->lastMixed = now;
+
+	//Switching from the shared mix
+	AudioSource* flush = NULL;
+
+	//If it needs its own encoder now
+	if (isMixed && !audio->encoder)
+	{
+		//Create it starting now
+		audio->encoder = std::make_shared<MixerAudioEncoder>(audio->codec,audio->properties);
+		audio->encoder->Init(rate,now);
+		//Send to participant
+		audio->encoder->AddListener(&audio->dispatcher);
+		//If it was getting the shared mix
+		if (audio->shared)
+		{
+			//Stop
+			audio->shared->RemoveListener(&audio->repacketizer);
+			//Send its pending frames before own ones
+			flush = audio;
+		}
+		//Not shared
+		audio->shared.reset();
+	} else if (!isMixed && audio->encoder && now>audio->lastMixed+kEncoderHangover) {
+		//Back to the shared mix
+		audio->encoder.reset();
+	}
+
+	//If it has its own
+	if (audio->encoder)
+	{
+		//Protect against participant losses
+		audio->encoder->ReportPacketLoss(audio->fractionLost);
+		//Encode it
+		AddEncoding(audio->encoder,samples,numSamples).flush = flush;
+		//Done
+		return;
+	}
+
+	//Get the shared encoder for the sidebar and codec configuration
+	std::shared_ptr<MixerAudioEncoder>& shared = sharedEncoders[std::make_pair(audio->sidebar,audio->key)];
+
+	//If not created yet
+	if (!shared)
+	{
+		//Create it starting now
+		shared = std::make_shared<MixerAudioEncoder>(audio->codec,audio->properties);
+		shared->Init(rate,now);
+	}
+
+	//If it has changed
+	if (audio->shared!=shared)
+	{
+		//Stop listening previous one
+		if (audio->shared)
+			audio->shared->RemoveListener(&audio->repacketizer);
+		//Listen to the shared mix, it will be encoded later
+		shared->AddListener(&audio->repacketizer);
+		//Store it
+		audio->shared = shared;
+	}
+
+	//Protect against the losses of all the participants getting it
+	shared->ReportPacketLoss(audio->fractionLost);
+
+	//Combine frames if accepted by the participant, unless it is losing too many packets
+	audio->combine = audio->fractionLost<kMaxRepacketizationLoss ? audio->maxFrames.load() : 1;
+}
+
+void AudioMixer::ReleaseEncoders(AudioSource* audio)
+{
+	//If getting the shared mix
+	if (audio->shared)
+		//Stop, it will be deleted by the mixer when nobody is listening
+		audio->shared->RemoveListener(&audio->repacketizer);
+	//Drop frames of the shared mix not sent yet
+	audio->repacketizer.Reset();
+	//Clean, encoders are deleted when not used
+	audio->shared.reset();
+	audio->encoder.reset();
+}
+
+void AudioMixer::SetLossReports(AudioSource* audio,RTPOutgoingSourceGroup* group)
+{
+	//If not changed
+	if (audio->group==group)
+		return;
+	//Stop listening previous one
+	if (audio->group)
+		audio->group->RemoveListener(audio);
+	//Listen new one
+	if (group)
+		group->AddListener(audio);
+	//Store it
+	audio->group = group;
+	//Old reports are not valid anymore
+	audio->fractionLost = 0;
+}
+
+int AudioMixer::SetEncodedOutput(int id,AudioCodec::Type codec,const Properties& properties,MediaFrame::Listener* listener,RTPOutgoingSourceGroup* group)
+{
+	Log("-SetEncodedOutput [id:%d,codec:%s]\n",id,AudioCodec::GetNameFor(codec));
+
+	//Block
+	mutex.Lock();
+
+	//Get participants
+	std::shared_ptr<const Audios> audios = std::atomic_load(&participants);
+
+	//Find it
+	Audios::const_iterator it = audios->find(id);
+
+	//If not found
+	if (it==audios->end())
+	{
+		//Unblock
+		mutex.Unlock();
+		//Error
+		return Error("Mixer not found\n");
+	}
+
+	//Get source
+	std::shared_ptr<AudioSource> audio = it->second;
+
+	//Store encoding parameters
+	audio->listener		= listener;
+	audio->codec		= codec;
+	audio->properties	= properties;
+	audio->key		= MixerAudioEncoder::GetKey(codec,properties);
+	//Stop previous encoding on next mix
+	audio->reset		= true;
+	//Get loss from the participant reports
+	SetLossReports(audio.get(),group);
+
+	//Unblock
+	mutex.Unlock();
+
+	//Send new frames to the listener, waiting for the one being delivered
+	audio->dispatcher.SetListener(listener,codec);
+
+	//OK
+	return 1;
+}
+
+int AudioMixer::RemoveEncodedOutput(int id)
+{
+	Log("-RemoveEncodedOutput [id:%d]\n",id);
+
+	//Block
+	mutex.Lock();
+
+	//Get participants
+	std::shared_ptr<const Audios> audios = std::atomic_load(&participants);
+
+	//Find it
+	Audios::const_iterator it = audios->find(id);
+
+	//If found
+	if (it!=audios->end())
+	{
+		//No listener
+		it->second->listener = NULL;
+		//Stop encoding on next mix
+		it->second->reset = true;
+		//No more reports
+		SetLossReports(it->second.get(),NULL);
+	}
+
+	//Unblock
+	mutex.Unlock();
+
+	//If found
+	if (it!=audios->end())
+		//Do not send anymore, waiting for the frame being delivered
+		it->second->dispatcher.SetListener(NULL,AudioCodec::UNKNOWN);
+
+	//OK
+	return 1;
+}
+
+int AudioMixer::SetPacketLoss(int id,BYTE fractionLost)
+{
+	//Get participants, without blocking the mixer
+	std::shared_ptr<const Audios> audios = std::atomic_load(&participants);
+
+	//Find it
+	Audios::const_iterator it = audios->find(id);
+
+	//Check
+	bool found = it!=audios->end();
+
+	//If found
+	if (found)
+		//Store it, it will be used on next encoding
+		it->second->fractionLost = fractionLost;
+
+	return found;
+}
+
+int AudioMixer::SetRepacketization(int id,DWORD maxFrames)
+{
+	Log("-SetRepacketization [id:%d,maxFrames:%u]\n",id,maxFrames);
+
+	//Get participants, without blocking the mixer
+	std::shared_ptr<const Audios> audios = std::atomic_load(&participants);
+
+	//Find it
+	Audios::const_iterator it = audios->find(id);
+
+	//Check
+	bool found = it!=audios->end();
+
+	//If found
+	if (found)
+		//Store it, it will be used on next encoding
+		it->second->maxFrames = maxFrames;
+
+	return found;
+}
+
+DWORD AudioMixer::GetEncoderCount()
+{
+	//Block
+	mutex.Lock();
+
+	//Get participants
+	std::shared_ptr<const Audios> audios = std::atomic_load(&participants);
+
+	DWORD num = 0;
+
+	//Shared ones still in use
+	for (SharedEncoders::iterator it = sharedEncoders.begin(); it!=sharedEncoders.end(); ++it)
+		if (it->second->GetListenerCount())
+			num++;
+
+	//Add own ones
+	for (Audios::const_iterator it = audios->begin(); it!=audios->end(); ++it)
+		if (it->second->encoder)
+			num++;
+
+	//Unblock
+	mutex.Unlock();
+
+	return num;
 }
 
 int AudioMixer::SetCalculateVAD(bool vad)
@@ -238,6 +696,9 @@ int AudioMixer::Init(const Properties &properties)
 	//Check if we are calculating vad
 	vad = properties.GetProperty("vad",vad);
 
+	//Check if we follow participants rate
+	nativeRate = properties.GetProperty("nativeRate",nativeRate);
+
 	return 1;
 }
 
@@ -261,26 +722,38 @@ int AudioMixer::End()
 	}
 
 	//Lock
-	lstAudiosUse.WaitUnusedAndLock();
+	mutex.Lock();
+
+	//Get participants
+	std::shared_ptr<const Audios> audios = std::atomic_load(&participants);
 
 	//Recorremos la lista
-	for (Audios::iterator it =audios.begin();it!=audios.end();++it)
+	for (Audios::const_iterator it =audios->begin();it!=audios->end();++it)
 	{
 		//Obtenemos el audio source
-		AudioSource *audio = it->second;
+		AudioSource *audio = it->second.get();
 
 		//Terminamos
 		audio->input->End();
 		audio->output->End();
-		
-		//SI esta borramos los objetos
-		delete audio->input;
-		delete audio->output;
-		delete audio;
+
+		//Stop encoding
+		ReleaseEncoders(audio);
+		//No more reports
+		SetLossReports(audio,NULL);
 	}
 
-	//Clear list
-	audios.clear();
+	//Clear list, sources are deleted when nobody is using them
+	std::atomic_store(&participants,std::make_shared<const Audios>());
+
+	//For each deleted participant
+	for (const auto& audio : deleted)
+		//Stop encoding
+		ReleaseEncoders(audio.get());
+
+	//Clear lists
+	deleted.clear();
+	sharedEncoders.clear();
 
 	//For each sidebar
 	for (Sidebars::iterator it=sidebars.begin(); it!=sidebars.end();++it)
@@ -295,7 +768,7 @@ int AudioMixer::End()
 	sidebars.clear();
 
 	//Unlock
-	lstAudiosUse.Unlock();
+	mutex.Unlock();
 	
 	Log("<End audiomixer\n");
 	
@@ -311,19 +784,22 @@ int AudioMixer::CreateMixer(int id)
 	Log(">CreateMixer audio [id:%d,vad:%d]\n",id,vad);
 
 	//Protegemos la lista
-	lstAudiosUse.WaitUnusedAndLock();
+	mutex.Lock();
+
+	//Get participants
+	std::shared_ptr<const Audios> audios = std::atomic_load(&participants);
 
 	//Miramos que si esta
-	if (audios.find(id)!=audios.end())
+	if (audios->find(id)!=audios->end())
 	{
 		//Desprotegemos la lista
-		lstAudiosUse.Unlock();
+		mutex.Unlock();
 		//Error
 		return Error("Audio source already existed\n");
 	}
 
 	//Creamos el source
-	AudioSource *audio = new AudioSource();
+	std::shared_ptr<AudioSource> audio = std::make_shared<AudioSource>();
 
 	//POnemos el input y el output
 	audio->input  = new PipeAudioInput();
@@ -335,11 +811,17 @@ int AudioMixer::CreateMixer(int id)
 	audio->len = 0;
 	audio->vad = 0;
 
+	//Copy the list, so anyone using current one is not affected
+	std::shared_ptr<Audios> updated = std::make_shared<Audios>(*audios);
+
 	//Y lo a�adimos a la lista
-	audios[id] = audio;
+	(*updated)[id] = audio;
+
+	//Publish it
+	std::atomic_store(&participants,std::shared_ptr<const Audios>(updated));
 
 	//Desprotegemos la lista
-	lstAudiosUse.Unlock();
+	mutex.Unlock();
 
 	//Y salimos
 	Log("<CreateMixer audio\n");
@@ -357,22 +839,25 @@ int AudioMixer::InitMixer(int id,int sidebarId)
 	Log(">Init mixer [%d]\n",id);
 
 	//Protegemos la lista
-	lstAudiosUse.IncUse();
+	mutex.Lock();
+
+	//Get participants
+	std::shared_ptr<const Audios> audios = std::atomic_load(&participants);
 
 	//Buscamos el audio source
-	Audios::iterator it = audios.find(id);
+	Audios::const_iterator it = audios->find(id);
 
 	//Si no esta	
-	if (it == audios.end())
+	if (it == audios->end())
 	{
 		//Desprotegemos
-		lstAudiosUse.DecUse();
+		mutex.Unlock();
 		//Salimos
 		return Error("Mixer not found\n");
 	}
 
 	//Obtenemos el audio source
-	AudioSource *audio = it->second;
+	AudioSource *audio = it->second.get();
 
 	//Get the sidebar for the user
 	Sidebars::iterator itSidebar = sidebars.find(sidebarId);
@@ -393,7 +878,7 @@ int AudioMixer::InitMixer(int id,int sidebarId)
 	defaultSidebar->AddParticipant(id);
 
 	//Desprotegemos
-	lstAudiosUse.DecUse();
+	mutex.Unlock();
 
 	Log("<Init mixer [%d]\n",id);
 
@@ -409,16 +894,19 @@ int AudioMixer::InitMixer(int id,int sidebarId)
 int AudioMixer::EndMixer(int id)
 {
 	//Protegemos la lista
-	lstAudiosUse.IncUse();
+	mutex.Lock();
+
+	//Get participants
+	std::shared_ptr<const Audios> audios = std::atomic_load(&participants);
 
 	//Buscamos el audio source
-	Audios::iterator it = audios.find(id);
+	Audios::const_iterator it = audios->find(id);
 
 	//Si no esta	
-	if (it == audios.end())
+	if (it == audios->end())
 	{
 		//Desprotegemos
-		lstAudiosUse.DecUse();
+		mutex.Unlock();
 		//Salimos
 		return false;
 	}
@@ -427,7 +915,7 @@ int AudioMixer::EndMixer(int id)
 	defaultSidebar->RemoveParticipant(id);
 
 	//Obtenemos el audio source
-	AudioSource *audio = it->second;
+	AudioSource *audio = it->second.get();
 
 	//Terminamos
 	audio->input->End();
@@ -442,7 +930,7 @@ int AudioMixer::EndMixer(int id)
 		it->second->RemoveParticipant(id);
 
 	//Desprotegemos
-	lstAudiosUse.DecUse();
+	mutex.Unlock();
 
 	//Si esta devolvemos el input
 	return true;;
@@ -457,33 +945,45 @@ int AudioMixer::DeleteMixer(int id)
 	Log("-DeleteMixer audio [%d]\n",id);
 
 	//Protegemos la lista
-	lstAudiosUse.WaitUnusedAndLock();
+	mutex.Lock();
+
+	//Get participants
+	std::shared_ptr<const Audios> audios = std::atomic_load(&participants);
 
 	//Lo buscamos
-	Audios::iterator it = audios.find(id);
+	Audios::const_iterator it = audios->find(id);
 
 	//SI no ta
-	if (it == audios.end())
+	if (it == audios->end())
 	{
 		//DDesprotegemos la lista
-		lstAudiosUse.Unlock();
+		mutex.Unlock();
 		//Salimos
 		return Error("Audio source not found\n");
 	}
 
 	//Obtenemos el audio source
-	AudioSource *audio = it->second;
+	std::shared_ptr<AudioSource> audio = it->second;
+
+	//No more reports
+	SetLossReports(audio.get(),NULL);
+	//Encoders will be released by the mixer
+	deleted.push_back(audio);
+
+	//Copy the list, so anyone using current one is not affected
+	std::shared_ptr<Audios> updated = std::make_shared<Audios>(*audios);
 
 	//Lo quitamos de la lista
-	audios.erase(it);
+	updated->erase(id);
+
+	//Publish it, source will be deleted when nobody is using it
+	std::atomic_store(&participants,std::shared_ptr<const Audios>(updated));
 
 	//Desprotegemos la lista
-	lstAudiosUse.Unlock();
+	mutex.Unlock();
 
-	//SI esta borramos los objetos
-	delete audio->input;
-	delete audio->output;
-	delete audio; 
+	//Do not send anymore, waiting for the frame being delivered
+	audio->dispatcher.SetListener(NULL,AudioCodec::UNKNOWN);
 
 	return 0;
 }
@@ -494,22 +994,19 @@ int AudioMixer::DeleteMixer(int id)
 ************************/
 AudioInput* AudioMixer::GetInput(int id)
 {
-	//Protegemos la lista
-	lstAudiosUse.IncUse();
+	//Get participants, without blocking the mixer
+	std::shared_ptr<const Audios> audios = std::atomic_load(&participants);
 
 	//Buscamos el audio source
-	Audios::iterator it = audios.find(id);
+	Audios::const_iterator it = audios->find(id);
 
 	//Obtenemos el input
 	AudioInput *input = NULL;
 
 	//Si esta
-	if (it != audios.end())
+	if (it != audios->end())
 		input = it->second->input;
 
-	//Desprotegemos
-	lstAudiosUse.DecUse();
-
 	//Si esta devolvemos el input
 	return input;
 }
@@ -520,22 +1017,19 @@ AudioInput* AudioMixer::GetInput(int id)
 ************************/
 AudioOutput* AudioMixer::GetOutput(int id)
 {
-	//Protegemos la lista
-	lstAudiosUse.IncUse();
+	//Get participants, without blocking the mixer
+	std::shared_ptr<const Audios> audios = std::atomic_load(&participants);
 
 	//Buscamos el audio source
-	Audios::iterator it = audios.find(id);
+	Audios::const_iterator it = audios->find(id);
 
 	//Obtenemos el output
 	AudioOutput *output = NULL;
 
 	//Si esta	
-	if (it != audios.end())
+	if (it != audios->end())
 		output = it->second->output;
 
-	//Desprotegemos
-	lstAudiosUse.DecUse();
-
 	//Si esta devolvemos el input
 	return output;
 }
@@ -549,22 +1043,25 @@ int AudioMixer::SetMixerSidebar(int id,int sidebarId)
 	Log(">SetMixerSidebar [id:%d,sidebar:%d]\n",id,sidebarId);
 
 	//Protegemos la lista
-	lstAudiosUse.IncUse();
+	mutex.Lock();
+
+	//Get participants
+	std::shared_ptr<const Audios> audios = std::atomic_load(&participants);
 
 	//Buscamos el audio source
-	Audios::iterator it = audios.find(id);
+	Audios::const_iterator it = audios->find(id);
 
 	//Si no esta
-	if (it == audios.end())
+	if (it == audios->end())
 	{
 		//Desprotegemos
-		lstAudiosUse.DecUse();
+		mutex.Unlock();
 		//Salimos
 		return Error("Mixer not found\n");
 	}
 
 	//Obtenemos el audio source
-	AudioSource *audio = it->second;
+	AudioSource *audio = it->second.get();
 
 	//Get the sidebar for the user
 	Sidebars::iterator itSidebar = sidebars.find(sidebarId);
@@ -578,7 +1075,7 @@ int AudioMixer::SetMixerSidebar(int id,int sidebarId)
 		Log("-No sidebar for participant found, will be send only.\n");
 
 	//Desprotegemos
-	lstAudiosUse.DecUse();
+	mutex.Unlock();
 
 	Log("<SetMixerSidebar [%d]\n",id);
 
@@ -594,7 +1091,7 @@ int AudioMixer::AddSidebarParticipant(int sidebarId, int partId)
 	Log("-AddSidebarParticipant [sidebar:%d,partId:%d]\n",sidebarId,partId);
 
 	//Block
-	lstAudiosUse.IncUse();
+	mutex.Lock();
 
 	//Get the sidebar for the user
 	Sidebars::iterator itSidebar = sidebars.find(sidebarId);
@@ -603,7 +1100,7 @@ int AudioMixer::AddSidebarParticipant(int sidebarId, int partId)
 	if (itSidebar==sidebars.end())
 	{
 		//UnBlock
-		lstAudiosUse.DecUse();
+		mutex.Unlock();
 		//Salimos
 		return Error("Sidebar not found\n");
 	}
@@ -612,7 +1109,7 @@ int AudioMixer::AddSidebarParticipant(int sidebarId, int partId)
 	itSidebar->second->AddParticipant(partId);
 
 	//UnBlock
-	lstAudiosUse.DecUse();
+	mutex.Unlock();
 
 	//Everything ok
 	return 1;
@@ -627,7 +1124,7 @@ int AudioMixer::RemoveSidebarParticipant(int sidebarId, int partId)
 	Log(">-RemoveSidebarParticipant [sidebar:%d,partId:%d]\n",sidebarId,partId);
 
 	//Block
-	lstAudiosUse.IncUse();
+	mutex.Lock();
 	
 	//Get the sidebar for the user
 	Sidebars::iterator itSidebar = sidebars.find(sidebarId);
@@ -636,7 +1133,7 @@ int AudioMixer::RemoveSidebarParticipant(int sidebarId, int partId)
 	if (itSidebar==sidebars.end())
 	{
 		//UnBlock
-		lstAudiosUse.DecUse();
+		mutex.Unlock();
 		//Salimos
 		return Error("Sidebar not found\n");
 	}
@@ -648,7 +1145,7 @@ int AudioMixer::RemoveSidebarParticipant(int sidebarId, int partId)
 	sidebar->RemoveParticipant(partId);
 
 	//UnBlock
-	lstAudiosUse.DecUse();
+	mutex.Unlock();
 		
 	//Correct
 	return 1;
@@ -660,13 +1157,13 @@ int AudioMixer::CreateSidebar()
 	int id = numSidebars++;
 
 	//Block
-	lstAudiosUse.IncUse();
+	mutex.Lock();
 
 	//add it
 	sidebars[id] = new Sidebar();
 
 	//UnBlock
-	lstAudiosUse.DecUse();
+	mutex.Unlock();
 
 	return id;
 }
@@ -675,7 +1172,10 @@ int AudioMixer::DeleteSidebar(int sidebarId)
 {
 
 	//Block
-	lstAudiosUse.WaitUnusedAndLock();
+	mutex.Lock();
+
+	//Get participants
+	std::shared_ptr<const Audios> audios = std::atomic_load(&participants);
 
 	//Get sidebar from id
 	Sidebars::iterator it = sidebars.find(sidebarId);
@@ -684,7 +1184,7 @@ int AudioMixer::DeleteSidebar(int sidebarId)
 	if (it==sidebars.end())
 	{
 		//UnBlock
-		lstAudiosUse.Unlock();
+		mutex.Unlock();
 		//error
 		return Error("Sidebar not found [id:%d]\n",sidebarId);
 	}
@@ -693,19 +1193,38 @@ int AudioMixer::DeleteSidebar(int sidebarId)
 	Sidebar *sidebar = it->second;
 
 	//For each audio
-	for (Audios::iterator ita = audios.begin(); ita!= audios.end(); ++ita)
+	for (Audios::const_iterator ita = audios->begin(); ita!= audios->end(); ++ita)
 	{
 		//Check it it has dis sidebar
 		if (ita->second->sidebar == sidebar)
-			//Set to null
+			//Set to null, encoders will be released by the mixer
 			ita->second->sidebar = NULL;
 	}
 
+	//For each shared encoder
+	for (SharedEncoders::iterator ite = sharedEncoders.begin(); ite!=sharedEncoders.end();)
+	{
+		//If it is from this sidebar
+		if (ite->first.first==sidebar)
+		{
+			//Anyone still listening to it, after changing sidebar
+			for (Audios::const_iterator ita = audios->begin(); ita!= audios->end(); ++ita)
+				//Stop encoding on next mix
+				if (ita->second->shared==ite->second)
+					ita->second->reset = true;
+			//Remove it, it will be deleted when not used
+			ite = sharedEncoders.erase(ite);
+		} else {
+			//Next
+			++ite;
+		}
+	}
+
 	//Remove sidebar
 	sidebars.erase(it);
 
 	//UnBlock
-	lstAudiosUse.Unlock();
+	mutex.Unlock();
 
 	//Delete sidebar
 	delete(sidebar);
@@ -718,20 +1237,17 @@ DWORD AudioMixer::GetVAD(int id)
 {
 	DWORD acuVAD = 0;
 
-	//Lock
-	lstAudiosUse.IncUse();
+	//Get participants, without blocking the mixer
+	std::shared_ptr<const Audios> audios = std::atomic_load(&participants);
 
 	//Find it
-	Audios::iterator it = audios.find(id);
+	Audios::const_iterator it = audios->find(id);
 
 	//If found
-	if (it!=audios.end())
+	if (it!=audios->end())
 		//Get vad
 		acuVAD = it->second->vad;
 
-	//Unlock
-	lstAudiosUse.DecUse();
-
 	//Return VAD acumulated
 	return acuVAD;
 }
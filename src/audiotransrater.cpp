@@ -46,6 +46,12 @@ int AudioTransrater::Open(DWORD inputRate, DWORD outputRate)
 	return 1;
 }
 
+void AudioTransrater::GetSharedFilters(DWORD* num, DWORD* bytes, DWORD* users)
+{
+	//Get them from resampler
+	mcu_resampler_get_shared_tables((spx_uint32_t*)num,(spx_uint32_t*)bytes,(spx_uint32_t*)users);
+}
+
 void AudioTransrater::Close()
 {
 	//Check if opened
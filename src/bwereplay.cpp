@@ -0,0 +1,157 @@
+#include <stdio.h>
+#include <vector>
+#include <algorithm>
+
+#include "config.h"
+#include "log.h"
+#include "SendSideBandwidthEstimation.h"
+
+/*
+ * Replays a transport wide feedback dump created with DTLSICETransport::DumpBWEStats
+ * through both send side estimators and prints the target bitrate of each one,
+ * together with the recorded one, after each feedback message.
+ */
+struct Entry
+{
+	uint64_t fb		= 0;
+	uint32_t seq		= 0;
+	uint32_t feedbackNum	= 0;
+	uint32_t size		= 0;
+	uint64_t sent		= 0;
+	uint64_t recv		= 0;
+	uint32_t target		= 0;
+	uint32_t rtt		= 0;
+	int	 mark		= 0;
+	int	 rtx		= 0;
+	int	 probing	= 0;
+};
+
+//Dump times are relative to first sent and first received packet, avoid 0 values
+constexpr uint64_t kTimeOffset = 1E6;
+
+int main(int argc, char** argv)
+{
+	if (argc<2)
+	{
+		fprintf(stderr,"usage: %s bwe.dump\n",argv[0]);
+		return 1;
+	}
+	
+	FILE* file = fopen(argv[1],"r");
+	
+	if (!file)
+	{
+		fprintf(stderr,"Could not open file %s\n",argv[1]);
+		return 1;
+	}
+	
+	std::vector<Entry> entries;
+	char line[1024];
+	
+	//Read all lines
+	while (fgets(line,sizeof(line),file))
+	{
+		Entry entry;
+		uint64_t deltaSent,deltaRecv,bwe,available;
+		int64_t delta;
+		//Parse them
+		if (sscanf(line,"%lu|%u|%u|%u|%lu|%lu|%lu|%lu|%ld|%lu|%u|%lu|%u|%d|%d|%d",
+			&entry.fb,&entry.seq,&entry.feedbackNum,&entry.size,&entry.sent,&entry.recv,
+			&deltaSent,&deltaRecv,&delta,&bwe,&entry.target,&available,&entry.rtt,
+			&entry.mark,&entry.rtx,&entry.probing)!=16)
+			//Skip
+			continue;
+		//Add it
+		entries.push_back(entry);
+	}
+	fclose(file);
+	
+	//Get sent packets in send order
+	std::vector<Entry> sent = entries;
+	std::stable_sort(sent.begin(),sent.end(),[](const Entry& a, const Entry& b) { return a.sent<b.sent; });
+	
+	SendSideBandwidthEstimation accumulatedDelay;
+	SendSideBandwidthEstimation delayGradient;
+	
+	//Set modes
+	accumulatedDelay.SetMode(SendSideBandwidthEstimation::AccumulatedDelay);
+	delayGradient.SetMode(SendSideBandwidthEstimation::DelayGradient);
+	
+	auto next = sent.begin();
+	uint32_t rtt = 0;
+	uint64_t num = 0;
+	uint64_t totalRecorded = 0;
+	uint64_t totalAccumulatedDelay = 0;
+	uint64_t totalDelayGradient = 0;
+	
+	printf("fb|recorded|accumulatedDelay|delayGradient\n");
+	
+	//For each feedback message, consecutive entries with same time and feedback number
+	for (auto it = entries.begin(); it!=entries.end(); )
+	{
+		uint64_t when = it->fb + kTimeOffset;
+		uint32_t feedbackNum = it->feedbackNum;
+		std::vector<std::pair<uint32_t,uint64_t>> packets;
+		
+		//Send all packets before the feedback
+		for (;next!=sent.end() && next->sent<=it->fb; ++next)
+		{
+			//Create stats
+			PacketStats stats(next->seq,0,0,next->size,0,0,next->sent + kTimeOffset,next->mark);
+			stats.rtx = next->rtx;
+			stats.probing = next->probing;
+			//Send them
+			accumulatedDelay.SentPacket(stats);
+			delayGradient.SentPacket(stats);
+		}
+		
+		//Update rtt as recorded
+		if (it->rtt!=rtt)
+		{
+			rtt = it->rtt;
+			accumulatedDelay.UpdateRTT(when,rtt);
+			delayGradient.UpdateRTT(when,rtt);
+		}
+		
+		//Recorded target for this feedback
+		uint32_t recorded = it->target;
+		
+		//Get all packets of the feedback, first received one is dumped as 0 too so it is seen as lost
+		for (;it!=entries.end() && it->fb + kTimeOffset==when && it->feedbackNum==feedbackNum; ++it)
+			packets.emplace_back(it->seq, it->recv ? it->recv + kTimeOffset : 0);
+		
+		//Run estimators
+		accumulatedDelay.ReceivedFeedback(feedbackNum,packets,when);
+		delayGradient.ReceivedFeedback(feedbackNum,packets,when);
+		
+		//Print results
+		printf("%lu|%u|%u|%u\n",
+			when - kTimeOffset,
+			recorded,
+			accumulatedDelay.GetTargetBitrate(),
+			delayGradient.GetTargetBitrate()
+		);
+		
+		//Summary
+		num++;
+		totalRecorded += recorded;
+		totalAccumulatedDelay += accumulatedDelay.GetTargetBitrate();
+		totalDelayGradient += delayGradient.GetTargetBitrate();
+	}
+	
+	//Check we have something
+	if (!num)
+	{
+		fprintf(stderr,"No feedback found on %s\n",argv[1]);
+		return 1;
+	}
+	
+	fprintf(stderr,"feedbacks:%lu avg recorded:%lubps accumulatedDelay:%lubps delayGradient:%lubps\n",
+		num,
+		totalRecorded/num,
+		totalAccumulatedDelay/num,
+		totalDelayGradient/num
+	);
+	
+	return 0;
+}
@@ -47,9 +47,9 @@
 #define	SEG_SHIFT	(4)		/* Left shift for segment number. */
 #define	SEG_MASK	(0x70)		/* Segment field mask. */
 
-static short seg_aend[8] = {0x1F, 0x3F, 0x7F, 0xFF,
+static const short seg_aend[8] = {0x1F, 0x3F, 0x7F, 0xFF,
 			    0x1FF, 0x3FF, 0x7FF, 0xFFF};
-static short seg_uend[8] = {0x3F, 0x7F, 0xFF, 0x1FF,
+static const short seg_uend[8] = {0x3F, 0x7F, 0xFF, 0x1FF,
 			    0x3FF, 0x7FF, 0xFFF, 0x1FFF};
 
 /* copy from CCITT G.711 specifications */
@@ -99,7 +99,7 @@ unsigned char _a2u[128] = {			/* A- to u-law conversions */
 static short
 search(
 	int		val,	//changed from "short" *drago*
-	short	*table,
+	const short	*table,
 	int		size)	//changed from "short" *drago*
 {
 	int		i;		//changed from "short" *drago*
@@ -307,3 +307,234 @@ ulaw2alaw(
 	return (unsigned char) ((uval & 0x80) ? (0xD5 ^ (_u2a[0xFF ^ uval] - 1)) :
 	    (unsigned char) (0x55 ^ (_u2a[0x7F ^ uval] - 1)));
 }
+
+/*
+ * Batch conversions
+ *
+ * Same algorithms as above on 16 bit lanes, without branches:
+ *  - The segment is the number of segment ends the magnitude is above.
+ *  - Variable right shifts are done as an unsigned high multiply by a power
+ *    of two halved once per segment.
+ *  - Variable left shifts on decode are a multiply by a power of two taken
+ *    from a byte shuffle on the segment number.
+ */
+#include <smmintrin.h>
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+static inline __m128i linear2ulaw_sse(__m128i pcm)
+{
+	//Get magnitude, clip and bias it
+	__m128i val = _mm_abs_epi16(_mm_srai_epi16(pcm,2));
+	val = _mm_add_epi16(_mm_min_epi16(val,_mm_set1_epi16(CLIP)),_mm_set1_epi16(BIAS>>2));
+	//Get segment and multiplier for shifting by segment+1
+	__m128i seg = _mm_setzero_si128();
+	__m128i mul = _mm_set1_epi16((short)0x8000);
+	for (int i=0;i<NSEGS;++i)
+	{
+		__m128i gt = _mm_cmpgt_epi16(val,_mm_set1_epi16(seg_uend[i]));
+		seg = _mm_sub_epi16(seg,gt);
+		mul = _mm_sub_epi16(mul,_mm_and_si128(_mm_srli_epi16(mul,1),gt));
+	}
+	//Combine segment and quantization bits, out of range values get the maximum
+	__m128i uval = _mm_or_si128(_mm_slli_epi16(seg,SEG_SHIFT),_mm_and_si128(_mm_mulhi_epu16(val,mul),_mm_set1_epi16(QUANT_MASK)));
+	uval = _mm_min_epi16(uval,_mm_set1_epi16(0x7F));
+	//Complement, without sign bit for negative values
+	return _mm_xor_si128(uval,_mm_xor_si128(_mm_set1_epi16(0xFF),_mm_and_si128(_mm_srai_epi16(pcm,15),_mm_set1_epi16(SIGN_BIT))));
+}
+
+static inline __m128i ulaw2linear_sse(__m128i uval)
+{
+	//Complement
+	uval = _mm_xor_si128(uval,_mm_set1_epi16(0xFF));
+	//Extract and bias the quantization bits
+	__m128i t = _mm_add_epi16(_mm_slli_epi16(_mm_and_si128(uval,_mm_set1_epi16(QUANT_MASK)),3),_mm_set1_epi16(BIAS));
+	//Shift up by the segment number, high byte index has msb set so it is zeroed
+	__m128i seg = _mm_or_si128(_mm_and_si128(_mm_srli_epi16(uval,SEG_SHIFT),_mm_set1_epi16(0x07)),_mm_set1_epi16((short)0x8000));
+	t = _mm_mullo_epi16(t,_mm_shuffle_epi8(_mm_setr_epi8(1,2,4,8,16,32,64,(char)128,0,0,0,0,0,0,0,0),seg));
+	//Remove bias and apply sign
+	t = _mm_sub_epi16(t,_mm_set1_epi16(BIAS));
+	__m128i neg = _mm_srai_epi16(_mm_slli_epi16(uval,8),15);
+	return _mm_sub_epi16(_mm_xor_si128(t,neg),neg);
+}
+
+static inline __m128i linear2alaw_sse(__m128i pcm)
+{
+	//Get magnitude, -pcm-1 for negative values
+	__m128i sign = _mm_srai_epi16(pcm,15);
+	__m128i val = _mm_xor_si128(_mm_srai_epi16(pcm,3),sign);
+	//Get segment and multiplier for shifting by segment, or 1 on first two
+	__m128i seg = _mm_sub_epi16(_mm_setzero_si128(),_mm_cmpgt_epi16(val,_mm_set1_epi16(seg_aend[0])));
+	__m128i mul = _mm_set1_epi16((short)0x8000);
+	for (int i=1;i<NSEGS;++i)
+	{
+		__m128i gt = _mm_cmpgt_epi16(val,_mm_set1_epi16(seg_aend[i]));
+		seg = _mm_sub_epi16(seg,gt);
+		mul = _mm_sub_epi16(mul,_mm_and_si128(_mm_srli_epi16(mul,1),gt));
+	}
+	//Combine segment and quantization bits
+	__m128i aval = _mm_or_si128(_mm_slli_epi16(seg,SEG_SHIFT),_mm_and_si128(_mm_mulhi_epu16(val,mul),_mm_set1_epi16(QUANT_MASK)));
+	//Toggle even bits, and set sign bit for positive values
+	return _mm_xor_si128(aval,_mm_xor_si128(_mm_set1_epi16(0xD5),_mm_and_si128(sign,_mm_set1_epi16(SIGN_BIT))));
+}
+
+static inline __m128i alaw2linear_sse(__m128i aval)
+{
+	//Toggle even bits
+	aval = _mm_xor_si128(aval,_mm_set1_epi16(0x55));
+	//Get segment
+	__m128i seg = _mm_and_si128(_mm_srli_epi16(aval,SEG_SHIFT),_mm_set1_epi16(0x07));
+	//Quantization bits with 8 bias, plus 0x100 when segment is not 0
+	__m128i t = _mm_add_epi16(_mm_slli_epi16(_mm_and_si128(aval,_mm_set1_epi16(QUANT_MASK)),4),_mm_set1_epi16(8));
+	t = _mm_add_epi16(t,_mm_and_si128(_mm_cmpgt_epi16(seg,_mm_setzero_si128()),_mm_set1_epi16(0x100)));
+	//Shift up by the segment number minus one, high byte index has msb set so it is zeroed
+	t = _mm_mullo_epi16(t,_mm_shuffle_epi8(_mm_setr_epi8(1,1,2,4,8,16,32,64,0,0,0,0,0,0,0,0),_mm_or_si128(seg,_mm_set1_epi16((short)0x8000))));
+	//Negative when sign bit is not set
+	__m128i neg = _mm_cmpeq_epi16(_mm_and_si128(aval,_mm_set1_epi16(SIGN_BIT)),_mm_setzero_si128());
+	return _mm_sub_epi16(_mm_xor_si128(t,neg),neg);
+}
+
+#ifdef __AVX2__
+static inline __m256i linear2ulaw_avx2(__m256i pcm)
+{
+	//Get magnitude, clip and bias it
+	__m256i val = _mm256_abs_epi16(_mm256_srai_epi16(pcm,2));
+	val = _mm256_add_epi16(_mm256_min_epi16(val,_mm256_set1_epi16(CLIP)),_mm256_set1_epi16(BIAS>>2));
+	//Get segment and multiplier for shifting by segment+1
+	__m256i seg = _mm256_setzero_si256();
+	__m256i mul = _mm256_set1_epi16((short)0x8000);
+	for (int i=0;i<NSEGS;++i)
+	{
+		__m256i gt = _mm256_cmpgt_epi16(val,_mm256_set1_epi16(seg_uend[i]));
+		seg = _mm256_sub_epi16(seg,gt);
+		mul = _mm256_sub_epi16(mul,_mm256_and_si256(_mm256_srli_epi16(mul,1),gt));
+	}
+	//Combine segment and quantization bits, out of range values get the maximum
+	__m256i uval = _mm256_or_si256(_mm256_slli_epi16(seg,SEG_SHIFT),_mm256_and_si256(_mm256_mulhi_epu16(val,mul),_mm256_set1_epi16(QUANT_MASK)));
+	uval = _mm256_min_epi16(uval,_mm256_set1_epi16(0x7F));
+	//Complement, without sign bit for negative values
+	return _mm256_xor_si256(uval,_mm256_xor_si256(_mm256_set1_epi16(0xFF),_mm256_and_si256(_mm256_srai_epi16(pcm,15),_mm256_set1_epi16(SIGN_BIT))));
+}
+
+static inline __m256i ulaw2linear_avx2(__m256i uval)
+{
+	//Complement
+	uval = _mm256_xor_si256(uval,_mm256_set1_epi16(0xFF));
+	//Extract and bias the quantization bits
+	__m256i t = _mm256_add_epi16(_mm256_slli_epi16(_mm256_and_si256(uval,_mm256_set1_epi16(QUANT_MASK)),3),_mm256_set1_epi16(BIAS));
+	//Shift up by the segment number, high byte index has msb set so it is zeroed
+	__m256i seg = _mm256_or_si256(_mm256_and_si256(_mm256_srli_epi16(uval,SEG_SHIFT),_mm256_set1_epi16(0x07)),_mm256_set1_epi16((short)0x8000));
+	t = _mm256_mullo_epi16(t,_mm256_shuffle_epi8(_mm256_setr_epi8(1,2,4,8,16,32,64,(char)128,0,0,0,0,0,0,0,0,1,2,4,8,16,32,64,(char)128,0,0,0,0,0,0,0,0),seg));
+	//Remove bias and apply sign
+	t = _mm256_sub_epi16(t,_mm256_set1_epi16(BIAS));
+	__m256i neg = _mm256_srai_epi16(_mm256_slli_epi16(uval,8),15);
+	return _mm256_sub_epi16(_mm256_xor_si256(t,neg),neg);
+}
+
+static inline __m256i linear2alaw_avx2(__m256i pcm)
+{
+	//Get magnitude, -pcm-1 for negative values
+	__m256i sign = _mm256_srai_epi16(pcm,15);
+	__m256i val = _mm256_xor_si256(_mm256_srai_epi16(pcm,3),sign);
+	//Get segment and multiplier for shifting by segment, or 1 on first two
+	__m256i seg = _mm256_sub_epi16(_mm256_setzero_si256(),_mm256_cmpgt_epi16(val,_mm256_set1_epi16(seg_aend[0])));
+	__m256i mul = _mm256_set1_epi16((short)0x8000);
+	for (int i=1;i<NSEGS;++i)
+	{
+		__m256i gt = _mm256_cmpgt_epi16(val,_mm256_set1_epi16(seg_aend[i]));
+		seg = _mm256_sub_epi16(seg,gt);
+		mul = _mm256_sub_epi16(mul,_mm256_and_si256(_mm256_srli_epi16(mul,1),gt));
+	}
+	//Combine segment and quantization bits
+	__m256i aval = _mm256_or_si256(_mm256_slli_epi16(seg,SEG_SHIFT),_mm256_and_si256(_mm256_mulhi_epu16(val,mul),_mm256_set1_epi16(QUANT_MASK)));
+	//Toggle even bits, and set sign bit for positive values
+	return _mm256_xor_si256(aval,_mm256_xor_si256(_mm256_set1_epi16(0xD5),_mm256_and_si256(sign,_mm256_set1_epi16(SIGN_BIT))));
+}
+
+static inline __m256i alaw2linear_avx2(__m256i aval)
+{
+	//Toggle even bits
+	aval = _mm256_xor_si256(aval,_mm256_set1_epi16(0x55));
+	//Get segment
+	__m256i seg = _mm256_and_si256(_mm256_srli_epi16(aval,SEG_SHIFT),_mm256_set1_epi16(0x07));
+	//Quantization bits with 8 bias, plus 0x100 when segment is not 0
+	__m256i t = _mm256_add_epi16(_mm256_slli_epi16(_mm256_and_si256(aval,_mm256_set1_epi16(QUANT_MASK)),4),_mm256_set1_epi16(8));
+	t = _mm256_add_epi16(t,_mm256_and_si256(_mm256_cmpgt_epi16(seg,_mm256_setzero_si256()),_mm256_set1_epi16(0x100)));
+	//Shift up by the segment number minus one, high byte index has msb set so it is zeroed
+	t = _mm256_mullo_epi16(t,_mm256_shuffle_epi8(_mm256_setr_epi8(1,1,2,4,8,16,32,64,0,0,0,0,0,0,0,0,1,1,2,4,8,16,32,64,0,0,0,0,0,0,0,0),_mm256_or_si256(seg,_mm256_set1_epi16((short)0x8000))));
+	//Negative when sign bit is not set
+	__m256i neg = _mm256_cmpeq_epi16(_mm256_and_si256(aval,_mm256_set1_epi16(SIGN_BIT)),_mm256_setzero_si256());
+	return _mm256_sub_epi16(_mm256_xor_si256(t,neg),neg);
+}
+
+//Pack 16 codes on 16 bit lanes into bytes
+static inline void store_codes_avx2(unsigned char* out, __m256i codes)
+{
+	_mm_storeu_si128((__m128i*)out,_mm_packus_epi16(_mm256_castsi256_si128(codes),_mm256_extracti128_si256(codes,1)));
+}
+#endif
+
+void linear2ulaw_block(const short* pcm, unsigned char* out, int len)
+{
+	int i = 0;
+#ifdef __AVX2__
+	//16 samples at a time
+	for (;i+16<=len;i+=16)
+		store_codes_avx2(out+i,linear2ulaw_avx2(_mm256_loadu_si256((const __m256i*)(pcm+i))));
+#endif
+	//8 samples at a time
+	for (;i+8<=len;i+=8)
+		_mm_storel_epi64((__m128i*)(out+i),_mm_packus_epi16(linear2ulaw_sse(_mm_loadu_si128((const __m128i*)(pcm+i))),_mm_setzero_si128()));
+	//Remaining
+	for (;i<len;++i)
+		out[i] = linear2ulaw(pcm[i]);
+}
+
+void ulaw2linear_block(const unsigned char* in, short* pcm, int len)
+{
+	int i = 0;
+#ifdef __AVX2__
+	//16 samples at a time
+	for (;i+16<=len;i+=16)
+		_mm256_storeu_si256((__m256i*)(pcm+i),ulaw2linear_avx2(_mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)(in+i)))));
+#endif
+	//8 samples at a time
+	for (;i+8<=len;i+=8)
+		_mm_storeu_si128((__m128i*)(pcm+i),ulaw2linear_sse(_mm_cvtepu8_epi16(_mm_loadl_epi64((const __m128i*)(in+i)))));
+	//Remaining
+	for (;i<len;++i)
+		pcm[i] = ulaw2linear(in[i]);
+}
+
+void linear2alaw_block(const short* pcm, unsigned char* out, int len)
+{
+	int i = 0;
+#ifdef __AVX2__
+	//16 samples at a time
+	for (;i+16<=len;i+=16)
+		store_codes_avx2(out+i,linear2alaw_avx2(_mm256_loadu_si256((const __m256i*)(pcm+i))));
+#endif
+	//8 samples at a time
+	for (;i+8<=len;i+=8)
+		_mm_storel_epi64((__m128i*)(out+i),_mm_packus_epi16(linear2alaw_sse(_mm_loadu_si128((const __m128i*)(pcm+i))),_mm_setzero_si128()));
+	//Remaining
+	for (;i<len;++i)
+		out[i] = linear2alaw(pcm[i]);
+}
+
+void alaw2linear_block(const unsigned char* in, short* pcm, int len)
+{
+	int i = 0;
+#ifdef __AVX2__
+	//16 samples at a time
+	for (;i+16<=len;i+=16)
+		_mm256_storeu_si256((__m256i*)(pcm+i),alaw2linear_avx2(_mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i*)(in+i)))));
+#endif
+	//8 samples at a time
+	for (;i+8<=len;i+=8)
+		_mm_storeu_si128((__m128i*)(pcm+i),alaw2linear_sse(_mm_cvtepu8_epi16(_mm_loadl_epi64((const __m128i*)(in+i)))));
+	//Remaining
+	for (;i<len;++i)
+		pcm[i] = alaw2linear(in[i]);
+}
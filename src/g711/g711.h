@@ -46,4 +46,13 @@ unsigned char alaw2ulaw(unsigned char aval);
 */
 unsigned char ulaw2alaw(unsigned char uval);
 
+/*
+** Batch conversions of len samples, bit exact with the ones above.
+** SSE4.1, or AVX2 when available, with a scalar tail so any length is accepted.
+*/
+void linear2alaw_block(const short* pcm, unsigned char* out, int len);
+void alaw2linear_block(const unsigned char* in, short* pcm, int len);
+void linear2ulaw_block(const short* pcm, unsigned char* out, int len);
+void ulaw2linear_block(const unsigned char* in, short* pcm, int len);
+
 #endif
\ No newline at end of file
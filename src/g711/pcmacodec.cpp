@@ -32,8 +32,7 @@ int PCMAEncoder::Encode (SWORD *in,int inLen,BYTE* out,int outLen)
 		return 0;
 
 	//Y codificamos
-	for (int j = 0; j< inLen ;j++)
-		out[j]=linear2alaw(in[j]);
+	linear2alaw_block(in,out,inLen);
 
 	return inLen;
 }
@@ -45,8 +44,7 @@ int PCMADecoder::Decode (const BYTE *in,int inLen,SWORD* out,int outLen)
 		return 0;
 
 	//Decodificamos
-	for (int j = 0; j< inLen ;j++)
-		out[j]=alaw2linear(in[j]);
+	alaw2linear_block(in,out,inLen);
 
 	return inLen;	
 }
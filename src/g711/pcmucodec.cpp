@@ -31,8 +31,7 @@ int PCMUEncoder::Encode (SWORD *in,int inLen,BYTE* out,int outLen)
 		return 0;
 
 	//Y codificamos
-	for (int j = 0; j< inLen ;j++)
-		out[j]=linear2ulaw(in[j]);
+	linear2ulaw_block(in,out,inLen);
 
 	return inLen;
 }
@@ -44,8 +43,7 @@ int PCMUDecoder::Decode (const BYTE *in,int inLen,SWORD* out,int outLen)
 		return 0;
 
 	//Decodificamos
-	for (int j = 0; j< inLen ;j++)
-		out[j]=ulaw2linear(in[j]);
+	ulaw2linear_block(in,out,inLen);
 
 	return inLen;	
 }
@@ -30,6 +30,7 @@
 #include <stdlib.h>
 
 #include "g722_enc_dec.h"
+#include "g722_qmf.h"
 
 #if !defined(FALSE)
 #define FALSE 0
@@ -228,10 +229,6 @@ size_t g722_decode(G722DecoderState *s, int16_t amp[],
            1688,   1360,   1040,    728,
             432,    136,   -432,   -136
     };
-    static const int qmf_coeffs[12] =
-    {
-           3,  -11,   12,   32, -210,  951, 3876, -805,  362, -156,   53,  -11,
-    };
 
     int dlowt;
     int rlow;
@@ -247,9 +244,18 @@ size_t g722_decode(G722DecoderState *s, int16_t amp[],
     size_t outlen;
     int i;
     size_t j;
+    /* Sum and difference of the even and odd tap accumulators */
+    int sum;
+    int diff;
+    /* Sliding QMF history, only moved back to the start when it is full */
+    int16_t hist[G722_QMF_TAPS - 2 + G722_QMF_BLOCK];
+    int pos;
 
     outlen = 0;
     rhigh = 0;
+    for (i = 0;  i < G722_QMF_TAPS - 2;  i++)
+        hist[i] = (int16_t) s->x[i + 2];
+    pos = G722_QMF_TAPS - 2;
     for (j = 0;  j < len;  )
     {
         if (s->packed)
@@ -368,18 +374,18 @@ size_t g722_decode(G722DecoderState *s, int16_t amp[],
             else
             {
                 /* Apply the receive QMF */
-                for (i = 0;  i < 22;  i++)
-                    s->x[i] = s->x[i + 2];
-                s->x[22] = rlow + rhigh;
-                s->x[23] = rlow - rhigh;
-
-                xout1 = 0;
-                xout2 = 0;
-                for (i = 0;  i < 12;  i++)
+                if (pos == G722_QMF_TAPS - 2 + G722_QMF_BLOCK)
                 {
-                    xout2 += s->x[2*i]*qmf_coeffs[i];
-                    xout1 += s->x[2*i + 1]*qmf_coeffs[11 - i];
+                    memmove(hist, hist + G722_QMF_BLOCK, (G722_QMF_TAPS - 2)*sizeof(hist[0]));
+                    pos = G722_QMF_TAPS - 2;
                 }
+                hist[pos++] = (int16_t) (rlow + rhigh);
+                hist[pos++] = (int16_t) (rlow - rhigh);
+
+                g722_qmf(hist + pos - G722_QMF_TAPS, &sum, &diff);
+                /* Both are exact, x[2i] taps cancel out on sum + diff and x[2i + 1] ones on sum - diff */
+                xout1 = (sum + diff) >> 1;
+                xout2 = (sum - diff) >> 1;
                 /* We shift by 12 to allow for the QMF filters (DC gain = 4096), less 1
                    to allow for the 15 bit input to the G.722 algorithm. */
                 /* , tlegrand: added saturation */
@@ -388,6 +394,12 @@ size_t g722_decode(G722DecoderState *s, int16_t amp[],
             }
         }
     }
+    if (pos > G722_QMF_TAPS - 2)
+    {
+        /* Keep the last 24 samples for the next block */
+        for (i = 0;  i < G722_QMF_TAPS;  i++)
+            s->x[i] = hist[pos - G722_QMF_TAPS + i];
+    }
     return outlen;
 }
 /*- End of function --------------------------------------------------------*/
@@ -35,6 +35,7 @@
 #include <stdlib.h>
 
 #include "g722_enc_dec.h"
+#include "g722_qmf.h"
 
 #if !defined(FALSE)
 #define FALSE 0
@@ -248,10 +249,6 @@ size_t g722_encode(G722EncoderState *s, uint8_t g722_data[],
     {
         -7408,  -1616,   7408,   1616
     };
-    static const int qmf_coeffs[12] =
-    {
-           3,  -11,   12,   32, -210,  951, 3876, -805,  362, -156,   53,  -11,
-    };
     static const int ihn[3] = {0, 1, 0};
     static const int ihp[3] = {0, 3, 2};
     static const int wh[3] = {0, -214, 798};
@@ -275,15 +272,28 @@ size_t g722_encode(G722EncoderState *s, uint8_t g722_data[],
     int xlow;
     int xhigh;
     size_t g722_bytes;
-    /* Even and odd tap accumulators */
-    int sumeven;
-    int sumodd;
+    /* Sum and difference of the even and odd tap accumulators */
+    int sum;
+    int diff;
     int ihigh;
     int ilow;
     int code;
+    int qmf;
+    /* Previous samples followed by the first ones of this block, so the QMF
+       window can be read from it until it is fully inside amp */
+    int16_t hist[2*G722_QMF_TAPS - 4] = {0};
+    const int16_t *x;
 
     g722_bytes = 0;
     xhigh = 0;
+    qmf = !s->itu_test_mode  &&  !s->eight_k;
+    if (qmf)
+    {
+        for (i = 0;  i < G722_QMF_TAPS - 2;  i++)
+            hist[i] = (int16_t) s->x[i + 2];
+        for (i = 0;  i < G722_QMF_TAPS - 2  &&  i < (int) len;  i++)
+            hist[G722_QMF_TAPS - 2 + i] = amp[i];
+    }
     for (j = 0;  j < len;  )
     {
         if (s->itu_test_mode)
@@ -300,26 +310,17 @@ size_t g722_encode(G722EncoderState *s, uint8_t g722_data[],
             }
             else
             {
-                /* Apply the transmit QMF */
-                /* Shuffle the buffer down */
-                for (i = 0;  i < 22;  i++)
-                    s->x[i] = s->x[i + 2];
-                s->x[22] = amp[j++];
-                s->x[23] = amp[j++];
+                /* Apply the transmit QMF on the last 24 samples */
+                x = (j < G722_QMF_TAPS - 2)  ?  hist + j  :  amp + j - (G722_QMF_TAPS - 2);
+                j += 2;
 
                 /* Discard every other QMF output */
-                sumeven = 0;
-                sumodd = 0;
-                for (i = 0;  i < 12;  i++)
-                {
-                    sumodd += s->x[2*i]*qmf_coeffs[i];
-                    sumeven += s->x[2*i + 1]*qmf_coeffs[11 - i];
-                }
+                g722_qmf(x, &sum, &diff);
                 /* We shift by 12 to allow for the QMF filters (DC gain = 4096), plus 1
                    to allow for us summing two filters, plus 1 to allow for the 15 bit
                    input to the G.722 algorithm. */
-                xlow = (sumeven + sumodd) >> 14;
-                xhigh = (sumeven - sumodd) >> 14;
+                xlow = sum >> 14;
+                xhigh = diff >> 14;
 
 #ifdef RUN_LIKE_REFERENCE_G722
                 /* The following lines are only used to verify bit-exactness
@@ -423,6 +424,22 @@ size_t g722_encode(G722EncoderState *s, uint8_t g722_data[],
             g722_data[g722_bytes++] = (uint8_t) code;
         }
     }
+    if (qmf)
+    {
+        /* Keep the last 24 samples for the next block */
+        if (len >= G722_QMF_TAPS)
+        {
+            for (i = 0;  i < G722_QMF_TAPS;  i++)
+                s->x[i] = amp[len - G722_QMF_TAPS + i];
+        }
+        else
+        {
+            for (i = 0;  i < G722_QMF_TAPS - (int) len;  i++)
+                s->x[i] = s->x[i + len];
+            for (i = 0;  i < (int) len;  i++)
+                s->x[G722_QMF_TAPS - len + i] = amp[i];
+        }
+    }
     return g722_bytes;
 }
 /*- End of function --------------------------------------------------------*/
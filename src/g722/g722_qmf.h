@@ -0,0 +1,77 @@
+/*
+ * g722_qmf.h - The G.722 transmit and receive QMF on 16 bit samples.
+ *
+ * The 24 tap band split filters are computed as two dot products of the
+ * last 24 samples, so the history does not need to be shuffled on every
+ * sample pair and the taps can be multiplied pairwise with SIMD. Results
+ * are bit exact with the scalar filters.
+ */
+
+/*! \file */
+
+#if !defined(_G722_QMF_H_)
+#define _G722_QMF_H_
+
+#include <stdint.h>
+#if defined(__SSSE3__)
+#include <tmmintrin.h>
+#endif
+
+#define G722_QMF_TAPS 24
+/* Samples filtered between moves of a sliding history */
+#define G722_QMF_BLOCK 320
+
+/* The QMF coefficients c[i] on even taps and c[11 - i] on odd ones, so
+   sum = sumodd + sumeven, and negated on even taps, so diff = sumeven - sumodd */
+static const int16_t g722_qmf_sum[G722_QMF_TAPS] =
+{
+       3,  -11,  -11,   53,   12, -156,   32,  362, -210, -805,  951, 3876,
+    3876,  951, -805, -210,  362,   32, -156,   12,   53,  -11,  -11,    3
+};
+static const int16_t g722_qmf_diff[G722_QMF_TAPS] =
+{
+      -3,  -11,   11,   53,  -12, -156,  -32,  362,  210, -805, -951, 3876,
+   -3876,  951,  805, -210, -362,   32,  156,   12,  -53,  -11,   11,    3
+};
+
+static __inline void g722_qmf(const int16_t x[G722_QMF_TAPS], int *sum, int *diff)
+{
+#if defined(__SSSE3__)
+    __m128i a;
+    __m128i d;
+    __m128i v;
+    int i;
+
+    a = _mm_setzero_si128();
+    d = _mm_setzero_si128();
+    for (i = 0;  i < G722_QMF_TAPS;  i += 8)
+    {
+        v = _mm_loadu_si128((const __m128i *) (x + i));
+        a = _mm_add_epi32(a, _mm_madd_epi16(v, _mm_loadu_si128((const __m128i *) (g722_qmf_sum + i))));
+        d = _mm_add_epi32(d, _mm_madd_epi16(v, _mm_loadu_si128((const __m128i *) (g722_qmf_diff + i))));
+    }
+    /* Reduce both accumulators at once */
+    a = _mm_hadd_epi32(a, d);
+    a = _mm_hadd_epi32(a, a);
+    *sum = _mm_cvtsi128_si32(a);
+    *diff = _mm_cvtsi128_si32(_mm_srli_si128(a, 4));
+#else
+    int a;
+    int d;
+    int i;
+
+    a = 0;
+    d = 0;
+    for (i = 0;  i < G722_QMF_TAPS;  i++)
+    {
+        a += x[i]*g722_qmf_sum[i];
+        d += x[i]*g722_qmf_diff[i];
+    }
+    *sum = a;
+    *diff = d;
+#endif
+}
+/*- End of function --------------------------------------------------------*/
+
+#endif
+/*- End of file ------------------------------------------------------------*/
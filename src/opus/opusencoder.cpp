@@ -7,6 +7,8 @@
 #include "opusencoder.h"
 #include "log.h"
 
+#include <algorithm>
+
 OpusEncoder::OpusEncoder(const Properties &properties)
 {
 	int error;
@@ -18,6 +20,13 @@ OpusEncoder::OpusEncoder(const Properties &properties)
 	numFrameSamples = rate * 20 / 1000;
 	//Set default mode
 	mode = properties.GetProperty("opus.application.audio",false) ? OPUS_APPLICATION_VOIP : OPUS_APPLICATION_AUDIO;
+	//Always use FEC, or enable it when there are losses
+	inbandfec = properties.GetProperty("opus.inbandfec",false);
+	fec = inbandfec;
+	//Do not send silence
+	dtx = properties.GetProperty("opus.dtx",false);
+	//No losses yet
+	loss = 0;
 
 	//Open encoder
 	enc = opus_encoder_create(rate, 1, mode, &error);
@@ -26,8 +35,43 @@ OpusEncoder::OpusEncoder(const Properties &properties)
 	if (!enc || error)
 		Error("Could not open OPUS encoder");
 
+	//Configure it
+	Configure();
+}
+
+void OpusEncoder::Configure()
+{
+	//Check encoder
+	if (!enc)
+		return;
 	//Enable FEC
-	opus_encoder_ctl(enc, OPUS_SET_INBAND_FEC(properties.GetProperty("opus.inbandfec",false)));
+	opus_encoder_ctl(enc, OPUS_SET_INBAND_FEC(fec));
+	//Expected loss, so FEC is given enough bits
+	opus_encoder_ctl(enc, OPUS_SET_PACKET_LOSS_PERC(loss));
+	//Discontinuous transmission
+	opus_encoder_ctl(enc, OPUS_SET_DTX(dtx));
+}
+
+void OpusEncoder::SetPacketLoss(BYTE fractionLost)
+{
+	//Get loss percentage
+	BYTE percent = std::min<DWORD>(fractionLost*100/256,kMaxFECLoss);
+	//Enable FEC only if there are losses
+	bool enabled = inbandfec || fractionLost>=kMinFECLoss;
+
+	//If nothing changed
+	if (percent==loss && enabled==fec)
+		//Done
+		return;
+
+	Debug("-OpusEncoder::SetPacketLoss() [loss:%u%%,fec:%d]\n",percent,enabled);
+
+	//Store new values
+	loss = percent;
+	fec = enabled;
+
+	//Update encoder
+	Configure();
 }
 
 DWORD OpusEncoder::TrySetRate(DWORD rate)
@@ -48,8 +92,8 @@ DWORD OpusEncoder::TrySetRate(DWORD rate)
 		numFrameSamples = rate * 20 / 1000;
 	}
 
-	//Enable FEC
-	opus_encoder_ctl(enc, OPUS_SET_INBAND_FEC(0));
+	//Keep configuration on new encoder
+	Configure();
 
 	//Return new rate
 	return this->rate;
@@ -63,5 +107,12 @@ OpusEncoder::~OpusEncoder()
 
 int OpusEncoder::Encode(SWORD *in,int inLen,BYTE* out,int outLen)
 {
-	return opus_encode(enc,in,inLen,out,outLen);
+	//Encode
+	int len = opus_encode(enc,in,inLen,out,outLen);
+	//Packets of 2 bytes or less do not need to be sent while in DTX
+	if (dtx && len>0 && len<=2)
+		//Nothing to send
+		return 0;
+	//Return encoded size
+	return len;
 }
@@ -13,6 +13,11 @@
 
 class OpusEncoder : public AudioEncoder
 {
+public:
+	//Loss over which in-band FEC is enabled, in 1/256 units as in RTCP reports
+	static constexpr BYTE kMinFECLoss = 3;
+	//Maximum loss to protect against, in percent
+	static constexpr BYTE kMaxFECLoss = 30;
 public:
 	OpusEncoder(const Properties &properties);
 	virtual ~OpusEncoder();
@@ -20,10 +25,21 @@ public:
 	virtual DWORD TrySetRate(DWORD rate);
 	virtual DWORD GetRate()			{ return rate;	}
 	virtual DWORD GetClockRate()		{ return 48000;	}
+
+	//Adapt in-band FEC to the loss reported by the receivers
+	void SetPacketLoss(BYTE fractionLost);
+	bool IsFECEnabled() const		{ return fec;	}
+	bool IsDTXEnabled() const		{ return dtx;	}
+private:
+	void Configure();
 private:
 	OpusEncoder *enc;
 	DWORD rate;
 	int mode;
+	bool inbandfec;
+	bool fec;
+	bool dtx;
+	BYTE loss;
 };
 
 #endif	/* OPUSENCODER_H */
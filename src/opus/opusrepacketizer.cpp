@@ -0,0 +1,407 @@
+#include "opusrepacketizer.h"
+#include "log.h"
+
+#include <string.h>
+#include <algorithm>
+
+OpusRepacketizer::OpusRepacketizer() :
+	packet(AudioCodec::OPUS)
+{
+	//Reserve space for a full packet
+	data.reserve(kMaxPacketSize);
+	lengths.reserve(kMaxFrames);
+}
+
+void OpusRepacketizer::SetMaxFrames(DWORD maxFrames)
+{
+	//Check if there is any change
+	if (this->maxFrames==maxFrames)
+		return;
+
+	Debug("-OpusRepacketizer::SetMaxFrames() [from:%u,to:%u]\n",this->maxFrames,maxFrames);
+
+	//Store it within limits
+	this->maxFrames = std::min(std::max(maxFrames,1u),kMaxFrames);
+
+	//If we already have enough
+	if (lengths.size()>=this->maxFrames)
+		//Do not wait for more
+		Flush();
+}
+
+void OpusRepacketizer::onMediaFrame(const MediaFrame &frame)
+{
+	const BYTE* frames[kMaxFrames];
+	WORD sizes[kMaxFrames];
+
+	//Check we have someone to send it to
+	if (!listener)
+		return;
+
+	//Update stats
+	received++;
+
+	//Only opus frames with known duration can be combined
+	bool opus = frame.GetType()==MediaFrame::Audio && ((const AudioFrame&)frame).GetCodec()==AudioCodec::OPUS && frame.GetDuration();
+
+	//Get frames
+	DWORD num = opus ? Parse(frame.GetData(),frame.GetLength(),frames,sizes,kMaxFrames) : 0;
+
+	//If not combining it
+	if (maxFrames<=1 || !num)
+	{
+		//Send pending ones first, so order is kept
+		Flush();
+		//Forward unchanged
+		listener->onMediaFrame(frame);
+		//Update stats
+		sent++;
+		//Done
+		return;
+	}
+
+	//Get configuration of the frames, all of them share it
+	BYTE config = frame.GetData()[0] & 0xFC;
+	//Get duration
+	DWORD frameDuration = GetFrameDuration(config)*num;
+	//Get total size of the frames
+	DWORD bytes = 0;
+	for (DWORD i=0;i<num;++i)
+		bytes += sizes[i];
+
+	//If they can not be added to pending ones
+	if (!lengths.empty() && (
+		config!=toc ||
+		frame.GetTimeStamp()!=end ||
+		lengths.size()+num>maxFrames ||
+		duration+frameDuration>kMaxDuration ||
+		//TOC, frame count and up to two bytes per frame length
+		2+(lengths.size()+num)*2+data.size()+bytes>kMaxPacketSize))
+		//Send them first
+		Flush();
+
+	//If it is the first one
+	if (lengths.empty())
+	{
+		//Packet starts with it
+		toc		= config;
+		timestamp	= frame.GetTimeStamp();
+		time		= frame.GetTime();
+		clockRate	= frame.GetClockRate();
+	}
+
+	//Append frames
+	for (DWORD i=0;i<num;++i)
+	{
+		//Add data
+		data.insert(data.end(),frames[i],frames[i]+sizes[i]);
+		//And length
+		lengths.push_back(sizes[i]);
+	}
+
+	//Update duration
+	duration += frameDuration;
+	//Next frame should start at
+	end = frame.GetTimeStamp()+frame.GetDuration();
+
+	//If it is full
+	if (lengths.size()>=maxFrames)
+		//Send it
+		Flush();
+}
+
+void OpusRepacketizer::Flush()
+{
+	const BYTE* frames[kMaxFrames];
+
+	//Check if we have anything
+	if (lengths.empty())
+		return;
+
+	//Get frame pointers
+	const BYTE* ptr = data.data();
+	for (DWORD i=0;i<lengths.size();++i)
+	{
+		//Set it
+		frames[i] = ptr;
+		//Move to next
+		ptr += lengths[i];
+	}
+
+	//Write packet
+	DWORD size = Pack(toc,frames,lengths.data(),lengths.size(),packet.GetData(),packet.GetMaxMediaLength());
+
+	//If it fits
+	if (size)
+	{
+		//Set length
+		packet.SetLength(size);
+		//Set timing of the first frame
+		packet.SetClockRate(clockRate);
+		packet.SetTimestamp(timestamp);
+		packet.SetTime(time);
+		//Set duration of all of them
+		packet.SetDuration(end-timestamp);
+		//Clear rtp
+		packet.ClearRTPPacketizationInfo();
+		//Single rtp packet
+		packet.AddRtpPacket(0,size,NULL,0);
+		//Send it
+		listener->onMediaFrame(packet);
+		//Update stats
+		sent++;
+	} else {
+		//Should not happen
+		Error("-OpusRepacketizer::Flush() could not pack frames [num:%u,size:%u]\n",lengths.size(),data.size());
+	}
+
+	//Clean
+	Reset();
+}
+
+void OpusRepacketizer::Reset()
+{
+	//Drop pending frames
+	data.clear();
+	lengths.clear();
+	duration = 0;
+}
+
+static inline bool ReadLength(const BYTE*& data, DWORD& size, WORD& length)
+{
+	//Check
+	if (!size)
+		return false;
+	//One byte lengths
+	if (data[0]<252)
+	{
+		length = data[0];
+		data++;
+		size--;
+		return true;
+	}
+	//Two bytes
+	if (size<2)
+		return false;
+	length = data[1]*4 + data[0];
+	data += 2;
+	size -= 2;
+	return true;
+}
+
+static inline DWORD WriteLength(BYTE* data, WORD length)
+{
+	//One byte lengths
+	if (length<252)
+	{
+		data[0] = length;
+		return 1;
+	}
+	//Two bytes
+	data[0] = 252 + (length & 0x03);
+	data[1] = (length - data[0]) >> 2;
+	return 2;
+}
+
+DWORD OpusRepacketizer::Parse(const BYTE* data, DWORD size, const BYTE* frames[], WORD lengths[], DWORD max)
+{
+	/*
+	 * RFC 6716 3.1
+		0 1 2 3 4 5 6 7
+	       +-+-+-+-+-+-+-+-+
+	       | config  |s| c |
+	       +-+-+-+-+-+-+-+-+
+	 */
+	//Check toc and max packet size
+	if (!size || size>kMaxFrames*kMaxFrameSize)
+		return 0;
+
+	//Get frame count code
+	BYTE code = data[0] & 0x03;
+	//Skip toc
+	data++;
+	size--;
+
+	DWORD num = 0;
+
+	//Depending on code
+	switch (code)
+	{
+		case 0:
+			//One frame
+			num = 1;
+			lengths[0] = size;
+			break;
+		case 1:
+			//Two equal frames
+			if (size%2)
+				return 0;
+			num = 2;
+			lengths[0] = lengths[1] = size/2;
+			break;
+		case 2:
+			//Two frames, first length coded
+			num = 2;
+			if (!ReadLength(data,size,lengths[0]) || lengths[0]>size)
+				return 0;
+			lengths[1] = size - lengths[0];
+			break;
+		case 3:
+		{
+			/*
+				0 1 2 3 4 5 6 7
+			       +-+-+-+-+-+-+-+-+
+			       |v|p|     M     |
+			       +-+-+-+-+-+-+-+-+
+			 */
+			//Check frame count byte
+			if (!size)
+				return 0;
+			bool vbr = data[0] & 0x80;
+			bool padding = data[0] & 0x40;
+			num = data[0] & 0x3F;
+			data++;
+			size--;
+			//Check
+			if (!num || num>max)
+				return 0;
+			//Skip padding
+			if (padding)
+			{
+				DWORD pad = 0;
+				BYTE value;
+				do {
+					//Check
+					if (!size)
+						return 0;
+					//Get padding byte
+					value = *data++;
+					size--;
+					//255 means 254 more bytes and another padding byte
+					pad += value==255 ? 254 : value;
+				} while (value==255);
+				//Padding is at the end
+				if (pad>size)
+					return 0;
+				size -= pad;
+			}
+			//If variable bit rate
+			if (vbr)
+			{
+				//All but last are length coded
+				for (DWORD i=0;i<num-1;++i)
+					if (!ReadLength(data,size,lengths[i]))
+						return 0;
+				//Get total
+				DWORD total = 0;
+				for (DWORD i=0;i<num-1;++i)
+					total += lengths[i];
+				//Check
+				if (total>size)
+					return 0;
+				//Last one takes the rest
+				lengths[num-1] = size - total;
+			} else {
+				//All equal
+				if (size%num)
+					return 0;
+				for (DWORD i=0;i<num;++i)
+					lengths[i] = size/num;
+			}
+			break;
+		}
+	}
+
+	//Check number of frames
+	if (num>max)
+		return 0;
+
+	//Set frame pointers
+	for (DWORD i=0;i<num;++i)
+	{
+		//Check size
+		if (lengths[i]>kMaxFrameSize)
+			return 0;
+		//Set it
+		frames[i] = data;
+		//Next
+		data += lengths[i];
+	}
+
+	return num;
+}
+
+DWORD OpusRepacketizer::Pack(BYTE toc, const BYTE* const frames[], const WORD lengths[], DWORD num, BYTE* out, DWORD max)
+{
+	//Check
+	if (!num || num>kMaxFrames || !max)
+		return 0;
+
+	//Single frame packet
+	if (num==1)
+	{
+		//Check size
+		if ((DWORD)lengths[0]+1>max)
+			return 0;
+		//Code 0
+		out[0] = toc & 0xFC;
+		//Copy frame
+		memcpy(out+1,frames[0],lengths[0]);
+		//Done
+		return lengths[0]+1;
+	}
+
+	//Check if all frames have the same size
+	bool vbr = false;
+	for (DWORD i=1;i<num;++i)
+		if (lengths[i]!=lengths[0])
+			vbr = true;
+
+	//Worst case size
+	DWORD size = 2 + (vbr ? (num-1)*2 : 0);
+	for (DWORD i=0;i<num;++i)
+		size += lengths[i];
+
+	//Check it fits
+	if (size>max)
+		return 0;
+
+	//Code 3, arbitrary number of frames
+	out[0] = (toc & 0xFC) | 0x03;
+	//Frame count, without padding
+	out[1] = (vbr ? 0x80 : 0x00) | num;
+
+	DWORD len = 2;
+
+	//If variable bit rate
+	if (vbr)
+		//Write lengths of all but last
+		for (DWORD i=0;i<num-1;++i)
+			len += WriteLength(out+len,lengths[i]);
+
+	//Copy frames
+	for (DWORD i=0;i<num;++i)
+	{
+		//Copy
+		memcpy(out+len,frames[i],lengths[i]);
+		//Next
+		len += lengths[i];
+	}
+
+	return len;
+}
+
+DWORD OpusRepacketizer::GetFrameDuration(BYTE toc)
+{
+	//Get config
+	BYTE config = toc >> 3;
+
+	//SILK only, 10, 20, 40 and 60ms
+	if (config<12)
+		return config%4==3 ? 2880 : 480 << (config%4);
+	//Hybrid, 10 and 20ms
+	if (config<16)
+		return 480 << (config%2);
+	//CELT only, 2.5, 5, 10 and 20ms
+	return 120 << (config%4);
+}
@@ -0,0 +1,69 @@
+#ifndef OPUSREPACKETIZER_H
+#define OPUSREPACKETIZER_H
+
+#include <vector>
+
+#include "config.h"
+#include "audio.h"
+
+/*
+ * Combines consecutive Opus frames into a single packet (RFC 6716 code 3),
+ * so listeners that accept longer packets get fewer RTP packets, and so less
+ * SRTP operations and sends.
+ *  - Frames are only combined while they share the same TOC configuration
+ *    and are contiguous, a timestamp gap (DTX) sends the pending ones.
+ *  - Packets never exceed 120ms, 48 frames or kMaxPacketSize bytes.
+ *  - With one frame per packet, or for other codecs, frames are forwarded
+ *    unchanged.
+ */
+class OpusRepacketizer : public MediaFrame::Listener
+{
+public:
+	static constexpr DWORD kMaxFrames	= 48;
+	static constexpr DWORD kMaxDuration	= 5760;	// samples at 48khz, 120ms
+	static constexpr DWORD kMaxFrameSize	= 1275;	// bytes
+	static constexpr DWORD kMaxPacketSize	= 1000;	// bytes
+public:
+	OpusRepacketizer();
+	virtual ~OpusRepacketizer() = default;
+
+	void SetListener(MediaFrame::Listener* listener)	{ this->listener = listener;	}
+	//Max number of frames per packet, 1 disables it
+	void SetMaxFrames(DWORD maxFrames);
+	DWORD GetMaxFrames() const	{ return maxFrames;	}
+	//Send pending frames now
+	void Flush();
+	//Drop pending frames
+	void Reset();
+
+	virtual void onMediaFrame(const MediaFrame &frame) override;
+	virtual void onMediaFrame(DWORD ssrc, const MediaFrame &frame) override	{ onMediaFrame(frame);	}
+
+	QWORD GetReceivedFrames() const	{ return received;	}
+	QWORD GetSentPackets() const	{ return sent;		}
+
+	//Get frames of an opus packet, return number of frames or 0 if malformed
+	static DWORD Parse(const BYTE* data, DWORD size, const BYTE* frames[], WORD lengths[], DWORD max);
+	//Write frames with given TOC configuration as a single packet, return its size or 0 if it does not fit
+	static DWORD Pack(BYTE toc, const BYTE* const frames[], const WORD lengths[], DWORD num, BYTE* out, DWORD max);
+	//Duration of each frame of a packet, in samples at 48khz
+	static DWORD GetFrameDuration(BYTE toc);
+private:
+	MediaFrame::Listener* listener = nullptr;
+	AudioFrame	packet;
+	DWORD		maxFrames = 1;
+	//Pending frames
+	BYTE		toc	 = 0;
+	std::vector<BYTE> data;
+	std::vector<WORD> lengths;
+	DWORD		duration = 0;
+	QWORD		timestamp = 0;
+	QWORD		end	 = 0;
+	QWORD		time	 = 0;
+	DWORD		clockRate = 0;
+	//Stats
+	QWORD		received = 0;
+	QWORD		sent	 = 0;
+};
+
+#endif /* OPUSREPACKETIZER_H */
@@ -1,6 +1,8 @@
 #include "log.h"
 #include "pipeaudioinput.h"
 
+#include <atomic>
+
 PipeAudioInput::PipeAudioInput()
 {
 	//Creamos el mutex
@@ -13,7 +15,10 @@ PipeAudioInput::PipeAudioInput()
 	inited = false;
 	recording = false;
 	canceled = false;
+	waiting = false;
 	nativeRate = 8000;
+	recordRate = 0;
+	transraterRate = 0;
 }
 
 PipeAudioInput::~PipeAudioInput()
@@ -27,24 +32,24 @@ PipeAudioInput::~PipeAudioInput()
 
 int PipeAudioInput::ClearBuffer()
 {
-	//Bloqueamos
-	pthread_mutex_lock(&mutex);
-
 	//Clear data
 	fifoBuffer.clear();
 
-	//Desbloqueamos
-	pthread_mutex_unlock(&mutex);
+	return true;
 }
 int PipeAudioInput::RecBuffer(SWORD *buffer,DWORD size)
 {
-	int len = 0;
-
 	//Bloqueamos
 	pthread_mutex_lock(&mutex);
 
+	//Let the mixer know it has to signal us
+	waiting = true;
+
+	//Make sure the mixer sees it before we check the samples, or we see its samples
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+
 	//Mientras no tengamos suficientes muestras
-	while(recording && (fifoBuffer.length()<size))
+	while(recording && fifoBuffer.length()<size)
 	{
 		//Esperamos la condicion
 		pthread_cond_wait(&cond,&mutex);
@@ -54,37 +59,39 @@ int PipeAudioInput::RecBuffer(SWORD *buffer,DWORD size)
 		{
 			//Remove flag
 			canceled = false;
+			//Not waiting anymore
+			waiting = false;
+			//Desbloqueamos
+			pthread_mutex_unlock(&mutex);
 			//Exit
 			Log("PipeAudioInput: RecBuffer cancelled.\n");
 			//End
-			goto end;
+			return 0;
 		}
 	}
 
-	//Get samples from queue
-	len = fifoBuffer.pop(buffer,size);
+	//Not waiting anymore
+	waiting = false;
 
-end:
 	//Desbloqueamos
 	pthread_mutex_unlock(&mutex);
 
-	return len;
+	//Check we have all of them
+	if (fifoBuffer.length()<size)
+		return 0;
+
+	//Get samples from queue
+	return fifoBuffer.pop(buffer,size);
 }
 
 int PipeAudioInput::StartRecording(DWORD rate)
 {
 	Log("-PipeAudioInput start recording [rate:%d]\n",rate);
 
-	//Bloqueamos
-	pthread_mutex_lock(&mutex);
-	//Store recording rate
+	//Store recording rate, transrater will be opened by the mixer
 	recordRate = rate;
-	//Open transrater
-	transrater.Open( nativeRate, recordRate );
 	//Estamos grabando
 	recording = true;
-	//Desbloqueamos
-	pthread_mutex_unlock(&mutex);
 
 	return true;
 }
@@ -99,9 +106,9 @@ int PipeAudioInput::StopRecording()
 	//Estamos grabando
 	recording = false;
 
-	//Close transrater
-	transrater.Close();
-	
+	//Open transrater again when recording is restarted
+	transraterRate = 0;
+
 	//Se�alamos
 	pthread_cond_signal(&cond);
 
@@ -116,44 +123,52 @@ int PipeAudioInput::PutSamples(SWORD *buffer,DWORD size)
 	SWORD resampled[4096];
 	DWORD resampledSize = 4096;
 
-	
-	//Block
-	pthread_mutex_lock(&mutex);
-	
+	//Si no estamos grabando
+	if (!recording)
+		//Nothing to do
+		return true;
+
+	//Get recording rate
+	DWORD rate = recordRate;
+
+	//If it has changed since we opened the transrater
+	if (rate!=transraterRate)
+	{
+		//Open transrater
+		transrater.Open( nativeRate, rate );
+		//Store it
+		transraterRate = rate;
+	}
+
 	//If we need to transrate
 	if (transrater.IsOpen())
 	{
 		//Transrate
 		if (!transrater.ProcessBuffer(buffer, size, resampled, &resampledSize))
-		{
-			//Desbloqueamos
-			pthread_mutex_unlock(&mutex);
 			//Error
 			return Error("-PipeAudioInput could not transrate\n");
-		}
 		//Swith input parameters to resample ones
 		buffer = resampled;
 		size = resampledSize;
 	}
 
-	//Si estamos reproduciendo
-	if (recording)
-	{
-		//Si no cabe
-		if (fifoBuffer.length()+size>fifoBuffer.size())
-			//Limpiamos
-			fifoBuffer.clear();
+	//Encolamos, if it is full the samples that do not fit are dropped
+	fifoBuffer.push(buffer,size);
 
-		//Encolamos
-		fifoBuffer.push(buffer,size);
+	//Make sure we see the recorder waiting flag after it could see the samples
+	std::atomic_thread_fence(std::memory_order_seq_cst);
 
+	//If the recorder is waiting for samples
+	if (waiting)
+	{
+		//Block
+		pthread_mutex_lock(&mutex);
 		//Se�alamos
 		pthread_cond_signal(&cond);
+		//Desbloqueamos
+		pthread_mutex_unlock(&mutex);
 	}
 
-	//Desbloqueamos
-	pthread_mutex_unlock(&mutex);
-
 	//Salimos
 	return true;
 
@@ -178,6 +193,22 @@ int PipeAudioInput::Init(DWORD rate)
 	return true;
 }
 
+int PipeAudioInput::SetNativeRate(DWORD rate)
+{
+	Log("-PipeAudioInput set native rate [rate:%d]\n",rate);
+
+	//Store new rate, called from the mixer so no lock is needed
+	nativeRate = rate;
+
+	//Queued samples are at previous rate
+	fifoBuffer.clear();
+
+	//Open transrater again on next samples
+	transraterRate = 0;
+
+	return true;
+}
+
 int PipeAudioInput::End()
 {
 	//Protegemos
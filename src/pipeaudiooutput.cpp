@@ -12,6 +12,7 @@ PipeAudioOutput::PipeAudioOutput(bool calcVAD)
 	//No rates yet
 	nativeRate = 0;
 	playRate = 0;
+	transraterRate = 0;
 	//Creamos el mutex
 	pthread_mutex_init(&mutex,NULL);
 }
@@ -26,50 +27,66 @@ int PipeAudioOutput::PlayBuffer(SWORD *buffer,DWORD size,DWORD frameTime, BYTE v
 {
 	SWORD resampled[4096];
 	DWORD resampledSize = 4096;
-	int v = -1;//vadLevel;
+	//If the level has been signaled in the rtp packets in -dBov, trust it instead of calculating vad
+	int v = vadLevel!=(BYTE)-1 ? vadLevel<127 : -1;
+	//Level used to accumulate vad
+	DWORD level = 0;
 
 	//Check if we need to calculate it
 	if (calcVAD && v<0 && vad.IsRateSupported(playRate))
 		//Calculate vad
 		v = vad.CalcVad(buffer,size,playRate);
 
+	//Get mixer rate
+	DWORD rate = nativeRate;
+
+	//Lock transrater, so it is not changed while in use
+	pthread_mutex_lock(&mutex);
+
+	//If mixer rate has changed since we opened the transrater
+	if (rate!=transraterRate)
+	{
+		//Close previous one
+		transrater.Close();
+		//If playing at a different rate
+		if (playRate && playRate!=rate)
+			//Open it
+			transrater.Open(playRate,rate);
+		//Store it
+		transraterRate = rate;
+	}
+
 	//Check if we are transtrating
 	if (transrater.IsOpen())
 	{
 		//Proccess
 		if (!transrater.ProcessBuffer( buffer, size, resampled, &resampledSize))
+		{
+			//Unlock
+			pthread_mutex_unlock(&mutex);
 			//Error
 			return Error("-PipeAudioOutput could not transrate\n");
+		}
 
 		//Check if we need to calculate it
-		if (calcVAD && v<0 && vad.IsRateSupported(nativeRate))
+		if (calcVAD && v<0 && vad.IsRateSupported(rate))
 			//Calculate vad
-			v = vad.CalcVad(buffer,size,nativeRate);
+			v = vad.CalcVad(buffer,size,rate);
 
 		//Update parameters
 		buffer = resampled;
 		size = resampledSize;
 	}
 
-	//Bloqueamos
-	pthread_mutex_lock(&mutex);
-
-	//Get left space
-	int left = fifoBuffer.size()-fifoBuffer.length();
-
-	//if not enought
-	if(size>left)
-		//Free space
-		fifoBuffer.remove(size-left);
-
-	//Get initial bump
-	if (!acu && v>0)
-		//1 second minimum at 8khz
-		acu+=8000;
+	//Unlock
+	pthread_mutex_unlock(&mutex);
 
-	//Check if we have level info
-	if (v>0)
+	//If the level was signaled
+	if (v>0 && vadLevel!=(BYTE)-1)
 	{
+		//Same as the rms level below for a signal at that -dBov
+		level = sqrt(size)*4*pow(10,-vadLevel/20.0);
+	} else if (v>0) {
 		double sum = 0;
 		for (int i = 0; i < size ; ++i)
 		{
@@ -78,27 +95,31 @@ int PipeAudioOutput::PlayBuffer(SWORD *buffer,DWORD size,DWORD frameTime, BYTE v
 		}
 		//Debug("-sum %f %f\n",sum,sum/size);
 		//Set RMS level
-		vadLevel = sqrt(sum)*4;
+		level = sqrt(sum)*4;
 	}
 
 	//Check we have detected speech
 	if (v>0)
-		//Acumule VAD at 8Khz
-		acu += v*vadLevel*size*8000/playRate;
+	{
+		DWORD prev = acu;
+		DWORD next;
+		do {
+			//Get initial bump, 1 second minimum at 8khz
+			next = prev ? prev : 8000;
+			//Acumule VAD at 8Khz
+			next += v*level*size*8000/playRate;
+			//Limit so it can timeout faster
+			if (next>48000)
+				next = 48000;
+		//Mixer may be consuming it at the same time
+		} while (!acu.compare_exchange_weak(prev,next));
+	}
 
-	//Debug("-%p acu:%.6d v:%.2d level:%.2d\n",this,acu,v,vadLevel);
-	
-	//Check max
-	if (acu>48000)
-		//Limit so it can timeout faster
-		acu = 48000;
+	//Debug("-%p acu:%.6d v:%.2d level:%.2d\n",this,(DWORD)acu,v,level);
 
-	//Metemos en la fifo
+	//Metemos en la fifo, if it is full the samples that do not fit are dropped
 	fifoBuffer.push(buffer,size);
 
-	//Desbloqueamos
-	pthread_mutex_unlock(&mutex);
-
 	return size;
 }
 
@@ -117,10 +138,16 @@ int PipeAudioOutput::StartPlaying(DWORD rate)
 		//Close it
 		transrater.Close();
 
+	//Get mixer rate
+	DWORD mixerRate = nativeRate;
+
 	//if rates are different
-	if (playRate!=nativeRate)
+	if (playRate!=mixerRate)
 		//Open it
-		transrater.Open(playRate,nativeRate);
+		transrater.Open(playRate,mixerRate);
+
+	//Store mixer rate it has been opened for
+	transraterRate = mixerRate;
 	
 	//Unlock
 	pthread_mutex_unlock(&mutex);
@@ -146,24 +173,8 @@ int PipeAudioOutput::StopPlaying()
 
 int PipeAudioOutput::GetSamples(SWORD *buffer,DWORD num)
 {
-	//Bloqueamos
-	pthread_mutex_lock(&mutex);
-
-	//Obtenemos la longitud
-	int len = fifoBuffer.length();
-
-	//Miramos si hay suficientes
-	if (len > num)
-		len = num;
-
-	//OBtenemos las muestras
-	fifoBuffer.pop(buffer,len);
-
-	//Desbloqueamos
-	pthread_mutex_unlock(&mutex);
-
-	//Salimos
-	return len;
+	//OBtenemos las muestras que haya, without locking
+	return fifoBuffer.pop(buffer,num);
 }
 int PipeAudioOutput::Init(DWORD rate)
 {
@@ -184,6 +195,19 @@ int PipeAudioOutput::Init(DWORD rate)
 	return true;
 } 
 
+int PipeAudioOutput::SetNativeRate(DWORD rate)
+{
+	Log("-PipeAudioOutput set native rate [rate:%d]\n",rate);
+
+	//Store new rate, the player will open the transrater again on next samples so the mixer never blocks on it
+	nativeRate = rate;
+
+	//Queued samples are at previous rate
+	fifoBuffer.clear();
+
+	return true;
+}
+
 int PipeAudioOutput::End()
 {
 	//Protegemos
@@ -203,23 +227,26 @@ int PipeAudioOutput::End()
 
 DWORD PipeAudioOutput::GetVAD(DWORD numSamples)
 {
-	//Protegemos
-	pthread_mutex_lock(&mutex);
-	
+	//Get mixer rate
+	DWORD rate = nativeRate;
+	//Get decay at 8khz
+	DWORD decay = rate ? numSamples*8000/rate : 0;
+
 	//Get vad value
 	DWORD r = acu;
+	DWORD next;
+
+	do {
+		//Check
+		if (!rate || r<decay)
+			//No vad
+			next = 0;
+		else
+			//Remove cumulative value
+			next = r-decay;
+	//Player may be adding to it at the same time
+	} while (!acu.compare_exchange_weak(r,next));
 
-	//Check
-	if (!nativeRate || acu<numSamples*8000/nativeRate)
-		//No vad
-		acu = 0;
-	else 
-		//Remove cumulative value
-		acu -= numSamples*8000/nativeRate;
-		
-	//Protegemos
-	pthread_mutex_unlock(&mutex);
-	
 	//Return
 	return r;
 }
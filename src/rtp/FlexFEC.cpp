@@ -0,0 +1,137 @@
+#include "rtp/FlexFEC.h"
+#include "tools.h"
+
+#include <cstring>
+#include <emmintrin.h>
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+//Mask chunks: bits and offset of first bit, each one prefixed by its k bit
+static constexpr DWORD MaskChunkBits[3]	= { 15, 31, 63 };
+static constexpr DWORD MaskChunkPos[3]	= { 18*8, 20*8, 24*8 };
+
+DWORD FlexFEC::GetHeaderSize(DWORD maskBits)
+{
+	if (maskBits<=15)
+		return 20;
+	if (maskBits<=46)
+		return 24;
+	return 32;
+}
+
+DWORD FlexFEC::WriteHeader(BYTE* data, DWORD size, BYTE recoveryFlags, BYTE recoveryPT, WORD recoveryLength, DWORD recoveryTimestamp, DWORD ssrc, WORD seqNumBase, const bool* mask, DWORD maskBits)
+{
+	//Check mask
+	if (maskBits>MaxMaskBits)
+		return 0;
+	
+	//Get header size
+	DWORD len = GetHeaderSize(maskBits);
+	
+	//Check size
+	if (size<len)
+		return 0;
+	
+	//Clear it
+	memset(data,0,len);
+	
+	//R=0, F=0 and P|X|CC from the protected packets
+	data[0] = recoveryFlags & 0x3F;
+	//M and PT
+	data[1] = recoveryPT;
+	set2(data,2,recoveryLength);
+	set4(data,4,recoveryTimestamp);
+	//Single ssrc
+	data[8] = 1;
+	set4(data,12,ssrc);
+	set2(data,16,seqNumBase);
+	
+	//Number of chunks needed
+	DWORD chunks = len==20 ? 1 : len==24 ? 2 : 3;
+	
+	//Write mask
+	DWORD n = 0;
+	for (DWORD c=0;c<chunks;++c)
+	{
+		//Last chunk has k set
+		if (c==chunks-1)
+			data[MaskChunkPos[c]/8] |= 0x80;
+		//Set bits
+		for (DWORD i=0;i<MaskChunkBits[c];++i,++n)
+		{
+			if (n<maskBits && mask[n])
+			{
+				//Bit position skipping the k bit
+				DWORD pos = MaskChunkPos[c] + 1 + i;
+				data[pos/8] |= 0x80 >> (pos%8);
+			}
+		}
+	}
+	
+	return len;
+}
+
+DWORD FlexFEC::ReadHeader(const BYTE* data, DWORD size, DWORD* ssrc, WORD* seqNumBase, bool* mask, DWORD* maskBits)
+{
+	//Check size
+	if (size<MinHeaderSize)
+		return 0;
+	//Only flexible mask supported
+	if (data[0] & 0xC0)
+		return 0;
+	//Only single stream supported
+	if (data[8]!=1)
+		return 0;
+	
+	*ssrc		= get4(data,12);
+	*seqNumBase	= get2(data,16);
+	
+	DWORD n = 0;
+	//Read mask chunks
+	for (DWORD c=0;c<3;++c)
+	{
+		//Check we have it
+		if (size<MaskChunkPos[c]/8 + (MaskChunkBits[c]+1)/8)
+			return 0;
+		//Get bits
+		for (DWORD i=0;i<MaskChunkBits[c];++i,++n)
+		{
+			DWORD pos = MaskChunkPos[c] + 1 + i;
+			mask[n] = data[pos/8] & (0x80 >> (pos%8));
+		}
+		//If k is set, this is the last one
+		if (data[MaskChunkPos[c]/8] & 0x80)
+		{
+			*maskBits = n;
+			return (MaskChunkPos[c] + MaskChunkBits[c] + 1)/8;
+		}
+	}
+	
+	//Wrong k bits
+	return 0;
+}
+
+void FlexFEC::Xor(BYTE* dst, const BYTE* src, DWORD size)
+{
+	DWORD i = 0;
+#ifdef __AVX2__
+	//32 bytes at a time
+	for (;i+32<=size;i+=32)
+	{
+		__m256i a = _mm256_loadu_si256((const __m256i*)(dst+i));
+		__m256i b = _mm256_loadu_si256((const __m256i*)(src+i));
+		_mm256_storeu_si256((__m256i*)(dst+i),_mm256_xor_si256(a,b));
+	}
+#endif
+	//16 bytes at a time
+	for (;i+16<=size;i+=16)
+	{
+		__m128i a = _mm_loadu_si128((const __m128i*)(dst+i));
+		__m128i b = _mm_loadu_si128((const __m128i*)(src+i));
+		_mm_storeu_si128((__m128i*)(dst+i),_mm_xor_si128(a,b));
+	}
+	//Remaining
+	for (;i<size;++i)
+		dst[i] ^= src[i];
+}
@@ -0,0 +1,248 @@
+#include "rtp/FlexFECDecoder.h"
+#include "tools.h"
+#include "log.h"
+
+#include <algorithm>
+#include <cstring>
+
+void FlexFECDecoder::Enable()
+{
+	Debug("-FlexFECDecoder::Enable()\n");
+	
+	//Allocate rings
+	medias.resize(kMediaRingSize);
+	repairs.resize(kMaxRepairs);
+}
+
+void FlexFECDecoder::Reset()
+{
+	//Free everything, it will be enabled again on next repair packet
+	medias.clear();
+	repairs.clear();
+	recovered.clear();
+	nextRepair = 0;
+}
+
+FlexFECDecoder::Media* FlexFECDecoder::GetMedia(WORD seqNum)
+{
+	//Get slot
+	Media& media = medias[seqNum % kMediaRingSize];
+	//Check it is the same packet
+	return media.used && media.seqNum==seqNum ? &media : nullptr;
+}
+
+void FlexFECDecoder::AddMedia(const BYTE* data, DWORD size)
+{
+	//Nothing to do if remote is not sending fec
+	if (!IsEnabled())
+		return;
+	
+	//Check size
+	if (size<FlexFEC::RTPHeaderSize || size>MTU)
+		return;
+	
+	//Store it
+	Store(data,size);
+}
+
+void FlexFECDecoder::Store(const BYTE* data, DWORD size)
+{
+	//Get seq num
+	WORD seqNum = get2(data,2);
+	
+	//If we have it already
+	if (GetMedia(seqNum))
+		//Done
+		return;
+	
+	//Replace previous packet on same slot
+	Media& media = medias[seqNum % kMediaRingSize];
+	media.used	= true;
+	media.seqNum	= seqNum;
+	media.size	= size;
+	memcpy(media.data.data(),data,size);
+	
+	//Update newest one
+	if ((WORD)(seqNum-lastSeqNum)<0x8000)
+		lastSeqNum = seqNum;
+	
+	//Update repairs protecting it
+	for (auto& repair : repairs)
+	{
+		//Skip empty
+		if (!repair.used)
+			continue;
+		//Drop old ones, protected packets may have been overwritten on the ring
+		if ((WORD)(lastSeqNum-repair.seqNumBase)>=kMaxAge)
+		{
+			repair.used = false;
+			continue;
+		}
+		//Get offset on the mask
+		WORD offset = seqNum-repair.seqNumBase;
+		//If not protected by it
+		if (offset>=repair.maskBits || !repair.mask[offset])
+			continue;
+		//One less missing
+		if (--repair.missing==1)
+			//Last missing one can be recovered now
+			Recover(repair);
+		else if (!repair.missing)
+			//Nothing to recover
+			repair.used = false;
+	}
+}
+
+void FlexFECDecoder::AddFEC(const BYTE* data, DWORD size)
+{
+	//Start storing media on first repair packet
+	if (!IsEnabled())
+		Enable();
+	
+	//Check size
+	if (size>MTU)
+		return;
+	
+	repairPackets++;
+	
+	//Get next slot, overwritting the oldest one
+	Repair& repair = repairs[nextRepair++ % kMaxRepairs];
+	repair.used = false;
+	
+	//Parse header
+	repair.header = FlexFEC::ReadHeader(data,size,&repair.ssrc,&repair.seqNumBase,repair.mask.data(),&repair.maskBits);
+	
+	//Check
+	if (!repair.header)
+	{
+		Debug("-FlexFECDecoder::AddFEC() | Unsupported repair packet\n");
+		return;
+	}
+	
+	//Count missing packets
+	repair.missing = 0;
+	for (DWORD i=0;i<repair.maskBits;++i)
+		if (repair.mask[i] && !GetMedia(repair.seqNumBase+i))
+			repair.missing++;
+	
+	//If nothing was lost
+	if (!repair.missing)
+	{
+		uselessRepairs++;
+		return;
+	}
+	
+	//Store it
+	repair.used = true;
+	repair.size = size;
+	memcpy(repair.data.data(),data,size);
+	
+	//If only one is missing
+	if (repair.missing==1)
+		//Recover it
+		Recover(repair);
+}
+
+bool FlexFECDecoder::Recover(Repair& repair)
+{
+	//It will be used now
+	repair.used = false;
+	
+	//Find the missing packet
+	int lost = -1;
+	for (DWORD i=0;i<repair.maskBits;++i)
+	{
+		//If protected and missing
+		if (repair.mask[i] && !GetMedia(repair.seqNumBase+i))
+		{
+			//Can't recover more than one
+			if (lost!=-1)
+				return false;
+			lost = i;
+		}
+	}
+	
+	//Check we have one
+	if (lost==-1)
+		return false;
+	
+	//Get repair data
+	const BYTE* data = repair.data.data();
+	DWORD payloadSize = repair.size-repair.header;
+	
+	//Start from the recovery fields
+	BYTE  flags	= data[0];
+	BYTE  pt	= data[1];
+	WORD  length	= get2(data,2);
+	DWORD ts	= get4(data,4);
+	
+	//Recovered packet
+	BYTE packet[MTU];
+	memcpy(packet+FlexFEC::RTPHeaderSize,data+repair.header,std::min(payloadSize,MTU-FlexFEC::RTPHeaderSize));
+	
+	//XOR all other protected packets
+	for (DWORD i=0;i<repair.maskBits;++i)
+	{
+		//Skip not protected and lost
+		if (!repair.mask[i] || i==(DWORD)lost)
+			continue;
+		//Get it
+		const Media* media = GetMedia(repair.seqNumBase+i);
+		//Get length
+		DWORD len = media->size-FlexFEC::RTPHeaderSize;
+		//Recover header fields
+		flags	^= media->data[0];
+		pt	^= media->data[1];
+		length	^= len;
+		ts	^= get4(media->data.data(),4);
+		//And payload
+		FlexFEC::Xor(packet+FlexFEC::RTPHeaderSize,media->data.data()+FlexFEC::RTPHeaderSize,std::min(len,payloadSize));
+	}
+	
+	//Check recovered length
+	if (length>payloadSize || FlexFEC::RTPHeaderSize+length>MTU)
+	{
+		Debug("-FlexFECDecoder::Recover() | Wrong recovered length [length:%u,payload:%u]\n",length,payloadSize);
+		return false;
+	}
+	
+	WORD seqNum = repair.seqNumBase+lost;
+	
+	//Rebuild fixed header
+	packet[0] = 0x80 | (flags & 0x3F);
+	packet[1] = pt;
+	set2(packet,2,seqNum);
+	set4(packet,4,ts);
+	set4(packet,8,repair.ssrc);
+	
+	recoveredPackets++;
+	
+	//Queue it for delivery
+	recovered.push_back(seqNum);
+	
+	//Store it, it may complete other repairs
+	Store(packet,FlexFEC::RTPHeaderSize+length);
+	
+	return true;
+}
+
+DWORD FlexFECDecoder::GetRecovered(BYTE* data, DWORD size)
+{
+	//Get next recovered still on the ring
+	while (!recovered.empty())
+	{
+		//Get media
+		const Media* media = GetMedia(recovered.front());
+		//Remove from queue
+		recovered.pop_front();
+		//Check it fits
+		if (!media || media->size>size)
+			continue;
+		//Copy it
+		memcpy(data,media->data.data(),media->size);
+		//Done
+		return media->size;
+	}
+	//None
+	return 0;
+}
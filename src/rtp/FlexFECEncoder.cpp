@@ -0,0 +1,146 @@
+#include "rtp/FlexFECEncoder.h"
+#include "tools.h"
+#include "log.h"
+
+#include <algorithm>
+#include <cstring>
+
+//Mask bits used on the generated packets
+static constexpr DWORD MaxGroupSpan = 46;
+
+void FlexFECEncoder::Update(BYTE fractionLost, DWORD rtt)
+{
+	//NACKs are enough if the rtt is low, and nothing to protect if there is no loss
+	if (rtt<kMinRTT || !fractionLost)
+		return SetGroupSize(0);
+	
+	//Get loss rate
+	float loss = fractionLost/256.0f;
+	
+	//A group only recovers one loss, size it so the expected one per group is well below it, as losses are bursty
+	SetGroupSize(std::clamp<DWORD>(1/(3*loss),kMinGroupSize,kMaxGroupSize));
+}
+
+void FlexFECEncoder::SetGroupSize(DWORD groupSize)
+{
+	//Check if changed
+	if (this->groupSize==groupSize)
+		return;
+	
+	Debug("-FlexFECEncoder::SetGroupSize() [groupSize:%u]\n",groupSize);
+	
+	//If disabling it
+	if (!groupSize)
+		//Drop current group
+		Reset();
+	
+	//Store new size, current group will use it
+	this->groupSize = std::min(groupSize,MaxGroupSpan);
+}
+
+DWORD FlexFECEncoder::AddPacket(const BYTE* data, DWORD size, bool mark)
+{
+	//Check if enabled
+	if (!groupSize)
+		return 0;
+	
+	//Check size
+	if (size<FlexFEC::RTPHeaderSize || size-FlexFEC::RTPHeaderSize+FlexFEC::GetHeaderSize(MaxGroupSpan)>kMaxRepairSize)
+		return 0;
+	
+	DWORD packetSsrc = get4(data,8);
+	WORD  seqNum	 = get2(data,2);
+	
+	DWORD flushed = 0;
+	
+	//If it does not fit on current group
+	if (count && (packetSsrc!=ssrc || (WORD)(seqNum-seqNumBase)>=MaxGroupSpan))
+		//Generate repair for the partial group and start a new one
+		flushed = Flush();
+	
+	//If first on the group
+	if (!count)
+	{
+		ssrc		= packetSsrc;
+		seqNumBase	= seqNum;
+	}
+	
+	//Get offset on the mask
+	DWORD offset = (WORD)(seqNum-seqNumBase);
+	
+	//Check it is not protected already
+	if (mask[offset])
+		return 0;
+	
+	//Recover header fields
+	flags	^= data[0];
+	pt	^= data[1];
+	ts	^= get4(data,4);
+	length	^= size-FlexFEC::RTPHeaderSize;
+	
+	//Protect all data after the fixed header
+	DWORD len = size-FlexFEC::RTPHeaderSize;
+	FlexFEC::Xor(payload.data(),data+FlexFEC::RTPHeaderSize,len);
+	
+	//Update group
+	payloadSize = std::max(payloadSize,len);
+	mask[offset] = true;
+	//Packets may be sent out of order, keep the highest one
+	last = std::max(last,offset);
+	timestamp = get4(data,4);
+	count++;
+	protectedPackets++;
+	
+	//If group is full or frame has ended with enough packets
+	if (count>=groupSize || (mark && count>=std::max(groupSize/2,2u)))
+		//Generate repair
+		return Flush();
+	
+	//Only the partial group, if any
+	return flushed;
+}
+
+DWORD FlexFECEncoder::Flush()
+{
+	//Write header
+	DWORD len = FlexFEC::WriteHeader(repair.data(),repair.size(),flags,pt,length,ts,ssrc,seqNumBase,mask.data(),last+1);
+	
+	//Check
+	if (!len || len+payloadSize>repair.size())
+	{
+		//Drop it
+		Reset();
+		return 0;
+	}
+	
+	//Copy repair data
+	memcpy(repair.data()+len,payload.data(),payloadSize);
+	len += payloadSize;
+	//Timestamp of last protected packet
+	repairTimestamp = timestamp;
+	
+	//Stats
+	repairPackets++;
+	repairBytes += len;
+	
+	//Start next group
+	Reset();
+	
+	return len;
+}
+
+void FlexFECEncoder::Reset()
+{
+	//Clear only used part of the payload
+	memset(payload.data(),0,payloadSize);
+	//Clear whole mask, it is small
+	mask.fill(false);
+	//Reset group
+	count		= 0;
+	last		= 0;
+	flags		= 0;
+	pt		= 0;
+	length		= 0;
+	ts		= 0;
+	payloadSize	= 0;
+}
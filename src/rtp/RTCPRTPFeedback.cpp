@@ -148,185 +148,56 @@ DWORD RTCPRTPFeedback::Serialize(BYTE* data,DWORD size)
 
 
 DWORD RTCPRTPFeedback::TransportWideFeedbackMessageField::GetSize() const
+{
+	//Run encoder without writing to know the size
+	return Encode(nullptr,0);
+}
+
+DWORD RTCPRTPFeedback::TransportWideFeedbackMessageField::Serialize(BYTE* data,DWORD size) const
+{
+	//Encode it
+	return Encode(data,size);
+}
+
+DWORD RTCPRTPFeedback::TransportWideFeedbackMessageField::Encode(BYTE* data,DWORD size) const
 {
 	//If we have no packets
-	if (packets.size()==0)
+	if (packets.empty())
 		return 0;
 	
-	//Initial time in us
-	QWORD time = 0;
+	//Check header size
+	if (data && size<8)
+		return 0;
 	
 	//Calculate temporal info
 	bool firstReceived	= false;
 	QWORD referenceTime	= 0;
+	QWORD time		= 0;
 	
-	//Store delta array
-	std::list<int> deltas;
-	std::list<PacketStatus> statuses;
-	PacketStatus lastStatus = PacketStatus::Reserved;
-	PacketStatus maxStatus = PacketStatus::NotReceived;
-	bool allsame = true;
-	
-	//Header
-	DWORD len = 8;
-	
-	//For each packet 
-	for (Packets::const_iterator it = packets.begin(); it!=packets.end(); ++it)
-	{
-		PacketStatus status = PacketStatus::NotReceived;
-		
-		//If got packet
-		if (it->second)
-		{
-			int delta = 0;
-			//If first received
-			if (!firstReceived)
-			{
-				//Got it 
-				firstReceived = true;
-				//Set it as 3 bytes signed integer
-				referenceTime = (it->second/64000) & 0x7FFFFF;
-				//Get initial time
-				time = referenceTime * 64000;
-			}
-					
-			//Get delta
-			if (it->second>time)
-				delta = (it->second-time)/250;
-			else
-				delta = -(int)((time-it->second)/250);
-			//If it is negative or to big
-			if (delta<0 || delta> 127)
-				//Big one
-				status = PacketStatus::LargeOrNegativeDelta;
-			else
-				//Small
-				status = PacketStatus::SmallDelta;
-			//Store delta
-			deltas.push_back(delta);
-			//Set next time
-			time = time + delta*250;
-		}
-		
-		//Check if all previoues ones were equal and this one the firt different
-		if (allsame && lastStatus!=PacketStatus::Reserved && status!=lastStatus)
+	//Get receive delta of packet in 250us units, as the receiver will reconstruct it
+	auto getDelta = [&](QWORD ts) -> int {
+		int delta = 0;
+		//If first received
+		if (!firstReceived)
 		{
-			//Anything bigger is worth a run
-			if (statuses.size()>7)
-			{
-				//One chunk
-				len+=2;
-				//Remove all statuses
-				statuses.clear();
-				//REset
-				lastStatus = PacketStatus::Reserved;
-				maxStatus = PacketStatus::NotReceived;
-				allsame = true;
-			} else {
-				//Not same
-				allsame = false;
-			}
+			//Got it 
+			firstReceived = true;
+			//Set it as 3 bytes signed integer
+			referenceTime = (ts/64000) & 0x7FFFFF;
+			//Get initial time
+			time = referenceTime * 64000;
 		}
-		
-		//Push back statuses, it will be handled later
-		statuses.push_back(status);
-		
-		//If it is bigger
-		if (status>maxStatus)
-			//Store it
-			maxStatus = status;
-		//Store las status
-		lastStatus = status;
-
-		//If they are different already
-		if (!allsame)
-		{
-			//Check 
-			if (maxStatus==PacketStatus::LargeOrNegativeDelta && statuses.size()>6)
-			{
-				//One chunk
-				len+=2;
-				//Remove next 7
-				for (DWORD i=0;i<7;++i)
-					//Remove
-					statuses.pop_front();
-				//REset
-				lastStatus = PacketStatus::Reserved;
-				maxStatus = PacketStatus::NotReceived;
-				allsame = true;
-				// We need to restore the values, as there may be more elements on the buffer
-				for (auto it = statuses.begin(); it!=statuses.end(); ++it)
-				{
-					//Get status
-					status = *it;
-					//If it is bigger
-					if (status>maxStatus)
-						//Store it
-						maxStatus = status;
-					//Check if it is the same
-					if (allsame && lastStatus!=PacketStatus::Reserved && status!=lastStatus)
-						//not the same
-						allsame = false;
-					//Store las status
-					lastStatus = status;
-				}
-			} else if (statuses.size()>13) {
-				//One chunk
-				len+=2;
-				//Remove last 14
-				for (DWORD i=0;i<14;++i)
-					//Remove
-					statuses.pop_front();
-				//REset
-				lastStatus = PacketStatus::Reserved;
-				maxStatus = PacketStatus::NotReceived;
-				allsame = true;
-			}
-		}
-	}
+		//Get delta
+		if (ts>time)
+			delta = std::min<QWORD>((ts-time)/250,32767);
+		else
+			delta = -(int)std::min<QWORD>((time-ts)/250,32768);
+		//Set next time
+		time = time + delta*250;
+		//Done
+		return delta;
+	};
 	
-	//If not finished yet
-	if (statuses.size()>0)
-		//One chunk more
-		len+=2;
-	
-	//Write now the deltas
-	for (std::list<int>::iterator it = deltas.begin(); it!=deltas.end(); ++it)
-	{
-		//Check size
-		if (*it<0 || *it>127)
-		{
-			//2 bytes
-			//Inc
-			len += 2;
-		} else {
-			//1 byte
-			//Inc
-			len ++;
-		}
-	}
-
-	//Add zero padding
-	if (len%4)
-		//DWORD boundary
-		len += 4 - (len%4);
-	
-	//Done
-	return len;
-}
-
-DWORD RTCPRTPFeedback::TransportWideFeedbackMessageField::Serialize(BYTE* data,DWORD size) const
-{
-	//If we have no packets
-	if (packets.size()==0)
-		return 0;
-	
-	//Calculate temporal info
-	WORD baseSeqNumber	= packets.begin()->first;
-	bool firstReceived	= false;
-	QWORD referenceTime	= 0;
-	WORD packetStatusCount	= packets.size();
-
 	/*
 		0                   1                   2                   3
 		0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5 6 7 8 9 0 1
@@ -336,97 +207,120 @@ DWORD RTCPRTPFeedback::TransportWideFeedbackMessageField::Serialize(BYTE* data,D
 	       |                 reference time                | fb pkt. count |
 	       +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+	
 	 */
-	//Set data
-	set2(data,0,baseSeqNumber);
-	set2(data,2,packetStatusCount);
-	//Set3 referenceTime when first received
-	set1(data,7,feedbackPacketCount);
-	
-	//Initial time in us
-	QWORD time = 0;
+	DWORD len = 8;
 	
-	//Store delta array
-	std::list<int> deltas;
-	std::list<PacketStatus> statuses;
+	//Pending statuses, only the first 14 are needed as longer ones are always written as a run
+	PacketStatus statuses[14];
+	DWORD num = 0;
 	PacketStatus lastStatus = PacketStatus::Reserved;
 	PacketStatus maxStatus = PacketStatus::NotReceived;
 	bool allsame = true;
+	//Total size of receive deltas
+	DWORD deltasLen = 0;
+	
+	//Write chunk directly on the buffer
+	auto putChunk = [&](WORD chunk) -> bool {
+		//If only calculating size
+		if (data)
+		{
+			//Check size
+			if (len+2>size)
+				return false;
+			//Write it
+			set2(data,len,chunk);
+		}
+		//Inc
+		len += 2;
+		return true;
+	};
+	
+	/*
+		0                   1
+		0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5
+	       +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+	       |T| S |       Run Length        |
+	       +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+		T = 0
+	 */
+	auto putRun = [&]() -> bool {
+		//Write run of last status
+		return putChunk((WORD)lastStatus<<13 | num);
+	};
 	
-	//Bitwritter for the rest
-	BitWritter writter(data+8,size-8);
+	/*
+		0                   1
+		0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5
+	       +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+	       |T|S|        Symbols            |
+	       +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
+		T = 1
+		S = 0 -> 14 symbols of 1 bit, S = 1 -> 7 symbols of 2 bits
+	 */
+	auto putVector = [&](bool twoBits,DWORD count) -> bool {
+		WORD chunk = twoBits ? 0xC000 : 0x8000;
+		//For each symbol, rest will be zero padded
+		for (DWORD i=0;i<count;++i)
+			//Set status
+			chunk |= twoBits ? (WORD)statuses[i]<<(2*(6-i)) : ((WORD)statuses[i]&1)<<(13-i);
+		return putChunk(chunk);
+	};
 	
 	//For each packet 
-	for (Packets::const_iterator it = packets.begin(); it!=packets.end(); ++it)
+	for (const auto& packet : packets)
 	{
 		PacketStatus status = PacketStatus::NotReceived;
 		
 		//If got packet
-		if (it->second)
+		if (packet.second)
 		{
-			int delta = 0;
-			//If first received
-			if (!firstReceived)
-			{
-				//Got it 
-				firstReceived = true;
-				//Set it as 3 bytes signed integer
-				referenceTime = (it->second/64000) & 0x7FFFFF;
-				//Get initial time
-				time = referenceTime * 64000;
-				//also in bufffer
-				set3(data,4,referenceTime);
-			}
-			
 			//Get delta
-			if (it->second>time)
-				delta = (it->second-time)/250;
-			else
-				delta = -(int)((time-it->second)/250);
+			int delta = getDelta(packet.second);
 			//If it is negative or to big
-			if (delta<0 || delta> 127)
+			if (delta<0 || delta>255)
+			{
 				//Big one
 				status = PacketStatus::LargeOrNegativeDelta;
-			else
+				deltasLen += 2;
+			} else {
 				//Small
 				status = PacketStatus::SmallDelta;
-			//Store delta
-			deltas.push_back(delta);
-			//Set next time
-			time = time + delta*250;
+				deltasLen ++;
+			}
 		}
 		
-		//Check if all previoues ones were equal and this one the firt different
-		if (allsame && lastStatus!=PacketStatus::Reserved && status!=lastStatus)
+		//Check if all previous ones were equal and this one the first different
+		if (allsame && num && status!=lastStatus)
 		{
 			//Anything bigger is worth a run
-			if (statuses.size()>7)
+			if (num>7)
 			{
-				//Write run!
-				/*
-					0                   1
-					0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5
-				       +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
-				       |T| S |       Run Length        |
-				       +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
-					T = 0
-				 */
-				writter.Put(1,0);
-				writter.Put(2,lastStatus);
-				writter.Put(13,statuses.size());
-				//Remove all statuses
-				statuses.clear();
-				//Reset status
-				lastStatus = PacketStatus::Reserved;
+				//Write run
+				if (!putRun())
+					return 0;
+				//Reset
+				num = 0;
 				maxStatus = PacketStatus::NotReceived;
-				allsame = true;
 			} else {
 				//Not same
 				allsame = false;
 			}
 		}
 		
-		//Push back statuses, it will be handled later
-		statuses.push_back(status);
+		//Run length is 13 bits only
+		if (allsame && num==0x1FFF)
+		{
+			//Write run
+			if (!putRun())
+				return 0;
+			//Reset
+			num = 0;
+			maxStatus = PacketStatus::NotReceived;
+		}
+		
+		//Push back status, it will be handled later
+		if (num<14)
+			statuses[num] = status;
+		num++;
 		
 		//If it is bigger
 		if (status>maxStatus)
@@ -434,73 +328,47 @@ DWORD RTCPRTPFeedback::TransportWideFeedbackMessageField::Serialize(BYTE* data,D
 			maxStatus = status;
 		//Store las status
 		lastStatus = status;
-
+		
 		//If they are different already
 		if (!allsame)
 		{
-			//Check 
-			if (maxStatus==PacketStatus::LargeOrNegativeDelta && statuses.size()>6)
+			//While we have enough 2 bit symbols
+			while (maxStatus==PacketStatus::LargeOrNegativeDelta && num>6)
 			{
-				/*
-					0                   1
-					0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5
-				       +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
-				       |T|S|        Symbols            |
-				       +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
-					T = 1
-					S = 1
-				 */
-				writter.Put(1,1);
-				writter.Put(1,1);
-				//Set next 7
-				for (DWORD i=0;i<7;++i)
-				{
-					//Write
-					writter.Put(2,(BYTE)statuses.front());
-					//Remove
-					statuses.pop_front();
-				}
-				//REset
+				//Write next 7
+				if (!putVector(true,7))
+					return 0;
+				//Move the rest
+				num -= 7;
+				memmove(statuses,statuses+7,num*sizeof(PacketStatus));
+				//Reset
 				lastStatus = PacketStatus::Reserved;
 				maxStatus = PacketStatus::NotReceived;
 				allsame = true;
-				// We need to restore the values, as there may be more elements on the buffer
-				for (auto it = statuses.begin(); it!=statuses.end(); ++it)
+				//We need to restore the values, as there may be more elements on the buffer
+				for (DWORD i=0;i<num;++i)
 				{
-					//Get status
-					status = *it;
 					//If it is bigger
-					if (status>maxStatus)
+					if (statuses[i]>maxStatus)
 						//Store it
-						maxStatus = status;
+						maxStatus = statuses[i];
 					//Check if it is the same
-					if (allsame && lastStatus!=PacketStatus::Reserved && status!=lastStatus)
-						//not the same
+					if (lastStatus!=PacketStatus::Reserved && statuses[i]!=lastStatus)
+						//Not the same
 						allsame = false;
 					//Store las status
-					lastStatus = status;
+					lastStatus = statuses[i];
 				}
-			} else if (statuses.size()>13) {
-				/*
-					0                   1
-					0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5
-				       +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
-				       |T|S|       symbol list         |
-				       +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
-					 T = 1
-					 S = 0
-				 */
-				writter.Put(1,1);
-				writter.Put(1,0);
-				//Set next 7
-				for (DWORD i=0;i<14;++i)
-				{
-					//Write
-					writter.Put(1,(BYTE)statuses.front());
-					//Remove
-					statuses.pop_front();
-				}
-				//REset
+			}
+			
+			//If we have enough 1 bit symbols
+			if (!allsame && num>13)
+			{
+				//Write them
+				if (!putVector(false,14))
+					return 0;
+				//Reset
+				num = 0;
 				lastStatus = PacketStatus::Reserved;
 				maxStatus = PacketStatus::NotReceived;
 				allsame = true;
@@ -509,215 +377,190 @@ DWORD RTCPRTPFeedback::TransportWideFeedbackMessageField::Serialize(BYTE* data,D
 	}
 	
 	//If not finished yet
-	if (statuses.size()>0)
+	if (num)
 	{
 		//How big was the same run
 		if (allsame)
 		{
-			//Write run!
-			writter.Put(1,0);
-			writter.Put(2,lastStatus);
-			writter.Put(13,statuses.size());
+			//Write run
+			if (!putRun())
+				return 0;
 		} else if (maxStatus==PacketStatus::LargeOrNegativeDelta) {
-			//Write chunk
-			writter.Put(1,1);
-			writter.Put(1,1);
-			//Wirte rest
-			for (std::list<PacketStatus>::iterator it = statuses.begin(); it!= statuses.end(); ++it)
-				//Write
-				writter.Put(2,(BYTE)*it);
-			//Write pending
-			writter.Put(14-statuses.size()*2,0);
+			//Write 2 bits chunk
+			if (!putVector(true,num))
+				return 0;
 		} else {
-			//Write chunck
-			writter.Put(1,1);
-			writter.Put(1,0);
-			//Wirte rest
-			for (std::list<PacketStatus>::iterator it = statuses.begin(); it!= statuses.end(); ++it)
-				//Write
-				writter.Put(1,(BYTE)*it);
-			//Write pending
-			writter.Put(14-statuses.size(),0);
+			//Write 1 bit chunk
+			if (!putVector(false,num))
+				return 0;
 		}
 	}
 	
-	//Flush wirtter and aling, count also header
-	DWORD len = writter.Flush()+8;
+	//Get total length with deltas and zero padding to DWORD boundary
+	DWORD total = pad32(len+deltasLen);
+	
+	//If only calculating size
+	if (!data)
+		//Done
+		return total;
+	
+	//Check size
+	if (total>size)
+		return 0;
+	
+	//Reset temporal info to calculate deltas again
+	firstReceived = false;
 	
-	//Write now the deltas
-	for (std::list<int>::iterator it = deltas.begin(); it!=deltas.end(); ++it)
+	//For each packet 
+	for (const auto& packet : packets)
 	{
+		//If not received
+		if (!packet.second)
+			//Skip
+			continue;
+		//Get delta
+		int delta = getDelta(packet.second);
 		//Check size
-		if (*it<0 || *it>127)
+		if (delta<0 || delta>255)
 		{
 			//2 bytes
-			set2(data,len,(short)*it);
+			set2(data,len,(short)delta);
 			//Inc
 			len += 2;
 		} else {
 			//1 byte
-			set1(data,len,(BYTE)*it);
+			set1(data,len,(BYTE)delta);
 			//Inc
 			len ++;
 		}
 	}
-
+	
 	//Add zero padding
-	while (len%4)
+	while (len<total)
 		//Add padding
 		data[len++] = 0;
+	
+	//Set header now that we have the reference time
+	set2(data,0,packets.front().first);
+	set2(data,2,packets.size());
+	set3(data,4,referenceTime);
+	set1(data,7,feedbackPacketCount);
+	
 	//Done
 	return len;
 }
 
 DWORD RTCPRTPFeedback::TransportWideFeedbackMessageField::Parse(const BYTE* data,DWORD size)
 {
-	//Create the  status count
-	std::vector<PacketStatus> statuses;
-	
 	if (size<8) return 0;
 	
 	//This are temporal, only packet list count
-	//We use DWORDs instead of WORD to allow sequence wrapping without perturving maps
-	DWORD baseSeqNumber	= get2(data,0);
+	WORD baseSeqNumber	= get2(data,0);
 	WORD packetStatusCount	= get2(data,2);
 	//Get reference time
 	referenceTime		= get3(data,4);
 	//Store packet count
 	feedbackPacketCount	= get1(data,7);
-
-	//Rseserve initial space
-	statuses.reserve(packetStatusCount);
-
+	
 	//Where we are 
 	DWORD len = 8;
-	//Get all
-	while (statuses.size()<packetStatusCount)
+	//Number of statuses on the chunks so far
+	DWORD count = 0;
+	
+	//Walk the chunk array first to know where the receive deltas start
+	while (count<packetStatusCount)
 	{
 		//Ensure we have enought
 		if (len+2>size)
 			return 0;
-		
 		//Get chunk
 		WORD chunk = get2(data,len);
 		//Skip it
 		len += 2;
-		
-		//Check packet type
-		if (chunk>>15) 
-		{
-			//Debug("-Chunk %x\n",chunk);
-			/*
-				0                   1
-				0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5
-			       +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
-			       |T|S|       symbol list         |
-			       +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
-				 T = 1
-			*/ 
-			//Get status size
-			if (chunk>>14 & 1)
-			{
-				//Debug("-2 bits states\n");
-				//S=1 => 7 states, 2 bits per state
-				for (DWORD j=0;j<7;++j)
-				{
-					//Get status
-					PacketStatus status = (PacketStatus)((chunk >> 2 * (7 - 1 - j)) & 0x03);
-					//Debug("-status %d\n",status);
-					//Push it back
-					statuses.push_back(status);
-					
-				}
-			} else {
-				//Debug("-1 bits states\n");
-				//S=> 14 states, 1 bit per state
-				for (DWORD j=0;j<14;++j)
-				{
-					//Get status
-					PacketStatus status = (PacketStatus)((chunk >> (14 - 1 - j)) & 0x01);
-					//Debug("-status %d\n",status);
-					//Push it back
-					statuses.push_back(status);
-					
-				}
-			}
-
-		} else {
-			
-			/*
-				0                   1
-				0 1 2 3 4 5 6 7 8 9 0 1 2 3 4 5
-			       +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
-			       |T| S |       Run Length        |
-			       +-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+-+
-				T = 0
-			 */
-			//Get status
-			PacketStatus status = (PacketStatus)(chunk>>13) ;
-			//Run lengh
-			WORD run = chunk & 0x1FFF;
-			//Debug("-run %d status %d\n",run,status);
-			//For eachone
-			for (WORD j=0;j<run;++j)
-				//Append it
-				statuses.push_back(status);
-		}
+		//Vector chunks have 7 or 14 symbols, runs have the length
+		count += chunk>>15 ? ((chunk>>14 & 1) ? 7 : 14) : chunk & 0x1FFF;
 	}
+	
+	//Delta position
+	DWORD pos = len;
+	//Reference time in us
 	QWORD time = referenceTime * 64000;
-	//::Dump4(data+len,size-len);
-	//For each packet
-	for (DWORD i=0;i<packetStatusCount;++i)
+	
+	//Reuse packet list
+	packets.clear();
+	packets.reserve(packetStatusCount);
+	
+	//Current chunk
+	DWORD i = 0;
+	//For each chunk
+	for (DWORD chunkPos = 8; i<packetStatusCount; chunkPos+=2)
 	{
-		//Depending on the status
-		switch (statuses[i])
+		//Get chunk
+		WORD chunk = get2(data,chunkPos);
+		//Get number of symbols
+		DWORD num = chunk>>15 ? ((chunk>>14 & 1) ? 7 : 14) : chunk & 0x1FFF;
+		
+		//For each symbol in chunk
+		for (DWORD j=0; j<num && i<packetStatusCount; ++j, ++i)
 		{
-			case PacketStatus::NotReceived:
-				//Append not received
-				packets[baseSeqNumber+i] = 0;
-				break;
-			case PacketStatus::SmallDelta:
-			{
-				//Check size
-				if (len+1>size)
-					return 0;
-				//Read 1 length delta
-				int delta = get1(data,len)* 250 ;
-				//Add it to time
-				time += delta;
-				//Increase delta
-				len += 1;
-				//Append it
-				packets[baseSeqNumber+i] = time;
-				break;
-			}
-			case PacketStatus::LargeOrNegativeDelta:
+			PacketStatus status;
+			
+			//Check chunk type
+			if (!(chunk>>15))
+				//T=0, run length chunk
+				status = (PacketStatus)(chunk>>13 & 0x03);
+			else if (chunk>>14 & 1)
+				//T=1,S=1 => 7 states, 2 bits per state
+				status = (PacketStatus)((chunk >> 2 * (7 - 1 - j)) & 0x03);
+			else
+				//T=1,S=0 => 14 states, 1 bit per state
+				status = (PacketStatus)((chunk >> (14 - 1 - j)) & 0x01);
+			
+			//Transport sequence numbers wrap
+			WORD seqNum = baseSeqNumber+i;
+			
+			//Depending on the status
+			switch (status)
 			{
-				//Check size
-				if (len+2>size)
-					return 0;
-				//Get short delta
-				short aux = get2(data,len);
-				//Read 2 length delta as signed short
-				int delta = aux * 250 ;
-				len += 2;
-				//Increase delta
-				time += delta;
-				//Append it
-				packets[baseSeqNumber+i] = time;
-				break;	
+				case PacketStatus::NotReceived:
+					//Append not received
+					packets.emplace_back(seqNum,0);
+					break;
+				case PacketStatus::SmallDelta:
+					//Check size
+					if (pos+1>size)
+						return 0;
+					//Read 1 length delta
+					time += get1(data,pos) * 250;
+					//Increase delta
+					pos += 1;
+					//Append it
+					packets.emplace_back(seqNum,time);
+					break;
+				case PacketStatus::LargeOrNegativeDelta:
+					//Check size
+					if (pos+2>size)
+						return 0;
+					//Read 2 length delta as signed short
+					time += (short)get2(data,pos) * 250;
+					//Increase delta
+					pos += 2;
+					//Append it
+					packets.emplace_back(seqNum,time);
+					break;	
+				case PacketStatus::Reserved:
+					//Ignore
+					break;
 			}
-			case PacketStatus::Reserved:
-				//Ignore
-				break;
 		}
 	}
+	
 	//Skip zero padding
-	if (len%4)
+	if (pos%4)
 		//DWORD boundary
-		len += 4 - (len%4);
+		pos += 4 - (pos%4);
 	//Parsed
-	return len;
+	return pos;
 }
 
 void RTCPRTPFeedback::TransportWideFeedbackMessageField::Dump() const
@@ -0,0 +1,213 @@
+#include "rtp/RTCPScheduler.h"
+
+#include <algorithm>
+
+#include "log.h"
+#include "tools.h"
+#include "rtp/RTCPReceiverReport.h"
+#include "rtp/RTCPSenderReport.h"
+
+constexpr std::chrono::milliseconds RTCPScheduler::MinInterval;
+constexpr std::chrono::milliseconds RTCPScheduler::MaxInterval;
+
+RTCPScheduler::RTCPScheduler(TimeService& timeService, Sender sender) :
+	timeService(timeService),
+	sender(sender)
+{
+	//Create flush timer, not scheduled
+	timer = timeService.CreateTimer([this](...){
+		//Not scheduled anymore
+		scheduled = 0;
+		//Send all pending blocks
+		Flush();
+	});
+}
+
+RTCPScheduler::~RTCPScheduler()
+{
+	//Stop timer
+	Stop();
+}
+
+void RTCPScheduler::Stop()
+{
+	//Cancel timer
+	if (timer) timer->Cancel();
+	//Nothing scheduled
+	scheduled = 0;
+	//Drop pending blocks
+	pending.clear();
+}
+
+std::chrono::milliseconds RTCPScheduler::GetInterval() const
+{
+	//If we don't have bandwidth or size info yet
+	if (!bandwidth || !avgSize)
+		//Use minimum
+		return MinInterval;
+	
+	//RTCP bandwidth is 5% of the session bandwidth
+	QWORD rtcpBandwidth = bandwidth/20;
+	
+	//Get interval so the average compound size fits in the rtcp bandwidth
+	auto interval = std::chrono::milliseconds(static_cast<QWORD>(avgSize)*8*1000/std::max<QWORD>(rtcpBandwidth,1));
+	
+	//Set min/max limits
+	return std::min(std::max(interval,MinInterval),MaxInterval);
+}
+
+void RTCPScheduler::Schedule(const std::chrono::milliseconds& ms)
+{
+	//Get when we would like to flush
+	QWORD next = timeService.GetNow().count() + ms.count();
+	
+	//If we are already going to flush before that
+	if (scheduled && scheduled<=next)
+		//Nothing to do
+		return;
+	
+	//Store next flush time
+	scheduled = next;
+	
+	//Reschedule
+	timer->Again(ms);
+}
+
+void RTCPScheduler::Enqueue(const RTCPPacket::shared& packet, bool urgent)
+{
+	//Double check
+	if (!packet)
+		return;
+	
+	//Add to pending blocks
+	pending.push_back({packet,static_cast<QWORD>(timeService.GetNow().count())});
+	
+	//Early feedback is sent on next loop iteration, regular ones wait for the report interval
+	Schedule(urgent ? std::chrono::milliseconds(0) : GetInterval());
+}
+
+void RTCPScheduler::Enqueue(const RTCPCompoundPacket::shared& rtcp, bool urgent)
+{
+	//Double check
+	if (!rtcp)
+		return;
+	
+	//Get enqueue time
+	QWORD now = timeService.GetNow().count();
+	
+	//Add each packet
+	for (DWORD i=0; i<rtcp->GetPacketCount(); ++i)
+		//Add to pending blocks
+		pending.push_back({rtcp->GetPacket(i),now});
+	
+	//Schedule flush
+	Schedule(urgent ? std::chrono::milliseconds(0) : GetInterval());
+}
+
+void RTCPScheduler::AddDelay(const RTCPPacket::shared& packet, QWORD ms)
+{
+	//Delay since last SR is in 1/65536 seconds
+	DWORD delay = ms*65536/1000;
+	
+	//Add it to the reports of an SR received
+	auto add = [delay](const RTCPReport::shared& report) {
+		if (report->GetLastSR())
+			report->SetDelaySinceLastSR(report->GetDelaySinceLastSR()+delay);
+	};
+	
+	//Depending on the type
+	switch (packet->GetType())
+	{
+		case RTCPPacket::SenderReport:
+		{
+			auto sr = std::static_pointer_cast<RTCPSenderReport>(packet);
+			for (DWORD i=0; i<sr->GetCount(); ++i)
+				add(sr->GetReport(i));
+			break;
+		}
+		case RTCPPacket::ReceiverReport:
+		{
+			auto rr = std::static_pointer_cast<RTCPReceiverReport>(packet);
+			for (DWORD i=0; i<rr->GetCount(); ++i)
+				add(rr->GetReport(i));
+			break;
+		}
+		default:
+			break;
+	}
+}
+
+void RTCPScheduler::Flush()
+{
+	//If nothing to send
+	if (pending.empty())
+		//Done
+		return;
+	
+	//Check if it is a report block
+	auto isReport = [](const RTCPPacket::shared& packet) {
+		return packet->GetType()==RTCPPacket::SenderReport || packet->GetType()==RTCPPacket::ReceiverReport;
+	};
+	
+	//Compound packets must start with a report, so move them first keeping the order
+	std::stable_partition(pending.begin(), pending.end(), [&](const Pending& block) {
+		return isReport(block.packet);
+	});
+	
+	//Get now
+	QWORD now = timeService.GetNow().count();
+	
+	//Current compound packet
+	RTCPCompoundPacket::shared rtcp;
+	DWORD size = 0;
+	
+	//For each pending block
+	for (const auto& [packet,enqueued] : pending)
+	{
+		//If it has been delayed
+		if (now>enqueued)
+			//Account it on the report blocks
+			AddDelay(packet,now-enqueued);
+		//Get block size
+		DWORD len = packet->GetSize();
+		
+		//If it doesn't fit in current compound
+		if (rtcp && size+len>MaxCompoundSize)
+		{
+			//Send it
+			sender(rtcp);
+			//Update average compound size
+			avgSize = avgSize ? (avgSize*15 + size)/16 : size;
+			//One more
+			totalCompounds++;
+			//Start new one
+			rtcp.reset();
+		}
+		//If starting a new compound
+		if (!rtcp)
+		{
+			//Create it
+			rtcp = RTCPCompoundPacket::Create();
+			size = 0;
+			//If there are no reports left, start it with an empty one as required by RFC 3550
+			if (!isReport(packet))
+				size += rtcp->CreatePacket<RTCPReceiverReport>(ssrc)->GetSize();
+		}
+		//Append block
+		rtcp->AddPacket(packet);
+		//Increase size
+		size += len;
+		//One more
+		totalBlocks++;
+	}
+	
+	//Send last one
+	sender(rtcp);
+	//Update average compound size
+	avgSize = avgSize ? (avgSize*15 + size)/16 : size;
+	//One more
+	totalCompounds++;
+	
+	//Clear pending blocks
+	pending.clear();
+}
@@ -2,10 +2,9 @@
 
 	
 RTPIncomingMediaStreamMultiplexer::RTPIncomingMediaStreamMultiplexer(DWORD ssrc,TimeService& timeService) :
+	RTPStreamFanOut(ssrc),
 	timeService(timeService)
 {
-	//Store type
-	this->ssrc = ssrc;
 }
 
 void RTPIncomingMediaStreamMultiplexer::Stop()
@@ -14,32 +13,12 @@ void RTPIncomingMediaStreamMultiplexer::Stop()
 	timeService.Async([=](...){}).wait();
 }
 
-void RTPIncomingMediaStreamMultiplexer::AddListener(RTPIncomingMediaStream::Listener* listener) 
-{
-	Debug("-RTPIncomingMediaStreamMultiplexer::AddListener() [listener:%p,this:%p]\n",listener,this);
-		
-	ScopedLock scoped(listenerMutex);
-	listeners.insert(listener);
-}
-
-void RTPIncomingMediaStreamMultiplexer::RemoveListener(RTPIncomingMediaStream::Listener* listener) 
-{
-	Debug("-RTPIncomingMediaStreamMultiplexer::RemoveListener() [listener:%p]\n",listener);
-		
-	ScopedLock scoped(listenerMutex);
-	listeners.erase(listener);
-}
-
 void RTPIncomingMediaStreamMultiplexer::onRTP(RTPIncomingMediaStream* stream,const RTPPacket::shared& packet)
 {
 	//Dispatch in thread async
 	timeService.Async([=](...){
-		//Block listeners
-		ScopedLock scoped(listenerMutex);
-		//Deliver to all listeners
-		for (auto listener : listeners)
-			//Dispatch rtp packet
-			listener->onRTP(this,packet);
+		//Deliver to all transponders and listeners
+		RTPStreamFanOut::onRTP(this,packet);
 	});
 }
 
@@ -47,14 +26,10 @@ void RTPIncomingMediaStreamMultiplexer::onRTP(RTPIncomingMediaStream* stream,con
 {
 	//Dispatch in thread async
 	timeService.Async([=](...){
-		//Block listeners
-		ScopedLock scoped(listenerMutex);
 		//For each packet
 		for (const auto packet : packets)
-			//Deliver to all listeners
-			for (auto listener : listeners)
-				//Dispatch rtp packet
-				listener->onRTP(stream,packet);
+			//Deliver to all transponders and listeners
+			RTPStreamFanOut::onRTP(this,packet);
 	});
 }
 
@@ -63,12 +38,8 @@ void RTPIncomingMediaStreamMultiplexer::onBye(RTPIncomingMediaStream* stream)
 {
 	//Dispatch in thread async
 	timeService.Async([=](...){
-		//Block listeners
-		ScopedLock scoped(listenerMutex);
-		//Deliver to all listeners
-		for (auto listener : listeners)
-			//Dispatch rtp packet
-			listener->onBye(this);
+		//Deliver to all transponders and listeners
+		RTPStreamFanOut::onBye(this);
 	});
 }
 
@@ -77,11 +48,7 @@ void RTPIncomingMediaStreamMultiplexer::onEnded(RTPIncomingMediaStream* stream)
 {
 	//Dispatch in thread async
 	timeService.Async([=](...){
-		//Block listeners
-		ScopedLock scoped(listenerMutex);
-		//Deliver to all listeners
-		for (auto listener : listeners)
-			//Dispatch rtp packet
-			listener->onEnded(this);
+		//Deliver to all transponders and listeners
+		RTPStreamFanOut::onEnded(this);
 	});
 }
@@ -1,6 +1,7 @@
 #include "rtp/RTPIncomingSourceGroup.h"
 
 #include <math.h>
+#include <algorithm>
 
 #include "VideoLayerSelector.h"
 #include "remoterateestimator.h"
@@ -19,6 +20,12 @@ RTPIncomingSourceGroup::RTPIncomingSourceGroup(MediaFrame::Type type,TimeService
 	remoteRateEstimator.SetListener(this);
 	//Create dispatch timer
 	dispatchTimer = timeService.CreateTimer([this](auto now){ DispatchPackets(now.count()); });
+	//Create timer for delayed key frame requests and for resending unanswered ones
+	keyFrameTimer = timeService.CreateTimer([this](auto now){
+		//Only if still needed
+		if (pendingKeyFrameRequest || waitingForKeyFrame)
+			ForwardKeyFrameRequest(getTimeMS());
+	});
 }
 
 RTPIncomingSource* RTPIncomingSourceGroup::GetSource(DWORD ssrc)
@@ -38,6 +45,18 @@ void RTPIncomingSourceGroup::AddListener(RTPIncomingMediaStream::Listener* liste
 		
 	ScopedLock scoped(listenerMutex);
 	listeners.insert(listener);
+	
+	//If we have a cached gop
+	if (gopCache && gopStarted)
+	{
+		//Get cached packets
+		auto cached = GetCachedPackets(LayerInfo::MaxLayerId);
+		
+		Debug("-RTPIncomingSourceGroup::AddListener() | priming from gop cache [listener:%p,packets:%u,size:%u]\n",listener,cached.size(),gopSize);
+		
+		//Deliver them before any new one, so the listener can start from the last key frame
+		listener->onRTP(this,cached);
+	}
 }
 
 void RTPIncomingSourceGroup::RemoveListener(RTPIncomingMediaStream::Listener* listener) 
@@ -114,6 +133,11 @@ void RTPIncomingSourceGroup::Bye(DWORD ssrc)
 		media.Reset();
 		//REset packets
 		ResetPackets();
+		//Cached frames are not valid anymore
+		{
+			ScopedLock scoped(listenerMutex);
+			ClearGOPCache();
+		}
 		//Reset 
 		{
 			//Block listeners
@@ -129,6 +153,8 @@ void RTPIncomingSourceGroup::Bye(DWORD ssrc)
 	} else if (ssrc == fec.ssrc) {
 		//Reset source
 		fec.Reset();
+		//Drop pending repairs
+		fecDecoder.Reset();
 	}
 }
 
@@ -137,6 +163,8 @@ void RTPIncomingSourceGroup::ResetPackets()
 	//Reset packet queue and lost count
 	packets.Reset();
 	losts.Reset();
+	//Stored media and repairs are from previous stream
+	fecDecoder.Reset();
 	//Reset stats
 	lost = 0;
 	minWaitedTime = 0;
@@ -233,6 +261,9 @@ void RTPIncomingSourceGroup::DispatchPackets(uint64_t time)
 	{
 		//Block listeners
 		ScopedLock scoped(listenerMutex);
+		//Store them for new listeners
+		if (gopCache)
+			UpdateGOPCache(ordered);
 		//Deliver to all listeners
 		for (auto listener : listeners)
 			//Dispatch rtp packet
@@ -247,8 +278,9 @@ void RTPIncomingSourceGroup::DispatchPackets(uint64_t time)
 
 void RTPIncomingSourceGroup::Stop()
 {
-	//Stop timer
+	//Stop timers
 	dispatchTimer->Cancel();
+	keyFrameTimer->Cancel();
 	
 	ScopedLock scoped(listenerMutex);
 	
@@ -289,6 +321,10 @@ RTPIncomingSource* RTPIncomingSourceGroup::Process(RTPPacket::shared &packet)
 		ScopedLock scoped(*source);
 		//Update source and layer info
 		source->Update(time, packet->GetSeqNum(), packet->GetRTPHeader().GetSize() + packet->GetMediaLength(), info);
+		//If it is an intra frame from the publisher
+		if (source==&media && packet->IsKeyFrame())
+			//Any outstanding request has been served
+			onKeyFrame(time);
 	} else {
 		//Lock sources accumulators
 		ScopedLock scoped(*source);
@@ -307,6 +343,195 @@ RTPIncomingSource* RTPIncomingSourceGroup::Process(RTPPacket::shared &packet)
 }
 
 
+QWORD RTPIncomingSourceGroup::GetKeyFrameInterval() const
+{
+	//A key frame can't arrive before a full round trip, so don't ask more often than that
+	return std::max<QWORD>(kMinKeyFrameInterval,2*rtt);
+}
+
+bool RTPIncomingSourceGroup::RequestKeyFrame(QWORD now)
+{
+	//One more requested
+	requestedPLIs++;
+	
+	//Get when we are allowed to request again
+	QWORD next = std::max(lastForwardedPLI,lastKeyFrame) + GetKeyFrameInterval();
+	
+	//If not requested recently
+	if (!lastForwardedPLI || now>=next)
+	{
+		//Send it now
+		ForwardKeyFrameRequest(now);
+		return true;
+	}
+	
+	//If we are already waiting for one, the listener will get it too
+	if (waitingForKeyFrame)
+	{
+		//Coalesce
+		UltraDebug("-RTPIncomingSourceGroup::RequestKeyFrame() | coalesced with outstanding request [ssrc:%u]\n",media.ssrc);
+		//Not sent
+		return false;
+	}
+	
+	//We got a key frame recently, request it when the interval expires
+	if (!pendingKeyFrameRequest)
+	{
+		//Delay it
+		pendingKeyFrameRequest = true;
+		keyFrameTimer->Again(std::chrono::milliseconds(next-now));
+	}
+	
+	UltraDebug("-RTPIncomingSourceGroup::RequestKeyFrame() | delayed [ssrc:%u,ms:%llu]\n",media.ssrc,next-now);
+	//Not sent yet
+	return false;
+}
+
+void RTPIncomingSourceGroup::ForwardKeyFrameRequest(QWORD now)
+{
+	Debug("-RTPIncomingSourceGroup::ForwardKeyFrameRequest() [ssrc:%u,requested:%u,forwarded:%u]\n",media.ssrc,requestedPLIs,forwardedPLIs);
+	
+	//Not pending anymore
+	pendingKeyFrameRequest = false;
+	//Outstanding until the key frame arrives
+	waitingForKeyFrame = true;
+	//Send it again if it is lost or not answered in time
+	keyFrameTimer->Again(std::chrono::milliseconds(GetKeyFrameInterval()));
+	lastForwardedPLI = now;
+	//Update stats
+	forwardedPLIs++;
+	media.lastPLI = getTime();
+	media.totalPLIs++;
+	
+	//Send it
+	if (keyFrameRequester)
+		keyFrameRequester(media.ssrc);
+}
+
+void RTPIncomingSourceGroup::onKeyFrame(QWORD now)
+{
+	//If it was not requested
+	if (!waitingForKeyFrame)
+		//Just store time
+		return (void)(lastKeyFrame = now);
+	
+	UltraDebug("-RTPIncomingSourceGroup::onKeyFrame() | outstanding request served [ssrc:%u,ms:%llu]\n",media.ssrc,now-lastForwardedPLI);
+	
+	//Served
+	waitingForKeyFrame = false;
+	lastKeyFrame = now;
+	//Do not resend it
+	keyFrameTimer->Cancel();
+}
+
+void RTPIncomingSourceGroup::SetGOPCache(bool enabled, DWORD maxSize)
+{
+	Debug("-RTPIncomingSourceGroup::SetGOPCache() [enabled:%d,maxSize:%u]\n",enabled,maxSize);
+	
+	//Block listeners
+	ScopedLock scoped(listenerMutex);
+	
+	//Store config
+	gopCache = enabled;
+	gopMaxSize = maxSize;
+	
+	//Start again
+	ClearGOPCache();
+}
+
+void RTPIncomingSourceGroup::ClearGOPCache()
+{
+	gop.clear();
+	gopSize = 0;
+	gopStarted = false;
+}
+
+std::vector<RTPPacket::shared> RTPIncomingSourceGroup::GetGOPCache(BYTE maxSpatialLayerId)
+{
+	//Block listeners
+	ScopedLock scoped(listenerMutex);
+	
+	//Get them
+	return GetCachedPackets(maxSpatialLayerId);
+}
+
+std::vector<RTPPacket::shared> RTPIncomingSourceGroup::GetCachedPackets(BYTE maxSpatialLayerId) const
+{
+	std::vector<RTPPacket::shared> cached;
+	
+	//Get all layers up to the requested one
+	for (const auto& entry : gop)
+		if (entry.first<=maxSpatialLayerId && !entry.second.dropped)
+			cached.insert(cached.end(),entry.second.packets.begin(),entry.second.packets.end());
+	
+	//Interleave them back in sequence order
+	std::sort(cached.begin(),cached.end(),[](const RTPPacket::shared& a, const RTPPacket::shared& b){
+		return a->GetExtSeqNum()<b->GetExtSeqNum();
+	});
+	
+	return cached;
+}
+
+void RTPIncomingSourceGroup::UpdateGOPCache(const std::vector<RTPPacket::shared>& ordered)
+{
+	for (const auto& packet : ordered)
+	{
+		//Get layer, parsed already when processed
+		LayerInfo info = VideoLayerSelector::GetLayerIds(packet);
+		//Non layered streams are stored as base layer
+		BYTE spatialLayerId = info.spatialLayerId!=LayerInfo::MaxLayerId ? info.spatialLayerId : 0;
+		
+		//If it is a new key frame
+		if (packet->IsKeyFrame() && (!gopStarted || packet->GetTimestamp()!=gopTimestamp))
+		{
+			//Start new gop
+			ClearGOPCache();
+			gopStarted = true;
+			gopTimestamp = packet->GetTimestamp();
+		}
+		
+		//Wait for the first key frame
+		if (!gopStarted)
+			continue;
+		
+		//Get layer
+		auto& layer = gop[spatialLayerId];
+		
+		//If we have stopped caching this layer
+		if (layer.dropped)
+			continue;
+		
+		//Store it
+		layer.packets.push_back(packet);
+		gopSize += packet->GetMediaLength();
+		
+		//If over the memory cap
+		if (gopSize>gopMaxSize)
+		{
+			//Find highest layer still cached
+			auto it = std::find_if(gop.rbegin(),gop.rend(),[](const auto& entry){ return !entry.second.dropped; });
+			
+			//If it is the base one
+			if (it==gop.rend() || it->first==gop.begin()->first)
+			{
+				Debug("-RTPIncomingSourceGroup::UpdateGOPCache() | gop too big, waiting for next key frame [ssrc:%u,size:%u]\n",media.ssrc,gopSize);
+				//Nothing can be decoded without it
+				ClearGOPCache();
+				continue;
+			}
+			
+			Debug("-RTPIncomingSourceGroup::UpdateGOPCache() | gop too big, dropping layer [ssrc:%u,sid:%u,size:%u]\n",media.ssrc,it->first,gopSize);
+			
+			//Release memory
+			for (const auto& dropped : it->second.packets)
+				gopSize -= dropped->GetMediaLength();
+			it->second.packets.clear();
+			//Don't store more packets of this layer until next key frame
+			it->second.dropped = true;
+		}
+	}
+}
+
 void RTPIncomingSourceGroup::onTargetBitrateRequested(DWORD bitrate)
 {
 	UltraDebug("-RTPIncomingSourceGroup::onTargetBitrateRequested() | [bitrate:%d]\n",bitrate);
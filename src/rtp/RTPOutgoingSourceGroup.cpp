@@ -139,6 +139,18 @@ void RTPOutgoingSourceGroup::onREMB(DWORD ssrc, DWORD bitrate)
 		listener->onREMB(this,ssrc,bitrate);
 }
 
+void RTPOutgoingSourceGroup::onPacketLoss(DWORD ssrc, BYTE fractionLost)
+{
+	//Update loss only if reported for media, not for rtx or fec
+	if (ssrc==media.ssrc)
+		//Store it
+		media.fractionLost = fractionLost;
+
+	ScopedLock scoped(listenersMutex);
+	for (auto listener : listeners)
+		listener->onPacketLoss(this,ssrc,fractionLost);
+}
+
 void RTPOutgoingSourceGroup::Update()
 {
 	Update(getTimeMS());
@@ -0,0 +1,166 @@
+#include "rtp/RTPPacer.h"
+
+#include <algorithm>
+
+#include "log.h"
+
+constexpr double RTPPacer::PacingFactor;
+constexpr std::chrono::milliseconds RTPPacer::Interval;
+constexpr std::chrono::milliseconds RTPPacer::MaxBurst;
+constexpr std::chrono::milliseconds RTPPacer::MaxQueueTime;
+
+RTPPacer::RTPPacer(TimeService& timeService, Sender sender, Padder padder) :
+	timeService(timeService),
+	sender(sender),
+	padder(padder),
+	last(0)
+{
+}
+
+RTPPacer::~RTPPacer()
+{
+	//Stop timer
+	Stop();
+}
+
+void RTPPacer::Start()
+{
+	//If already started
+	if (timer)
+		//Done
+		return;
+	
+	//Init budget time
+	last = timeService.GetNow();
+	
+	//Create process timer
+	timer = timeService.CreateTimer(std::chrono::milliseconds(0),Interval,[this](std::chrono::milliseconds now){
+		//Send queued packets and padding
+		Process(now);
+	});
+}
+
+void RTPPacer::Stop()
+{
+	//Cancel timer
+	if (timer) timer->Cancel();
+	//Not started
+	timer = nullptr;
+	//Drop queued packets
+	for (auto& queue : queues)
+		queue.clear();
+}
+
+DWORD RTPPacer::GetQueuedPackets() const
+{
+	DWORD num = 0;
+	//Sum all queues
+	for (const auto& queue : queues)
+		num += queue.size();
+	//Done
+	return num;
+}
+
+std::chrono::milliseconds RTPPacer::GetQueueTime() const
+{
+	std::chrono::milliseconds oldest = timeService.GetNow();
+	//Get oldest packet in queues
+	for (const auto& queue : queues)
+		if (!queue.empty())
+			oldest = std::min(oldest,queue.front().time);
+	//Return how much it has been waiting
+	return timeService.GetNow() - oldest;
+}
+
+void RTPPacer::Refill(std::chrono::milliseconds now)
+{
+	//Get pacing rate in bytes per ms
+	int64_t rate = static_cast<int64_t>(bitrate*PacingFactor/8000);
+	
+	//If not pacing
+	if (!rate)
+	{
+		//Don't accumulate debt or budget
+		budget = 0;
+		last = now;
+		return;
+	}
+	
+	//Add budget for elapsed time
+	budget += rate * (now - last).count();
+	
+	//Do not allow more than a burst
+	budget = std::min<int64_t>(budget, rate * MaxBurst.count());
+	
+	//Store time
+	last = now;
+}
+
+DWORD RTPPacer::SendPacket(RTPPacket::shared&& packet)
+{
+	//Send it
+	DWORD len = sender(std::move(packet));
+	//Consume budget
+	budget -= len;
+	//Done
+	return len;
+}
+
+void RTPPacer::Enqueue(MediaFrame::Type type, RTPPacket::shared&& packet)
+{
+	//Get now
+	auto now = timeService.GetNow();
+	
+	//Update budget
+	Refill(now);
+	
+	//Audio bypasses the pacer, and everything if we don't have a target yet
+	if (type==MediaFrame::Audio || !bitrate || !timer)
+	{
+		//Send it now
+		SendPacket(std::move(packet));
+		//Done
+		return;
+	}
+	
+	//Get queue
+	auto& queue = queues[type==MediaFrame::Video ? MediaFrame::Video : MediaFrame::Text];
+	
+	//If we have budget and nothing is waiting before it
+	if (budget>0 && !GetQueuedPackets())
+	{
+		//Send it now
+		SendPacket(std::move(packet));
+		//Done
+		return;
+	}
+	
+	//Wait for budget
+	queue.push_back({std::move(packet),now});
+}
+
+void RTPPacer::Process(std::chrono::milliseconds now)
+{
+	//Update budget
+	Refill(now);
+	
+	//Drain queues in priority order
+	for (auto& queue : queues)
+	{
+		//While there is something queued
+		while (!queue.empty())
+		{
+			//Check if we can send more, or if it has been waiting too long
+			if (budget<=0 && bitrate && now-queue.front().time<MaxQueueTime)
+				//Wait for next interval
+				return;
+			//Send it
+			SendPacket(std::move(queue.front().packet));
+			//Remove
+			queue.pop_front();
+		}
+	}
+	
+	//Nothing queued, offer remaining budget for padding
+	padder(budget>0 ? budget : 0);
+}
@@ -195,6 +195,31 @@ RTPPacket::shared RTPPacket::Parse(const BYTE* data, DWORD size, const RTPMap& r
 
 
 DWORD RTPPacket::Serialize(BYTE* data,DWORD size,const RTPMap& extMap) const
+{
+	const BYTE* payload = nullptr;
+	DWORD payloadLen = 0;
+	
+	//Serialize headers and rewritten descriptors, get the payload slice to append
+	DWORD len = SerializeHeaders(data,size,extMap,payload,payloadLen);
+	
+	//Check
+	if (!len)
+		//Error
+		return 0;
+	
+	//Ensure we have enougth data
+	if (len+payloadLen>size)
+		//Error
+		return Error("-RTPPacket::Serialize() | Media overflow\n");
+	
+	//Flatten the shared payload, this is the only payload copy
+	memcpy(data+len,payload,payloadLen);
+	
+	//Return copied len
+	return len+payloadLen;
+}
+
+DWORD RTPPacket::SerializeHeaders(BYTE* data,DWORD size,const RTPMap& extMap,const BYTE* &payload,DWORD &payloadLen) const
 {
 	//Serialize header
 	uint32_t len = header.Serialize(data,size);
@@ -202,7 +227,7 @@ DWORD RTPPacket::Serialize(BYTE* data,DWORD size,const RTPMap& extMap) const
 	//Check
 	if (!len)
 		//Error
-		return Error("-RTPPacket::Serialize() | Error serializing rtp headers\n");
+		return Error("-RTPPacket::SerializeHeaders() | Error serializing rtp headers\n");
 
 	//If we have extension
 	if (header.extension)
@@ -212,57 +237,77 @@ DWORD RTPPacket::Serialize(BYTE* data,DWORD size,const RTPMap& extMap) const
 		//Comprobamos que quepan
 		if (!n)
 			//Error
-			return Error("-RTPPacket::Serialize() | Error serializing rtp extension headers\n");
+			return Error("-RTPPacket::SerializeHeaders() | Error serializing rtp extension headers\n");
 		//Inc len
 		len += n;
 	}
-
-	//Ensure we have enougth data
-	if (len+GetMediaLength()>size)
-		//Error
-		return Error("-RTPPacket::Serialize() | Media overflow\n");
 	
 	//If we have osn
 	if (osn)
 	{
+		//Check size
+		if (len+2>size)
+			//Error
+			return Error("-RTPPacket::SerializeHeaders() | Media overflow\n");
 		//And set the original seq
 		set2(data, len, osn);
 		//Move payload start
 		len += 2;
 	}
 	
+	//By default whole media payload is appended as it is
+	payload = GetMediaData();
+	payloadLen = GetMediaLength();
+	
+	//Original descriptor length to skip from payload
+	uint32_t descLen = 0;
+	
 	//If we need to rewrite the vp8 descriptor
 	if (rewitePictureIds && vp8PayloadDescriptor)
 	{
 		//Get current vp8 descriptor length
-		uint32_t descLen = vp8PayloadDescriptor->GetSize();
+		descLen = vp8PayloadDescriptor->GetSize();
 		//Copy the descriptor
 		auto vp8NewPayloadDescriptor = vp8PayloadDescriptor.value();
 		//Always store it as two bytes
+		vp8NewPayloadDescriptor.extendedControlBitsPresent = 1;
 		vp8NewPayloadDescriptor.pictureIdPresent = 1;
 		vp8NewPayloadDescriptor.pictureIdLength = 2;
+		//Check size
+		if (len+vp8NewPayloadDescriptor.GetSize()>size)
+			//Error
+			return Error("-RTPPacket::SerializeHeaders() | Media overflow\n");
 		//Write it back
 		len += vp8NewPayloadDescriptor.Serialize(data+len,size-len);
-		
-		//Check size
-		if (descLen>GetMediaLength())
+	//If we need to rewrite the vp9 descriptor
+	} else if (rewitePictureIds && vp9PayloadDescriptor) {
+		//Get current vp9 descriptor length
+		descLen = vp9PayloadDescriptor->GetSize();
+		//Copy the descriptor
+		auto vp9NewPayloadDescription = vp9PayloadDescriptor.value();
+		//Always store it as 15 bits
+		vp9NewPayloadDescription.pictureIdPresent = 1;
+		vp9NewPayloadDescription.extendedPictureIdPresent = 1;
+		//Write it back
+		DWORD n = vp9NewPayloadDescription.Serialize(data+len,size-len);
+		//Check
+		if (!n)
 			//Error
-			return Error("-RTPPacket::Serialize() | Wrong vp8PayloadDescriptor when rewriting pict ids\n");
-		
-		//Copy media payload without the old description
-		memcpy(data+len,GetMediaData()+descLen,GetMediaLength()-descLen);
-		//Inc payload len
-		len += GetMediaLength()-descLen;
-		
-	} else {
-		//Copy media payload
-		memcpy(data+len,GetMediaData(),GetMediaLength());
-		//Inc payload len
-		len += GetMediaLength();
+			return Error("-RTPPacket::SerializeHeaders() | Media overflow\n");
+		//Inc len
+		len += n;
 	}
 	
+	//Check size
+	if (descLen>payloadLen)
+		//Error
+		return Error("-RTPPacket::SerializeHeaders() | Wrong payload descriptor when rewriting pict ids\n");
+	
+	//Skip the old description from the payload slice
+	payload += descLen;
+	payloadLen -= descLen;
 	
-	//Return copied len
+	//Return header length
 	return len;
 }
 
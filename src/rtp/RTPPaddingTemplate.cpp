@@ -0,0 +1,115 @@
+#include "rtp/RTPPaddingTemplate.h"
+
+#include <cstring>
+
+#include "tools.h"
+
+constexpr BYTE RTPPaddingTemplate::MaxPadding;
+
+bool RTPPaddingTemplate::Build(DWORD ssrc, BYTE payloadType, BYTE transportWideCCId, BYTE absSendTimeId)
+{
+	//Reset
+	buffer.fill(0);
+	headerLen = 0;
+	transportWideCCOffset = 0;
+	absSendTimeOffset = 0;
+	
+	//Only one-byte header ids are supported
+	if ((transportWideCCId!=RTPMap::NotFound && (!transportWideCCId || transportWideCCId>14)) || (absSendTimeId!=RTPMap::NotFound && (!absSendTimeId || absSendTimeId>14)))
+		//Error
+		return false;
+	
+	//Store config
+	this->ssrc		= ssrc;
+	this->payloadType	= payloadType;
+	this->transportWideCCId	= transportWideCCId;
+	this->absSendTimeId	= absSendTimeId;
+	
+	//Check if we need extensions
+	bool extension = transportWideCCId!=RTPMap::NotFound || absSendTimeId!=RTPMap::NotFound;
+	
+	//Version 2 with padding and no csrcs
+	buffer[0] = 0xA0 | (extension ? 0x10 : 0x00);
+	//No mark
+	buffer[1] = payloadType & 0x7F;
+	//Set ssrc, seq num and timestamp are set on fill
+	set4(buffer.data(),8,ssrc);
+	
+	DWORD len = 12;
+	
+	//If we have extensions
+	if (extension)
+	{
+		//Set one byte header magic
+		set2(buffer.data(),len,0xBEDE);
+		//Extension start
+		DWORD ini = len;
+		//Skip header
+		len += 4;
+		
+		//Same order than RTPHeaderExtension
+		if (absSendTimeId!=RTPMap::NotFound)
+		{
+			//Id and length-1
+			buffer[len++] = absSendTimeId<<4 | 2;
+			//Store offset
+			absSendTimeOffset = len;
+			//Skip value
+			len += 3;
+		}
+		
+		if (transportWideCCId!=RTPMap::NotFound)
+		{
+			//Id and length-1
+			buffer[len++] = transportWideCCId<<4 | 1;
+			//Store offset
+			transportWideCCOffset = len;
+			//Skip value
+			len += 2;
+		}
+		
+		//Pad to 32 bit words, already zeroed
+		len = ini + pad32(len-ini);
+		
+		//Set length in words
+		set2(buffer.data(),ini+2,(len-ini)/4-1);
+	}
+	
+	//Store header length, padding after it is already zeroed
+	headerLen = len;
+	
+	//Done
+	return true;
+}
+
+DWORD RTPPaddingTemplate::Fill(BYTE* data, DWORD size, WORD seqNum, DWORD timestamp, WORD transportSeqNum, QWORD absSendTime, BYTE padding) const
+{
+	//Get packet length
+	DWORD len = headerLen + padding;
+	
+	//Check it is built and it fits, padding must be at least the length byte
+	if (!headerLen || !padding || len>size)
+		//Error
+		return 0;
+	
+	//Copy header and zeroed padding in one go
+	memcpy(data,buffer.data(),len);
+	
+	//Set sequence number and timestamp
+	set2(data,2,seqNum);
+	set4(data,4,timestamp);
+	
+	//Set extensions
+	if (absSendTimeOffset)
+		//Set 6.18 fixed point from ms
+		set3(data,absSendTimeOffset,((absSendTime << 18) / 1000));
+	if (transportWideCCOffset)
+		//Set transport seq num
+		set2(data,transportWideCCOffset,transportSeqNum);
+	
+	//Set padding size in last byte of the padding
+	data[len-1] = padding;
+	
+	//Done
+	return len;
+}
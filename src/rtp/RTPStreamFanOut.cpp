@@ -0,0 +1,171 @@
+#include "rtp/RTPStreamFanOut.h"
+#include "rtp/RTPStreamTransponder.h"
+
+#include <algorithm>
+
+RTPStreamFanOut::RTPStreamFanOut(DWORD ssrc)
+{
+	//Store ssrc
+	this->ssrc = ssrc;
+}
+
+DWORD RTPStreamFanOut::GetTransponderCount() const
+{
+	DWORD num = 0;
+	//Sum all loops
+	for (const auto& loop : loops)
+		num += loop.transponders.size();
+	//Done
+	return num;
+}
+
+void RTPStreamFanOut::AddListener(RTPIncomingMediaStream::Listener* listener)
+{
+	Debug("-RTPStreamFanOut::AddListener() [listener:%p,this:%p]\n",listener,this);
+	
+	ScopedLock scoped(listenerMutex);
+	
+	//Check if it is a transponder
+	auto transponder = dynamic_cast<RTPStreamTransponder*>(listener);
+	
+	//If it is not or it has no sender
+	if (!transponder || !transponder->GetSender())
+	{
+		//Deliver packets to it directly
+		listeners.insert(listener);
+		//Done
+		return;
+	}
+	
+	//Get the loop of its sender
+	TimeService* timeService = &transponder->GetSender()->GetTimeService();
+	
+	//Find loop group
+	auto it = std::find_if(loops.begin(),loops.end(),[=](const Loop& loop){ return loop.timeService==timeService; });
+	
+	//If not found
+	if (it==loops.end())
+		//Create new group
+		it = loops.insert(loops.end(),Loop{timeService,{}});
+	
+	//Check it was not already added
+	if (std::find(it->transponders.begin(),it->transponders.end(),transponder)!=it->transponders.end())
+		//Done
+		return;
+	
+	//Add it
+	it->transponders.push_back(transponder);
+}
+
+void RTPStreamFanOut::RemoveListener(RTPIncomingMediaStream::Listener* listener)
+{
+	Debug("-RTPStreamFanOut::RemoveListener() [listener:%p]\n",listener);
+	
+	ScopedLock scoped(listenerMutex);
+	
+	//Remove from regular listeners
+	listeners.erase(listener);
+	
+	//Remove from groups
+	for (auto it = loops.begin(); it!=loops.end();)
+	{
+		//Remove transponder keeping the rest contiguous
+		it->transponders.erase(std::remove(it->transponders.begin(),it->transponders.end(),listener),it->transponders.end());
+		
+		//If the loop is empty
+		if (it->transponders.empty())
+			//Remove group
+			it = loops.erase(it);
+		else
+			//Next
+			++it;
+	}
+}
+
+void RTPStreamFanOut::onRTP(RTPIncomingMediaStream* stream,const RTPPacket::shared& packet)
+{
+	//Block listeners
+	ScopedLock scoped(listenerMutex);
+	
+	//For each loop
+	for (auto& loop : loops)
+	{
+		std::vector<std::pair<RTPSender*,RTPStreamTransponder::Rewrite>> batch;
+		
+		//Allocate only once
+		batch.reserve(loop.transponders.size());
+		
+		//For each transponder on same loop
+		for (auto transponder : loop.transponders)
+		{
+			RTPStreamTransponder::Rewrite rewrite;
+			//Calculate header rewrite
+			if (!transponder->Process(packet,rewrite))
+				//Dropped
+				continue;
+			//Get current sender, it is removed from us before being closed
+			RTPSender* sender = transponder->GetSender();
+			//If it is not on this loop anymore
+			if (sender && &sender->GetTimeService()!=loop.timeService)
+				//Send it on its own
+				sender->Enqueue(packet,[=](const RTPPacket::shared& packet) -> RTPPacket::shared {
+					return rewrite.Apply(packet);
+				});
+			else if (sender)
+				//Add to batch
+				batch.emplace_back(sender,rewrite);
+		}
+		
+		//If all dropped
+		if (batch.empty())
+			//Next
+			continue;
+		
+		//Send all of them on the sender loop in one go
+		loop.timeService->Async([packet,batch = std::move(batch)](...){
+			//For each subscriber
+			for (const auto& entry : batch)
+				//Send the rewritten clone
+				entry.first->Send(entry.second.Apply(packet));
+		});
+	}
+	
+	//Deliver to all other listeners
+	for (auto listener : listeners)
+		//Dispatch rtp packet
+		listener->onRTP(this,packet);
+}
+
+void RTPStreamFanOut::onBye(RTPIncomingMediaStream* stream)
+{
+	//Block listeners
+	ScopedLock scoped(listenerMutex);
+	
+	//Deliver to all transponders
+	for (auto& loop : loops)
+		for (auto transponder : loop.transponders)
+			transponder->onBye(this);
+	
+	//Deliver to all listeners
+	for (auto listener : listeners)
+		listener->onBye(this);
+}
+
+void RTPStreamFanOut::onEnded(RTPIncomingMediaStream* stream)
+{
+	//Block listeners
+	ScopedLock scoped(listenerMutex);
+	
+	//Deliver to all transponders
+	for (auto& loop : loops)
+		for (auto transponder : loop.transponders)
+			transponder->onEnded(this);
+	
+	//Deliver to all listeners
+	for (auto listener : listeners)
+		listener->onEnded(this);
+	
+	//They will not remove themselves after the stream has ended
+	loops.clear();
+	listeners.clear();
+}
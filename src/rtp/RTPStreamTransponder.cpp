@@ -12,6 +12,7 @@
  */
 
 #include "rtp/RTPStreamTransponder.h"
+#include "LayerAllocator.h"
 #include "waitqueue.h"
 #include "vp8/vp8.h"
 
@@ -27,7 +28,15 @@ RTPStreamTransponder::RTPStreamTransponder(RTPOutgoingSourceGroup* outgoing,RTPS
 	//Add us as listeners
 	outgoing->AddListener(this);
 	
-	Debug("-RTPStreamTransponder() | [outgoing:%p,sender:%p,ssrc:%u]\n",outgoing,sender,ssrc);
+	//Get the allocator of the sender for video layers
+	if (sender && outgoing->type==MediaFrame::Video)
+		allocator = sender->GetLayerAllocator();
+	
+	//Let it choose our layers
+	if (allocator)
+		allocator->AddTransponder(this);
+	
+	Debug("-RTPStreamTransponder() | [outgoing:%p,sender:%p,ssrc:%u,allocator:%p]\n",outgoing,sender,ssrc,allocator);
 }
 
 
@@ -48,8 +57,10 @@ bool RTPStreamTransponder::SetIncoming(RTPIncomingMediaStream* incoming, RTPRece
         {
                 ScopedLock lock(mutex);
         
-                //Reset packets before start listening again
+                //Reset packets before start listening again, selector will be recreated on next packet
                 reset = true;
+                //New stream needs a new intra
+                primed = false;
 
                 //Store stream and receiver
                 this->incoming = incoming;
@@ -59,13 +70,24 @@ bool RTPStreamTransponder::SetIncoming(RTPIncomingMediaStream* incoming, RTPRece
 	//Double check
 	if (this->incoming)
 	{
-		//Add us as listeners
+		//Add us as listeners, we may get the last key frame from the incoming gop cache
 		this->incoming->AddListener(this);
 		
-		//Request update on the incoming
-		if (this->receiver) this->receiver->SendPLI(this->incoming->GetMediaSSRC());
-		//Update last requested PLI
-		lastSentPLI = getTime();
+		//Check if we have been primed with an intra
+		bool primed;
+		{
+			ScopedLock lock(mutex);
+			primed = this->primed;
+		}
+		
+		//If not
+		if (!primed)
+		{
+			//Request update on the incoming
+			if (this->receiver) this->receiver->SendPLI(this->incoming->GetMediaSSRC());
+			//Update last requested PLI
+			lastSentPLI = getTime();
+		}
 	}
 	
 	Debug("<RTPStreamTransponder::SetIncoming() | [incoming:%p,receiver:%p]\n",incoming,receiver);
@@ -87,11 +109,15 @@ void RTPStreamTransponder::Close()
 	//Stop listeneing
 	if (outgoing) outgoing->RemoveListener(this);
 	if (incoming) incoming->RemoveListener(this);
+	
+	//Stop allocating our layers, not locked as the allocator selects layers with its own lock held
+	if (allocator) allocator->RemoveTransponder(this);
 
 	//Lock
 	ScopedLock lock(mutex);
 
 	//Remove sources
+	allocator = nullptr;
 	outgoing = nullptr;
 	incoming = nullptr;
 	receiver = nullptr;
@@ -101,17 +127,76 @@ void RTPStreamTransponder::Close()
 }
 
 
+RTPPacket::shared RTPStreamTransponder::Rewrite::Apply(const RTPPacket::shared& packet) const
+{
+	//Clone packet, payload is shared
+	auto cloned = packet->Clone();
+	//Set new seq numbers
+	cloned->SetExtSeqNum(extSeqNum);
+	//Set normailized timestamp
+	cloned->SetTimestamp(timestamp);
+	//Set mark again
+	cloned->SetMark(mark);
+	//Change ssrc
+	cloned->SetSSRC(ssrc);
+	//We need to rewrite vp8 picture ids
+	cloned->rewitePictureIds = rewitePictureIds;
+	//Ensure we have desc
+	if (cloned->vp8PayloadDescriptor)
+	{
+		//Rewrite picture id
+		cloned->vp8PayloadDescriptor->pictureId = pictureId & 0x7FFF;
+		//Rewrite tl0 index
+		cloned->vp8PayloadDescriptor->temporalLevelZeroIndex = temporalLevelZeroIndex;
+	}
+	//Same for vp9, descriptor is serialized over the shared payload
+	if (cloned->vp9PayloadDescriptor)
+	{
+		//Rewrite picture id
+		cloned->vp9PayloadDescriptor->pictureId = pictureId & 0x7FFF;
+		//Rewrite tl0 index
+		cloned->vp9PayloadDescriptor->temporalLayer0Index = temporalLevelZeroIndex;
+	}
+	//Move it
+	return cloned;
+}
+
 void RTPStreamTransponder::onRTP(RTPIncomingMediaStream* stream,const RTPPacket::shared& packet)
+{
+	Rewrite rewrite;
+	
+	//Get header rewrite for packet
+	if (!Process(packet,rewrite))
+		//Dropped
+		return;
+	
+	//Send packet
+	if (sender)
+		//Create clone on sender thread
+		sender->Enqueue(packet,[=](const RTPPacket::shared& packet) -> RTPPacket::shared {
+			//Rewrite headers on the clone
+			return rewrite.Apply(packet);
+		});
+}
+
+bool RTPStreamTransponder::Process(const RTPPacket::shared& packet,Rewrite& rewrite)
 {
 	
 	if (!packet)
 		//Exit
-		return;
+		return false;
 	
 	//If muted
 	if (muted)
+	{
+		//Do not leave gaps on the outgoing sequence numbers
+		if (firstExtSeqNum && packet->GetSSRC()==source)
+			dropped++;
+		//Decoder will need an intra after unmuting
+		selector = nullptr;
 		//Skip
-		return;
+		return false;
+	}
 
 	//Check if it is an empty packet
 	if (!packet->GetMediaLength())
@@ -120,21 +205,21 @@ void RTPStreamTransponder::onRTP(RTPIncomingMediaStream* stream,const RTPPacket:
 		//Drop it
 		dropped++;
 		//Exit
-		return;
+		return false;
 	}
 	
 	//Check sender
 	if (!sender)
 		//Nothing
-		return;
+		return false;
 	
 	//Check if source has changed
 	if (source && packet->GetSSRC()!=source)
 		//We need to reset
 		reset = true;
 	
-	//If we need to reset
-	if (reset)
+	//If we need to reset, clearing it first so a new one requested meanwhile is not lost
+	if (reset.exchange(false))
 	{
 		Debug("-StreamTransponder::onRTP() | Reset stream\n");
 		//IF last was not completed
@@ -163,14 +248,18 @@ void RTPStreamTransponder::onRTP(RTPIncomingMediaStream* stream,const RTPPacket:
 		//None dropped or added
 		dropped = 0;
 		added = 0;
+		//New talkspurt
+		silentPackets = 0;
 		//Not selecting
 		selector = nullptr;
 		//No layer
 		spatialLayerId = LayerInfo::MaxLayerId;
 		temporalLayerId = LayerInfo::MaxLayerId;
-		
-		//Reseted
-		reset = false;
+		//Layer stats are from the previous source
+		{
+			ScopedLock scoped(layersMutex);
+			layers.clear();
+		}
 	}
 	
 	//Update source
@@ -212,7 +301,7 @@ void RTPStreamTransponder::onRTP(RTPIncomingMediaStream* stream,const RTPPacket:
 	//Ensure it is not before first one
 	if (extSeqNum<firstExtSeqNum)
 		//Exit
-		return;
+		return false;
 	
 	//Only for viedo
 	if (packet->GetMedia()==MediaFrame::Video)
@@ -231,9 +320,48 @@ void RTPStreamTransponder::onRTP(RTPIncomingMediaStream* stream,const RTPPacket:
 	//Get rtp marking
 	bool mark = packet->GetMark();
 	
+	//If suppressing silence on audio with level info
+	if (silenceSuppression && packet->GetMedia()==MediaFrame::Audio && packet->HasAudioLevel())
+	{
+		//Check if it is silent, muted participants send digital silence
+		if (!packet->GetVAD() || packet->GetLevel()>=silenceLevel)
+		{
+			//One more silent in a row
+			silentPackets++;
+			//Keep the first ones so decoder can fade out, and one per keep alive period
+			if (silentPackets>kSilenceHangover && (silentPackets-kSilenceHangover)%kSilenceKeepAlive)
+			{
+				//Drop it, outgoing seq num will skip it so there is no gap
+				dropped++;
+				suppressed++;
+				return false;
+			}
+		} else {
+			//If we were suppressing
+			if (silentPackets>kSilenceHangover)
+				//Mark begining of talkspurt
+				mark = true;
+			//Speaking
+			silentPackets = 0;
+		}
+	}
+	
 	//If we have selector for codec
 	if (selector)
 	{
+		//Get layer of the packet
+		LayerInfo info = VideoLayerSelector::GetLayerIds(packet);
+		//If it is a layered stream
+		if (info.IsValid())
+		{
+			//Lock layers
+			ScopedLock scoped(layersMutex);
+			//Find layer or create new one
+			auto it = layers.try_emplace(info.GetId(),info).first;
+			//Update incoming bitrate of the layer, even if it is not forwarded
+			it->second.Update(getTimeMS(),packet->GetMediaLength());
+		}
+		
 		//Select layer
 		selector->SelectSpatialLayer(spatialLayerId);
 		selector->SelectTemporalLayer(temporalLayerId);
@@ -248,10 +376,16 @@ void RTPStreamTransponder::onRTP(RTPIncomingMediaStream* stream,const RTPPacket:
 				//Request it again
 				RequestPLI();
 			//Drop
-			return;
+			return false;
 		}
 		//Get current spatial layer id
 		lastSpatialLayerId = selector->GetSpatialLayer();
+		
+		//Forwarding from an intra, checked with the lock held when the incoming is set
+		ScopedLock lock(mutex);
+		//Unless it is from the previous incoming stream
+		if (!reset)
+			primed = true;
 	}
 	
 	//Set normalized seq num
@@ -301,6 +435,34 @@ void RTPStreamTransponder::onRTP(RTPIncomingMediaStream* stream,const RTPPacket:
 		temporalLevelZeroIndex = tl0Idx;
 		//We need to rewrite vp8 picture ids
 		rewitePictureIds = true;
+	} else if (rewritePicId && codec==VideoCodec::VP9 && packet->vp9PayloadDescriptor) {
+		//Get VP9 desc
+		const auto& desc = *packet->vp9PayloadDescriptor;
+		
+		//Check if we have a new pictId, all spatial layers of a picture share it
+		if (desc.pictureIdPresent && desc.pictureId!=lastPicId)
+		{
+			//Update ids
+			lastPicId = desc.pictureId;
+			//Increase picture id
+			picId++;
+		}
+		
+		//Check if we a new base layer, only on non flexible mode
+		if (desc.layerIndicesPresent && !desc.flexibleMode && desc.temporalLayer0Index!=lastTl0Idx)
+		{
+			//Update ids
+			lastTl0Idx = desc.temporalLayer0Index;
+			//Increase tl0 index
+			tl0Idx++;
+		}
+		
+		//Rewrite picture id
+		pictureId = picId;
+		//Rewrite tl0 index
+		temporalLevelZeroIndex = tl0Idx;
+		//We need to rewrite vp9 picture ids
+		rewitePictureIds = true;
 	}
 	
 	//If we have to append h264 sprop parameters set for the first packet of an iframe
@@ -335,33 +497,17 @@ void RTPStreamTransponder::onRTP(RTPIncomingMediaStream* stream,const RTPPacket:
 	//Update last sent time
 	lastTime = getTime();
 	
-	//Send packet
-	if (sender)
-		//Create clone on sender thread
-		sender->Enqueue(packet,[=](const RTPPacket::shared& packet) -> RTPPacket::shared {
-			//Clone packet
-			auto cloned = packet->Clone();
-			//Set new seq numbers
-			cloned->SetExtSeqNum(extSeqNum);
-			//Set normailized timestamp
-			cloned->SetTimestamp(timestamp);
-			//Set mark again
-			cloned->SetMark(mark);
-			//Change ssrc
-			cloned->SetSSRC(ssrc);
-			//We need to rewrite vp8 picture ids
-			cloned->rewitePictureIds = rewitePictureIds;
-			//Ensure we have desc
-			if (cloned->vp8PayloadDescriptor)
-			{
-				//Rewrite picture id
-				cloned->vp8PayloadDescriptor->pictureId = pictureId;
-				//Rewrite tl0 index
-				cloned->vp8PayloadDescriptor->temporalLevelZeroIndex = temporalLevelZeroIndex;
-			}
-			//Move it
-			return std::move(cloned);
-		});
+	//Fill header rewrite
+	rewrite.ssrc			= ssrc;
+	rewrite.extSeqNum		= extSeqNum;
+	rewrite.timestamp		= timestamp;
+	rewrite.mark			= mark;
+	rewrite.rewitePictureIds	= rewitePictureIds;
+	rewrite.pictureId		= pictureId;
+	rewrite.temporalLevelZeroIndex	= temporalLevelZeroIndex;
+	
+	//Forward it
+	return true;
 }
 
 void RTPStreamTransponder::onBye(RTPIncomingMediaStream* stream)
@@ -425,6 +571,51 @@ void RTPStreamTransponder::SelectLayer(int spatialLayerId,int temporalLayerId)
 		RequestPLI();
 }
 
+std::vector<LayerSource> RTPStreamTransponder::GetLayers(QWORD now)
+{
+	std::vector<LayerSource> result;
+	
+	//Lock layers
+	ScopedLock scoped(layersMutex);
+	
+	//For each layer
+	for (auto& entry : layers)
+	{
+		//Expire old data from the window
+		entry.second.acumulator.Update(now);
+		//Update bitrate in bps
+		entry.second.bitrate = entry.second.acumulator.GetInstant()*8;
+		//Copy it
+		result.push_back(entry.second);
+	}
+	
+	return result;
+}
+
+DWORD RTPStreamTransponder::GetLayerBitrate(BYTE spatialLayerId,BYTE temporalLayerId,QWORD now)
+{
+	DWORD bitrate = 0;
+	
+	//Lower layers are needed for decoding the upper ones, so add them all
+	for (const auto& layer : GetLayers(now))
+		//If it is below or at the requested one
+		if (layer.spatialLayerId<=spatialLayerId && layer.temporalLayerId<=temporalLayerId)
+			//Add it
+			bitrate += layer.bitrate;
+	
+	return bitrate;
+}
+
+void RTPStreamTransponder::SetSilenceSuppression(bool enabled, BYTE silenceLevel)
+{
+	Debug("-RTPStreamTransponder::SetSilenceSuppression() [enabled:%d,level:%u]\n",enabled,silenceLevel);
+	
+	//Store level first
+	this->silenceLevel = silenceLevel;
+	//Enable
+	silenceSuppression = enabled;
+}
+
 void RTPStreamTransponder::Mute(bool muting)
 {
 	//Check if we are changing state
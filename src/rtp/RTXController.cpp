@@ -0,0 +1,60 @@
+#include "rtp/RTXController.h"
+
+#include <algorithm>
+
+#include "log.h"
+
+bool RTXController::Accept(WORD seq, QWORD age, DWORD rtt, DWORD rtxBitrate, DWORD availableBitrate, QWORD now)
+{
+	//Get last retransmission of this seq num
+	Resent& resent = history[seq % kHistorySize];
+	
+	//If it was already sent within last rtt
+	if (resent.time && resent.seq==seq && now<resent.time+std::max<QWORD>(rtt,kMinResendInterval))
+	{
+		UltraDebug("-RTXController::Accept() | duplicated nack [seq:%u,ms:%llu,rtt:%u]\n",seq,now-resent.time,rtt);
+		//Still in flight
+		suppressedDuplicates++;
+		return false;
+	}
+	
+	//If we don't have an estimation yet, send everything
+	if (availableBitrate)
+	{
+		//Check if we are sending way to much bitrate
+		if (rtxBitrate>availableBitrate*kMaxRTXRatio)
+		{
+			UltraDebug("-RTXController::Accept() | too much bitrate on rtx [seq:%u,rtx:%u,available:%u]\n",seq,rtxBitrate,availableBitrate);
+			//Don't make congestion worse
+			suppressedBudget++;
+			return false;
+		}
+		//If we are getting close, send only the ones the receiver is still waiting for
+		if (rtxBitrate>availableBitrate*kPreferredRTXRatio && age>rtt+kJitterBufferDelay)
+		{
+			UltraDebug("-RTXController::Accept() | packet too old [seq:%u,age:%llu,rtt:%u]\n",seq,age,rtt);
+			//Probably too late
+			suppressedLate++;
+			return false;
+		}
+	}
+	
+	//Store retransmission
+	resent.seq  = seq;
+	resent.time = now;
+	//One more
+	sent++;
+	
+	return true;
+}
+
+void RTXController::Reset()
+{
+	//Clean history
+	history.fill({});
+	//Reset stats
+	sent = 0;
+	suppressedDuplicates = 0;
+	suppressedBudget = 0;
+	suppressedLate = 0;
+}
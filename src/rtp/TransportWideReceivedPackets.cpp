@@ -0,0 +1,125 @@
+#include "rtp/TransportWideReceivedPackets.h"
+
+constexpr DWORD TransportWideReceivedPackets::Size;
+constexpr DWORD TransportWideReceivedPackets::LateWindow;
+
+void TransportWideReceivedPackets::Reset()
+{
+	//Clear ring
+	times.fill(0);
+	//Not started
+	base = 0;
+	first = 0;
+	reported = 0;
+	last = 0;
+	count = 0;
+	firstTime = 0;
+	started = false;
+}
+
+bool TransportWideReceivedPackets::Fits(DWORD extSeqNum) const
+{
+	//Either late, or inside the window not overlapping the reported ones
+	return !started || extSeqNum<base || extSeqNum-base<Size-LateWindow;
+}
+
+bool TransportWideReceivedPackets::Add(DWORD extSeqNum, QWORD time)
+{
+	//If first one
+	if (!started)
+	{
+		//Start from it
+		base = extSeqNum;
+		first = extSeqNum;
+		last = extSeqNum;
+		started = true;
+	}
+	
+	//Check if it was already reported and too late to report it again
+	if (extSeqNum<base && base-extSeqNum>reported)
+		//Drop
+		return false;
+	
+	//If it is out of the window
+	if (extSeqNum>=base && extSeqNum-base>=Size-LateWindow)
+	{
+		//We can only skip the gap if there is nothing pending
+		if (count)
+			//Caller must flush first
+			return false;
+		//Forget reported ones
+		times.fill(0);
+		reported = 0;
+		//Start again from it
+		base = extSeqNum;
+		first = extSeqNum;
+	}
+	
+	//Get position
+	QWORD& pos = times[extSeqNum & (Size-1)];
+	
+	//If duplicated
+	if (pos)
+		//Ignore
+		return false;
+	
+	//Store receive time
+	pos = time;
+	
+	//If it is the first one on this feedback or older
+	if (!count || time<firstTime)
+		//Store it
+		firstTime = time;
+	
+	//If it was reported as lost, report it again from it
+	if (extSeqNum<first)
+		//Store it
+		first = extSeqNum;
+	
+	//Update max
+	if (extSeqNum>last)
+		//Store it
+		last = extSeqNum;
+	
+	//One more
+	count++;
+	
+	//Added
+	return true;
+}
+
+void TransportWideReceivedPackets::Flush(RTCPRTPFeedback::TransportWideFeedbackMessageField::Packets& packets, QWORD initTime)
+{
+	//If nothing to report
+	if (!count)
+		//Done
+		return;
+	
+	//Reserve space for all, including lost ones
+	packets.reserve(packets.size()+last-first+1);
+	
+	//For each one from the first not reported, as feedback must be contiguous
+	for (DWORD extSeqNum=first; extSeqNum<=last; ++extSeqNum)
+	{
+		//Get position
+		const QWORD pos = times[extSeqNum & (Size-1)];
+		//Add it with time relative to init, or as lost
+		packets.emplace_back(extSeqNum, pos ? pos - initTime : 0);
+	}
+	
+	//Reported ones on the ring, including the new ones
+	DWORD total = reported + last + 1 - base;
+	//Clear the ones out of the late window
+	for (DWORD extSeqNum=base-reported; total>LateWindow; ++extSeqNum, --total)
+		//Clear it
+		times[extSeqNum & (Size-1)] = 0;
+	//Keep the rest
+	reported = total;
+	
+	//Next one to report
+	base = last+1;
+	first = base;
+	//Nothing pending
+	count = 0;
+	firstTime = 0;
+}
@@ -752,6 +752,8 @@ void RTPSession::onRTCPPacket(const BYTE* buffer, DWORD size)
 							//Set it
 							SetRTT(rtt);
 						}
+						//Report loss to the media producers
+						send.onPacketLoss(report->GetSSRC(),report->GetFactionLost());
 					}
 				}
 				break;
@@ -5,50 +5,118 @@
  * Created on 9 de agosto de 2012, 15:26
  */
 #include <string.h>
-#include <emmintrin.h>
+#include <algorithm>
 #include "sidebar.h"
 #include "log.h"
 
 Sidebar::Sidebar()
 {
 	//Alloc alligned
+	accumulator = (int32_t*) malloc32(MIXER_BUFFER_SIZE*sizeof(int32_t));
 	mixer_buffer = (SWORD*) malloc32(MIXER_BUFFER_SIZE*sizeof(SWORD));
+	//Clean
+	Reset();
 }
 
 Sidebar::~Sidebar()
 {
+	free(accumulator);
 	free(mixer_buffer);
 }
 
-int Sidebar::Update(int id,SWORD *samples,DWORD len)
+int Sidebar::Update(int id,SWORD *samples,DWORD len,DWORD vad)
 {
 	//Check size
 	if (len>MIXER_BUFFER_SIZE)
 		//error
 		return Error("-Sidebar error updating particionat, len bigger than mixer max buffer size [len:%d,size:%d]\n",len,MIXER_BUFFER_SIZE);
 
-	//Get pointers to buffer
-	__m128i* d = (__m128i*) mixer_buffer;
-	__m128i* s = (__m128i*) samples;
+	//Add it, samples must be kept until mixed
+	inputs.push_back({id,samples,len,vad});
 
-	//Sum 8 ech time
-	for(DWORD n = (len + 7) >> 3; n != 0; --n,++d,++s)
+	//OK
+	return len;
+}
+
+void Sidebar::Mix(DWORD len,DWORD maxSpeakers)
+{
+	//Check size
+	if (len>MIXER_BUFFER_SIZE)
+		//Set it at most
+		len = MIXER_BUFFER_SIZE;
+
+	//One more
+	mixes++;
+
+	//If we only mix the loudest ones
+	if (maxSpeakers)
 	{
-		//Load data in SSE registers
-		__m128i xmm1 = _mm_load_si128(d);
-		__m128i xmm2 = _mm_load_si128(s);
-		//SSE2 sum
-		_mm_store_si128(d, _mm_add_epi16(xmm1,xmm2));
+		//Selected recently, it is kept while active so speakers near the cutoff do not flap
+		auto isHeld = [this](int id) {
+			auto it = selected.find(id);
+			return it!=selected.end() && mixes<it->second+MIN_SELECTED_MIXES;
+		};
+		//Selected ones have to be beaten by a margin
+		auto getScore = [this](const Input& input) -> QWORD {
+			return selected.count(input.id) ? (QWORD)input.vad*(100+SELECTED_MARGIN)/100 : input.vad;
+		};
+		//Only active ones are candidates
+		auto end = std::partition(inputs.begin(),inputs.end(),[](const Input& input){ return input.vad>0; });
+		//Remove the rest
+		inputs.erase(end,inputs.end());
+		//If there are more active speakers than allowed
+		if (inputs.size()>maxSpeakers)
+		{
+			//Get the held ones first and then the loudest ones
+			std::nth_element(inputs.begin(),inputs.begin()+maxSpeakers,inputs.end(),[&](const Input& a, const Input& b){
+				bool heldA = isHeld(a.id);
+				bool heldB = isHeld(b.id);
+				return heldA!=heldB ? heldA : getScore(a)>getScore(b);
+			});
+			//Drop the others
+			inputs.resize(maxSpeakers);
+		}
+		//Remove the ones not selected anymore
+		for (auto it = selected.begin(); it!=selected.end();)
+		{
+			//Check if it is still on the mix
+			if (std::find_if(inputs.begin(),inputs.end(),[&](const Input& input){ return input.id==it->first; })==inputs.end())
+				it = selected.erase(it);
+			else
+				++it;
+		}
+		//Add new ones, keeping when the others were selected
+		for (const auto& input : inputs)
+			selected.emplace(input.id,mixes);
+	} else {
+		//Everybody is mixed
+		selected.clear();
 	}
 
-	//OK
-	return len;
+	//Sum them on 32 bits so it never wraps
+	for (const auto& input : inputs)
+	{
+		//Sum
+		AudioMixKernel::Accumulate(accumulator,input.samples,input.len);
+		//It is on the mix now
+		mixed.insert(input.id);
+	}
+
+	//Done
+	inputs.clear();
+
+	//Limit back to 16 bits
+	limiter.Process(mixer_buffer,accumulator,len);
 }
 
 void Sidebar::Reset()
 {
-	//zero the mixer buffer
+	//zero the mixer buffers
+	AudioMixKernel::Clear(accumulator,MIXER_BUFFER_SIZE);
 	memset((BYTE*)mixer_buffer, 0, MIXER_BUFFER_SIZE*sizeof(SWORD));
+	//Nobody mixed
+	mixed.clear();
+	inputs.clear();
 }
 
 void Sidebar::AddParticipant(int id)
@@ -59,6 +127,8 @@ void Sidebar::AddParticipant(int id)
 void Sidebar::RemoveParticipant(int id)
 {
 	participants.erase(id);
+	mixed.erase(id);
+	selected.erase(id);
 }
 
 bool Sidebar::HasParticipant(int id)
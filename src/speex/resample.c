@@ -79,6 +79,7 @@ static void speex_free (void *ptr) {free(ptr);}
 
 #include "stack_alloc.h"
 #include <math.h>
+#include <pthread.h>
 
 #ifndef M_PI
 #define M_PI 3.14159263
@@ -555,6 +556,104 @@ static int resampler_basic_interpolate_double(SpeexResamplerState *st, spx_uint3
 }
 #endif
 
+/* Filter banks only depend on the reduced ratio and the quality, so they are
+   computed once and shared by all the resamplers with the same configuration */
+typedef struct SincTable {
+   spx_uint32_t num_rate;
+   spx_uint32_t den_rate;
+   int          quality;
+   spx_uint32_t length;
+   spx_word16_t *table;
+   int          refs;
+   struct SincTable *next;
+} SincTable;
+
+static SincTable *sinc_tables = NULL;
+static pthread_mutex_t sinc_tables_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static void compute_sinc_table(SpeexResamplerState *st, spx_word16_t *sinc_table, int direct)
+{
+   spx_int32_t i;
+   if (direct)
+   {
+      for (i=0;i<(spx_int32_t)st->den_rate;i++)
+      {
+         spx_int32_t j;
+         for (j=0;j<st->filt_len;j++)
+         {
+            sinc_table[i*st->filt_len+j] = sinc(st->cutoff,((j-(spx_int32_t)st->filt_len/2+1)-((float)i)/st->den_rate), st->filt_len, quality_map[st->quality].window_func);
+         }
+      }
+   } else {
+      for (i=-4;i<(spx_int32_t)(st->oversample*st->filt_len+4);i++)
+         sinc_table[i+4] = sinc(st->cutoff,(i/(float)st->oversample - st->filt_len/2), st->filt_len, quality_map[st->quality].window_func);
+   }
+}
+
+static spx_word16_t *acquire_sinc_table(SpeexResamplerState *st, spx_uint32_t length, int direct)
+{
+   SincTable *entry;
+   pthread_mutex_lock(&sinc_tables_mutex);
+   for (entry=sinc_tables;entry;entry=entry->next)
+      if (entry->num_rate==st->num_rate && entry->den_rate==st->den_rate && entry->quality==st->quality)
+         break;
+   if (!entry)
+   {
+      entry = (SincTable *)speex_alloc(sizeof(SincTable));
+      entry->num_rate = st->num_rate;
+      entry->den_rate = st->den_rate;
+      entry->quality = st->quality;
+      entry->length = length;
+      entry->table = (spx_word16_t *)speex_alloc(length*sizeof(spx_word16_t));
+      entry->refs = 0;
+      compute_sinc_table(st, entry->table, direct);
+      entry->next = sinc_tables;
+      sinc_tables = entry;
+   }
+   entry->refs++;
+   st->sinc_table_length = entry->length;
+   pthread_mutex_unlock(&sinc_tables_mutex);
+   return entry->table;
+}
+
+static void release_sinc_table(spx_word16_t *table)
+{
+   SincTable **entry;
+   if (!table)
+      return;
+   pthread_mutex_lock(&sinc_tables_mutex);
+   for (entry=&sinc_tables;*entry;entry=&(*entry)->next)
+   {
+      if ((*entry)->table==table)
+      {
+         /* Free it with the last resampler using it */
+         if (!--(*entry)->refs)
+         {
+            SincTable *unused = *entry;
+            *entry = unused->next;
+            speex_free(unused->table);
+            speex_free(unused);
+         }
+         break;
+      }
+   }
+   pthread_mutex_unlock(&sinc_tables_mutex);
+}
+
+SPX_RESAMPLE_EXPORT void speex_resampler_get_shared_tables(spx_uint32_t *num, spx_uint32_t *bytes, spx_uint32_t *refs)
+{
+   SincTable *entry;
+   *num = *bytes = *refs = 0;
+   pthread_mutex_lock(&sinc_tables_mutex);
+   for (entry=sinc_tables;entry;entry=entry->next)
+   {
+      (*num)++;
+      *bytes += entry->length*sizeof(spx_word16_t);
+      *refs += entry->refs;
+   }
+   pthread_mutex_unlock(&sinc_tables_mutex);
+}
+
 static void update_filter(SpeexResamplerState *st)
 {
    spx_uint32_t old_length;
@@ -593,22 +692,9 @@ static void update_filter(SpeexResamplerState *st)
    if (st->den_rate <= (st->oversample+8))
 #endif
    {
-      spx_uint32_t i;
-      if (!st->sinc_table)
-         st->sinc_table = (spx_word16_t *)speex_alloc(st->filt_len*st->den_rate*sizeof(spx_word16_t));
-      else if (st->sinc_table_length < st->filt_len*st->den_rate)
-      {
-         st->sinc_table = (spx_word16_t *)speex_realloc(st->sinc_table,st->filt_len*st->den_rate*sizeof(spx_word16_t));
-         st->sinc_table_length = st->filt_len*st->den_rate;
-      }
-      for (i=0;i<st->den_rate;i++)
-      {
-         spx_int32_t j;
-         for (j=0;j<st->filt_len;j++)
-         {
-            st->sinc_table[i*st->filt_len+j] = sinc(st->cutoff,((j-(spx_int32_t)st->filt_len/2+1)-((float)i)/st->den_rate), st->filt_len, quality_map[st->quality].window_func);
-         }
-      }
+      /* Drop previous filter, it may be shared */
+      release_sinc_table(st->sinc_table);
+      st->sinc_table = acquire_sinc_table(st, st->filt_len*st->den_rate, 1);
 #ifdef FIXED_POINT
       st->resampler_ptr = resampler_basic_direct_single;
 #else
@@ -619,16 +705,9 @@ static void update_filter(SpeexResamplerState *st)
 #endif
       /*fprintf (stderr, "resampler uses direct sinc table and normalised cutoff %f\n", cutoff);*/
    } else {
-      spx_int32_t i;
-      if (!st->sinc_table)
-         st->sinc_table = (spx_word16_t *)speex_alloc((st->filt_len*st->oversample+8)*sizeof(spx_word16_t));
-      else if (st->sinc_table_length < st->filt_len*st->oversample+8)
-      {
-         st->sinc_table = (spx_word16_t *)speex_realloc(st->sinc_table,(st->filt_len*st->oversample+8)*sizeof(spx_word16_t));
-         st->sinc_table_length = st->filt_len*st->oversample+8;
-      }
-      for (i=-4;i<(spx_int32_t)(st->oversample*st->filt_len+4);i++)
-         st->sinc_table[i+4] = sinc(st->cutoff,(i/(float)st->oversample - st->filt_len/2), st->filt_len, quality_map[st->quality].window_func);
+      /* Drop previous filter, it may be shared */
+      release_sinc_table(st->sinc_table);
+      st->sinc_table = acquire_sinc_table(st, st->filt_len*st->oversample+8, 0);
 #ifdef FIXED_POINT
       st->resampler_ptr = resampler_basic_interpolate_single;
 #else
@@ -794,7 +873,7 @@ SPX_RESAMPLE_EXPORT SpeexResamplerState *speex_resampler_init_frac(spx_uint32_t
 SPX_RESAMPLE_EXPORT void speex_resampler_destroy(SpeexResamplerState *st)
 {
    speex_free(st->mem);
-   speex_free(st->sinc_table);
+   release_sinc_table(st->sinc_table);
    speex_free(st->last_sample);
    speex_free(st->magic_samples);
    speex_free(st->samp_frac_num);
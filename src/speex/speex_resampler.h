@@ -76,6 +76,7 @@
 #define speex_resampler_skip_zeros CAT_PREFIX(RANDOM_PREFIX,_resampler_skip_zeros)
 #define speex_resampler_reset_mem CAT_PREFIX(RANDOM_PREFIX,_resampler_reset_mem)
 #define speex_resampler_strerror CAT_PREFIX(RANDOM_PREFIX,_resampler_strerror)
+#define speex_resampler_get_shared_tables CAT_PREFIX(RANDOM_PREFIX,_resampler_get_shared_tables)
 
 #define spx_int16_t short
 #define spx_int32_t int
@@ -337,6 +338,13 @@ int speex_resampler_reset_mem(SpeexResamplerState *st);
  */
 const char *speex_resampler_strerror(int err);
 
+/** Get the filter banks shared between resamplers with same ratio and quality
+ * @param num Number of filter banks in use
+ * @param bytes Memory used by them
+ * @param refs Number of resamplers using them
+ */
+void speex_resampler_get_shared_tables(spx_uint32_t *num, spx_uint32_t *bytes, spx_uint32_t *refs);
+
 #ifdef __cplusplus
 }
 #endif
@@ -23,7 +23,7 @@ VP9InterPictureDependency::VP9InterPictureDependency()
 	switchingPoint = false;
 }
 
-DWORD VP9InterPictureDependency::GetSize()
+DWORD VP9InterPictureDependency::GetSize() const
 {
 	return 1 + referenceIndexDiff.size();
 }
@@ -49,7 +49,7 @@ DWORD VP9InterPictureDependency::Parse(const BYTE* data, DWORD size)
 	return 1+pdifs;
 }
 
-DWORD VP9InterPictureDependency::Serialize(BYTE *data,DWORD size)
+DWORD VP9InterPictureDependency::Serialize(BYTE *data,DWORD size) const
 {
 	//Check size
 	if (size<GetSize())
@@ -118,7 +118,7 @@ VP9ScalabilityScructure::VP9ScalabilityScructure()
 	groupOfFramesDescriptionPresent = false;
 }
 
-DWORD VP9ScalabilityScructure::GetSize()
+DWORD VP9ScalabilityScructure::GetSize() const
 {
 	//Heder
 	DWORD len =  1;
@@ -209,7 +209,7 @@ DWORD VP9ScalabilityScructure::Parse(const BYTE* data, DWORD size)
 	return len;
 }
 
-DWORD VP9ScalabilityScructure::Serialize(BYTE *data,DWORD size)
+DWORD VP9ScalabilityScructure::Serialize(BYTE *data,DWORD size) const
 {
 	//Check size
 	if (size<GetSize())
@@ -343,7 +343,7 @@ VP9PayloadDescription::VP9PayloadDescription()
 }
 
 
-DWORD VP9PayloadDescription::GetSize()
+DWORD VP9PayloadDescription::GetSize() const
 {
 	//Heder
 	DWORD len =  1;
@@ -363,7 +363,7 @@ DWORD VP9PayloadDescription::GetSize()
 			len += 1;
 	}
 	
-	if (flexibleMode && pictureIdPresent)
+	if (flexibleMode && interPicturePredictedLayerFrame)
 		//n P diffs
 		len += referenceIndexDiff.size();
 	
@@ -498,7 +498,7 @@ DWORD VP9PayloadDescription::Parse(const BYTE* data, DWORD size)
 	return len;
 }
 
-DWORD VP9PayloadDescription::Serialize(BYTE *data,DWORD size)
+DWORD VP9PayloadDescription::Serialize(BYTE *data,DWORD size) const
 {
 	//Check kength
 	if (size<GetSize())
@@ -545,7 +545,7 @@ DWORD VP9PayloadDescription::Serialize(BYTE *data,DWORD size)
 		//Get indices
 		data[len] = temporalLayerId;
 		data[len] = data[len] << 1 | switchingPoint;
-		data[len] = data[len] << 3 | (spatialLayerId & 0x03);
+		data[len] = data[len] << 3 | (spatialLayerId & 0x07);
 		data[len] = data[len] << 1 | interlayerDependencyUsed;
 		//Inc
 		len ++;
@@ -559,25 +559,13 @@ DWORD VP9PayloadDescription::Serialize(BYTE *data,DWORD size)
 		}
 	}
 		
-        if (flexibleMode && interPicturePredictedLayerFrame)
-        {
-                bool next = true;
-                //Check last diff mark
-                while (next)
-                {
-                        //Check length
-                        if (size<len+1)
-                                //Error
-                                return 0;
-                        //Add ref index
-                        referenceIndexDiff.push_back(data[len]>>1);
-                        //Are there more?
-                        next = data[len] & 0x01;
-
-                        //Inc len
-                        len ++;
-                }
-        }
+	if (flexibleMode && interPicturePredictedLayerFrame)
+	{
+		//For each reference index
+		for (DWORD i=0;i<referenceIndexDiff.size();++i)
+			//Set diff and mark if there are more
+			data[len++] = referenceIndexDiff[i]<<1 | (i+1<referenceIndexDiff.size() ? 0x01 : 0x00);
+	}
 
 
 	if (scalabiltiyStructureDataPresent)
@@ -57,10 +57,10 @@ struct VP9InterPictureDependency
 	
 	
 	VP9InterPictureDependency();
-	DWORD GetSize();
+	DWORD GetSize() const;
 	DWORD Parse(const BYTE* data, DWORD size);
 
-	DWORD Serialize(BYTE *data,DWORD size);
+	DWORD Serialize(BYTE *data,DWORD size) const;
 	void Dump();
 	
 };
@@ -115,10 +115,10 @@ struct VP9ScalabilityScructure
 	std::vector<VP9InterPictureDependency> groupOfFramesDescription;
 	
 	VP9ScalabilityScructure();
-	DWORD GetSize();
+	DWORD GetSize() const;
 	DWORD Parse(const BYTE* data, DWORD size);
 
-	DWORD Serialize(BYTE *data,DWORD size);
+	DWORD Serialize(BYTE *data,DWORD size) const;
 	void Dump();
 };
 
@@ -286,10 +286,10 @@ struct VP9PayloadDescription
 	VP9ScalabilityScructure scalabilityStructure;
 
 	VP9PayloadDescription();
-	DWORD GetSize();
+	DWORD GetSize() const;
 	DWORD Parse(const BYTE* data, DWORD size);
 
-	DWORD Serialize(BYTE *data,DWORD size);
+	DWORD Serialize(BYTE *data,DWORD size) const;
 	void Dump();
 };
 
@@ -0,0 +1,153 @@
+#include "test.h"
+#include "g711/g711.h"
+#include "g711/g711codec.h"
+#include "g722/g722codec.h"
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+
+class AudioCodecTestPlan: public TestPlan
+{
+public:
+	AudioCodecTestPlan() : TestPlan("Audio codec test plan")
+	{
+
+	}
+
+	virtual void Execute()
+	{
+		Log("AudioCodec::Init\n");
+		testG711();
+		testG722();
+		Log("AudioCodec::End\n");
+	}
+
+	static DWORD Hash(const BYTE* data, DWORD size)
+	{
+		//FNV-1a
+		DWORD hash = 2166136261u;
+		for (DWORD i=0;i<size;++i)
+			hash = (hash ^ data[i]) * 16777619u;
+		return hash;
+	}
+
+	void testG711()
+	{
+		Log("testG711\n");
+
+		//All possible samples, with room for unaligned starts
+		std::vector<SWORD> pcm(65536+16);
+		for (DWORD i=0;i<pcm.size();++i)
+			pcm[i] = (SWORD)(i-32768);
+
+		std::vector<BYTE> alaw(pcm.size());
+		std::vector<BYTE> ulaw(pcm.size());
+
+		//Batch encoding must be bit exact with the scalar one on any length and alignment
+		for (DWORD offset=0;offset<16;++offset)
+		{
+			DWORD len = 65536-offset;
+			linear2alaw_block(pcm.data()+offset,alaw.data(),len);
+			linear2ulaw_block(pcm.data()+offset,ulaw.data(),len);
+			for (DWORD i=0;i<len;++i)
+			{
+				assert(alaw[i]==linear2alaw(pcm[offset+i]));
+				assert(ulaw[i]==linear2ulaw(pcm[offset+i]));
+			}
+		}
+
+		//All possible codes
+		BYTE codes[256+16];
+		for (DWORD i=0;i<sizeof(codes);++i)
+			codes[i] = i;
+
+		SWORD decoded[256+16];
+
+		//Batch decoding must be bit exact too
+		for (DWORD len=0;len<=sizeof(codes);++len)
+		{
+			alaw2linear_block(codes,decoded,len);
+			for (DWORD i=0;i<len;++i)
+				assert(decoded[i]==alaw2linear(codes[i]));
+			ulaw2linear_block(codes,decoded,len);
+			for (DWORD i=0;i<len;++i)
+				assert(decoded[i]==ulaw2linear(codes[i]));
+		}
+
+		//And through the codec interfaces
+		Properties properties;
+		PCMUEncoder pcmuEncoder(properties);
+		PCMUDecoder pcmuDecoder;
+		PCMAEncoder pcmaEncoder(properties);
+		PCMADecoder pcmaDecoder;
+
+		SWORD frame[160];
+		SWORD out[160];
+		BYTE encoded[160];
+		for (DWORD i=0;i<160;++i)
+			frame[i] = 16000*sin(i*0.3);
+
+		assert(pcmuEncoder.Encode(frame,160,encoded,160)==160);
+		assert(pcmuDecoder.Decode(encoded,160,out,160)==160);
+		for (DWORD i=0;i<160;++i)
+			assert(out[i]==ulaw2linear(linear2ulaw(frame[i])));
+		assert(pcmaEncoder.Encode(frame,160,encoded,160)==160);
+		assert(pcmaDecoder.Decode(encoded,160,out,160)==160);
+		for (DWORD i=0;i<160;++i)
+			assert(out[i]==alaw2linear(linear2alaw(frame[i])));
+	}
+
+	void testG722()
+	{
+		Log("testG722\n");
+
+		//One second of tones, noise and full scale bursts
+		std::vector<SWORD> in(16000);
+		DWORD seed = 1;
+		for (DWORD i=0;i<in.size();++i)
+		{
+			seed = seed*1103515245+12345;
+			in[i] = (SWORD)(12000*sin(i*0.05)+9000*sin(i*1.3)+((int)(seed>>16)%4000));
+			if (i%3000<40)
+				in[i] = i&1 ? 32767 : -32768;
+		}
+
+		Properties properties;
+		G722Encoder encoder(properties);
+		G722Decoder decoder;
+
+		std::vector<BYTE> encoded(8000);
+		std::vector<SWORD> decoded(16000);
+
+		//Uneven block sizes, so history is carried between calls
+		const DWORD chunks[] = {320,2,30,64,320,1000,2,158};
+
+		DWORD len = 0;
+		for (DWORD pos=0,i=0;pos<in.size();++i)
+		{
+			DWORD size = std::min<DWORD>(chunks[i%8],in.size()-pos);
+			len += encoder.Encode(in.data()+pos,size,encoded.data()+len,encoded.size()-len);
+			pos += size;
+		}
+		assert(len==8000);
+
+		DWORD num = 0;
+		for (DWORD pos=0,i=0;pos<len;++i)
+		{
+			DWORD size = std::min<DWORD>(std::max<DWORD>(chunks[i%8]/2,1),len-pos);
+			num += decoder.Decode(encoded.data()+pos,size,decoded.data()+num,decoded.size()-num);
+			pos += size;
+		}
+		assert(num==16000);
+
+		//Must be bit exact with the reference band split filters
+		DWORD encodedHash = Hash(encoded.data(),len);
+		DWORD decodedHash = Hash((const BYTE*)decoded.data(),num*sizeof(SWORD));
+		Log("-G722 [encoded:%.8x,decoded:%.8x]\n",encodedHash,decodedHash);
+		assert(encodedHash==0x8e32e5e6);
+		assert(decodedHash==0x535aa832);
+	}
+};
+
+AudioCodecTestPlan audiocodec;
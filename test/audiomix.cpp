@@ -0,0 +1,1443 @@
+#include "test.h"
+#include "tools.h"
+#include "sidebar.h"
+#include "AudioMixKernel.h"
+#include "audiomixer.h"
+#include "audiodecoder.h"
+#include "AudioConferenceEngine.h"
+#include "AudioJitterBuffer.h"
+#include "MediaFrameListenerBridge.h"
+#include "SPSCRing.h"
+
+#include <vector>
+#include <chrono>
+#include <cmath>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <dirent.h>
+#include <emmintrin.h>
+
+class AudioMixTestPlan: public TestPlan
+{
+public:
+	AudioMixTestPlan() : TestPlan("Audio mix test plan")
+	{
+
+	}
+
+	virtual void Execute()
+	{
+		Log("AudioMix::Init\n");
+		testKernel();
+		testLimiter();
+		testMaxSpeakers();
+		testBenchmark();
+		testSharedEncoding();
+		testConferenceEngine();
+		testSkipSilence();
+		testJitterBuffer();
+		testAdaptivePlayout();
+		testNativeRate();
+		testResampleBenchmark();
+		testOpusDTX();
+		testOpusNarrowband();
+		testOpusRepacketizer();
+		testRepacketizedFanout();
+		testLossReports();
+		testRepacketizedDTX();
+		testListenerCallback();
+		testSPSCRing();
+		testMixerContention();
+		Log("AudioMix::End\n");
+	}
+
+	class FrameCounter : public MediaFrame::Listener
+	{
+	public:
+		virtual void onMediaFrame(const MediaFrame &frame)
+		{
+			//Timestamps must be continuous even when switching encoders
+			if (num)
+				assert(frame.GetTimeStamp()>last);
+			last = frame.GetTimeStamp();
+			num++;
+		}
+		virtual void onMediaFrame(DWORD ssrc, const MediaFrame &frame) {}
+	public:
+		QWORD num  = 0;
+		QWORD last = 0;
+	};
+
+	class PacketCounter : public RTPIncomingMediaStream::Listener
+	{
+	public:
+		virtual void onRTP(RTPIncomingMediaStream* stream,const RTPPacket::shared& packet)
+		{
+			//Timestamps keep running during silence
+			if (num)
+				assert(packet->GetTimestamp()>last);
+			last = packet->GetTimestamp();
+			num++;
+			bytes += packet->GetMediaLength();
+			if (packet->GetMark())
+				marks++;
+		}
+		virtual void onBye(RTPIncomingMediaStream* stream) {}
+		virtual void onEnded(RTPIncomingMediaStream* stream) {}
+	public:
+		QWORD num   = 0;
+		QWORD bytes = 0;
+		QWORD marks = 0;
+		DWORD last  = 0;
+	};
+
+	class FrameCollector : public MediaFrame::Listener
+	{
+	public:
+		virtual void onMediaFrame(const MediaFrame &frame)
+		{
+			packets.emplace_back(frame.GetData(),frame.GetData()+frame.GetLength());
+			timestamps.push_back(frame.GetTimeStamp());
+			durations.push_back(frame.GetDuration());
+		}
+		virtual void onMediaFrame(DWORD ssrc, const MediaFrame &frame) {}
+	public:
+		std::vector<std::vector<BYTE>> packets;
+		std::vector<QWORD> timestamps;
+		std::vector<DWORD> durations;
+	};
+
+	static DWORD GetThreadCount()
+	{
+		DWORD num = 0;
+		DIR* dir = opendir("/proc/self/task");
+		if (!dir)
+			return 0;
+		while (struct dirent* entry = readdir(dir))
+			if (entry->d_name[0]!='.')
+				num++;
+		closedir(dir);
+		return num;
+	}
+
+	static SWORD Noise(DWORD& seed)
+	{
+		seed = seed*1664525 + 1013904223;
+		return seed >> 16;
+	}
+
+	//Old 16 bit wrapping mix, for comparison
+	static void LegacyAdd(SWORD* dst, const SWORD* src, DWORD len)
+	{
+		__m128i* d = (__m128i*) dst;
+		__m128i* s = (__m128i*) src;
+		for(DWORD n = (len + 7) >> 3; n != 0; --n,++d,++s)
+			_mm_store_si128(d, _mm_add_epi16(_mm_load_si128(d),_mm_load_si128(s)));
+	}
+
+	static void LegacySub(SWORD* dst, const SWORD* src, DWORD len)
+	{
+		__m128i* d = (__m128i*) dst;
+		__m128i* s = (__m128i*) src;
+		for(DWORD n = (len + 7) >> 3; n != 0; --n,++d,++s)
+			_mm_store_si128(d, _mm_sub_epi16(_mm_load_si128(s),_mm_load_si128(d)));
+	}
+
+	void testKernel()
+	{
+		Log("testKernel\n");
+
+		DWORD seed = 1;
+
+		//Check all tails
+		for (DWORD len=0;len<80;++len)
+		{
+			int32_t acc[80];
+			int32_t expected[80];
+			int32_t minus[80];
+			SWORD samples[80];
+			SWORD out[80];
+
+			for (DWORD i=0;i<len;++i)
+			{
+				acc[i] = expected[i] = Noise(seed)*7;
+				samples[i] = Noise(seed);
+			}
+
+			AudioMixKernel::Accumulate(acc,samples,len);
+			for (DWORD i=0;i<len;++i)
+				assert(acc[i]==expected[i]+samples[i]);
+
+			AudioMixKernel::Subtract(minus,acc,samples,len);
+			for (DWORD i=0;i<len;++i)
+				assert(minus[i]==expected[i]);
+
+			int32_t peak = 0;
+			for (DWORD i=0;i<len;++i)
+				peak = std::max(peak,std::abs(acc[i]));
+			assert(AudioMixKernel::GetPeak(acc,len)==peak);
+
+			AudioMixKernel::Saturate(out,acc,len);
+			for (DWORD i=0;i<len;++i)
+				assert(out[i]==std::min(32767,std::max(-32768,acc[i])));
+
+			AudioMixKernel::Scale(out,acc,len,0.5f,0.5f);
+			for (DWORD i=0;i<len;++i)
+				assert(std::abs(out[i]-std::min(32767.0f,std::max(-32768.0f,acc[i]*0.5f)))<=1);
+		}
+	}
+
+	void testLimiter()
+	{
+		Log("testLimiter\n");
+
+		const DWORD len = 480;
+		int32_t acc[len];
+		SWORD out[len];
+		AudioLimiter limiter;
+
+		//Quiet signal goes through untouched
+		for (DWORD i=0;i<len;++i)
+			acc[i] = 10000*sin(i*0.05);
+		limiter.Process(out,acc,len);
+		for (DWORD i=0;i<len;++i)
+			assert(out[i]==acc[i]);
+		assert(limiter.GetGain()==1.0f);
+
+		//Sum of 100 loud participants
+		for (DWORD i=0;i<len;++i)
+			acc[i] = 100*20000*sin(i*0.05);
+
+		for (DWORD n=0;n<10;++n)
+		{
+			limiter.Process(out,acc,len);
+			//No sign flip, no wrapping
+			for (DWORD i=0;i<len;++i)
+				assert(acc[i]==0 || (out[i]>0)==(acc[i]>0));
+		}
+		//Gain settled under threshold
+		assert(AudioMixKernel::GetPeak(acc,len)*limiter.GetGain()<=AudioLimiter::kThreshold+1);
+		assert(limiter.GetLimitedBlocks()==1);
+
+		//Back to quiet, gain recovers slowly
+		for (DWORD i=0;i<len;++i)
+			acc[i] = 10000*sin(i*0.05);
+		limiter.Process(out,acc,len);
+		assert(limiter.GetGain()<1.0f);
+		for (DWORD n=0;n<30;++n)
+			limiter.Process(out,acc,len);
+		assert(limiter.GetGain()==1.0f);
+	}
+
+	void testMaxSpeakers()
+	{
+		Log("testMaxSpeakers\n");
+
+		const DWORD len = 480;
+		const DWORD num = 100;
+		std::vector<SWORD*> buffers;
+		Sidebar sidebar;
+
+		for (DWORD i=0;i<num;++i)
+		{
+			SWORD* buffer = (SWORD*)malloc32(len*sizeof(SWORD));
+			for (DWORD j=0;j<len;++j)
+				buffer[j] = i==7 ? 1000 : 1;
+			buffers.push_back(buffer);
+			sidebar.AddParticipant(i);
+		}
+
+		//Everybody
+		sidebar.Reset();
+		for (DWORD i=0;i<num;++i)
+			sidebar.Update(i,buffers[i],len,i%10==0 ? 10+i : 0);
+		sidebar.Mix(len);
+		assert(sidebar.GetMixed().size()==num);
+		assert(sidebar.GetBuffer()[0]==1000+num-1);
+
+		//Only the 3 loudest active ones
+		sidebar.Reset();
+		for (DWORD i=0;i<num;++i)
+			sidebar.Update(i,buffers[i],len,i%10==0 ? 10+i : 0);
+		sidebar.Mix(len,3);
+		assert(sidebar.GetMixed().size()==3);
+		assert(sidebar.IsMixed(90));
+		assert(sidebar.IsMixed(80));
+		assert(sidebar.IsMixed(70));
+		assert(!sidebar.IsMixed(7));
+		assert(sidebar.GetBuffer()[0]==3);
+
+		//Less active ones than allowed
+		sidebar.Reset();
+		for (DWORD i=0;i<num;++i)
+			sidebar.Update(i,buffers[i],len,i==7 ? 1 : 0);
+		sidebar.Mix(len,3);
+		assert(sidebar.GetMixed().size()==1);
+		assert(sidebar.GetBuffer()[0]==1000);
+
+		//Speakers near the cutoff do not flap
+		Sidebar hysteresis;
+		auto mix = [&](const std::vector<DWORD>& vads) {
+			hysteresis.Reset();
+			for (DWORD i=0;i<vads.size();++i)
+				hysteresis.Update(i,buffers[i],len,vads[i]);
+			hysteresis.Mix(len,3);
+		};
+		for (DWORD i=0;i<4;++i)
+			hysteresis.AddParticipant(i);
+		mix({100,90,80,70});
+		for (DWORD n=0;n<100;++n)
+		{
+			//Fourth one is louder than third one on every other mix, but not by the margin
+			mix({100,90,80,n%2 ? 95u : 70u});
+			assert(hysteresis.IsMixed(2));
+			assert(!hysteresis.IsMixed(3));
+		}
+		//Clearly louder, replaces the quietest one
+		mix({100,90,80,200});
+		assert(hysteresis.IsMixed(3));
+		assert(!hysteresis.IsMixed(2));
+		//Kept for a while even if others are louder
+		mix({100,90,300,10});
+		assert(hysteresis.IsMixed(3));
+		assert(hysteresis.IsMixed(2));
+		assert(!hysteresis.IsMixed(1));
+
+		for (auto buffer : buffers)
+			free(buffer);
+	}
+
+	void testBenchmark()
+	{
+		Log("testBenchmark\n");
+
+		//10ms at 48khz
+		const DWORD len = 480;
+		const DWORD num = 100;
+		const DWORD ticks = 1000;
+		std::vector<SWORD*> buffers;
+		SWORD* mixed = (SWORD*)malloc32(len*sizeof(SWORD));
+		SWORD* out = (SWORD*)malloc32(len*sizeof(SWORD));
+		int32_t* minus = (int32_t*)malloc32(len*sizeof(int32_t));
+		std::vector<AudioLimiter> limiters(num);
+		Sidebar sidebar;
+		DWORD seed = 1;
+
+		//Speech like levels
+		for (DWORD i=0;i<num;++i)
+		{
+			SWORD* buffer = (SWORD*)malloc32(len*sizeof(SWORD));
+			for (DWORD j=0;j<len;++j)
+				buffer[j] = Noise(seed)/4;
+			buffers.push_back(buffer);
+			sidebar.AddParticipant(i);
+		}
+
+		//Old mix
+		DWORD wrapped = 0;
+		auto start = std::chrono::steady_clock::now();
+		for (DWORD n=0;n<ticks;++n)
+		{
+			memset(mixed,0,len*sizeof(SWORD));
+			for (DWORD i=0;i<num;++i)
+				LegacyAdd(mixed,buffers[i],len);
+			for (DWORD i=0;i<num;++i)
+			{
+				memcpy(out,buffers[i],len*sizeof(SWORD));
+				LegacySub(out,mixed,len);
+			}
+		}
+		auto legacy = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now()-start).count()/ticks;
+
+		//Count wrapped samples on the full mix
+		for (DWORD j=0;j<len;++j)
+		{
+			int32_t sum = 0;
+			for (DWORD i=0;i<num;++i)
+				sum += buffers[i][j];
+			if (sum!=mixed[j])
+				wrapped++;
+		}
+
+		//32 bits mix of all of them
+		start = std::chrono::steady_clock::now();
+		for (DWORD n=0;n<ticks;++n)
+		{
+			sidebar.Reset();
+			for (DWORD i=0;i<num;++i)
+				sidebar.Update(i,buffers[i],len,1);
+			sidebar.Mix(len);
+			for (DWORD i=0;i<num;++i)
+			{
+				AudioMixKernel::Subtract(minus,sidebar.GetAccumulator(),buffers[i],len);
+				limiters[i].Process(out,minus,len);
+			}
+		}
+		auto all = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now()-start).count()/ticks;
+
+		//Top 3 speakers, only them need their own mix
+		start = std::chrono::steady_clock::now();
+		for (DWORD n=0;n<ticks;++n)
+		{
+			sidebar.Reset();
+			for (DWORD i=0;i<num;++i)
+				sidebar.Update(i,buffers[i],len,i+1);
+			sidebar.Mix(len,3);
+			for (int i : sidebar.GetMixed())
+			{
+				AudioMixKernel::Subtract(minus,sidebar.GetAccumulator(),buffers[i],len);
+				limiters[i].Process(out,minus,len);
+			}
+		}
+		auto top = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now()-start).count()/ticks;
+
+		Log("Mixing %u inputs of %u samples: 16 bits %lldns/tick (%u wrapped samples), 32 bits %lldns/tick, top 3 %lldns/tick\n",num,len,legacy,wrapped,all,top);
+
+		assert(wrapped>0);
+		assert(top<all);
+
+		for (auto buffer : buffers)
+			free(buffer);
+		free(mixed);
+		free(out);
+		free(minus);
+	}
+
+	void testSharedEncoding()
+	{
+		Log("testSharedEncoding\n");
+
+		const DWORD rate = 8000;
+		const DWORD speakers = 3;
+		const DWORD listeners = 200;
+		AudioMixer mixer;
+		Properties properties;
+		std::vector<FrameCounter> counters(speakers+listeners);
+		SWORD samples[80];
+		DWORD seed = 1;
+
+		properties.SetProperty("rate",rate);
+		properties.SetProperty("online","no");
+		mixer.Init(properties);
+
+		for (DWORD i=0;i<speakers+listeners;++i)
+		{
+			mixer.CreateMixer(i);
+			mixer.InitMixer(i,AudioMixer::SidebarDefault);
+			//Listen only participants are not an input of the mix
+			if (i>=speakers)
+				mixer.RemoveSidebarParticipant(AudioMixer::SidebarDefault,i);
+			else
+				mixer.GetOutput(i)->StartPlaying(rate);
+			mixer.SetEncodedOutput(i,AudioCodec::PCMU,Properties(),&counters[i]);
+		}
+
+		//1s of audio
+		for (DWORD n=0;n<100;++n)
+		{
+			for (DWORD i=0;i<speakers;++i)
+			{
+				for (DWORD j=0;j<80;++j)
+					samples[j] = Noise(seed)/8;
+				mixer.GetOutput(i)->PlayBuffer(samples,80,0);
+			}
+			mixer.Process(80);
+		}
+
+		//Own encoder for each speaker and one for everybody else
+		assert(mixer.GetEncoderCount()==speakers+1);
+		for (const auto& counter : counters)
+			assert(counter.num==50);
+
+		Log("Encoders for %u participants: %u\n",speakers+listeners,mixer.GetEncoderCount());
+
+		//Speaker becomes listener
+		mixer.RemoveSidebarParticipant(AudioMixer::SidebarDefault,0);
+		for (DWORD n=0;n<100;++n)
+			mixer.Process(80);
+		//Keeps own encoder for a while
+		assert(mixer.GetEncoderCount()==speakers+1);
+		for (DWORD n=0;n<200;++n)
+			mixer.Process(80);
+		//Now shared
+		assert(mixer.GetEncoderCount()==speakers);
+		//No frame lost on the switch
+		assert(counters[0].num>=200-1);
+
+		for (DWORD i=0;i<speakers+listeners;++i)
+		{
+			mixer.RemoveEncodedOutput(i);
+			mixer.EndMixer(i);
+			mixer.DeleteMixer(i);
+		}
+		//Encoders are released on next mix
+		mixer.Process(80);
+		assert(mixer.GetEncoderCount()==0);
+		mixer.End();
+	}
+
+	void testConferenceEngine()
+	{
+		Log("testConferenceEngine\n");
+
+		const DWORD rate = 8000;
+		const DWORD conferences = 4;
+		const DWORD participants = 10;
+		std::vector<std::unique_ptr<AudioMixer>> mixers;
+		std::vector<std::unique_ptr<AudioDecoderWorker>> decoders;
+		std::vector<FrameCounter> counters(conferences*participants);
+		AudioConferenceEngine engine(2);
+		DWORD threads = GetThreadCount();
+		DWORD seed = 1;
+
+		for (DWORD c=0;c<conferences;++c)
+		{
+			AudioMixer* mixer = new AudioMixer();
+			Properties properties;
+			properties.SetProperty("rate",rate);
+			properties.SetProperty("online","no");
+			mixer->Init(properties);
+			engine.AddConference(mixer);
+
+			for (DWORD p=0;p<participants;++p)
+			{
+				AudioDecoderWorker* decoder = new AudioDecoderWorker();
+				mixer->CreateMixer(p);
+				mixer->InitMixer(p,AudioMixer::SidebarDefault);
+				mixer->SetEncodedOutput(p,AudioCodec::PCMU,Properties(),&counters[c*participants+p]);
+				decoder->AddAudioOuput(mixer->GetOutput(p));
+				engine.AddDecoder(mixer,decoder);
+				decoders.emplace_back(decoder);
+			}
+			mixers.emplace_back(mixer);
+		}
+
+		engine.Start();
+
+		//Only the workers, instead of 3 threads per participant and one per conference
+		assert(GetThreadCount()==threads+engine.GetNumWorkers());
+
+		//1s of audio
+		for (DWORD n=0;n<50;++n)
+		{
+			for (auto& decoder : decoders)
+			{
+				auto packet = std::make_shared<RTPPacket>(MediaFrame::Audio,AudioCodec::PCMU);
+				packet->SetClockRate(rate);
+				packet->SetTimestamp(n*160);
+				BYTE* data = packet->AdquireMediaData();
+				for (DWORD i=0;i<160;++i)
+					data[i] = Noise(seed);
+				packet->SetMediaLength(160);
+				decoder->onRTP(nullptr,packet);
+			}
+			msleep(20000);
+		}
+
+		engine.Stop();
+
+		Log("Engine %u conferences of %u participants on %u threads: %llu ticks, avg %lluus, max %lluus, last %lluus, missed %llu\n",
+			conferences,participants,engine.GetNumWorkers(),engine.GetTicks(),engine.GetAvgTickTime(),engine.GetMaxTickTime(),engine.GetLastTickTime(),engine.GetMissedTicks());
+
+		//Clock driven by deadlines, including catched up ticks
+		assert(engine.GetTicks()+engine.GetMissedTicks()>=90);
+		for (const auto& counter : counters)
+			assert(counter.num>=40);
+
+		for (DWORD c=0;c<conferences;++c)
+		{
+			AudioMixer* mixer = mixers[c].get();
+			for (DWORD p=0;p<participants;++p)
+			{
+				engine.RemoveDecoder(mixer,decoders[c*participants+p].get());
+				mixer->RemoveEncodedOutput(p);
+				mixer->EndMixer(p);
+			}
+			engine.RemoveConference(mixer);
+		}
+		assert(engine.GetConferenceCount()==0);
+		decoders.clear();
+		for (auto& mixer : mixers)
+			mixer->End();
+	}
+
+	void testSkipSilence()
+	{
+		Log("testSkipSilence\n");
+
+		const DWORD rate = 8000;
+		AudioMixer mixer;
+		AudioDecoderWorker decoder;
+		Properties properties;
+		DWORD seed = 1;
+		DWORD decoded = 0;
+		DWORD vad = 0;
+		DWORD hangover = 0;
+
+		properties.SetProperty("rate",rate);
+		properties.SetProperty("online","no");
+		mixer.SetCalculateVAD(true);
+		mixer.Init(properties);
+		mixer.CreateMixer(1);
+		mixer.InitMixer(1,AudioMixer::SidebarDefault);
+		decoder.AddAudioOuput(mixer.GetOutput(1));
+		decoder.SetSkipSilence(true);
+
+		//Talk, long silence and talk again
+		for (DWORD n=0;n<100;++n)
+		{
+			bool speech = n<20 || n>=80;
+			auto packet = std::make_shared<RTPPacket>(MediaFrame::Audio,AudioCodec::PCMU);
+			packet->SetClockRate(rate);
+			packet->SetTimestamp(n*160);
+			packet->SetAudioLevel(speech,speech ? 30 : 127);
+			BYTE* data = packet->AdquireMediaData();
+			//Noise on the hangover too, signaled as silence
+			for (DWORD i=0;i<160;++i)
+				data[i] = speech || n<20+AudioDecoderWorker::kSilenceHangover ? Noise(seed) : 0xFF;
+			packet->SetMediaLength(160);
+			decoder.onRTP(nullptr,packet);
+			decoded += decoder.Process();
+			mixer.Process(160);
+			//VAD from the header, no need to calculate it
+			if (n==19)
+				vad = mixer.GetVAD(1);
+			//Signaled level is used on the hangover instead of calculating vad
+			if (n==19+AudioDecoderWorker::kSilenceHangover)
+				hangover = mixer.GetVAD(1);
+		}
+
+		Log("Skip silence: decoded %u packets, skipped %llu\n",decoded,decoder.GetSkippedPackets());
+
+		assert(vad>0);
+		//Accumulated from the signaled level, not from the loud noise
+		assert(vad<48000);
+		assert(hangover<vad);
+		assert(decoder.GetSkippedPackets()==60-AudioDecoderWorker::kSilenceHangover);
+		assert(decoded==100-decoder.GetSkippedPackets());
+
+		decoder.RemoveAudioOutput(mixer.GetOutput(1));
+		mixer.EndMixer(1);
+		mixer.End();
+	}
+
+	static RTPPacket::shared CreatePacket(WORD seq, DWORD ts, DWORD rate, DWORD& seed)
+	{
+		auto packet = std::make_shared<RTPPacket>(MediaFrame::Audio,AudioCodec::PCMU);
+		packet->SetClockRate(rate);
+		packet->SetSeqNum(seq);
+		packet->SetTimestamp(ts);
+		BYTE* data = packet->AdquireMediaData();
+		for (DWORD i=0;i<rate/50;++i)
+			data[i] = Noise(seed);
+		packet->SetMediaLength(rate/50);
+		return packet;
+	}
+
+	void testJitterBuffer()
+	{
+		Log("testJitterBuffer\n");
+
+		const DWORD rate = 8000;
+		DWORD seed = 1;
+		AudioJitterBuffer jitterBuffer;
+		QWORD ts;
+
+		//On time packets, just one packet of delay
+		for (DWORD n=0;n<100;++n)
+			jitterBuffer.Add(CreatePacket(n,n*160,rate,seed),1000+n*20);
+		assert(jitterBuffer.GetTargetDelay()==AudioJitterBuffer::kMinDelay);
+
+		//Up to 60ms of jitter
+		for (DWORD n=100;n<200;++n)
+			jitterBuffer.Add(CreatePacket(n,n*160,rate,seed),1000+n*20+(WORD)Noise(seed)%60);
+		DWORD jittered = jitterBuffer.GetTargetDelay();
+		assert(jittered>=60 && jittered<=80+AudioJitterBuffer::kMinDelay);
+
+		//Back to normal, target shrinks slowly
+		for (DWORD n=200;n<500;++n)
+			jitterBuffer.Add(CreatePacket(n,n*160,rate,seed),1000+n*20);
+		Log("Jitter buffer: target %ums with jitter, %ums after\n",jittered,jitterBuffer.GetTargetDelay());
+		assert(jitterBuffer.GetTargetDelay()<30);
+		assert(jitterBuffer.GetBufferedDuration(jitterBuffer.GetFirstTimestamp())==AudioJitterBuffer::kMaxPackets*20);
+		assert(jitterBuffer.GetDroppedPackets()==500-AudioJitterBuffer::kMaxPackets);
+
+		//Out of order packets are played in timestamp order, late ones dropped
+		jitterBuffer.Reset();
+		jitterBuffer.Add(CreatePacket(3,480,rate,seed),0);
+		jitterBuffer.Add(CreatePacket(1,160,rate,seed),0);
+		jitterBuffer.Add(CreatePacket(2,320,rate,seed),0);
+		QWORD base = jitterBuffer.GetFirstTimestamp()-160;
+		assert(jitterBuffer.Pop(base+160,base+240,&ts) && ts==base+160);
+		assert(jitterBuffer.Pop(base+320,base+400,&ts) && ts==base+320);
+		assert(!jitterBuffer.Add(CreatePacket(0,0,rate,seed),0));
+		assert(jitterBuffer.GetLatePackets()==1);
+		assert(jitterBuffer.Pop(base+480,base+640,&ts) && ts==base+480);
+		assert(jitterBuffer.IsEmpty());
+
+		//Timestamp wrap
+		jitterBuffer.Reset();
+		jitterBuffer.Add(CreatePacket(1,160-320,rate,seed),0);
+		jitterBuffer.Add(CreatePacket(3,160,rate,seed),0);
+		jitterBuffer.Add(CreatePacket(2,160-160,rate,seed),0);
+		QWORD first = jitterBuffer.GetFirstTimestamp();
+		assert((DWORD)first==(DWORD)(160-320));
+		assert(jitterBuffer.Pop(first,first+1,&ts) && ts==first);
+		assert(jitterBuffer.Pop(first+160,first+161,&ts) && ts==first+160);
+		assert(jitterBuffer.Pop(first+320,first+321,&ts) && ts==first+320);
+
+		//Periodic signal, 32 samples period
+		std::vector<SWORD> tone(480);
+		for (DWORD i=0;i<tone.size();++i)
+			tone[i] = 10000*std::sin(2*M_PI*250*i/rate);
+
+		//Remove and repeat whole periods, so signal is not altered
+		std::vector<SWORD> accelerated(tone.begin(),tone.begin()+240);
+		DWORD removed = AudioJitterBuffer::Accelerate(accelerated,rate);
+		std::vector<SWORD> expanded(tone.begin(),tone.begin()+240);
+		DWORD added = AudioJitterBuffer::Expand(expanded,rate);
+		Log("Time stretch: removed %u samples, added %u samples\n",removed,added);
+		assert(removed && removed%32==0 && accelerated.size()==240-removed);
+		assert(added && added%32==0 && expanded.size()==240+added);
+		for (DWORD i=0;i<accelerated.size();++i)
+			assert(std::abs(accelerated[i]-tone[i])<=1);
+		for (DWORD i=0;i<expanded.size();++i)
+			assert(std::abs(expanded[i]-tone[i])<=1);
+	}
+
+	void testAdaptivePlayout()
+	{
+		Log("testAdaptivePlayout\n");
+
+		const DWORD rate = 8000;
+		AudioMixer mixer;
+		AudioDecoderWorker decoder;
+		Properties properties;
+		DWORD seed = 1;
+		std::vector<std::pair<QWORD,RTPPacket::shared>> network;
+
+		properties.SetProperty("rate",rate);
+		properties.SetProperty("online","no");
+		mixer.Init(properties);
+		mixer.CreateMixer(1);
+		mixer.InitMixer(1,AudioMixer::SidebarDefault);
+		decoder.SetAdaptivePlayout(true);
+		decoder.AddAudioOuput(mixer.GetOutput(1));
+
+		//1s with up to 80ms of jitter, then 4s without, 2% of packets lost
+		for (DWORD n=0;n<250;++n)
+			if (n%50!=25)
+				network.emplace_back(n*20 + (n<50 ? (WORD)Noise(seed)%80 : 0),CreatePacket(n,n*160,rate,seed));
+		//Order by arrival time
+		std::stable_sort(network.begin(),network.end(),[](const auto& a, const auto& b){ return a.first<b.first; });
+
+		QWORD start = getTimeMS();
+		QWORD ticks = 0;
+		DWORD jitteredTarget = 0;
+		DWORD jitteredDelay = 0;
+		auto it = network.begin();
+
+		//Run in real time, as the jitter buffer uses arrival time
+		while (ticks<500)
+		{
+			QWORD now = getTimeMS()-start;
+			//Deliver arrived packets
+			for (;it!=network.end() && it->first<=now;++it)
+				decoder.onRTP(nullptr,it->second);
+			//Play and mix pending ticks
+			for (;ticks<500 && ticks*10<=now;++ticks)
+			{
+				decoder.Process(10);
+				mixer.Process(rate/100);
+				//Get values when jitter stops
+				if (ticks==100)
+				{
+					jitteredTarget = decoder.GetTargetDelay();
+					jitteredDelay = decoder.GetPlayoutDelay();
+				}
+			}
+			msleep(2000);
+		}
+
+		Log("Adaptive playout: target %u->%ums delay %u->%ums, accelerated %llu expanded %llu samples, concealed %llu underruns %llu late %llu\n",
+			jitteredTarget,decoder.GetTargetDelay(),jitteredDelay,decoder.GetPlayoutDelay(),
+			decoder.GetAcceleratedSamples(),decoder.GetExpandedSamples(),decoder.GetConcealedFrames(),decoder.GetUnderruns(),decoder.GetLatePackets());
+
+		//Delay adapts to jitter and shrinks back when it is gone
+		assert(jitteredTarget>50);
+		assert(decoder.GetTargetDelay()<jitteredTarget);
+		assert(decoder.GetPlayoutDelay()<jitteredDelay);
+		assert(decoder.GetAcceleratedSamples());
+		assert(decoder.GetConcealedFrames());
+
+		decoder.RemoveAudioOutput(mixer.GetOutput(1));
+		mixer.EndMixer(1);
+		mixer.End();
+	}
+
+	void testNativeRate()
+	{
+		Log("testNativeRate\n");
+
+		AudioMixer mixer;
+		Properties properties;
+		DWORD num,bytes,users;
+		DWORD baseNum,baseBytes,baseUsers;
+
+		AudioTransrater::GetSharedFilters(&baseNum,&baseBytes,&baseUsers);
+
+		properties.SetProperty("rate",16000);
+		properties.SetProperty("online","no");
+		properties.SetProperty("nativeRate",true);
+		mixer.Init(properties);
+
+		//Three opus participants and a G.711 one
+		for (int id=1;id<=4;++id)
+		{
+			mixer.CreateMixer(id);
+			mixer.InitMixer(id,AudioMixer::SidebarDefault);
+			mixer.GetOutput(id)->StartPlaying(id<4 ? 48000 : 8000);
+		}
+
+		//Same rates share the filters
+		AudioTransrater::GetSharedFilters(&num,&bytes,&users);
+		assert(num-baseNum==2 && users-baseUsers==4);
+		assert(mixer.GetDominantRate()==48000);
+
+		//Mix for a while
+		for (DWORD i=0;i<200;++i)
+			mixer.Process(mixer.GetRate()/100);
+
+		//Players open their transraters again on next samples
+		SWORD samples[480] = {};
+		for (int id=1;id<=4;++id)
+			mixer.GetOutput(id)->PlayBuffer(samples,id<4 ? 480 : 80,0);
+
+		//Only the G.711 participant is resampled now
+		AudioTransrater::GetSharedFilters(&num,&bytes,&users);
+		assert(mixer.GetRate()==48000);
+		assert(num-baseNum==1 && users-baseUsers==1);
+
+		for (int id=1;id<=4;++id)
+			mixer.EndMixer(id);
+		mixer.End();
+	}
+
+	void testResampleBenchmark()
+	{
+		Log("testResampleBenchmark\n");
+
+		const DWORD participants = 100;
+		const DWORD ticks = 500;
+		SWORD input[480];
+		SWORD mixed[480];
+		DWORD seed = 1;
+
+		for (DWORD i=0;i<480;++i)
+			input[i] = Noise(seed)/4;
+
+		//Opus participants on a 16khz and on a native rate mixer
+		for (DWORD rate : {16000u,48000u})
+		{
+			std::vector<std::unique_ptr<PipeAudioOutput>> outputs;
+			DWORD num,bytes,users;
+
+			auto start = std::chrono::steady_clock::now();
+			for (DWORD i=0;i<participants;++i)
+			{
+				outputs.emplace_back(new PipeAudioOutput(false));
+				outputs.back()->Init(rate);
+				outputs.back()->StartPlaying(48000);
+			}
+			auto init = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now()-start).count();
+			AudioTransrater::GetSharedFilters(&num,&bytes,&users);
+
+			start = std::chrono::steady_clock::now();
+			for (DWORD n=0;n<ticks;++n)
+				for (auto& output : outputs)
+				{
+					output->PlayBuffer(input,480,480);
+					output->GetSamples(mixed,rate/100);
+				}
+			auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now()-start).count();
+
+			Log("Resample 48000->%u: %.2fus per participant per 10ms, init %lldus for %u participants, %u shared filters of %u bytes\n",
+				rate,elapsed/1000.0/ticks/participants,(long long)init,participants,num,bytes);
+
+			for (auto& output : outputs)
+				output->StopPlaying();
+		}
+	}
+
+	void testOpusDTX()
+	{
+		Log("testOpusDTX\n");
+
+		const DWORD ticks = 500;
+		SWORD samples[480];
+		DWORD seed = 1;
+		QWORD sent[2] = {};
+
+		for (bool dtx : {false,true})
+		{
+			Properties properties;
+			properties.SetProperty("opus.dtx",dtx);
+			MixerAudioEncoder encoder(AudioCodec::OPUS,properties);
+			MediaFrameListenerBridge bridge(1);
+			PacketCounter counter;
+
+			bridge.AddListener(&counter);
+			encoder.AddListener(&bridge);
+			//Bridge restarts timestamps on zero ones
+			assert(encoder.Init(48000,1000));
+
+			//Talk for 1s, 3s of silence and talk again
+			for (DWORD n=0;n<ticks;++n)
+			{
+				bool speech = n<100 || n>=400;
+				for (DWORD i=0;i<480;++i)
+					samples[i] = speech ? Noise(seed)/8 : 0;
+				//Receivers start reporting 10% loss
+				encoder.ReportPacketLoss(n>=200 ? 26 : 0);
+				encoder.Encode(samples,480);
+			}
+
+			Log("Opus %s: %llu packets, %llu bytes, %llu suppressed, %llu marked\n",dtx ? "dtx" : "no dtx",counter.num,counter.bytes,encoder.GetSuppressedFrames(),counter.marks);
+
+			sent[dtx] = counter.bytes;
+			assert(encoder.GetPacketLoss()==26);
+			assert(counter.num+encoder.GetSuppressedFrames()==ticks/2);
+			//Only first packet after silence is marked
+			if (dtx)
+				assert(encoder.GetSuppressedFrames() && counter.marks>=2);
+			else
+				assert(counter.marks==1);
+
+			bridge.RemoveListener(&counter);
+		}
+
+		Log("Opus DTX saves %.1f kbps per participant\n",(sent[0]-sent[1])*8/(ticks*10.0));
+		assert(sent[1]<sent[0]);
+
+		//Codecs without dtx keep marking all packets, even with durations not multiple of 1ms
+		{
+			MediaFrameListenerBridge bridge(1);
+			PacketCounter counter;
+			BYTE payload[100] = {};
+
+			bridge.AddListener(&counter);
+			for (DWORD n=0;n<100;++n)
+			{
+				//AAC frames of 1024 samples at 44.1khz
+				AudioFrame frame(AudioCodec::AAC);
+				frame.SetMedia(payload,sizeof(payload));
+				frame.AddRtpPacket(0,sizeof(payload),nullptr,0);
+				frame.SetTimestamp(n*1024*1000/44100+1);
+				frame.SetDuration(1024*1000/44100);
+				bridge.onMediaFrame(frame);
+			}
+			assert(counter.num==100 && counter.marks==100);
+			bridge.RemoveListener(&counter);
+		}
+	}
+
+	void testOpusNarrowband()
+	{
+		Log("testOpusNarrowband\n");
+
+		SWORD samples[480];
+		DWORD seed = 1;
+
+		//Opus clock rate is always 48khz, whatever the mixer rate is
+		for (DWORD rate : {8000,16000,48000})
+		{
+			MixerAudioEncoder encoder(AudioCodec::OPUS,Properties());
+			FrameCollector collector;
+
+			encoder.AddListener(&collector);
+			assert(encoder.Init(rate,1000));
+
+			//100ms in 10ms ticks
+			for (DWORD n=0;n<10;++n)
+			{
+				for (DWORD i=0;i<rate/100;++i)
+					samples[i] = Noise(seed)/8;
+				encoder.Encode(samples,rate/100);
+			}
+
+			//20ms frames on a 20ms cadence
+			assert(collector.timestamps.size()==5);
+			for (DWORD i=0;i<collector.timestamps.size();++i)
+			{
+				assert(collector.durations[i]==20);
+				assert(collector.timestamps[i]==1000+i*20);
+			}
+
+			encoder.RemoveListener(&collector);
+		}
+	}
+
+	void testOpusRepacketizer()
+	{
+		Log("testOpusRepacketizer\n");
+
+		OpusRepacketizer repacketizer;
+		FrameCollector collector;
+		AudioFrame frame(AudioCodec::OPUS);
+		std::vector<std::vector<BYTE>> sent;
+		DWORD seed = 1;
+
+		repacketizer.SetListener(&collector);
+		repacketizer.SetMaxFrames(3);
+
+		//20ms frames, some of them needing two bytes lengths
+		for (DWORD n=0;n<20;++n)
+		{
+			//Gap on the timestamps, as with DTX
+			if (n>=10 && n<13)
+				continue;
+			DWORD len = n%4 ? 40+n : 300+n;
+			frame.SetLength(len+1);
+			BYTE* data = frame.GetData();
+			//CELT fullband 20ms, single frame
+			data[0] = 0xF8;
+			for (DWORD i=1;i<=len;++i)
+				data[i] = (WORD)Noise(seed);
+			frame.SetTimestamp(n*20);
+			frame.SetDuration(20);
+			repacketizer.onMediaFrame(frame);
+			sent.emplace_back(data+1,data+1+len);
+		}
+		repacketizer.Flush();
+
+		const BYTE* frames[OpusRepacketizer::kMaxFrames];
+		WORD lengths[OpusRepacketizer::kMaxFrames];
+		DWORD num = 0;
+
+		//Get all frames back in order
+		for (size_t p=0;p<collector.packets.size();++p)
+		{
+			const auto& packet = collector.packets[p];
+			DWORD count = OpusRepacketizer::Parse(packet.data(),packet.size(),frames,lengths,OpusRepacketizer::kMaxFrames);
+			assert(count>=1 && count<=3);
+			assert((packet[0] & 0xFC)==0xF8);
+			assert(collector.durations[p]==count*20);
+			for (DWORD i=0;i<count;++i,++num)
+				assert(std::vector<BYTE>(frames[i],frames[i]+lengths[i])==sent[num]);
+		}
+		assert(num==sent.size());
+		//3+3+3+1 before the gap, 3+3+1 after it
+		assert(collector.packets.size()==7);
+		assert(collector.timestamps[3]==180 && collector.timestamps[4]==260);
+
+		//Disabled, forwarded unchanged
+		repacketizer.SetMaxFrames(1);
+		repacketizer.onMediaFrame(frame);
+		assert(collector.packets.size()==8 && collector.packets.back().size()==frame.GetLength());
+	}
+
+	void testRepacketizedFanout()
+	{
+		Log("testRepacketizedFanout\n");
+
+		const DWORD rate = 48000;
+		const DWORD listeners = 100;
+		AudioMixer mixer;
+		Properties properties;
+		std::vector<FrameCounter> counters(listeners+1);
+		SWORD samples[480];
+		DWORD seed = 1;
+
+		properties.SetProperty("rate",rate);
+		properties.SetProperty("online","no");
+		mixer.Init(properties);
+
+		for (DWORD i=0;i<=listeners;++i)
+		{
+			mixer.CreateMixer(i);
+			mixer.InitMixer(i,AudioMixer::SidebarDefault);
+			//Only first one talks
+			if (i)
+				mixer.RemoveSidebarParticipant(AudioMixer::SidebarDefault,i);
+			else
+				mixer.GetOutput(i)->StartPlaying(rate);
+			mixer.SetEncodedOutput(i,AudioCodec::OPUS,Properties(),&counters[i]);
+			//Everybody accepts 60ms packets
+			mixer.SetRepacketization(i,3);
+		}
+		//Last one is losing packets
+		mixer.SetPacketLoss(listeners,26);
+
+		//3s of audio
+		for (DWORD n=0;n<300;++n)
+		{
+			for (DWORD j=0;j<480;++j)
+				samples[j] = Noise(seed)/8;
+			mixer.GetOutput(0)->PlayBuffer(samples,480,0);
+			mixer.Process(480);
+		}
+
+		//Speaker is not delayed
+		assert(counters[0].num==150);
+		//Listeners get a packet every 3 frames
+		for (DWORD i=1;i<listeners;++i)
+			assert(counters[i].num==50);
+		//Unless losing too many
+		assert(counters[listeners].num==150);
+
+		QWORD packets = 0;
+		for (const auto& counter : counters)
+			packets += counter.num;
+		Log("Packets per second for %u listeners: %llu instead of %u\n",listeners+1,packets/3,(listeners+1)*50);
+
+		for (DWORD i=0;i<=listeners;++i)
+		{
+			mixer.RemoveEncodedOutput(i);
+			mixer.EndMixer(i);
+			mixer.DeleteMixer(i);
+		}
+		mixer.End();
+	}
+
+	void testLossReports()
+	{
+		Log("testLossReports\n");
+
+		const DWORD rate = 48000;
+		AudioMixer mixer;
+		Properties properties;
+		FrameCounter counters[3];
+		RTPOutgoingSourceGroup groups[3] = {MediaFrame::Audio,MediaFrame::Audio,MediaFrame::Audio};
+		SWORD samples[480];
+		DWORD seed = 1;
+
+		properties.SetProperty("rate",rate);
+		properties.SetProperty("online","no");
+		mixer.Init(properties);
+
+		for (DWORD i=0;i<3;++i)
+		{
+			mixer.CreateMixer(i);
+			mixer.InitMixer(i,AudioMixer::SidebarDefault);
+			//Only first one talks
+			if (i)
+				mixer.RemoveSidebarParticipant(AudioMixer::SidebarDefault,i);
+			else
+				mixer.GetOutput(i)->StartPlaying(rate);
+			groups[i].media.ssrc = 100+i;
+			mixer.SetEncodedOutput(i,AudioCodec::OPUS,Properties(),&counters[i],&groups[i]);
+			mixer.SetRepacketization(i,3);
+		}
+
+		//Receiver reports as processed by the transport, only last one is losing packets
+		groups[1].onPacketLoss(groups[1].media.ssrc,0);
+		groups[2].onPacketLoss(groups[2].media.ssrc,26);
+		//Reports of other streams are ignored
+		groups[1].onPacketLoss(groups[1].media.ssrc+1000,26);
+		assert(groups[1].media.fractionLost==0 && groups[2].media.fractionLost==26);
+
+		//3s of audio
+		for (DWORD n=0;n<300;++n)
+		{
+			for (DWORD j=0;j<480;++j)
+				samples[j] = Noise(seed)/8;
+			mixer.GetOutput(0)->PlayBuffer(samples,480,0);
+			mixer.Process(480);
+		}
+
+		//Loss reaches the shared encoder and disables repacketization for the one losing packets
+		assert(counters[1].num==50);
+		assert(counters[2].num==150);
+
+		for (DWORD i=0;i<3;++i)
+		{
+			mixer.RemoveEncodedOutput(i);
+			mixer.EndMixer(i);
+			mixer.DeleteMixer(i);
+		}
+		mixer.End();
+
+		//Not listening anymore
+		groups[2].onPacketLoss(groups[2].media.ssrc,0);
+	}
+
+	void testRepacketizedDTX()
+	{
+		Log("testRepacketizedDTX\n");
+
+		const DWORD rate = 48000;
+		AudioMixer mixer;
+		Properties properties;
+		Properties opus;
+		FrameCollector collectors[3];
+		SWORD samples[480];
+		DWORD seed = 1;
+
+		properties.SetProperty("rate",rate);
+		properties.SetProperty("online","no");
+		mixer.Init(properties);
+		opus.SetProperty("opus.dtx",true);
+
+		for (DWORD i=0;i<3;++i)
+		{
+			mixer.CreateMixer(i);
+			mixer.InitMixer(i,AudioMixer::SidebarDefault);
+			//Only first one talks
+			if (i)
+				mixer.RemoveSidebarParticipant(AudioMixer::SidebarDefault,i);
+			else
+				mixer.GetOutput(i)->StartPlaying(rate);
+			mixer.SetEncodedOutput(i,AudioCodec::OPUS,opus,&collectors[i]);
+		}
+		//Both listeners get the same shared mix, only one of them combines frames
+		mixer.SetRepacketization(1,3);
+
+		//Talk for 1s and keep silent for 2s
+		for (DWORD n=0;n<300;++n)
+		{
+			for (DWORD j=0;j<480;++j)
+				samples[j] = n<102 ? Noise(seed)/8 : 0;
+			mixer.GetOutput(0)->PlayBuffer(samples,480,0);
+			mixer.Process(480);
+		}
+
+		DWORD combined = 0;
+		DWORD single = 0;
+		for (auto duration : collectors[1].durations)
+			combined += duration;
+		for (auto duration : collectors[2].durations)
+			single += duration;
+		Log("-DTX repacketized [packets:%zu,frames:%zu,ms:%u]\n",collectors[1].packets.size(),collectors[2].packets.size(),combined);
+
+		//Some frames have been suppressed
+		assert(collectors[2].packets.size()<150);
+		assert(collectors[1].packets.size()<collectors[2].packets.size());
+		//Frames before the silence are not held until the talk resumes
+		assert(combined==single);
+
+		for (DWORD i=0;i<3;++i)
+		{
+			mixer.RemoveEncodedOutput(i);
+			mixer.EndMixer(i);
+			mixer.DeleteMixer(i);
+		}
+		mixer.End();
+	}
+
+	void testListenerCallback()
+	{
+		Log("testListenerCallback\n");
+
+		//Stops its own output from the mixer thread
+		class Unsubscriber : public MediaFrame::Listener
+		{
+		public:
+			Unsubscriber(AudioMixer& mixer,int id) : mixer(mixer), id(id) {}
+			virtual void onMediaFrame(const MediaFrame &frame)
+			{
+				num++;
+				//Calling back the mixer must not block
+				mixer.GetEncoderCount();
+				if (num==5)
+					mixer.RemoveEncodedOutput(id);
+			}
+			virtual void onMediaFrame(DWORD ssrc, const MediaFrame &frame) {}
+		public:
+			AudioMixer& mixer;
+			int id;
+			QWORD num = 0;
+		};
+
+		const DWORD rate = 8000;
+		AudioMixer mixer;
+		Properties properties;
+		SWORD samples[80];
+		DWORD seed = 1;
+
+		properties.SetProperty("rate",rate);
+		properties.SetProperty("online","no");
+		mixer.Init(properties);
+
+		Unsubscriber speaker(mixer,0);
+		Unsubscriber listener(mixer,1);
+
+		for (DWORD i=0;i<2;++i)
+		{
+			mixer.CreateMixer(i);
+			mixer.InitMixer(i,AudioMixer::SidebarDefault);
+		}
+		mixer.RemoveSidebarParticipant(AudioMixer::SidebarDefault,1);
+		mixer.GetOutput(0)->StartPlaying(rate);
+		//Own and shared encoder
+		mixer.SetEncodedOutput(0,AudioCodec::PCMU,Properties(),&speaker);
+		mixer.SetEncodedOutput(1,AudioCodec::PCMU,Properties(),&listener);
+
+		for (DWORD n=0;n<100;++n)
+		{
+			for (DWORD j=0;j<80;++j)
+				samples[j] = Noise(seed)/8;
+			mixer.GetOutput(0)->PlayBuffer(samples,80,0);
+			mixer.Process(80);
+		}
+
+		//No frames after being removed
+		assert(speaker.num==5);
+		assert(listener.num==5);
+		assert(mixer.GetEncoderCount()==0);
+
+		for (DWORD i=0;i<2;++i)
+		{
+			mixer.EndMixer(i);
+			mixer.DeleteMixer(i);
+		}
+		mixer.End();
+	}
+
+	void testSPSCRing()
+	{
+		Log("testSPSCRing\n");
+
+		SPSCRing<SWORD,4096> ring;
+		SWORD samples[5000];
+
+		for (DWORD i=0;i<5000;++i)
+			samples[i] = i;
+
+		//Overrun drops what does not fit
+		assert(ring.push(samples,3000)==3000);
+		assert(ring.push(samples+3000,2000)==1096);
+		assert(ring.GetOverruns()==1 && ring.GetDropped()==904);
+		//Underrun gets what is queued
+		assert(ring.pop(samples,5000)==4096);
+		assert(ring.GetUnderruns()==1);
+		for (DWORD i=0;i<4096;++i)
+			assert(samples[i]==(SWORD)i);
+		//Clear
+		ring.push(samples,100);
+		ring.clear();
+		assert(ring.length()==0);
+		ring.push(samples,10);
+		assert(ring.length()==10);
+
+		//Player and mixer on different threads
+		PipeAudioOutput output(false);
+		output.Init(8000);
+		output.StartPlaying(8000);
+
+		const DWORD total = 2000000;
+		std::atomic<bool> playing(true);
+		std::atomic<QWORD> received(0);
+		std::thread player([&](){
+			SWORD buffer[160];
+			for (DWORD sent=0;sent<total;sent+=160)
+			{
+				for (DWORD i=0;i<160;++i)
+					buffer[i] = (sent+i)%30000;
+				//Do not overrun the mixer
+				while (sent-received>8192-160)
+					std::this_thread::yield();
+				output.PlayBuffer(buffer,160,0);
+			}
+			playing = false;
+		});
+
+		QWORD gaps = 0;
+		SWORD last = -1;
+		SWORD buffer[80];
+		//Read until everything has been consumed
+		while (true)
+		{
+			bool done = !playing;
+			DWORD len = output.GetSamples(buffer,80);
+			for (DWORD i=0;i<len;++i)
+			{
+				//Order is kept
+				if (last>=0 && buffer[i]!=(last+1)%30000)
+					gaps++;
+				last = buffer[i];
+			}
+			received += len;
+			//Player finished and nothing left
+			if (done && !len)
+				break;
+		}
+		player.join();
+
+		Log("SPSC ring: %llu samples received, %llu dropped on %llu overruns, %llu underruns\n",received.load(),output.GetDroppedSamples(),output.GetOverruns(),output.GetUnderruns());
+		assert(received==total && !gaps);
+		assert(!output.GetOverruns() && !output.GetDroppedSamples());
+	}
+
+	void testMixerContention()
+	{
+		Log("testMixerContention\n");
+
+		const DWORD rate = 16000;
+		const DWORD participants = 50;
+		const DWORD ticks = 1000;
+		AudioMixer mixer;
+		Properties properties;
+		std::vector<std::thread> players;
+		std::atomic<bool> running(true);
+		std::atomic<QWORD> calls(0);
+
+		properties.SetProperty("rate",rate);
+		properties.SetProperty("online","no");
+		mixer.Init(properties);
+
+		for (DWORD i=0;i<participants;++i)
+		{
+			mixer.CreateMixer(i);
+			mixer.InitMixer(i,AudioMixer::SidebarDefault);
+			mixer.GetOutput(i)->StartPlaying(rate);
+		}
+
+		//Decoders, RTCP and VAD readers hammering the mixer
+		for (DWORD t=0;t<8;++t)
+			players.emplace_back([&,t](){
+				SWORD samples[160];
+				DWORD seed = t+1;
+				for (DWORD i=0;i<160;++i)
+					samples[i] = Noise(seed)/8;
+				while (running)
+				{
+					for (DWORD i=t;i<participants;i+=8)
+					{
+						mixer.GetOutput(i)->PlayBuffer(samples,160,0);
+						mixer.SetPacketLoss(i,0);
+						mixer.GetVAD(i);
+						calls++;
+					}
+				}
+			});
+
+		QWORD max = 0;
+		QWORD total = 0;
+		for (DWORD n=0;n<ticks;++n)
+		{
+			auto start = std::chrono::steady_clock::now();
+			mixer.Process(rate/100);
+			QWORD elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now()-start).count();
+			max = std::max(max,elapsed);
+			total += elapsed;
+		}
+
+		running = false;
+		for (auto& player : players)
+			player.join();
+
+		Log("Mixer tick with %u participants and 8 player threads: avg %lluus, max %lluus, %llu calls\n",participants,total/ticks,max,calls.load());
+		assert(calls>0);
+
+		for (DWORD i=0;i<participants;++i)
+		{
+			mixer.EndMixer(i);
+			mixer.DeleteMixer(i);
+		}
+		mixer.End();
+	}
+
+};
+
+AudioMixTestPlan audiomix;
@@ -1 +1,477 @@
+#include "test.h"
+#include "tools.h"
+#include "rtp/FlexFEC.h"
+#include "rtp/FlexFECEncoder.h"
+#include "rtp/FlexFECDecoder.h"
 
+#include <vector>
+#include <map>
+#include <chrono>
+
+//Deterministic pseudo random generator
+class Random
+{
+public:
+	Random(DWORD seed) : state(seed) {}
+	DWORD Next()		{ state = state*1664525 + 1013904223; return state >> 8;	}
+	bool Lost(float rate)	{ return (Next() % 10000) < rate*10000;				}
+private:
+	DWORD state;
+};
+
+class FECTestPlan: public TestPlan
+{
+public:
+	FECTestPlan() : TestPlan("FEC test plan")
+	{
+		
+	}
+	
+	virtual void Execute()
+	{
+		Log("FEC::Init\n");
+		testXor();
+		testHeader();
+		testProtectionLevel();
+		testLoopbackSimulation();
+		testDecoder();
+		testReordered();
+		testRecoveryBenchmark();
+		Log("FEC::End\n");
+	}
+	
+	void testXor()
+	{
+		Log("testXor\n");
+		
+		Random random(1);
+		
+		//Check all alignments and tails
+		for (DWORD size=0;size<200;++size)
+		{
+			for (DWORD offset=0;offset<4;++offset)
+			{
+				BYTE dst[256];
+				BYTE src[256];
+				BYTE expected[256];
+				
+				for (DWORD i=0;i<sizeof(dst);++i)
+				{
+					dst[i] = expected[i] = random.Next();
+					src[i] = random.Next();
+				}
+				//Scalar reference
+				for (DWORD i=0;i<size;++i)
+					expected[offset+i] ^= src[i];
+				
+				FlexFEC::Xor(dst+offset,src,size);
+				
+				assert(memcmp(dst,expected,sizeof(dst))==0);
+			}
+		}
+	}
+	
+	void testHeader()
+	{
+		Log("testHeader\n");
+		
+		for (DWORD bits : {10,15,40,46,100,109})
+		{
+			bool mask[FlexFEC::MaxMaskBits] = {};
+			for (DWORD i=0;i<bits;i+=3)
+				mask[i] = true;
+			mask[bits-1] = true;
+			
+			BYTE data[64];
+			DWORD len = FlexFEC::WriteHeader(data,sizeof(data),0x93,0xE0,1234,0xCAFEBABE,0x11223344,65530,mask,bits);
+			assert(len==FlexFEC::GetHeaderSize(bits));
+			assert(data[0]==0x13);
+			assert(data[1]==0xE0);
+			assert(get2(data,2)==1234);
+			assert(get4(data,4)==0xCAFEBABE);
+			
+			DWORD ssrc = 0;
+			WORD  base = 0;
+			DWORD maskBits = 0;
+			bool  parsed[FlexFEC::MaxMaskBits] = {};
+			
+			assert(FlexFEC::ReadHeader(data,len,&ssrc,&base,parsed,&maskBits)==len);
+			assert(ssrc==0x11223344);
+			assert(base==65530);
+			assert(maskBits>=bits);
+			for (DWORD i=0;i<maskBits;++i)
+				assert(parsed[i]==(i<bits && mask[i]));
+		}
+	}
+	
+	void testProtectionLevel()
+	{
+		Log("testProtectionLevel\n");
+		
+		FlexFECEncoder encoder;
+		
+		//Low rtt, NACKs are enough
+		encoder.Update(13,100);
+		assert(!encoder.IsEnabled());
+		//No loss
+		encoder.Update(0,300);
+		assert(!encoder.IsEnabled());
+		//Higher loss, smaller groups
+		encoder.Update(3,300);
+		assert(encoder.GetGroupSize()==FlexFECEncoder::kMaxGroupSize);
+		encoder.Update(13,300);
+		DWORD medium = encoder.GetGroupSize();
+		encoder.Update(64,300);
+		assert(encoder.GetGroupSize()==FlexFECEncoder::kMinGroupSize);
+		assert(medium>FlexFECEncoder::kMinGroupSize && medium<FlexFECEncoder::kMaxGroupSize);
+	}
+	
+	void testLoopbackSimulation()
+	{
+		Log("testLoopbackSimulation\n");
+		
+		for (float loss : {0.01f,0.05f,0.10f})
+		{
+			Random random(loss*1000);
+			FlexFECEncoder encoder;
+			encoder.Update(loss*256,300);
+			
+			std::map<WORD,std::vector<BYTE>> sent;
+			std::map<WORD,std::vector<BYTE>> received;
+			std::vector<std::vector<BYTE>> repairs;
+			QWORD mediaBytes = 0;
+			
+			//Generate 10s of 30fps video with 5 packets per frame
+			WORD seqNum = 65000;
+			for (DWORD i=0;i<1500;++i)
+			{
+				bool mark = i%5==4;
+				//Frames are split in full packets except the last one
+				std::vector<BYTE> packet(12 + (mark ? 100 + random.Next()%1100 : 1200));
+				//RTP header
+				packet[0] = 0x80;
+				packet[1] = 96 | (mark ? 0x80 : 0);
+				set2(packet.data(),2,seqNum);
+				set4(packet.data(),4,(i/5)*3000);
+				set4(packet.data(),8,0x12345678);
+				for (DWORD j=12;j<packet.size();++j)
+					packet[j] = random.Next();
+				
+				mediaBytes += packet.size();
+				
+				//Protect
+				DWORD len = encoder.AddPacket(packet.data(),packet.size(),mark);
+				
+				//Send media
+				if (!random.Lost(loss))
+					received[seqNum] = packet;
+				sent[seqNum] = std::move(packet);
+				
+				//Send repair
+				if (len && !random.Lost(loss))
+					repairs.emplace_back(encoder.GetRepair(),encoder.GetRepair()+len);
+				
+				seqNum++;
+			}
+			
+			DWORD lost = sent.size() - received.size();
+			DWORD recovered = 0;
+			
+			//Recover single losses on each repair group
+			for (const auto& repair : repairs)
+			{
+				DWORD ssrc = 0;
+				WORD  base = 0;
+				DWORD maskBits = 0;
+				bool  mask[FlexFEC::MaxMaskBits] = {};
+				DWORD headerLen = FlexFEC::ReadHeader(repair.data(),repair.size(),&ssrc,&base,mask,&maskBits);
+				assert(headerLen);
+				assert(ssrc==0x12345678);
+				
+				//Find missing ones
+				DWORD missing = 0;
+				WORD  missingSeqNum = 0;
+				for (DWORD i=0;i<maskBits;++i)
+				{
+					if (mask[i] && !received.count(base+i))
+					{
+						missing++;
+						missingSeqNum = base+i;
+					}
+				}
+				
+				//Only one can be recovered
+				if (missing!=1)
+					continue;
+				
+				//Start from the repair
+				BYTE  flags	= repair[0];
+				BYTE  pt	= repair[1];
+				WORD  length	= get2(repair.data(),2);
+				DWORD ts	= get4(repair.data(),4);
+				std::vector<BYTE> payload(repair.begin()+headerLen,repair.end());
+				
+				//XOR all received ones
+				for (DWORD i=0;i<maskBits;++i)
+				{
+					if (!mask[i] || (WORD)(base+i)==missingSeqNum)
+						continue;
+					const auto& packet = received[base+i];
+					flags	^= packet[0];
+					pt	^= packet[1];
+					length	^= packet.size()-12;
+					ts	^= get4(packet.data(),4);
+					FlexFEC::Xor(payload.data(),packet.data()+12,packet.size()-12);
+				}
+				
+				//Rebuild packet
+				std::vector<BYTE> packet(12+length);
+				packet[0] = 0x80 | (flags & 0x3F);
+				packet[1] = pt;
+				set2(packet.data(),2,missingSeqNum);
+				set4(packet.data(),4,ts);
+				set4(packet.data(),8,ssrc);
+				memcpy(packet.data()+12,payload.data(),length);
+				
+				//Must be the same
+				assert(packet==sent[missingSeqNum]);
+				
+				received[missingSeqNum] = std::move(packet);
+				recovered++;
+			}
+			
+			float overhead = 100.0f*encoder.GetRepairBytes()/mediaBytes;
+			float rate = lost ? 100.0f*recovered/lost : 100.0f;
+			
+			Log("-Loss %.0f%% [groupSize:%u,lost:%u,recovered:%u,rate:%.1f%%,repairs:%llu,overhead:%.1f%%,overheadBitrate:%llukbps]\n",
+				loss*100,encoder.GetGroupSize(),lost,recovered,rate,encoder.GetRepairPackets(),overhead,encoder.GetRepairBytes()*8/10/1000);
+			
+			//Most losses must be recovered without doubling the bitrate
+			assert(rate>=50);
+			assert(overhead<=40);
+		}
+	}
+	static std::vector<BYTE> CreateMediaPacket(Random& random, WORD seqNum, DWORD frame, bool mark)
+	{
+		//Frames are split in full packets except the last one
+		std::vector<BYTE> packet(12 + (mark ? 100 + random.Next()%1100 : 1200));
+		//RTP header
+		packet[0] = 0x80;
+		packet[1] = 96 | (mark ? 0x80 : 0);
+		set2(packet.data(),2,seqNum);
+		set4(packet.data(),4,frame*3000);
+		set4(packet.data(),8,0x12345678);
+		for (DWORD j=12;j<packet.size();++j)
+			packet[j] = random.Next();
+		return packet;
+	}
+	
+	void testDecoder()
+	{
+		Log("testDecoder\n");
+		
+		Random random(7);
+		FlexFECEncoder encoder;
+		FlexFECDecoder decoder;
+		encoder.SetGroupSize(5);
+		
+		std::vector<std::vector<BYTE>> packets;
+		std::vector<std::vector<BYTE>> repairs;
+		
+		//Two frames on two groups
+		for (DWORD i=0;i<10;++i)
+		{
+			packets.push_back(CreateMediaPacket(random,65533+i,i/5,i%5==4));
+			if (DWORD len = encoder.AddPacket(packets.back().data(),packets.back().size(),i%5==4))
+				repairs.emplace_back(encoder.GetRepair(),encoder.GetRepair()+len);
+		}
+		assert(repairs.size()==2);
+		
+		//Media is not stored until repair packets are received
+		decoder.AddMedia(packets[0].data(),packets[0].size());
+		assert(!decoder.IsEnabled());
+		
+		//Repair arrives before media, with two losses it can't recover yet
+		decoder.AddFEC(repairs[0].data(),repairs[0].size());
+		assert(decoder.IsEnabled());
+		for (DWORD i : {0,1,2})
+			decoder.AddMedia(packets[i].data(),packets[i].size());
+		assert(!decoder.GetRecoveredPackets());
+		
+		//Packet 4 is lost, so 3 completes the group
+		decoder.AddMedia(packets[3].data(),packets[3].size());
+		assert(decoder.GetRecoveredPackets()==1);
+		
+		BYTE data[MTU];
+		DWORD len = decoder.GetRecovered(data,sizeof(data));
+		assert(len==packets[4].size());
+		assert(memcmp(data,packets[4].data(),len)==0);
+		assert(!decoder.GetRecovered(data,sizeof(data)));
+		
+		//Second group, everything received before the repair
+		for (DWORD i=5;i<10;++i)
+			decoder.AddMedia(packets[i].data(),packets[i].size());
+		decoder.AddFEC(repairs[1].data(),repairs[1].size());
+		assert(decoder.GetUselessRepairs()==1);
+		assert(decoder.GetRecoveredPackets()==1);
+		
+		//Partial group is repaired when a packet out of its span arrives
+		auto first  = CreateMediaPacket(random,200,40,false);
+		auto second = CreateMediaPacket(random,201,41,false);
+		auto jump   = CreateMediaPacket(random,300,60,false);
+		assert(!encoder.AddPacket(first.data(),first.size(),false));
+		assert(!encoder.AddPacket(second.data(),second.size(),false));
+		len = encoder.AddPacket(jump.data(),jump.size(),false);
+		assert(len);
+		assert(encoder.GetRepairTimestamp()==41*3000);
+		
+		//Second one is lost and recovered
+		decoder.AddFEC(encoder.GetRepair(),len);
+		decoder.AddMedia(first.data(),first.size());
+		assert(decoder.GetRecoveredPackets()==2);
+		len = decoder.GetRecovered(data,sizeof(data));
+		assert(len==second.size());
+		assert(memcmp(data,second.data(),len)==0);
+	}
+	
+	void testReordered()
+	{
+		Log("testReordered\n");
+		
+		Random random(11);
+		FlexFECEncoder encoder;
+		FlexFECDecoder decoder;
+		encoder.SetGroupSize(4);
+		
+		std::vector<std::vector<BYTE>> packets;
+		for (DWORD i=0;i<8;++i)
+			packets.push_back(CreateMediaPacket(random,100+i,i/4,i%4==3));
+		
+		//First group is sent out of order, so the last one added is not the highest
+		std::vector<std::vector<BYTE>> repairs;
+		for (DWORD i : {0,1,3,2,4,5,6,7})
+			if (DWORD len = encoder.AddPacket(packets[i].data(),packets[i].size(),false))
+				repairs.emplace_back(encoder.GetRepair(),encoder.GetRepair()+len);
+		
+		//Both groups must be complete, no mask bit must leak from first one
+		assert(repairs.size()==2);
+		assert(encoder.GetProtectedPackets()==8);
+		
+		for (const auto& repair : repairs)
+		{
+			DWORD ssrc = 0;
+			WORD  base = 0;
+			DWORD maskBits = 0;
+			bool  mask[FlexFEC::MaxMaskBits] = {};
+			assert(FlexFEC::ReadHeader(repair.data(),repair.size(),&ssrc,&base,mask,&maskBits));
+			//All four packets are protected
+			DWORD protectedPackets = 0;
+			for (DWORD i=0;i<maskBits;++i)
+				protectedPackets += mask[i];
+			assert(protectedPackets==4);
+		}
+		
+		//Highest packet of the reordered group is lost and recovered
+		decoder.AddFEC(repairs[0].data(),repairs[0].size());
+		for (DWORD i : {0,1,2})
+			decoder.AddMedia(packets[i].data(),packets[i].size());
+		assert(decoder.GetRecoveredPackets()==1);
+		
+		BYTE data[MTU];
+		DWORD len = decoder.GetRecovered(data,sizeof(data));
+		assert(len==packets[3].size());
+		assert(memcmp(data,packets[3].data(),len)==0);
+	}
+	
+	void testRecoveryBenchmark()
+	{
+		Log("testRecoveryBenchmark\n");
+		
+		const DWORD num = 20000;
+		
+		for (float loss : {0.05f,0.20f})
+		{
+			Random random(loss*1000);
+			FlexFECEncoder encoder;
+			FlexFECDecoder decoder;
+			encoder.Update(loss*256,300);
+			
+			//Generate channel output beforehand so only decoding is measured
+			std::vector<std::pair<bool,std::vector<BYTE>>> received;
+			std::vector<std::vector<BYTE>> sent;
+			
+			for (DWORD i=0;i<num;++i)
+			{
+				bool mark = i%5==4;
+				auto packet = CreateMediaPacket(random,i,i/5,mark);
+				DWORD len = encoder.AddPacket(packet.data(),packet.size(),mark);
+				if (!random.Lost(loss))
+					received.emplace_back(false,packet);
+				if (len && !random.Lost(loss))
+					received.emplace_back(true,std::vector<BYTE>(encoder.GetRepair(),encoder.GetRepair()+len));
+				sent.push_back(std::move(packet));
+			}
+			
+			DWORD lost = num;
+			for (const auto& packet : received)
+				if (!packet.first)
+					lost--;
+			
+			BYTE data[MTU];
+			DWORD recovered = 0;
+			
+			auto ini = std::chrono::steady_clock::now();
+			
+			for (const auto& packet : received)
+			{
+				//Add it
+				if (packet.first)
+					decoder.AddFEC(packet.second.data(),packet.second.size());
+				else
+					decoder.AddMedia(packet.second.data(),packet.second.size());
+				//Get recovered
+				while (DWORD len = decoder.GetRecovered(data,sizeof(data)))
+				{
+					//Must be the same
+					assert(len==sent[get2(data,2)].size());
+					assert(memcmp(data,sent[get2(data,2)].data(),len)==0);
+					recovered++;
+				}
+			}
+			
+			auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now()-ini).count();
+			
+			Log("-Recovery at %.0f%% loss [groupSize:%u,lost:%u,recovered:%u,rate:%.1f%%,repairs:%llu,useless:%llu] %lldns per packet\n",
+				loss*100,encoder.GetGroupSize(),lost,recovered,100.0f*recovered/lost,decoder.GetRepairPackets(),decoder.GetUselessRepairs(),elapsed/received.size());
+			
+			assert(recovered==decoder.GetRecoveredPackets());
+			assert(recovered>0 && recovered<=lost);
+		}
+		
+		//Byte wise xor vs vectorized kernel over a full packet
+		BYTE dst[MTU] = {};
+		BYTE src[MTU] = {};
+		const DWORD loops = 100000;
+		
+		auto ini = std::chrono::steady_clock::now();
+		for (DWORD i=0;i<loops;++i)
+		{
+			for (DWORD j=0;j<sizeof(dst);++j)
+				dst[j] ^= src[j]+i;
+		}
+		auto scalar = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now()-ini).count();
+		
+		ini = std::chrono::steady_clock::now();
+		for (DWORD i=0;i<loops;++i)
+		{
+			src[i%sizeof(src)]++;
+			FlexFEC::Xor(dst,src,sizeof(dst));
+		}
+		auto vectorized = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now()-ini).count();
+		
+		Log("-XOR %u bytes byte wise:%lldns vectorized:%lldns [%u]\n",MTU,scalar/loops,vectorized/loops,dst[0]);
+	}
+	
+};
+
+FECTestPlan fec;
@@ -1,5 +1,65 @@
 #include "test.h"
 #include "rtp.h"
+#include "EventLoop.h"
+#include "rtp/RTCPScheduler.h"
+#include "rtp/RTPPacer.h"
+#include "rtp/RTPPaddingTemplate.h"
+#include "ProbeController.h"
+#include "SendSideBandwidthEstimation.h"
+#include "rtp/TransportWideReceivedPackets.h"
+#include "rtp/RTPStreamTransponder.h"
+#include "rtp/RTPStreamFanOut.h"
+#include "rtp/RTXController.h"
+#include "rtp/FlexFECEncoder.h"
+#include "LayerAllocator.h"
+#include "LastNForwarder.h"
+
+#include <atomic>
+
+//Sender that counts packets instead of sending them
+class CountingRTPReceiver : public RTPReceiver
+{
+public:
+	virtual int SendPLI(DWORD ssrc) override
+	{
+		return ++plis;
+	}
+	DWORD plis = 0;
+};
+
+class CountingRTPSender : public RTPSender
+{
+public:
+	CountingRTPSender(TimeService& timeService) : timeService(timeService) {}
+	virtual int Enqueue(const RTPPacket::shared& packet) override
+	{
+		timeService.Async([=](...){ Send(packet->Clone()); });
+		return 1;
+	}
+	virtual int Enqueue(const RTPPacket::shared& packet,std::function<RTPPacket::shared(const RTPPacket::shared&)> modifier) override
+	{
+		timeService.Async([=](...){ Send(modifier(packet)); });
+		return 1;
+	}
+	virtual int Send(RTPPacket::shared&& packet) override
+	{
+		last = packet;
+		return ++sent;
+	}
+	virtual TimeService& GetTimeService() override { return timeService; }
+	
+	TimeService& timeService;
+	RTPPacket::shared last;
+	std::atomic<DWORD> sent = {0};
+};
+
+class AllocatingRTPSender : public CountingRTPSender
+{
+public:
+	AllocatingRTPSender(TimeService& timeService) : CountingRTPSender(timeService) {}
+	virtual LayerAllocator* GetLayerAllocator() override { return &allocator; }
+	LayerAllocator allocator;
+};
 
 class RTPTestPlan: public TestPlan
 {
@@ -42,8 +102,42 @@ public:
 		testTransportWideFeedbackMessage();
 		Log("Transport Wide Message Feedback (2)\n");
 		testTransportWideFeedbackMessageParser();
+		Log("Transport Wide Message Feedback round trip\n");
+		testTransportWideFeedbackRoundTrip();
+		Log("Transport Wide received packets\n");
+		testTransportWideReceivedPackets();
+		Log("Transport Wide Message Feedback benchmark\n");
+		testTransportWideFeedbackBenchmark();
 		Log("testBye\n");
 		testBye();
+		Log("FEC decoder reset\n");
+		testFECDecoderReset();
+		Log("RTCPScheduler\n");
+		testRTCPScheduler();
+		Log("RTPPacer\n");
+		testRTPPacer();
+		Log("RTPPaddingTemplate\n");
+		testRTPPaddingTemplate();
+		Log("Probe clusters\n");
+		testProbeClusters();
+		Log("1 to N fan out benchmark\n");
+		testFanOutBenchmark();
+		Log("Multiplexer fan out\n");
+		testMultiplexerFanOut();
+		Log("Picture id rewrite\n");
+		testPictureIdRewrite();
+		Log("Layer allocator\n");
+		testLayerAllocator();
+		Log("Key frame request coalescing\n");
+		testKeyFrameRequests();
+		Log("GOP cache\n");
+		testGOPCache();
+		Log("RTX controller\n");
+		testRTXController();
+		Log("Last N forwarding\n");
+		testLastN();
+		Log("Silence suppression\n");
+		testSilenceSuppression();
 		end();
 	}
 	
@@ -130,6 +224,43 @@ public:
 	
      
 
+	void testFECDecoderReset()
+	{
+		EventLoop loop;
+		RTPIncomingSourceGroup group(MediaFrame::Video,loop);
+		group.media.ssrc = 1;
+		group.fec.ssrc = 2;
+		
+		//Protect two media packets
+		FlexFECEncoder encoder;
+		encoder.SetGroupSize(2);
+		BYTE packet[112] = {};
+		DWORD len = 0;
+		for (WORD seqNum=0;seqNum<2;++seqNum)
+		{
+			packet[0] = 0x80;
+			packet[1] = 96;
+			set2(packet,2,seqNum);
+			set4(packet,8,group.media.ssrc);
+			len = encoder.AddPacket(packet,sizeof(packet),false);
+		}
+		assert(len);
+		
+		//Repair received, decoder is storing media now
+		group.fecDecoder.AddFEC(encoder.GetRepair(),len);
+		assert(group.fecDecoder.IsEnabled());
+		
+		//Media stream ends
+		group.Bye(group.media.ssrc);
+		assert(!group.fecDecoder.IsEnabled());
+		
+		//Same when fec stream ends
+		group.fecDecoder.AddFEC(encoder.GetRepair(),len);
+		assert(group.fecDecoder.IsEnabled());
+		group.Bye(group.fec.ssrc);
+		assert(!group.fecDecoder.IsEnabled());
+	}
+
 	void testSenderReport()
 	{
 		BYTE msg[] = {
@@ -553,12 +684,12 @@ public:
 				//For each lost
 				for (DWORD i = lastFeedbackPacketExtSeqNum+1; i<transportExtSeqNum; ++i)
 					//Add it
-					field->packets.insert(std::make_pair(i,0));
+					field->packets.emplace_back(i,0);
 			//Store last
 			lastFeedbackPacketExtSeqNum = transportExtSeqNum;
 
 			//Add this one
-			field->packets.insert(std::make_pair(transportSeqNum,time));
+			field->packets.emplace_back(transportSeqNum,time);
 
 		}
 			
@@ -623,6 +754,186 @@ public:
 		}
 	}
 	
+	void testTransportWideFeedbackRoundTrip(const RTCPRTPFeedback::TransportWideFeedbackMessageField::Packets& packets)
+	{
+		BYTE data[65536];
+		
+		//Create field
+		RTCPRTPFeedback::TransportWideFeedbackMessageField field(1);
+		field.packets = packets;
+		
+		//Serialize
+		DWORD size = field.GetSize();
+		DWORD len = field.Serialize(data,sizeof(data));
+		assert(len);
+		assert(len==size);
+		assert(len%4==0);
+		
+		//Parse it back
+		RTCPRTPFeedback::TransportWideFeedbackMessageField parsed;
+		assert(parsed.Parse(data,len)==len);
+		assert(parsed.feedbackPacketCount==1);
+		assert(parsed.packets.size()==packets.size());
+		
+		//Check all packets
+		for (DWORD i=0;i<packets.size();++i)
+		{
+			//Sequence numbers are 16 bits on the wire
+			assert(parsed.packets[i].first==(packets[i].first & 0xFFFF));
+			//Check lost
+			assert(!parsed.packets[i].second==!packets[i].second);
+			//Receive times are quantized to 250us
+			if (packets[i].second)
+				assert(std::abs((long long)parsed.packets[i].second-(long long)packets[i].second)<250);
+		}
+		
+		//Buffer too small must fail
+		assert(!field.Serialize(data,len-1));
+	}
+	
+	void testTransportWideFeedbackRoundTrip()
+	{
+		RTCPRTPFeedback::TransportWideFeedbackMessageField::Packets packets;
+		
+		//All received with small deltas
+		for (DWORD i=0;i<100;++i)
+			packets.emplace_back(1000+i,1000000+i*1000);
+		testTransportWideFeedbackRoundTrip(packets);
+		
+		//Mixed lost, large and negative deltas crossing the sequence wrap
+		packets.clear();
+		QWORD time = 5000000;
+		for (DWORD i=0;i<500;++i)
+		{
+			//Lost
+			if (i%7==3 || i%31<4)
+				packets.emplace_back(0xFF00+i,0);
+			//Reordered
+			else if (i%11==5)
+				packets.emplace_back(0xFF00+i,time-3000);
+			//Big jump
+			else if (i%13==0)
+				packets.emplace_back(0xFF00+i,time+=100000);
+			else
+				packets.emplace_back(0xFF00+i,time+=(i*37)%2000);
+		}
+		testTransportWideFeedbackRoundTrip(packets);
+		
+		//Long losses needing several runs
+		packets.clear();
+		packets.emplace_back(10,2000000);
+		for (DWORD i=0;i<10000;++i)
+			packets.emplace_back(11+i,0);
+		packets.emplace_back(10011,2100000);
+		testTransportWideFeedbackRoundTrip(packets);
+		
+		//None received
+		packets.clear();
+		for (DWORD i=0;i<20;++i)
+			packets.emplace_back(i,0);
+		testTransportWideFeedbackRoundTrip(packets);
+	}
+	
+	void testTransportWideReceivedPackets()
+	{
+		TransportWideReceivedPackets history;
+		RTCPRTPFeedback::TransportWideFeedbackMessageField::Packets packets;
+		
+		//Nothing to report
+		history.Flush(packets,0);
+		assert(packets.empty());
+		
+		//Add with a lost one and out of order
+		assert(history.Add(100,1100));
+		assert(history.Add(101,1200));
+		assert(history.Add(104,1500));
+		assert(history.Add(103,1400));
+		assert(!history.Add(103,1400));
+		assert(history.GetCount()==4);
+		assert(history.GetFirstTime()==1100);
+		assert(history.GetLastExtSeqNum()==104);
+		
+		history.Flush(packets,1000);
+		assert(history.IsEmpty());
+		assert(packets.size()==5);
+		assert(packets[0].first==100 && packets[0].second==100);
+		assert(packets[2].first==102 && packets[2].second==0);
+		assert(packets[4].first==104 && packets[4].second==500);
+		packets.clear();
+		
+		//Late one already reported as lost
+		assert(history.Add(102,1300));
+		assert(!history.Add(102,1300));
+		assert(!history.Add(101,1200));
+		
+		//Next feedback reports again from the late one
+		assert(history.Add(107,1700));
+		history.Flush(packets,1000);
+		assert(packets.size()==6);
+		assert(packets[0].first==102 && packets[0].second==300);
+		assert(packets[1].first==103 && packets[1].second==400);
+		assert(packets[3].first==105 && packets[3].second==0);
+		assert(packets[5].first==107 && packets[5].second==700);
+		packets.clear();
+		
+		//Lost ones out of the late window are not reported anymore
+		assert(history.Add(107+TransportWideReceivedPackets::LateWindow+1,1800));
+		history.Flush(packets,1000);
+		packets.clear();
+		assert(!history.Add(108,1800));
+		
+		//Only a late one pending
+		assert(history.Add(110,1900));
+		assert(history.GetCount()==1);
+		history.Flush(packets,1000);
+		assert(packets.size()==TransportWideReceivedPackets::LateWindow-1);
+		assert(packets.front().first==110 && packets.front().second==900);
+		assert(packets.back().first==107+TransportWideReceivedPackets::LateWindow+1);
+		packets.clear();
+		
+		//Out of window
+		assert(history.Add(200,2000));
+		assert(!history.Fits(200+TransportWideReceivedPackets::Size));
+		assert(!history.Add(200+TransportWideReceivedPackets::Size,2100));
+		history.Flush(packets,1000);
+		packets.clear();
+		
+		//Gap is skipped when nothing is pending
+		assert(history.Add(200+TransportWideReceivedPackets::Size*2,2200));
+		history.Flush(packets,1000);
+		assert(packets.size()==1);
+	}
+	
+	void testTransportWideFeedbackBenchmark()
+	{
+		BYTE data[1500];
+		RTCPRTPFeedback::TransportWideFeedbackMessageField field(1);
+		RTCPRTPFeedback::TransportWideFeedbackMessageField parsed;
+		
+		//Typical feedback of 100 packets with some losses
+		for (DWORD i=0;i<100;++i)
+			field.packets.emplace_back(i,i%17==0 ? 0 : 1000000+i*800);
+		
+		DWORD num = 100000;
+		DWORD len = 0;
+		
+		//Encode
+		auto ini = std::chrono::steady_clock::now();
+		for (DWORD i=0;i<num;++i)
+			len = field.Serialize(data,sizeof(data));
+		auto encode = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now()-ini).count();
+		
+		//Decode
+		ini = std::chrono::steady_clock::now();
+		for (DWORD i=0;i<num;++i)
+			parsed.Parse(data,len);
+		auto decode = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now()-ini).count();
+		
+		assert(parsed.packets.size()==field.packets.size());
+		
+		Log("-TransportWideFeedback 100 packets encode:%lldns decode:%lldns\n",encode/num,decode/num);
+	}
+	
 	void testRTPPacket()
 	{
 		
@@ -813,6 +1124,1020 @@ public:
 		RTPPacket::Parse(kPacketWithInvalidExtension, sizeof(kPacketWithInvalidExtension), rtpMap, extMap)->Dump();
 
 	}
+
+	void testRTCPScheduler()
+	{
+		EventLoop loop;
+		std::vector<RTCPCompoundPacket::shared> sent;
+		
+		//Run loop without socket
+		loop.Start([&](){ loop.Run(); });
+		
+		//Store compounds instead of sending them
+		RTCPScheduler scheduler(loop,[&](const RTCPCompoundPacket::shared& rtcp){
+			sent.push_back(rtcp);
+			return 1;
+		});
+		
+		//Enqueue regular and urgent blocks on same iteration
+		loop.Sync([&](...){
+			scheduler.Enqueue(std::make_shared<RTCPReceiverReport>(1));
+			scheduler.Enqueue(std::make_shared<RTCPReceiverReport>(2));
+			for (DWORD i=0;i<5;++i)
+			{
+				auto nack = std::make_shared<RTCPRTPFeedback>(RTCPRTPFeedback::NACK,1,100+i);
+				nack->AddField(std::make_shared<RTCPRTPFeedback::NACKField>(i,(WORD)0));
+				scheduler.Enqueue(nack,true);
+			}
+		});
+		
+		//Wait for flush
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+		
+		loop.Sync([&](...){
+			//All of them must be aggregated on a single compound starting with the reports
+			assert(sent.size()==1);
+			assert(sent[0]->GetPacketCount()==7);
+			assert(sent[0]->GetPacket(0)->GetType()==RTCPPacket::ReceiverReport);
+			assert(sent[0]->GetPacket(1)->GetType()==RTCPPacket::ReceiverReport);
+			assert(sent[0]->GetPacket(2)->GetType()==RTCPPacket::RTPFeedback);
+			assert(scheduler.GetPendingCount()==0);
+			sent.clear();
+			
+			//Enqueue more than fit on a single compound
+			for (DWORD i=0;i<40;++i)
+			{
+				auto nack = std::make_shared<RTCPRTPFeedback>(RTCPRTPFeedback::NACK,1,100+i);
+				for (DWORD j=0;j<50;++j)
+					nack->AddField(std::make_shared<RTCPRTPFeedback::NACKField>(j*17,(WORD)0));
+				scheduler.Enqueue(nack,true);
+			}
+		});
+		
+		//Wait for flush
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+		
+		loop.Sync([&](...){
+			DWORD blocks = 0;
+			//Check they have been splitted
+			assert(sent.size()>1);
+			for (const auto& rtcp : sent)
+			{
+				assert(rtcp->GetSize()<=RTCPScheduler::MaxCompoundSize);
+				//Each one starts with an empty report
+				assert(rtcp->GetPacket(0)->GetType()==RTCPPacket::ReceiverReport);
+				assert(std::static_pointer_cast<RTCPReceiverReport>(rtcp->GetPacket(0))->GetCount()==0);
+				blocks += rtcp->GetPacketCount()-1;
+			}
+			assert(blocks==40);
+			assert(scheduler.GetTotalBlocks()==47);
+			sent.clear();
+			
+			//Enqueue a regular receiver report of a received SR
+			auto rr = std::make_shared<RTCPReceiverReport>(1);
+			auto report = std::make_shared<RTCPReport>();
+			report->SetSSRC(2);
+			report->SetLastSR(1);
+			report->SetDelaySinceLastSRMilis(10);
+			rr->AddReport(report);
+			scheduler.Enqueue(rr);
+		});
+		
+		//Wait for flush
+		std::this_thread::sleep_for(std::chrono::milliseconds(200));
+		
+		loop.Sync([&](...){
+			//The time it has been queued must be added to the delay since last SR
+			assert(sent.size()==1);
+			auto rr = std::static_pointer_cast<RTCPReceiverReport>(sent[0]->GetPacket(0));
+			assert(rr->GetReport(0)->GetDelaySinceLastSRMilis()>=10+RTCPScheduler::MinInterval.count()-5);
+			//Stop it
+			scheduler.Stop();
+		});
+		
+		//Done
+		loop.Stop();
+	}
+	
+	void testRTPPacer()
+	{
+		EventLoop loop;
+		DWORD sent = 0;
+		DWORD padding = 0;
+		
+		//Run loop without socket
+		loop.Start([&](){ loop.Run(); });
+		
+		//Count sent bytes instead of sending them
+		RTPPacer pacer(loop,
+			[&](RTPPacket::shared&& packet) -> DWORD {
+				sent += 1000;
+				return 1000;
+			},
+			[&](DWORD budget){
+				padding += budget;
+			}
+		);
+		
+		loop.Sync([&](...){
+			//Without target bitrate everything is sent right away
+			pacer.Start();
+			pacer.Enqueue(MediaFrame::Video,std::make_shared<RTPPacket>(MediaFrame::Video,VideoCodec::VP8));
+			assert(sent==1000);
+			assert(!pacer.GetQueuedPackets());
+			
+			//Pace at 1mbps, ~312 bytes per ms
+			pacer.SetTargetBitrate(1000000);
+			sent = 0;
+			
+			//Send a burst of 100 packets
+			for (DWORD i=0;i<100;++i)
+				pacer.Enqueue(MediaFrame::Video,std::make_shared<RTPPacket>(MediaFrame::Video,VideoCodec::VP8));
+			
+			//Audio is never queued
+			pacer.Enqueue(MediaFrame::Audio,std::make_shared<RTPPacket>(MediaFrame::Audio,AudioCodec::OPUS));
+			
+			//Most of the burst must be queued
+			assert(pacer.GetQueuedPackets()>90);
+		});
+		
+		//Wait a bit
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+		
+		loop.Sync([&](...){
+			//It must have been sent at pacing rate, not all at once
+			Log("-RTPPacer sent:%u queued:%u\n",sent,pacer.GetQueuedPackets());
+			assert(sent<60000);
+			assert(pacer.GetQueuedPackets());
+			assert(!padding);
+		});
+		
+		//Wait until it is drained
+		std::this_thread::sleep_for(std::chrono::milliseconds(400));
+		
+		loop.Sync([&](...){
+			//All sent and padding offered
+			assert(sent==101000);
+			assert(!pacer.GetQueuedPackets());
+			assert(padding);
+			pacer.Stop();
+		});
+		
+		//Done
+		loop.Stop();
+	}
+	
+	void testRTPPaddingTemplate()
+	{
+		RTPPaddingTemplate padding;
+		RTPMap extMap;
+		extMap[3] = RTPHeaderExtension::AbsoluteSendTime;
+		extMap[5] = RTPHeaderExtension::TransportWideCC;
+		BYTE data[1500];
+		
+		//Build template
+		assert(padding.Build(0x1234,97,5,3));
+		assert(padding.Matches(0x1234,97,5,3));
+		assert(!padding.Matches(0x1234,96,5,3));
+		
+		//Fill packet
+		DWORD len = padding.Fill(data,sizeof(data),1000,90000,4321,12345,RTPPaddingTemplate::MaxPadding);
+		assert(len==padding.GetHeaderLength()+RTPPaddingTemplate::MaxPadding);
+		
+		//Parse it back
+		RTPHeader header;
+		RTPHeaderExtension extension;
+		DWORD ini = header.Parse(data,len);
+		assert(ini);
+		assert(header.padding);
+		assert(header.extension);
+		assert(header.ssrc==0x1234);
+		assert(header.payloadType==97);
+		assert(header.sequenceNumber==1000);
+		assert(header.timestamp==90000);
+		assert(extension.Parse(extMap,data+ini,len-ini));
+		assert(extension.hasTransportWideCC);
+		assert(extension.transportSeqNum==4321);
+		assert(extension.hasAbsSentTime);
+		assert(data[len-1]==RTPPaddingTemplate::MaxPadding);
+		
+		//Without extensions
+		assert(padding.Build(0x1234,97,RTPMap::NotFound,RTPMap::NotFound));
+		assert(padding.GetHeaderLength()==12);
+		assert(!padding.HasTransportWideCC());
+		
+		//Two byte ids are not supported
+		assert(!padding.Build(0x1234,97,15,RTPMap::NotFound));
+	}
+	
+	void testProbeClusters()
+	{
+		ProbeController controller;
+		SendSideBandwidthEstimation bwe;
+		QWORD now = 1E6;
+		
+		//First estimation starts exponential probing
+		controller.SetEstimate(500000,now);
+		assert(controller.IsStarted());
+		assert(controller.GetPendingClusters()==2);
+		
+		WORD transportSeqNum = 0;
+		DWORD cluster = 0;
+		std::vector<std::pair<DWORD,QWORD>> packets;
+		
+		//Send the first cluster on 5ms ticks
+		while (DWORD size = controller.GetProbeSize(now))
+		{
+			//Get cluster
+			if (!cluster) cluster = controller.GetActiveClusterId();
+			//Stop when the next cluster starts
+			if (cluster!=controller.GetActiveClusterId())
+				break;
+			while (size)
+			{
+				//Next transport seq num
+				++transportSeqNum;
+				//Send 300 bytes probe
+				PacketStats stats(transportSeqNum,1,transportSeqNum,300,0,0,now,false);
+				stats.probing = true;
+				stats.probeCluster = cluster;
+				bwe.SentPacket(stats);
+				controller.ProbeSent(300);
+				//Received on a link with 1mbps capacity, 2.4ms per packet
+				packets.emplace_back(transportSeqNum,1E6+transportSeqNum*2400);
+				size -= std::min<DWORD>(size,300);
+			}
+			now += 5000;
+		}
+		
+		//At 1.5mbps for 15ms
+		assert(transportSeqNum>=ProbeController::kClusterMinPackets);
+		
+		//Feedback
+		bwe.ReceivedFeedback(0,packets,now+50000);
+		
+		//Probe must have been saturated by the link
+		Log("-Probe result %u\n",bwe.GetLastProbeResult());
+		assert(bwe.GetLastProbeResult()>800000);
+		assert(bwe.GetLastProbeResult()<1000000);
+		
+		//The estimation jumps to it
+		assert(bwe.GetEstimatedBitrate()>=bwe.GetLastProbeResult());
+		
+		//Ramp-up can be started before the first estimation
+		ProbeController started;
+		started.Start(ProbeController::kStartBitrate,now);
+		assert(started.IsStarted());
+		assert(started.GetPendingClusters()==2);
+		//First estimation does not start it again
+		started.SetEstimate(100000,now);
+		assert(started.GetPendingClusters()==2);
+		
+		//A large drop schedules a recovery probe later
+		ProbeController recovery;
+		recovery.SetEstimate(2000000,now);
+		while (recovery.GetProbeSize(now)) now += 100000;
+		recovery.SetEstimate(500000,now);
+		assert(!recovery.GetPendingClusters());
+		recovery.SetEstimate(500000,now+4E6);
+		assert(recovery.GetPendingClusters()==1);
+	}
+	
+	void testFanOutBenchmark()
+	{
+		const DWORD num = 500;
+		const DWORD packets = 200;
+		EventLoop loops[2];
+		std::vector<std::unique_ptr<RTPOutgoingSourceGroup>> groups;
+		std::vector<std::unique_ptr<CountingRTPSender>> senders;
+		std::vector<std::unique_ptr<RTPStreamTransponder>> transponders;
+		RTPStreamFanOut fanOut(1);
+		
+		//Run loops without socket
+		for (auto& loop : loops)
+			loop.Start([&](){ loop.Run(); });
+		
+		//Create subscribers on two loops
+		for (DWORD i=0;i<num;++i)
+		{
+			groups.emplace_back(new RTPOutgoingSourceGroup(MediaFrame::Audio));
+			groups.back()->media.ssrc = 1000+i;
+			senders.emplace_back(new CountingRTPSender(loops[i%2]));
+			transponders.emplace_back(new RTPStreamTransponder(groups.back().get(),senders.back().get()));
+		}
+		
+		//Forward packets to each transponder, as if each one was listening the incoming stream
+		auto legacy = [&](const RTPPacket::shared& packet) {
+			for (auto& transponder : transponders)
+				transponder->onRTP(nullptr,packet);
+		};
+		//Forward packets through the fan out stage
+		auto fanned = [&](const RTPPacket::shared& packet) {
+			fanOut.onRTP(nullptr,packet);
+		};
+		
+		for (auto forward : {std::function<void(const RTPPacket::shared&)>(legacy),std::function<void(const RTPPacket::shared&)>(fanned)})
+		{
+			auto ini = std::chrono::steady_clock::now();
+			
+			//Forward packets
+			for (DWORD i=0;i<packets;++i)
+			{
+				auto packet = std::make_shared<RTPPacket>(MediaFrame::Audio,AudioCodec::OPUS);
+				packet->SetSSRC(1);
+				packet->SetExtSeqNum(1+i);
+				packet->SetTimestamp(960*i);
+				packet->SetPayload((BYTE*)"opus",4);
+				forward(packet);
+			}
+			
+			//Wait until all have been sent
+			for (auto& loop : loops)
+				loop.Sync([](...){});
+			
+			auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now()-ini).count();
+			
+			//Check all have been sent and rewritten
+			for (DWORD i=0;i<num;++i)
+			{
+				assert(senders[i]->sent==packets);
+				assert(senders[i]->last->GetSSRC()==1000+i);
+				senders[i]->sent = 0;
+			}
+			
+			Log("-FanOut 1 to %u %s: %lldus (%lldns per packet and subscriber)\n",num,fanOut.GetTransponderCount() ? "batched" : "enqueue",elapsed,elapsed*1000/(num*packets));
+			
+			//Attach all transponders to the fan out for next run
+			for (auto& transponder : transponders)
+				transponder->SetIncoming(&fanOut,nullptr);
+			
+			//Grouped by loop
+			assert(fanOut.GetLoopCount()==2);
+			assert(fanOut.GetTransponderCount()==num);
+		}
+		
+		//Detach them
+		for (auto& transponder : transponders)
+			transponder->Close();
+		assert(!fanOut.GetTransponderCount());
+		
+		for (auto& loop : loops)
+			loop.Stop();
+	}
+	
+	void testMultiplexerFanOut()
+	{
+		EventLoop loops[2];
+		RTPOutgoingSourceGroup groups[3] = {RTPOutgoingSourceGroup(MediaFrame::Audio),RTPOutgoingSourceGroup(MediaFrame::Audio),RTPOutgoingSourceGroup(MediaFrame::Audio)};
+		
+		//Run loops without socket
+		for (auto& loop : loops)
+			loop.Start([&](){ loop.Run(); });
+		
+		RTPIncomingMediaStreamMultiplexer multiplexer(1,loops[0]);
+		CountingRTPSender senders[3] = {CountingRTPSender(loops[0]),CountingRTPSender(loops[1]),CountingRTPSender(loops[1])};
+		std::vector<std::unique_ptr<RTPStreamTransponder>> transponders;
+		
+		//Attach transponders to the multiplexer
+		for (DWORD i=0;i<3;++i)
+		{
+			groups[i].media.ssrc = 1000+i;
+			transponders.emplace_back(new RTPStreamTransponder(&groups[i],&senders[i]));
+			transponders.back()->SetIncoming(&multiplexer,nullptr);
+		}
+		
+		//Batched by sender loop
+		assert(multiplexer.GetLoopCount()==2);
+		assert(multiplexer.GetTransponderCount()==3);
+		
+		auto forward = [&](DWORD num) {
+			for (DWORD i=0;i<num;++i)
+			{
+				auto packet = std::make_shared<RTPPacket>(MediaFrame::Audio,AudioCodec::OPUS);
+				packet->SetSSRC(1);
+				packet->SetExtSeqNum(1+i);
+				packet->SetTimestamp(960*i);
+				packet->SetPayload((BYTE*)"opus",4);
+				multiplexer.onRTP(nullptr,packet);
+			}
+			//Wait until dispatched and sent
+			multiplexer.Stop();
+			for (auto& loop : loops)
+				loop.Sync([](...){});
+		};
+		
+		forward(10);
+		for (DWORD i=0;i<3;++i)
+		{
+			assert(senders[i].sent==10);
+			assert(senders[i].last->GetSSRC()==1000+i);
+		}
+		
+		//Closed transponders are removed and do not send anymore
+		transponders[2]->Close();
+		assert(multiplexer.GetTransponderCount()==2);
+		forward(10);
+		assert(senders[0].sent==20);
+		assert(senders[1].sent==20);
+		assert(senders[2].sent==10);
+		
+		//Delete the rest
+		transponders.clear();
+		assert(!multiplexer.GetTransponderCount());
+		assert(!multiplexer.GetLoopCount());
+		
+		for (auto& loop : loops)
+			loop.Stop();
+	}
+	
+	void testPictureIdRewrite()
+	{
+		RTPMap extMap;
+		BYTE data[1500];
+		BYTE vp9[] = { 
+			0xac,			//I L B E
+			0x2a,			//Short picture id
+			0x00,			//Layer indices: T0 S0
+			0x07,			//TL0PICIDX
+			0x11, 0x22, 0x33, 0x44	//Payload
+		};
+		BYTE vp8[] = { 
+			0x10,			//S, no extension
+			0x55, 0x66, 0x77	//Payload
+		};
+		
+		//Create vp9 packet
+		auto packet = std::make_shared<RTPPacket>(MediaFrame::Video,VideoCodec::VP9);
+		packet->SetPayload(vp9,sizeof(vp9));
+		packet->vp9PayloadDescriptor.emplace();
+		assert(packet->vp9PayloadDescriptor->Parse(vp9,sizeof(vp9))==4);
+		
+		//Rewrite on clone with continuous ids
+		RTPStreamTransponder::Rewrite rewrite;
+		rewrite.ssrc = 0x1234;
+		rewrite.extSeqNum = 10;
+		rewrite.rewitePictureIds = true;
+		rewrite.pictureId = 0x1234;
+		rewrite.temporalLevelZeroIndex = 9;
+		auto cloned = rewrite.Apply(packet);
+		
+		//Check header and payload slices
+		const BYTE* payload = nullptr;
+		DWORD payloadLen = 0;
+		DWORD len = cloned->SerializeHeaders(data,sizeof(data),extMap,payload,payloadLen);
+		assert(len==12+5);
+		assert(payloadLen==4);
+		//Payload is not copied and it is shared with the original
+		assert(payload==packet->GetMediaData()+4);
+		
+		//Flatten
+		len = cloned->Serialize(data,sizeof(data),extMap);
+		assert(len==12+5+4);
+		
+		//Parse it back
+		VP9PayloadDescription desc;
+		assert(desc.Parse(data+12,len-12)==5);
+		assert(desc.extendedPictureIdPresent);
+		assert(desc.pictureId==0x1234);
+		assert(desc.temporalLayer0Index==9);
+		assert(memcmp(data+12+5,vp9+4,4)==0);
+		
+		//Original is untouched
+		assert(packet->vp9PayloadDescriptor->pictureId==0x2a);
+		
+		//Create vp8 packet without picture id
+		packet = std::make_shared<RTPPacket>(MediaFrame::Video,VideoCodec::VP8);
+		packet->SetPayload(vp8,sizeof(vp8));
+		packet->vp8PayloadDescriptor.emplace();
+		assert(packet->vp8PayloadDescriptor->Parse(vp8,sizeof(vp8))==1);
+		cloned = rewrite.Apply(packet);
+		
+		//Flatten, descriptor grows with the extension and picture id
+		len = cloned->Serialize(data,sizeof(data),extMap);
+		assert(len==12+4+3);
+		VP8PayloadDescriptor vp8desc;
+		assert(vp8desc.Parse(data+12,len-12)==4);
+		assert(vp8desc.pictureIdPresent);
+		assert(vp8desc.pictureId==0x1234);
+		assert(memcmp(data+12+4,vp8+1,3)==0);
+	}
+	
+
+	void testLayerAllocator()
+	{
+		EventLoop loop;
+		RTPOutgoingSourceGroup first(MediaFrame::Video);
+		RTPOutgoingSourceGroup second(MediaFrame::Video);
+		CountingRTPSender sender(loop);
+		first.media.ssrc = 1;
+		second.media.ssrc = 2;
+		RTPStreamTransponder high(&first,&sender);
+		RTPStreamTransponder low(&second,&sender);
+		BYTE payload[1000] = {};
+		
+		//Feed 200kbps on T0, 96kbps on T1 and 104kbps on T2 to both
+		DWORD seqNum = 1;
+		for (auto count : {std::make_pair(0,25),std::make_pair(1,12),std::make_pair(2,13)})
+		{
+			for (int i=0;i<count.second;++i)
+			{
+				//Non start of partition VP8 descriptor with temporal layer index
+				payload[0] = 0x80;
+				payload[1] = 0x20;
+				payload[2] = count.first<<6;
+				auto packet = std::make_shared<RTPPacket>(MediaFrame::Video,VideoCodec::VP8);
+				packet->SetSSRC(1);
+				packet->SetExtSeqNum(seqNum++);
+				packet->SetPayload(payload,sizeof(payload));
+				high.onRTP(nullptr,packet);
+				low.onRTP(nullptr,packet);
+			}
+		}
+		QWORD now = getTimeMS();
+		
+		//Check measured layers
+		auto layers = high.GetLayers(now);
+		assert(layers.size()==3);
+		assert(layers[0].temporalLayerId==0 && layers[0].bitrate==200000);
+		assert(high.GetLayerBitrate(LayerInfo::MaxLayerId,1,now)==296000);
+		assert(high.GetLayerBitrate(LayerInfo::MaxLayerId,2,now)==400000);
+		
+		//Cumulative candidates with hints
+		auto candidates = LayerAllocator::GetCandidates(layers,LayerInfo::MaxLayerId,1);
+		assert(candidates.size()==2);
+		assert(candidates[1].temporalLayerId==1 && candidates[1].bitrate==296000);
+		
+		LayerAllocator allocator;
+		allocator.AddTransponder(&high,1);
+		allocator.AddTransponder(&low,0);
+		
+		//Enough for everything
+		assert(allocator.Allocate(1000000,now)==800000);
+		assert(high.GetSelectedTemporalLayerId()==2);
+		assert(low.GetSelectedTemporalLayerId()==2);
+		
+		//Priority one keeps the top layer
+		assert(allocator.Allocate(600000,now)==600000);
+		assert(high.GetSelectedTemporalLayerId()==2);
+		assert(low.GetSelectedTemporalLayerId()==0);
+		
+		//No upgrade just after a downgrade
+		assert(allocator.Allocate(1000000,now+LayerAllocator::kAllocationInterval)==600000);
+		assert(low.GetSelectedTemporalLayerId()==0);
+		
+		//Viewport hint caps the layer
+		allocator.SetMaxLayers(&high,LayerInfo::MaxLayerId,0);
+		assert(allocator.Allocate(1000000,now+LayerAllocator::kAllocationInterval)==400000);
+		assert(high.GetSelectedTemporalLayerId()==0);
+		allocator.SetMaxLayers(&high,LayerInfo::MaxLayerId,LayerInfo::MaxLayerId);
+		
+		//Upgrades need headroom above the layer cost
+		LayerAllocator other;
+		other.AddTransponder(&low);
+		assert(other.Allocate(296000,now)==200000);
+		assert(low.GetSelectedTemporalLayerId()==0);
+		assert(other.Allocate(296000+296000*(LayerAllocator::kUpgradeHeadroom-1)+1,now)==296000);
+		assert(low.GetSelectedTemporalLayerId()==1);
+		//But it is kept when it just fits
+		assert(other.Allocate(296000,now)==296000);
+		assert(low.GetSelectedTemporalLayerId()==1);
+		
+		//Removed transponders are not touched
+		allocator.RemoveTransponder(&low);
+		assert(allocator.GetTransponderCount()==1);
+		assert(allocator.Allocate(0,now)==200000);
+		assert(low.GetSelectedTemporalLayerId()==1);
+		
+		//Video transponders are added to the allocator of their sender until closed
+		AllocatingRTPSender transport(loop);
+		RTPOutgoingSourceGroup video(MediaFrame::Video);
+		RTPOutgoingSourceGroup audio(MediaFrame::Audio);
+		RTPStreamTransponder videoTransponder(&video,&transport);
+		RTPStreamTransponder audioTransponder(&audio,&transport);
+		assert(transport.allocator.GetTransponderCount()==1);
+		videoTransponder.Close();
+		assert(transport.allocator.GetTransponderCount()==0);
+	}
+	
+
+	void testKeyFrameRequests()
+	{
+		EventLoop loop;
+		RTPIncomingSourceGroup group(MediaFrame::Video,loop);
+		DWORD sent = 0;
+		
+		//Run loop without socket
+		loop.Start([&](){ loop.Run(); });
+		
+		group.media.ssrc = 1;
+		group.SetKeyFrameRequester([&](DWORD ssrc){
+			assert(ssrc==1);
+			sent++;
+		});
+		
+		loop.Sync([&](...){
+			QWORD now = getTimeMS();
+			
+			//Lots of subscribers joining at the same time
+			assert(group.RequestKeyFrame(now));
+			for (DWORD i=1;i<100;++i)
+				assert(!group.RequestKeyFrame(now));
+			assert(group.requestedPLIs==100);
+			assert(group.forwardedPLIs==1);
+			assert(group.IsWaitingForKeyFrame());
+			
+			//Key frame arrives
+			group.onKeyFrame(now+50);
+			assert(!group.IsWaitingForKeyFrame());
+			
+			//Late joiners are delayed until the min interval expires
+			assert(!group.RequestKeyFrame(now+100));
+			assert(!group.RequestKeyFrame(now+200));
+			assert(group.forwardedPLIs==1);
+		});
+		
+		//Wait for the delayed one
+		std::this_thread::sleep_for(std::chrono::milliseconds(RTPIncomingSourceGroup::kMinKeyFrameInterval+200));
+		
+		loop.Sync([&](...){
+			assert(group.requestedPLIs==102);
+			assert(group.forwardedPLIs==2);
+			assert(sent==2);
+			
+			//Interval grows with the rtt
+			group.SetRTT(400);
+			assert(group.GetKeyFrameInterval()==800);
+			
+			//Unanswered requests are sent again after the interval
+			QWORD now = getTimeMS();
+			group.RequestKeyFrame(now+100);
+			assert(group.forwardedPLIs==2);
+			group.RequestKeyFrame(now+1000);
+			assert(group.forwardedPLIs==3);
+			assert(sent==3);
+		});
+		
+		//Nobody asks again, but the key frame does not arrive
+		std::this_thread::sleep_for(std::chrono::milliseconds(800+200));
+		
+		loop.Sync([&](...){
+			//It is resent on its own
+			assert(group.forwardedPLIs==4);
+			assert(sent==4);
+			assert(group.IsWaitingForKeyFrame());
+			
+			//Until it is served
+			group.onKeyFrame(getTimeMS());
+			assert(!group.IsWaitingForKeyFrame());
+		});
+		
+		std::this_thread::sleep_for(std::chrono::milliseconds(800+200));
+		
+		loop.Sync([&](...){
+			assert(group.forwardedPLIs==4);
+			assert(sent==4);
+			
+			group.Stop();
+		});
+		
+		loop.Stop();
+	}
+	
+
+	void testGOPCache()
+	{
+		const BYTE sps[] = { 0x67, 0x42, 0xc0, 0x1f };
+		const BYTE idr[] = { 0x65, 0x88, 0x84, 0x00 };
+		const BYTE non[] = { 0x41, 0x9a, 0x02, 0x00 };
+		
+		//Time to first frame for a subscriber joining in the middle of a 2s gop at 30fps
+		for (bool cached : {false,true})
+		{
+			EventLoop loop;
+			RTPIncomingSourceGroup group(MediaFrame::Video,loop);
+			RTPOutgoingSourceGroup outgoing(MediaFrame::Video);
+			CountingRTPSender sender(loop);
+			CountingRTPReceiver receiver;
+			RTPStreamTransponder transponder(&outgoing,&sender);
+			DWORD seqNum = 1;
+			int first = -1;
+			
+			//Run loop without socket
+			loop.Start([&](){ loop.Run(); });
+			
+			group.media.ssrc = 1;
+			outgoing.media.ssrc = 2;
+			group.SetGOPCache(cached);
+			
+			for (DWORD frame=0;frame<90;++frame)
+			{
+				//Subscriber joins in the middle of the gop
+				if (frame==30)
+				{
+					transponder.SetIncoming(&group,&receiver);
+					//Only request an intra if it has not been primed from the cache
+					assert(receiver.plis==(cached ? 0 : 1));
+				}
+				
+				loop.Sync([&](...){
+					//Key frame each 60 frames
+					std::vector<std::pair<const BYTE*,DWORD>> nals;
+					if (frame%60==0)
+						nals = {{sps,sizeof(sps)},{idr,sizeof(idr)},{idr,sizeof(idr)}};
+					else
+						nals = {{non,sizeof(non)}};
+					for (size_t i=0;i<nals.size();++i)
+					{
+						auto packet = std::make_shared<RTPPacket>(MediaFrame::Video,VideoCodec::H264);
+						packet->SetSSRC(1);
+						packet->SetSeqNum(seqNum++);
+						packet->SetTimestamp(frame*3000);
+						packet->SetMark(i==nals.size()-1);
+						packet->SetTime(getTimeMS());
+						packet->SetPayload(nals[i].first,nals[i].second);
+						group.Process(packet);
+						group.AddPacket(packet,nals[i].second);
+					}
+				});
+				//Let it dispatch and send
+				std::this_thread::sleep_for(std::chrono::milliseconds(2));
+				loop.Sync([](...){});
+				
+				//Check if first frame has been forwarded
+				if (first<0 && sender.sent)
+					first = frame;
+			}
+			
+			Log("-Time to first frame %s gop cache: %ums\n",cached ? "with" : "without",(first-30)*1000/30);
+			
+			//Without cache it has to wait for the next key frame
+			assert(first==(cached ? 30 : 60));
+			assert(!cached || group.GetGOPCacheSize()==(3+29)*sizeof(non));
+			
+			transponder.Close();
+			group.Stop();
+			loop.Stop();
+		}
+	}
+	
+
+	void testRTXController()
+	{
+		RTXController controller;
+		QWORD now = 1000;
+		
+		//First request is sent, duplicates within rtt are not
+		assert(controller.Accept(1,10,100,0,0,now));
+		assert(!controller.Accept(1,20,100,0,0,now+10));
+		assert(!controller.Accept(1,110,100,0,0,now+99));
+		assert(controller.GetSuppressedDuplicates()==2);
+		//After rtt it may have been lost again
+		assert(controller.Accept(1,110,100,0,0,now+100));
+		//Min interval when rtt is not known
+		assert(controller.Accept(2,0,0,0,0,now));
+		assert(!controller.Accept(2,0,0,0,0,now+RTXController::kMinResendInterval-1));
+		assert(controller.Accept(2,0,0,0,0,now+RTXController::kMinResendInterval));
+		
+		//Over budget
+		assert(!controller.Accept(3,10,100,310000,1000000,now));
+		assert(controller.GetSuppressedBudget()==1);
+		//Close to budget, only the ones still waited by the jitter buffer
+		assert(!controller.Accept(4,100+RTXController::kJitterBufferDelay+1,100,200000,1000000,now));
+		assert(controller.Accept(5,100,100,200000,1000000,now));
+		assert(controller.GetSuppressedLate()==1);
+		//Below, everything
+		assert(controller.Accept(4,400,100,100000,1000000,now));
+		
+		//Same slot, different seq num is not a duplicate
+		assert(controller.Accept(6+RTXController::kHistorySize,10,100,0,0,now));
+		assert(controller.Accept(6,10,100,0,0,now));
+		
+		assert(controller.GetSent()==8);
+		assert(controller.GetSuppressed()==5);
+	}
+	
+	void testLastN()
+	{
+		const DWORD num = 50;
+		const DWORD lastN = 4;
+		const DWORD ticks = 500;
+		EventLoop loop;
+		CountingRTPSender sender(loop);
+		QWORD bytes[2] = {};
+		
+		for (DWORD run=0;run<2;++run)
+		{
+			std::vector<std::unique_ptr<RTPOutgoingSourceGroup>> groups;
+			std::vector<std::unique_ptr<RTPStreamTransponder>> transponders;
+			std::map<DWORD,std::vector<RTPStreamTransponder*>> byPublisher;
+			//Forward everything on first run
+			LastNForwarder forwarder(run ? lastN : 0);
+			
+			//Everybody subscribes to everybody else
+			for (DWORD subscriber=1;subscriber<=num;++subscriber)
+			{
+				for (DWORD publisher=1;publisher<=num;++publisher)
+				{
+					if (subscriber==publisher)
+						continue;
+					groups.emplace_back(new RTPOutgoingSourceGroup(MediaFrame::Video));
+					groups.back()->media.ssrc = subscriber*1000+publisher;
+					transponders.emplace_back(new RTPStreamTransponder(groups.back().get(),&sender));
+					byPublisher[publisher].push_back(transponders.back().get());
+					forwarder.AddTransponder(subscriber,publisher,transponders.back().get());
+				}
+			}
+			
+			//Before anyone has spoken, first publishers fill the slots
+			assert(forwarder.GetForwardedCount()==(run ? num*lastN : num*(num-1)));
+			
+			//Transponder from publisher 20 to subscriber 10
+			RTPStreamTransponder* watched = byPublisher[20][9];
+			DWORD firstForwarded = 0;
+			
+			for (DWORD tick=1;tick<=ticks;++tick)
+			{
+				QWORD now = tick*20;
+				
+				//3 speakers on first half, 2 different ones on second
+				for (DWORD publisher=1;publisher<=num;++publisher)
+				{
+					bool speaking = tick<ticks/2 ? publisher<=3 : publisher==20 || publisher==21;
+					forwarder.Accumulate(publisher,speaking,speaking ? 20 : 127,now);
+				}
+				
+				//One video packet per publisher, with a key frame each second
+				for (DWORD publisher=1;publisher<=num;++publisher)
+				{
+					BYTE payload[1000] = {};
+					payload[0] = tick%50==0 ? 0x67 : 0x41;
+					auto packet = std::make_shared<RTPPacket>(MediaFrame::Video,VideoCodec::H264);
+					packet->SetSSRC(publisher);
+					packet->SetExtSeqNum(tick);
+					packet->SetTimestamp(tick*1800);
+					packet->SetMark(true);
+					packet->SetPayload(payload,sizeof(payload));
+					
+					for (auto transponder : byPublisher[publisher])
+					{
+						RTPStreamTransponder::Rewrite rewrite;
+						//Forward it
+						if (!transponder->Process(packet,rewrite))
+							continue;
+						bytes[run] += packet->GetMediaLength();
+						//First packet forwarded after entering the set
+						if (transponder==watched && tick>=ticks/2 && !firstForwarded)
+							firstForwarded = tick;
+					}
+				}
+			}
+			
+			if (run)
+			{
+				//New speakers are forwarded, each subscriber gets N videos
+				auto& speakers = forwarder.GetActiveSpeakerDetector().GetActiveSpeakers();
+				assert(speakers.size()==lastN+1);
+				assert(std::find(speakers.begin(),speakers.end(),20)!=speakers.end());
+				assert(std::find(speakers.begin(),speakers.end(),21)!=speakers.end());
+				assert(!watched->IsMuted());
+				assert(forwarder.GetForwardedCount()==num*lastN);
+				//Nothing forwarded until the key frame
+				assert(firstForwarded && firstForwarded%50==0);
+			}
+			
+			for (auto& transponder : transponders)
+			{
+				forwarder.RemoveTransponder(transponder.get());
+				transponder->Close();
+			}
+		}
+		
+		Log("-LastN %u of %u publishers: forwarded %llukbps vs %llukbps, %.1f%% saved\n",lastN,num,bytes[1]*8/(ticks*20),bytes[0]*8/(ticks*20),100.0*(bytes[0]-bytes[1])/bytes[0]);
+		
+		//Most of the bandwidth is saved
+		assert(bytes[1]*num<bytes[0]*lastN*2);
+		
+		//Ranks swapping inside the set without any speaker leaving it
+		{
+			RTPOutgoingSourceGroup first(MediaFrame::Video);
+			RTPOutgoingSourceGroup second(MediaFrame::Video);
+			first.media.ssrc = 1;
+			second.media.ssrc = 2;
+			RTPStreamTransponder fromFirst(&first,&sender);
+			RTPStreamTransponder fromSecond(&second,&sender);
+			LastNForwarder forwarder(1);
+			
+			//Subscriber 3 only gets the loudest of both
+			forwarder.AddTransponder(3,1,&fromFirst);
+			forwarder.AddTransponder(3,2,&fromSecond);
+			
+			for (DWORD tick=1;tick<=ticks;++tick)
+			{
+				//First one speaks, then the second one
+				bool speaking = tick<=ticks/2;
+				forwarder.Accumulate(1,speaking,speaking ? 20 : 127,tick*20);
+				forwarder.Accumulate(2,!speaking,!speaking ? 20 : 127,tick*20);
+				
+				//Always both on the set once processed
+				assert(tick==1 || forwarder.GetActiveSpeakerDetector().GetActiveSpeakers().size()==2);
+				
+				if (tick==ticks/2)
+					assert(!fromFirst.IsMuted() && fromSecond.IsMuted());
+			}
+			
+			//Second one is forwarded now
+			assert(forwarder.GetActiveSpeakerDetector().GetActiveSpeakers().front()==2);
+			assert(fromFirst.IsMuted() && !fromSecond.IsMuted());
+			
+			forwarder.RemoveTransponder(&fromFirst);
+			forwarder.RemoveTransponder(&fromSecond);
+			fromFirst.Close();
+			fromSecond.Close();
+		}
+	}
+	
+	void testSilenceSuppression()
+	{
+		const DWORD num = 100;
+		const DWORD packets = 500;
+		EventLoop loop;
+		CountingRTPSender sender(loop);
+		RTPOutgoingSourceGroup group(MediaFrame::Audio);
+		group.media.ssrc = 1;
+		
+		//Single stream, speaking, silent for a while and speaking again
+		RTPStreamTransponder transponder(&group,&sender);
+		transponder.SetSilenceSuppression(true);
+		
+		DWORD forwarded = 0;
+		DWORD last = 0;
+		for (DWORD i=0;i<300;++i)
+		{
+			bool speaking = i<50 || i>=250;
+			auto packet = std::make_shared<RTPPacket>(MediaFrame::Audio,AudioCodec::OPUS);
+			packet->SetSSRC(2);
+			packet->SetExtSeqNum(1000+i);
+			packet->SetTimestamp(960*i);
+			packet->SetPayload((BYTE*)"opus",4);
+			packet->SetAudioLevel(speaking,speaking ? 30 : 127);
+			
+			RTPStreamTransponder::Rewrite rewrite;
+			if (!transponder.Process(packet,rewrite))
+				continue;
+			
+			//Sequence numbers must be contiguous
+			if (forwarded)
+				assert(rewrite.extSeqNum==last+1);
+			last = rewrite.extSeqNum;
+			forwarded++;
+			
+			//Marked on begining of talkspurt
+			assert(rewrite.mark==(i==250));
+		}
+		//Speech, hangover and keep alives
+		assert(forwarded==100+RTPStreamTransponder::kSilenceHangover+(200-RTPStreamTransponder::kSilenceHangover)/RTPStreamTransponder::kSilenceKeepAlive);
+		assert(transponder.GetSuppressedPackets()==300-forwarded);
+		transponder.Close();
+		
+		//Audio room with 3 speakers, as received by one participant
+		std::vector<std::unique_ptr<RTPStreamTransponder>> transponders;
+		QWORD total[2] = {};
+		for (DWORD enabled=0;enabled<2;++enabled)
+		{
+			for (DWORD i=0;i<num-1;++i)
+			{
+				transponders.emplace_back(new RTPStreamTransponder(&group,&sender));
+				transponders.back()->SetSilenceSuppression(enabled);
+			}
+			
+			for (DWORD i=0;i<packets;++i)
+			{
+				for (DWORD j=0;j<num-1;++j)
+				{
+					bool speaking = j<3;
+					auto packet = std::make_shared<RTPPacket>(MediaFrame::Audio,AudioCodec::OPUS);
+					packet->SetSSRC(100+j);
+					packet->SetExtSeqNum(i);
+					packet->SetTimestamp(960*i);
+					packet->SetPayload((BYTE*)"opus",4);
+					packet->SetAudioLevel(speaking,speaking ? 30 : 90);
+					
+					RTPStreamTransponder::Rewrite rewrite;
+					if (transponders[j]->Process(packet,rewrite))
+						total[enabled]++;
+				}
+			}
+			
+			for (auto& transponder : transponders)
+				transponder->Close();
+			transponders.clear();
+		}
+		
+		Log("-Silence suppression %u participants: %llupps vs %llupps, %.1f%% removed\n",num,total[1]*50/packets,total[0]*50/packets,100.0*(total[0]-total[1])/total[0]);
+		
+		//Most packets are gone
+		assert(total[1]*5<total[0]);
+	}
 	
 };
 
@@ -13,6 +13,7 @@ public:
 	virtual void Execute()
 	{
 		testDescriptor();
+		testFlexibleModeRoundTrip();
 	}
 	
 	void testDescriptor()
@@ -45,6 +46,36 @@ public:
 		Dump(aux,len);
 	}
 	
+	void testFlexibleModeRoundTrip()
+	{
+		BYTE aux[1024];
+		BYTE data[] = { 
+			0xf8,			//I P L F B
+			0x80,   0x2a,		//Extended picture id
+			0x45,			//Layer indices: T2 S2
+			0x03, 0x04,		//Two P diffs
+		};
+		
+		VP9PayloadDescription desc;
+		VP9PayloadDescription parsed;
+		
+		//Parse
+		DWORD len = desc.Parse(data,sizeof(data));
+		assert(len==sizeof(data));
+		assert(desc.GetSize()==len);
+		assert(desc.referenceIndexDiff.size()==2);
+		assert(desc.spatialLayerId==2);
+		
+		//Write it back
+		len = desc.Serialize(aux,sizeof(aux));
+		assert(len==sizeof(data));
+		assert(memcmp(aux,data,len)==0);
+		
+		//Parse again
+		assert(parsed.Parse(aux,len)==len);
+		assert(parsed.referenceIndexDiff==desc.referenceIndexDiff);
+	}
+	
 };
 
 VP9Plan vp9;